@@ -4,6 +4,9 @@ SDL_IMAGE_LOCAL_PATH := $(call my-dir)
 # Enable this if you want PNG and JPG support with minimal dependencies
 USE_STBIMAGE ?= true
 
+# Enable this if you want to save GIF images, which needs no dependencies
+SUPPORT_SAVE_GIF ?= true
+
 # The additional formats below require downloading third party dependencies,
 # using the external/download.sh script.
 
@@ -81,6 +84,7 @@ LOCAL_SRC_FILES :=  \
     src/IMG_png.c       \
     src/IMG_pnm.c       \
     src/IMG_qoi.c       \
+    src/IMG_quantize.c  \
     src/IMG_stb.c       \
     src/IMG_svg.c       \
     src/IMG_tga.c       \
@@ -105,6 +109,12 @@ ifeq ($(USE_STBIMAGE),true)
     LOCAL_CFLAGS += -DLOAD_JPG -DLOAD_PNG -DUSE_STBIMAGE
 endif
 
+ifeq ($(SUPPORT_SAVE_GIF),true)
+    LOCAL_CFLAGS += -DSDL_IMAGE_SAVE_GIF=1
+else
+    LOCAL_CFLAGS += -DSDL_IMAGE_SAVE_GIF=0
+endif
+
 ifeq ($(SUPPORT_AVIF),true)
     LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(AVIF_LIBRARY_PATH)/include
     LOCAL_CFLAGS += -DLOAD_AVIF
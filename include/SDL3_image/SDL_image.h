@@ -1347,6 +1347,48 @@ extern SDL_DECLSPEC SDL_Surface * SDLCALL IMG_LoadGIF_IO(SDL_IOStream *src);
  */
 extern SDL_DECLSPEC SDL_Surface * SDLCALL IMG_LoadJPG_IO(SDL_IOStream *src);
 
+/**
+ * Load a small preview of a JPG image.
+ *
+ * If the image has an EXIF thumbnail that is at least `size` pixels on its
+ * longer side, that thumbnail is decoded and the main image data is never
+ * read. Otherwise the image itself is decoded at the smallest scale of 1/8,
+ * 1/4 or 1/2 that keeps its longer side at least `size` pixels, or at full
+ * size if it is already smaller than that.
+ *
+ * EXIF thumbnails are stored unrotated, the EXIF orientation is not applied.
+ *
+ * \param src an SDL_IOStream to load image data from.
+ * \param size the minimum length of the longer side of the returned image,
+ *             or 0 to accept any thumbnail and fall back to a 1/8 scale
+ *             decode.
+ * \returns SDL surface, or NULL on error.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_LoadJPG_IO
+ */
+extern SDL_DECLSPEC SDL_Surface * SDLCALL IMG_LoadJPGThumbnail_IO(SDL_IOStream *src, int size);
+
+/**
+ * A variable controlling the speed/quality tradeoff when decoding JPEG
+ * images.
+ *
+ * The variable can be set to the following values:
+ *
+ * - "accurate": Use the slow but accurate integer DCT and fancy chroma
+ *   upsampling. (default)
+ * - "fast": Use the fast integer DCT and simple chroma upsampling.
+ * - "fastest": Use the fastest DCT available, simple chroma upsampling and
+ *   no block smoothing. Intended for previews and thumbnails.
+ *
+ * This hint is checked each time a JPEG image is loaded, and only has an
+ * effect when SDL_image is built with libjpeg.
+ *
+ * \since This hint is available since SDL_image 3.4.0.
+ */
+#define IMG_HINT_JPG_DECODE_MODE    "SDL_IMAGE_JPG_DECODE_MODE"
+
 /**
  * Load a JXL image directly.
  *
@@ -1483,6 +1525,127 @@ extern SDL_DECLSPEC SDL_Surface * SDLCALL IMG_LoadPCX_IO(SDL_IOStream *src);
  */
 extern SDL_DECLSPEC SDL_Surface * SDLCALL IMG_LoadPNG_IO(SDL_IOStream *src);
 
+/**
+ * A variable controlling whether 16-bit per channel PNG images keep their
+ * full precision when loaded.
+ *
+ * The variable can be set to the following values:
+ *
+ * - "0": 16-bit samples are reduced to 8 bits. (default)
+ * - "1": Images with 16-bit samples are loaded as SDL_PIXELFORMAT_RGB48 or
+ *   SDL_PIXELFORMAT_RGBA64 surfaces, with grayscale expanded to RGB and
+ *   transparent color keys expanded to an alpha channel.
+ *
+ * This hint is checked each time a PNG image is loaded.
+ *
+ * \since This hint is available since SDL_image 3.4.0.
+ */
+#define IMG_HINT_PNG_LOAD_16BIT     "SDL_IMAGE_PNG_LOAD_16BIT"
+
+/**
+ * A variable controlling whether the checksums in PNG images are verified
+ * when they're loaded.
+ *
+ * Skipping them saves computing the CRC-32 of every chunk and the Adler-32
+ * of all the image data. This is only meant for images that are known to be
+ * intact, e.g. from an asset archive that has already been verified, as
+ * corrupted image data may then be decoded into garbage instead of failing.
+ *
+ * The variable can be set to the following values:
+ *
+ * - "0": Chunk CRCs and the zlib Adler-32 checksum are verified. (default)
+ * - "1": Checksums are not computed or verified.
+ *
+ * This hint is checked each time a PNG image is loaded.
+ *
+ * \since This hint is available since SDL_image 3.4.0.
+ */
+#define IMG_HINT_PNG_SKIP_CHECKSUMS "SDL_IMAGE_PNG_SKIP_CHECKSUMS"
+
+/**
+ * An object that decodes a PNG image incrementally, as its data arrives.
+ *
+ * \since This struct is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_CreatePNGStream
+ */
+typedef struct IMG_PNGStream IMG_PNGStream;
+
+/**
+ * A callback that is called as the rows of a PNG image are decoded.
+ *
+ * `surface` is the image being decoded, which only has valid pixels in the
+ * rows that have been reported so far. It is owned by the stream and should
+ * not be freed.
+ *
+ * Interlaced images are decoded in 7 passes, each of which fills in more of
+ * the pixels of the rows it reports, so the surface can be displayed as a
+ * progressively more detailed preview. Non-interlaced images report each row
+ * once, with a pass of 0.
+ *
+ * \param userdata what was passed as `userdata` to IMG_CreatePNGStream().
+ * \param surface the surface the image is being decoded into.
+ * \param row the row that was just decoded.
+ * \param pass the interlace pass the row was decoded in, from 0 to 6.
+ *
+ * \since This datatype is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_CreatePNGStream
+ */
+typedef void (SDLCALL *IMG_PNGRowCallback)(void *userdata, SDL_Surface *surface, int row, int pass);
+
+/**
+ * Create a stream to decode a PNG image as its data arrives.
+ *
+ * Data is passed to the stream with IMG_FeedPNGStream() in pieces of any
+ * size, for example as they are received from a network socket, and rows
+ * are reported to `callback` as soon as they can be decoded. Only a small
+ * amount of data is buffered between calls.
+ *
+ * When built without libpng, the image is decoded when the stream is closed
+ * and all the rows are reported then.
+ *
+ * \param callback a function to call as rows are decoded, may be NULL.
+ * \param userdata a pointer that is passed to `callback`.
+ * \returns a new IMG_PNGStream, or NULL on error.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_FeedPNGStream
+ * \sa IMG_ClosePNGStream
+ */
+extern SDL_DECLSPEC IMG_PNGStream * SDLCALL IMG_CreatePNGStream(IMG_PNGRowCallback callback, void *userdata);
+
+/**
+ * Pass more PNG data to a stream.
+ *
+ * \param stream the IMG_PNGStream to decode with.
+ * \param data the next bytes of the PNG file.
+ * \param size the number of bytes in `data`.
+ * \returns true on success or false if the data couldn't be decoded; call
+ *          SDL_GetError() for more information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_CreatePNGStream
+ * \sa IMG_ClosePNGStream
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_FeedPNGStream(IMG_PNGStream *stream, const void *data, size_t size);
+
+/**
+ * Finish decoding and free a PNG stream.
+ *
+ * \param stream the IMG_PNGStream to close.
+ * \returns the decoded image, or NULL if the image was incomplete or
+ *          couldn't be decoded; call SDL_GetError() for more information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_CreatePNGStream
+ * \sa IMG_FeedPNGStream
+ */
+extern SDL_DECLSPEC SDL_Surface * SDLCALL IMG_ClosePNGStream(IMG_PNGStream *stream);
+
 /**
  * Load a PNM image directly.
  *
@@ -1926,6 +2089,126 @@ extern SDL_DECLSPEC bool SDLCALL IMG_SavePNG(SDL_Surface *surface, const char *f
  */
 extern SDL_DECLSPEC bool SDLCALL IMG_SavePNG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio);
 
+/**
+ * Deflate strategies for PNG encoding.
+ *
+ * These match the zlib strategies of the same name.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SavePNGWithProperties
+ */
+typedef enum IMG_PNGStrategy
+{
+    IMG_PNG_STRATEGY_DEFAULT,       /**< Normal LZ77 matching and Huffman coding */
+    IMG_PNG_STRATEGY_FILTERED,      /**< Favor Huffman coding over short matches, good for filtered rows */
+    IMG_PNG_STRATEGY_HUFFMAN_ONLY,  /**< Huffman coding only, no string matching */
+    IMG_PNG_STRATEGY_RLE,           /**< Only match runs of the previous byte */
+    IMG_PNG_STRATEGY_FIXED          /**< Use only the fixed Huffman tables */
+} IMG_PNGStrategy;
+
+/**
+ * Row filters for PNG encoding.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SavePNGWithProperties
+ */
+typedef enum IMG_PNGFilter
+{
+    IMG_PNG_FILTER_DEFAULT,     /**< Let the encoder choose */
+    IMG_PNG_FILTER_NONE,        /**< Store rows unfiltered, fastest */
+    IMG_PNG_FILTER_SUB,         /**< Difference from the pixel to the left */
+    IMG_PNG_FILTER_UP,          /**< Difference from the pixel above */
+    IMG_PNG_FILTER_AVERAGE,     /**< Difference from the average of the pixels to the left and above */
+    IMG_PNG_FILTER_PAETH,       /**< Difference from the Paeth predictor */
+    IMG_PNG_FILTER_ADAPTIVE     /**< Pick the best filter for each row, slowest */
+} IMG_PNGFilter;
+
+/**
+ * Encoder presets for PNG encoding.
+ *
+ * A preset selects a starting point for the other PNG save properties, any
+ * of which can still be overridden individually.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SavePNGWithProperties
+ */
+typedef enum IMG_PNGPreset
+{
+    IMG_PNG_PRESET_DEFAULT,     /**< Compression level 6, default strategy and filter */
+    IMG_PNG_PRESET_FAST,        /**< Compression level 1, sub filter, suitable for real time capture */
+    IMG_PNG_PRESET_SMALL        /**< Compression level 9, adaptive filter */
+} IMG_PNGPreset;
+
+/**
+ * Dithering modes used when quantizing colors for a palette.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SavePNGWithProperties
+ * \sa IMG_SaveGIFWithProperties
+ */
+typedef enum IMG_DitherMode
+{
+    IMG_DITHER_NONE,            /**< Map each pixel to the nearest palette color */
+    IMG_DITHER_ORDERED,         /**< Add a fixed pattern, which stays in place from frame to frame */
+    IMG_DITHER_FLOYD_STEINBERG  /**< Spread the error of each pixel to its neighbors */
+} IMG_DitherMode;
+
+/**
+ * Save an SDL_Surface into PNG image data, via an SDL_IOStream, with encoder
+ * options.
+ *
+ * These are the supported properties:
+ *
+ * - `IMG_PROP_PNG_SAVE_PRESET_NUMBER`: an IMG_PNGPreset value, applied
+ *   before any of the other properties, defaults to IMG_PNG_PRESET_DEFAULT.
+ * - `IMG_PROP_PNG_SAVE_COMPRESSION_LEVEL_NUMBER`: the deflate compression
+ *   level, from 0 (store only) to 9 (smallest output), defaults to 6.
+ * - `IMG_PROP_PNG_SAVE_STRATEGY_NUMBER`: an IMG_PNGStrategy value.
+ * - `IMG_PROP_PNG_SAVE_FILTER_NUMBER`: an IMG_PNGFilter value.
+ * - `IMG_PROP_PNG_SAVE_THREADS_NUMBER`: the number of threads to encode
+ *   with, or 0 to use one per logical CPU core, defaults to 1. Large images
+ *   are split into horizontal stripes that are filtered and deflated in
+ *   parallel by the built-in encoder instead of libpng, and are written as
+ *   32-bit RGBA. Surfaces with a palette still go through libpng when it is
+ *   available.
+ * - `IMG_PROP_PNG_SAVE_PALETTE_COLORS_NUMBER`: the maximum number of colors,
+ *   from 2 to 256, to reduce surfaces without a palette to, or 0 to save
+ *   them with full color, defaults to 0. Images with no more distinct colors
+ *   than this are stored exactly, others are quantized with median cut. The
+ *   image is written with a palette, a tRNS chunk for translucent colors and
+ *   as few bits per pixel as the number of colors allows.
+ * - `IMG_PROP_PNG_SAVE_DITHER_NUMBER`: an IMG_DitherMode value used when
+ *   quantizing colors, defaults to IMG_DITHER_NONE.
+ *
+ * If `closeio` is true, `dst` will be closed before returning, whether this
+ * function succeeds or not.
+ *
+ * \param surface the SDL surface to save.
+ * \param dst the SDL_IOStream to save the image data to.
+ * \param closeio true to close/free the SDL_IOStream before returning, false
+ *                to leave it open.
+ * \param props the properties of the encoder, may be 0 for defaults.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SavePNG_IO
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SavePNGWithProperties(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props);
+
+#define IMG_PROP_PNG_SAVE_PRESET_NUMBER             "SDL_image.png.save.preset"
+#define IMG_PROP_PNG_SAVE_COMPRESSION_LEVEL_NUMBER  "SDL_image.png.save.compression_level"
+#define IMG_PROP_PNG_SAVE_STRATEGY_NUMBER           "SDL_image.png.save.strategy"
+#define IMG_PROP_PNG_SAVE_FILTER_NUMBER             "SDL_image.png.save.filter"
+#define IMG_PROP_PNG_SAVE_THREADS_NUMBER            "SDL_image.png.save.threads"
+#define IMG_PROP_PNG_SAVE_PALETTE_COLORS_NUMBER     "SDL_image.png.save.palette_colors"
+#define IMG_PROP_PNG_SAVE_DITHER_NUMBER             "SDL_image.png.save.dither"
+
 /**
  * Save an SDL_Surface into a JPEG image file.
  *
@@ -1967,6 +2250,249 @@ extern SDL_DECLSPEC bool SDLCALL IMG_SaveJPG(SDL_Surface *surface, const char *f
  */
 extern SDL_DECLSPEC bool SDLCALL IMG_SaveJPG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, int quality);
 
+/**
+ * Chroma subsampling modes for JPEG encoding.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveJPGWithProperties
+ */
+typedef enum IMG_JPGSubsampling
+{
+    IMG_JPG_SUBSAMPLING_444,    /**< No chroma subsampling, best color fidelity */
+    IMG_JPG_SUBSAMPLING_422,    /**< Chroma halved horizontally */
+    IMG_JPG_SUBSAMPLING_420     /**< Chroma halved horizontally and vertically, smallest output */
+} IMG_JPGSubsampling;
+
+/**
+ * DCT implementations for JPEG encoding.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveJPGWithProperties
+ */
+typedef enum IMG_JPGDCTMethod
+{
+    IMG_JPG_DCT_ISLOW,          /**< Accurate integer DCT */
+    IMG_JPG_DCT_IFAST,          /**< Faster, less accurate integer DCT */
+    IMG_JPG_DCT_FLOAT           /**< Floating point DCT */
+} IMG_JPGDCTMethod;
+
+/**
+ * Encoder presets for JPEG encoding.
+ *
+ * A preset selects a starting point for the other JPEG save properties, any
+ * of which can still be overridden individually.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveJPGWithProperties
+ */
+typedef enum IMG_JPGPreset
+{
+    IMG_JPG_PRESET_DEFAULT,     /**< Baseline, 4:2:0, accurate DCT, default Huffman tables */
+    IMG_JPG_PRESET_FAST,        /**< Baseline, 4:2:0, fast DCT, default Huffman tables */
+    IMG_JPG_PRESET_SMALL        /**< Progressive, 4:2:0, accurate DCT, optimized Huffman tables */
+} IMG_JPGPreset;
+
+/**
+ * Save an SDL_Surface into JPEG image data, via an SDL_IOStream, with
+ * encoder options.
+ *
+ * These are the supported properties:
+ *
+ * - `IMG_PROP_JPG_SAVE_PRESET_NUMBER`: an IMG_JPGPreset value, applied
+ *   before any of the other properties, defaults to IMG_JPG_PRESET_DEFAULT.
+ * - `IMG_PROP_JPG_SAVE_QUALITY_NUMBER`: the quality, from 0 to 100, defaults
+ *   to 90.
+ * - `IMG_PROP_JPG_SAVE_PROGRESSIVE_BOOLEAN`: true to write a progressive
+ *   JPEG.
+ * - `IMG_PROP_JPG_SAVE_OPTIMIZE_BOOLEAN`: true to compute optimal Huffman
+ *   tables for the image, which makes the file smaller at the cost of an
+ *   extra pass over the data.
+ * - `IMG_PROP_JPG_SAVE_SUBSAMPLING_NUMBER`: an IMG_JPGSubsampling value.
+ * - `IMG_PROP_JPG_SAVE_RESTART_INTERVAL_NUMBER`: the number of MCU blocks
+ *   between restart markers, or 0 for none, defaults to 0.
+ * - `IMG_PROP_JPG_SAVE_DCT_METHOD_NUMBER`: an IMG_JPGDCTMethod value.
+ * - `IMG_PROP_JPG_SAVE_THREADS_NUMBER`: the number of threads to encode
+ *   with, or 0 to use one per logical CPU core, defaults to 1. Large images
+ *   are split into horizontal stripes that are encoded in parallel and joined
+ *   with restart markers. This is ignored for progressive or optimized
+ *   images, which are always encoded on the calling thread.
+ *
+ * When SDL_image is built without libjpeg, or libjpeg can't be loaded at
+ * runtime, the fallback encoder only honors the quality and writes baseline
+ * 4:4:4 images.
+ *
+ * If `closeio` is true, `dst` will be closed before returning, whether this
+ * function succeeds or not.
+ *
+ * \param surface the SDL surface to save.
+ * \param dst the SDL_IOStream to save the image data to.
+ * \param closeio true to close/free the SDL_IOStream before returning, false
+ *                to leave it open.
+ * \param props the properties of the encoder, may be 0 for defaults.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveJPG_IO
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SaveJPGWithProperties(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props);
+
+#define IMG_PROP_JPG_SAVE_PRESET_NUMBER             "SDL_image.jpg.save.preset"
+#define IMG_PROP_JPG_SAVE_QUALITY_NUMBER            "SDL_image.jpg.save.quality"
+#define IMG_PROP_JPG_SAVE_PROGRESSIVE_BOOLEAN       "SDL_image.jpg.save.progressive"
+#define IMG_PROP_JPG_SAVE_OPTIMIZE_BOOLEAN          "SDL_image.jpg.save.optimize"
+#define IMG_PROP_JPG_SAVE_SUBSAMPLING_NUMBER        "SDL_image.jpg.save.subsampling"
+#define IMG_PROP_JPG_SAVE_RESTART_INTERVAL_NUMBER   "SDL_image.jpg.save.restart_interval"
+#define IMG_PROP_JPG_SAVE_DCT_METHOD_NUMBER         "SDL_image.jpg.save.dct_method"
+#define IMG_PROP_JPG_SAVE_THREADS_NUMBER            "SDL_image.jpg.save.threads"
+
+/**
+ * Save an SDL_Surface into a GIF image file.
+ *
+ * If the file already exists, it will be overwritten.
+ *
+ * \param surface the SDL surface to save.
+ * \param file path on the filesystem to write new file to.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveGIF_IO
+ * \sa IMG_SaveGIFWithProperties
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SaveGIF(SDL_Surface *surface, const char *file);
+
+/**
+ * Save an SDL_Surface into GIF image data, via an SDL_IOStream.
+ *
+ * If you just want to save to a filename, you can use IMG_SaveGIF() instead.
+ *
+ * Pixels with an alpha value below 128 are stored as transparent, the others
+ * as opaque. An image with no more than 256 distinct colors is stored
+ * exactly, others are quantized to a 256 color palette.
+ *
+ * If `closeio` is true, `dst` will be closed before returning, whether this
+ * function succeeds or not.
+ *
+ * \param surface the SDL surface to save.
+ * \param dst the SDL_IOStream to save the image data to.
+ * \param closeio true to close/free the SDL_IOStream before returning, false
+ *                to leave it open.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveGIF
+ * \sa IMG_SaveGIFWithProperties
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SaveGIF_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio);
+
+/**
+ * Save an SDL_Surface into GIF image data, via an SDL_IOStream, with encoder
+ * options.
+ *
+ * These are the supported properties:
+ *
+ * - `IMG_PROP_GIF_SAVE_PALETTE_COLORS_NUMBER`: the maximum number of colors
+ *   in a palette, from 2 to 256, defaults to 256. Images with no more
+ *   distinct colors than this are stored exactly, others are quantized with
+ *   median cut.
+ * - `IMG_PROP_GIF_SAVE_DITHER_NUMBER`: an IMG_DitherMode value used when
+ *   quantizing colors, defaults to IMG_DITHER_NONE.
+ * - `IMG_PROP_GIF_SAVE_LOOP_COUNT_NUMBER`: the number of times an animation
+ *   is played, or 0 to loop forever, defaults to 0.
+ * - `IMG_PROP_GIF_SAVE_OPTIMIZE_BOOLEAN`: true to store only the area of
+ *   each animation frame that changes, defaults to true.
+ *
+ * If `closeio` is true, `dst` will be closed before returning, whether this
+ * function succeeds or not.
+ *
+ * \param surface the SDL surface to save.
+ * \param dst the SDL_IOStream to save the image data to.
+ * \param closeio true to close/free the SDL_IOStream before returning, false
+ *                to leave it open.
+ * \param props the properties of the encoder, may be 0 for defaults.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveGIF_IO
+ * \sa IMG_SaveGIFAnimationWithProperties
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SaveGIFWithProperties(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props);
+
+#define IMG_PROP_GIF_SAVE_PALETTE_COLORS_NUMBER     "SDL_image.gif.save.palette_colors"
+#define IMG_PROP_GIF_SAVE_DITHER_NUMBER             "SDL_image.gif.save.dither"
+#define IMG_PROP_GIF_SAVE_LOOP_COUNT_NUMBER         "SDL_image.gif.save.loop_count"
+#define IMG_PROP_GIF_SAVE_OPTIMIZE_BOOLEAN          "SDL_image.gif.save.optimize"
+
+/**
+ * Lossless JPEG transformations.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_TransformJPG_IO
+ */
+typedef enum IMG_JPGTransform
+{
+    IMG_JPG_TRANSFORM_NONE,         /**< Leave the image as is, useful with cropping */
+    IMG_JPG_TRANSFORM_FLIP_H,       /**< Mirror the image horizontally */
+    IMG_JPG_TRANSFORM_FLIP_V,       /**< Mirror the image vertically */
+    IMG_JPG_TRANSFORM_TRANSPOSE,    /**< Mirror the image across the top-left to bottom-right diagonal */
+    IMG_JPG_TRANSFORM_TRANSVERSE,   /**< Mirror the image across the top-right to bottom-left diagonal */
+    IMG_JPG_TRANSFORM_ROTATE_90,    /**< Rotate the image 90 degrees clockwise */
+    IMG_JPG_TRANSFORM_ROTATE_180,   /**< Rotate the image 180 degrees */
+    IMG_JPG_TRANSFORM_ROTATE_270,   /**< Rotate the image 270 degrees clockwise */
+    IMG_JPG_TRANSFORM_EXIF          /**< Apply the EXIF orientation of the image, and reset it to normal */
+} IMG_JPGTransform;
+
+/**
+ * Losslessly transform and crop JPEG image data.
+ *
+ * This works directly on the compressed DCT coefficients, so no image
+ * quality is lost and it is much faster than decoding and encoding the image
+ * again. All APPn and COM markers, including EXIF metadata, are copied to the
+ * output. Progressive images stay progressive, other images are written with
+ * optimized Huffman tables.
+ *
+ * The coefficients are stored in blocks of 8x8 to 16x16 pixels depending on
+ * the chroma subsampling of the image, and only whole blocks can be moved. As
+ * a result:
+ *
+ * - The top-left corner of `crop` is moved up and left to the closest block
+ *   boundary, with the width and height growing to still cover the
+ *   requested area.
+ * - Partial blocks on an edge that a transform would move to the top or left
+ *   of the image are dropped, so the output may be a few pixels smaller than
+ *   expected, just like `jpegtran -trim`.
+ *
+ * This function is only available when SDL_image uses libjpeg.
+ *
+ * If `closeio` is true, `src` and `dst` will be closed before returning,
+ * whether this function succeeds or not.
+ *
+ * \param src an SDL_IOStream containing JPEG image data.
+ * \param dst the SDL_IOStream to save the transformed image data to.
+ * \param closeio true to close/free both SDL_IOStreams before returning,
+ *                false to leave them open.
+ * \param transform the IMG_JPGTransform to apply.
+ * \param crop the area of the source image to keep, in source pixel
+ *             coordinates, or NULL to keep the whole image. The crop is
+ *             applied before the transform.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_TransformJPG_IO(SDL_IOStream *src, SDL_IOStream *dst, bool closeio, IMG_JPGTransform transform, const SDL_Rect *crop);
+
 /**
  * Animated image support
  *
@@ -2070,6 +2596,11 @@ extern SDL_DECLSPEC void SDLCALL IMG_FreeAnimation(IMG_Animation *anim);
  * better to use the abstract interfaces; also, there is only an SDL_IOStream
  * interface available here.
  *
+ * If every frame uses the global color table, and any transparent color is
+ * the same in all frames, the frames are SDL_PIXELFORMAT_INDEX8 surfaces
+ * sharing a palette, with the transparent color set as the color key.
+ * Otherwise they are 32-bit surfaces.
+ *
  * \param src an SDL_IOStream that data will be read from.
  * \returns a new IMG_Animation, or NULL on error.
  *
@@ -2082,6 +2613,26 @@ extern SDL_DECLSPEC void SDLCALL IMG_FreeAnimation(IMG_Animation *anim);
  */
 extern SDL_DECLSPEC IMG_Animation * SDLCALL IMG_LoadGIFAnimation_IO(SDL_IOStream *src);
 
+/**
+ * A variable controlling the number of threads used to load GIF animations.
+ *
+ * A GIF animation is first read into memory and scanned for the position of
+ * every frame. When this is more than one, the compressed image data of the
+ * frames is then decoded on several threads at once, and finally the frames
+ * are composited in order. This only applies to loading a whole animation,
+ * an animation decoder always works on the calling thread.
+ *
+ * The variable can be set to the number of threads, or "0" to use one per
+ * logical CPU core. (default "1")
+ *
+ * This hint is checked each time a GIF animation is loaded.
+ *
+ * \since This hint is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_LoadGIFAnimation_IO
+ */
+#define IMG_HINT_GIF_LOAD_THREADS   "SDL_IMAGE_GIF_LOAD_THREADS"
+
 /**
  * Load a WEBP animation directly.
  *
@@ -2102,6 +2653,440 @@ extern SDL_DECLSPEC IMG_Animation * SDLCALL IMG_LoadGIFAnimation_IO(SDL_IOStream
  */
 extern SDL_DECLSPEC IMG_Animation * SDLCALL IMG_LoadWEBPAnimation_IO(SDL_IOStream *src);
 
+/**
+ * Load an animated PNG (APNG) directly.
+ *
+ * If you know you definitely have a PNG image, you can call this function,
+ * which will skip SDL_image's file format detection routines. Generally it's
+ * better to use the abstract interfaces; also, there is only an SDL_IOStream
+ * interface available here.
+ *
+ * The frames are fully composited RGBA32 surfaces. A PNG image without
+ * animation is returned as a single frame.
+ *
+ * \param src an SDL_IOStream that data will be read from.
+ * \returns a new IMG_Animation, or NULL on error.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_LoadAnimation
+ * \sa IMG_LoadAnimation_IO
+ * \sa IMG_LoadAnimationTyped_IO
+ * \sa IMG_FreeAnimation
+ */
+extern SDL_DECLSPEC IMG_Animation * SDLCALL IMG_LoadPNGAnimation_IO(SDL_IOStream *src);
+
+/**
+ * Save an animation into GIF image data, via an SDL_IOStream.
+ *
+ * Each frame is compared with what is on screen before it, and only the area
+ * that changes is stored, with the pixels in it that stay the same left
+ * transparent. Frames that change nothing are merged into the previous one.
+ * If all the frames together have no more than 256 distinct colors, they
+ * share one palette and are stored exactly, otherwise each frame is quantized
+ * to a palette of its own.
+ *
+ * Frame delays are stored in hundredths of a second, and delays shorter than
+ * 20 milliseconds are raised to 20, since many viewers play those frames
+ * much slower.
+ *
+ * If `closeio` is true, `dst` will be closed before returning, whether this
+ * function succeeds or not.
+ *
+ * \param anim the animation to save.
+ * \param dst the SDL_IOStream to save the image data to.
+ * \param closeio true to close/free the SDL_IOStream before returning, false
+ *                to leave it open.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveGIFAnimationWithProperties
+ * \sa IMG_LoadGIFAnimation_IO
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SaveGIFAnimation_IO(IMG_Animation *anim, SDL_IOStream *dst, bool closeio);
+
+/**
+ * Save an animation into GIF image data, via an SDL_IOStream, with encoder
+ * options.
+ *
+ * This supports the same properties as IMG_SaveGIFWithProperties().
+ *
+ * If `closeio` is true, `dst` will be closed before returning, whether this
+ * function succeeds or not.
+ *
+ * \param anim the animation to save.
+ * \param dst the SDL_IOStream to save the image data to.
+ * \param closeio true to close/free the SDL_IOStream before returning, false
+ *                to leave it open.
+ * \param props the properties of the encoder, may be 0 for defaults.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_SaveGIFAnimation_IO
+ * \sa IMG_SaveGIFWithProperties
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SaveGIFAnimationWithProperties(IMG_Animation *anim, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props);
+
+/**
+ * An object that decodes an animation one frame at a time.
+ *
+ * Unlike IMG_LoadAnimation(), which keeps every frame of the animation in
+ * memory, a decoder only keeps the frame being composited, so long or large
+ * animations can be played back in a small, constant amount of memory.
+ *
+ * \since This struct is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_CreateAnimationDecoder
+ * \sa IMG_CreateAnimationDecoder_IO
+ */
+typedef struct IMG_AnimationDecoder IMG_AnimationDecoder;
+
+/**
+ * The state of an animation decoder.
+ *
+ * \since This enum is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_GetAnimationDecoderStatus
+ */
+typedef enum IMG_AnimationDecoderStatus
+{
+    IMG_DECODER_STATUS_OK,          /**< The next frame can be decoded */
+    IMG_DECODER_STATUS_FAILED,      /**< The last frame couldn't be decoded */
+    IMG_DECODER_STATUS_COMPLETE     /**< All the frames have been decoded */
+} IMG_AnimationDecoderStatus;
+
+/**
+ * Create a decoder to read an animation from a file one frame at a time.
+ *
+ * When done with the returned decoder, the app should dispose of it with a
+ * call to IMG_CloseAnimationDecoder().
+ *
+ * \param file path on the filesystem containing an animated image.
+ * \returns a new IMG_AnimationDecoder, or NULL on error.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_CreateAnimationDecoder_IO
+ * \sa IMG_GetAnimationDecoderFrame
+ * \sa IMG_CloseAnimationDecoder
+ */
+extern SDL_DECLSPEC IMG_AnimationDecoder * SDLCALL IMG_CreateAnimationDecoder(const char *file);
+
+/**
+ * Create a decoder to read an animation from an SDL_IOStream one frame at a
+ * time.
+ *
+ * GIF and WEBP animations are decoded as the frames are requested. GIF data
+ * is read from `src` as it's needed, so `src` must stay valid and seekable
+ * until the decoder is closed, while the compressed WEBP data is read into
+ * memory up front. Other animated formats are fully decoded when the decoder
+ * is created.
+ *
+ * If `closeio` is true, `src` will be closed when the decoder is closed, or
+ * before returning if this function fails.
+ *
+ * \param src an SDL_IOStream that data will be read from.
+ * \param closeio true to close/free the SDL_IOStream when the decoder is
+ *                closed, false to leave it open.
+ * \param type a filename extension that represent this data ("GIF", etc),
+ *             may be NULL.
+ * \returns a new IMG_AnimationDecoder, or NULL on error.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_CreateAnimationDecoder
+ * \sa IMG_GetAnimationDecoderFrame
+ * \sa IMG_CloseAnimationDecoder
+ */
+extern SDL_DECLSPEC IMG_AnimationDecoder * SDLCALL IMG_CreateAnimationDecoder_IO(SDL_IOStream *src, bool closeio, const char *type);
+
+/**
+ * Get the size of the frames of an animation.
+ *
+ * \param decoder the IMG_AnimationDecoder to query.
+ * \param w a pointer filled in with the width of the frames, may be NULL.
+ * \param h a pointer filled in with the height of the frames, may be NULL.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_GetAnimationDecoderFrame
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_GetAnimationDecoderSize(IMG_AnimationDecoder *decoder, int *w, int *h);
+
+/**
+ * Decode the next frame of an animation.
+ *
+ * The fully composited frame is copied into `frame`, which must be exactly
+ * the size returned by IMG_GetAnimationDecoderSize() and can be in any pixel
+ * format SDL can blit to. The same surface can be reused for every frame.
+ *
+ * This function returns false when there are no more frames or the frame
+ * couldn't be decoded; IMG_GetAnimationDecoderStatus() tells the two apart.
+ *
+ * \param decoder the IMG_AnimationDecoder to decode with.
+ * \param frame the surface to copy the frame into.
+ * \param delay a pointer filled in with how long the frame should be shown,
+ *              in milliseconds, may be NULL.
+ * \returns true if a frame was decoded or false otherwise; call
+ *          SDL_GetError() for more information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_GetAnimationDecoderSize
+ * \sa IMG_GetAnimationDecoderStatus
+ * \sa IMG_RewindAnimationDecoder
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_GetAnimationDecoderFrame(IMG_AnimationDecoder *decoder, SDL_Surface *frame, int *delay);
+
+/**
+ * Get the state of an animation decoder.
+ *
+ * \param decoder the IMG_AnimationDecoder to query.
+ * \returns IMG_DECODER_STATUS_OK if more frames can be decoded,
+ *          IMG_DECODER_STATUS_COMPLETE after the last frame, or
+ *          IMG_DECODER_STATUS_FAILED if a frame couldn't be decoded.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_GetAnimationDecoderFrame
+ */
+extern SDL_DECLSPEC IMG_AnimationDecoderStatus SDLCALL IMG_GetAnimationDecoderStatus(IMG_AnimationDecoder *decoder);
+
+/**
+ * Go back to the first frame of an animation.
+ *
+ * This is typically used to loop an animation once
+ * IMG_GetAnimationDecoderStatus() returns IMG_DECODER_STATUS_COMPLETE.
+ *
+ * \param decoder the IMG_AnimationDecoder to rewind.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_GetAnimationDecoderFrame
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_RewindAnimationDecoder(IMG_AnimationDecoder *decoder);
+
+/**
+ * Move an animation decoder to a frame.
+ *
+ * The next call to IMG_GetAnimationDecoderFrame() returns the frame at
+ * `index`, where the first frame is 0.
+ *
+ * GIF and WEBP animations are composited starting from the nearest frame at
+ * or before `index` that doesn't depend on earlier frames, such as a frame
+ * that covers the whole image or one that follows a frame disposed to the
+ * background, so only the frames in between are decoded. Seeking forward to a
+ * later frame than the current one continues from the current frame if that
+ * is closer.
+ *
+ * \param decoder the IMG_AnimationDecoder to seek.
+ * \param index the index of the frame to go to.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_GetAnimationDecoderFrame
+ * \sa IMG_SeekAnimationDecoderToTime
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SeekAnimationDecoder(IMG_AnimationDecoder *decoder, int index);
+
+/**
+ * Move an animation decoder to the frame that is showing at a point in time.
+ *
+ * The time is measured from the start of the first frame, adding up the
+ * delay of each frame, without looping. The next call to
+ * IMG_GetAnimationDecoderFrame() returns the frame that is showing at that
+ * time, which is the last frame that starts at or before it, so frames with
+ * a delay of 0 are skipped. If every frame has a delay of 0, this goes to the
+ * first frame.
+ *
+ * \param decoder the IMG_AnimationDecoder to seek.
+ * \param ms the time from the start of the animation, in milliseconds.
+ * \param index a pointer filled in with the index of the frame, may be NULL.
+ * \returns true on success or false on failure, including when the time is
+ *          past the end of the animation; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_GetAnimationDecoderFrame
+ * \sa IMG_SeekAnimationDecoder
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_SeekAnimationDecoderToTime(IMG_AnimationDecoder *decoder, Uint64 ms, int *index);
+
+/**
+ * Dispose of an animation decoder and free its resources.
+ *
+ * The provided `decoder` pointer is not valid once this call returns.
+ *
+ * \param decoder the IMG_AnimationDecoder to close.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_CreateAnimationDecoder
+ * \sa IMG_CreateAnimationDecoder_IO
+ */
+extern SDL_DECLSPEC void SDLCALL IMG_CloseAnimationDecoder(IMG_AnimationDecoder *decoder);
+
+/**
+ * An animation stored as the areas that change from one frame to the next.
+ *
+ * The first frame is stored completely and each following frame only keeps
+ * the pixels of the rectangle that differs from the frame before it, which
+ * for most animations is a small part of the image. Frames are played back
+ * by applying them in order onto a surface or texture that holds the
+ * previous frame.
+ *
+ * \since This struct is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_LoadDeltaAnimation
+ * \sa IMG_LoadDeltaAnimation_IO
+ */
+typedef struct IMG_DeltaAnimation IMG_DeltaAnimation;
+
+/**
+ * Load an animation from a file as a delta animation.
+ *
+ * When done with the returned animation, the app should dispose of it with a
+ * call to IMG_FreeDeltaAnimation().
+ *
+ * \param file path on the filesystem containing an animated image.
+ * \returns a new IMG_DeltaAnimation, or NULL on error.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_LoadDeltaAnimation_IO
+ * \sa IMG_FreeDeltaAnimation
+ */
+extern SDL_DECLSPEC IMG_DeltaAnimation * SDLCALL IMG_LoadDeltaAnimation(const char *file);
+
+/**
+ * Load an animation from an SDL_IOStream as a delta animation.
+ *
+ * If `closeio` is true, `src` will be closed before returning, whether this
+ * function succeeds or not. SDL_image reads everything it needs from `src`
+ * during this call in any case.
+ *
+ * When done with the returned animation, the app should dispose of it with a
+ * call to IMG_FreeDeltaAnimation().
+ *
+ * \param src an SDL_IOStream that data will be read from.
+ * \param closeio true to close/free the SDL_IOStream before returning, false
+ *                to leave it open.
+ * \param type a filename extension that represent this data ("GIF", etc),
+ *             may be NULL.
+ * \returns a new IMG_DeltaAnimation, or NULL on error.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_LoadDeltaAnimation
+ * \sa IMG_FreeDeltaAnimation
+ */
+extern SDL_DECLSPEC IMG_DeltaAnimation * SDLCALL IMG_LoadDeltaAnimation_IO(SDL_IOStream *src, bool closeio, const char *type);
+
+/**
+ * Get the size, pixel format and frame count of a delta animation.
+ *
+ * A texture that frames are applied to with IMG_UpdateDeltaAnimationTexture()
+ * is updated without conversion if it has this size and format.
+ *
+ * Animations with a shared palette, like most GIF animations, are stored as
+ * SDL_PIXELFORMAT_INDEX8 and converted to the format of the surface or
+ * texture they are applied to, with transparent pixels as alpha.
+ *
+ * \param anim the IMG_DeltaAnimation to query.
+ * \param w a pointer filled in with the width of the frames, may be NULL.
+ * \param h a pointer filled in with the height of the frames, may be NULL.
+ * \param format a pointer filled in with the pixel format of the frames, may
+ *               be NULL.
+ * \param count a pointer filled in with the number of frames, may be NULL.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_GetDeltaAnimationInfo(IMG_DeltaAnimation *anim, int *w, int *h, SDL_PixelFormat *format, int *count);
+
+/**
+ * Get the changed area and delay of a frame of a delta animation.
+ *
+ * \param anim the IMG_DeltaAnimation to query.
+ * \param index the index of the frame, from 0 to the frame count - 1.
+ * \param rect a pointer filled in with the area that differs from the
+ *             previous frame, may be NULL. The first frame covers the whole
+ *             image.
+ * \param delay a pointer filled in with how long the frame should be shown,
+ *              in milliseconds, may be NULL.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_GetDeltaAnimationFrameInfo(IMG_DeltaAnimation *anim, int index, SDL_Rect *rect, int *delay);
+
+/**
+ * Apply a frame of a delta animation to a surface.
+ *
+ * `dst` must be the size of the animation and hold the frame before `index`,
+ * so only the changed area of the frame is copied. The first frame covers
+ * the whole image, so playback can start or loop from it with any contents
+ * in `dst`. To show an arbitrary frame, apply the frames from 0 up to it.
+ *
+ * \param anim the IMG_DeltaAnimation to apply a frame of.
+ * \param index the index of the frame, from 0 to the frame count - 1.
+ * \param dst the surface holding the previous frame.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_UpdateDeltaAnimationTexture
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_ApplyDeltaAnimationFrame(IMG_DeltaAnimation *anim, int index, SDL_Surface *dst);
+
+/**
+ * Apply a frame of a delta animation to a texture.
+ *
+ * This uploads only the changed area of the frame with SDL_UpdateTexture(),
+ * under the same rules as IMG_ApplyDeltaAnimationFrame(). The texture must be
+ * the size of the animation, and is updated without conversion if it's also
+ * in the pixel format returned by IMG_GetDeltaAnimationInfo().
+ *
+ * \param anim the IMG_DeltaAnimation to apply a frame of.
+ * \param index the index of the frame, from 0 to the frame count - 1.
+ * \param texture the texture holding the previous frame.
+ * \returns true on success or false on failure; call SDL_GetError() for more
+ *          information.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_ApplyDeltaAnimationFrame
+ */
+extern SDL_DECLSPEC bool SDLCALL IMG_UpdateDeltaAnimationTexture(IMG_DeltaAnimation *anim, int index, SDL_Texture *texture);
+
+/**
+ * Dispose of an IMG_DeltaAnimation and free its resources.
+ *
+ * The provided `anim` pointer is not valid once this call returns.
+ *
+ * \param anim IMG_DeltaAnimation to dispose of.
+ *
+ * \since This function is available since SDL_image 3.4.0.
+ *
+ * \sa IMG_LoadDeltaAnimation
+ * \sa IMG_LoadDeltaAnimation_IO
+ */
+extern SDL_DECLSPEC void SDLCALL IMG_FreeDeltaAnimation(IMG_DeltaAnimation *anim);
+
 /* Ends C function definitions when using C++ */
 #ifdef __cplusplus
 }
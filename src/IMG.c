@@ -23,6 +23,8 @@
 
 #include <SDL3_image/SDL_image.h>
 
+#include "IMG_anim_decoder.h"
+
 #ifdef __EMSCRIPTEN__
 #include <emscripten/emscripten.h>
 #endif
@@ -77,10 +79,12 @@ static struct {
     const char *type;
     bool (SDLCALL *is)(SDL_IOStream *src);
     IMG_Animation *(SDLCALL *load)(SDL_IOStream *src);
+    bool (*create)(IMG_AnimationDecoder *decoder);
 } supported_anims[] = {
     /* keep magicless formats first */
-    { "GIF", IMG_isGIF, IMG_LoadGIFAnimation_IO },
-    { "WEBP", IMG_isWEBP, IMG_LoadWEBPAnimation_IO },
+    { "GIF", IMG_isGIF, IMG_LoadGIFAnimation_IO, IMG_CreateGIFAnimationDecoder },
+    { "WEBP", IMG_isWEBP, IMG_LoadWEBPAnimation_IO, IMG_CreateWEBPAnimationDecoder },
+    { "PNG", IMG_isPNG, IMG_LoadPNGAnimation_IO, NULL },
 };
 
 int IMG_Version(void)
@@ -338,3 +342,637 @@ void IMG_FreeAnimation(IMG_Animation *anim)
     }
 }
 
+
+/* Append the remaining frames of a decoder to a new animation */
+IMG_Animation *IMG_DecodeAnimation(IMG_AnimationDecoder *decoder)
+{
+    IMG_Animation *anim;
+    SDL_Surface *frame;
+    int delay;
+    SDL_Rect dirty;
+    int capacity = 0;
+
+    anim = (IMG_Animation *)SDL_calloc(1, sizeof(*anim));
+    if (!anim) {
+        return NULL;
+    }
+    anim->w = decoder->w;
+    anim->h = decoder->h;
+
+    while ((decoder->status = decoder->GetNextFrame(decoder, &frame, &delay, &dirty)) == IMG_DECODER_STATUS_OK) {
+        if (anim->count == capacity) {
+            SDL_Surface **frames;
+            int *delays;
+
+            capacity = capacity ? capacity * 2 : 16;
+            frames = (SDL_Surface **)SDL_realloc(anim->frames, capacity * sizeof(*anim->frames));
+            if (!frames) {
+                break;
+            }
+            anim->frames = frames;
+            delays = (int *)SDL_realloc(anim->delays, capacity * sizeof(*anim->delays));
+            if (!delays) {
+                break;
+            }
+            anim->delays = delays;
+        }
+
+        anim->frames[anim->count] = SDL_DuplicateSurface(frame);
+        if (!anim->frames[anim->count]) {
+            break;
+        }
+        anim->delays[anim->count] = delay;
+        ++anim->count;
+    }
+
+    /* Keep the frames that were decoded before running into an error */
+    if (anim->count == 0) {
+        IMG_FreeAnimation(anim);
+        anim = NULL;
+    }
+    return anim;
+}
+
+/* Animations without a streaming decoder are loaded up front and played back from memory */
+typedef struct
+{
+    IMG_Animation *anim;
+    int current;
+} IMG_LoadedAnimation;
+
+static IMG_AnimationDecoderStatus IMG_GetNextLoadedFrame(IMG_AnimationDecoder *decoder, SDL_Surface **frame, int *delay, SDL_Rect *dirty)
+{
+    IMG_LoadedAnimation *ctx = (IMG_LoadedAnimation *)decoder->ctx;
+
+    if (ctx->current >= ctx->anim->count) {
+        return IMG_DECODER_STATUS_COMPLETE;
+    }
+    *frame = ctx->anim->frames[ctx->current];
+    *delay = ctx->anim->delays[ctx->current];
+    dirty->x = 0;
+    dirty->y = 0;
+    dirty->w = decoder->w;
+    dirty->h = decoder->h;
+    ++ctx->current;
+    return IMG_DECODER_STATUS_OK;
+}
+
+static bool IMG_RewindLoadedAnimation(IMG_AnimationDecoder *decoder)
+{
+    IMG_LoadedAnimation *ctx = (IMG_LoadedAnimation *)decoder->ctx;
+
+    ctx->current = 0;
+    return true;
+}
+
+static bool IMG_GetLoadedFrameDelay(IMG_AnimationDecoder *decoder, int index, int *delay)
+{
+    IMG_LoadedAnimation *ctx = (IMG_LoadedAnimation *)decoder->ctx;
+
+    if (index >= ctx->anim->count) {
+        return false;
+    }
+    *delay = ctx->anim->delays[index];
+    return true;
+}
+
+static bool IMG_SeekLoadedAnimation(IMG_AnimationDecoder *decoder, int index)
+{
+    IMG_LoadedAnimation *ctx = (IMG_LoadedAnimation *)decoder->ctx;
+
+    /* Every frame is already composited */
+    ctx->current = index;
+    return true;
+}
+
+static void IMG_CloseLoadedAnimation(IMG_AnimationDecoder *decoder)
+{
+    IMG_LoadedAnimation *ctx = (IMG_LoadedAnimation *)decoder->ctx;
+
+    IMG_FreeAnimation(ctx->anim);
+    SDL_free(ctx);
+}
+
+static bool IMG_CreateLoadedAnimationDecoder(IMG_AnimationDecoder *decoder, const char *type)
+{
+    IMG_LoadedAnimation *ctx;
+
+    ctx = (IMG_LoadedAnimation *)SDL_calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        return false;
+    }
+    ctx->anim = IMG_LoadAnimationTyped_IO(decoder->src, false, type);
+    if (!ctx->anim) {
+        SDL_free(ctx);
+        return false;
+    }
+
+    decoder->w = ctx->anim->w;
+    decoder->h = ctx->anim->h;
+    decoder->ctx = ctx;
+    decoder->GetNextFrame = IMG_GetNextLoadedFrame;
+    decoder->Rewind = IMG_RewindLoadedAnimation;
+    decoder->GetFrameDelay = IMG_GetLoadedFrameDelay;
+    decoder->Seek = IMG_SeekLoadedAnimation;
+    decoder->Close = IMG_CloseLoadedAnimation;
+    return true;
+}
+
+/* Create an animation decoder for a file */
+IMG_AnimationDecoder *IMG_CreateAnimationDecoder(const char *file)
+{
+    SDL_IOStream *src = SDL_IOFromFile(file, "rb");
+    const char *ext = SDL_strrchr(file, '.');
+    if (ext) {
+        ext++;
+    }
+    if (!src) {
+        /* The error message has been set in SDL_IOFromFile */
+        return NULL;
+    }
+    return IMG_CreateAnimationDecoder_IO(src, true, ext);
+}
+
+/* Create an animation decoder for an SDL datasource, optionally specifying the type */
+IMG_AnimationDecoder *IMG_CreateAnimationDecoder_IO(SDL_IOStream *src, bool closeio, const char *type)
+{
+    size_t i;
+    IMG_AnimationDecoder *decoder;
+    bool (*create)(IMG_AnimationDecoder *decoder) = NULL;
+    bool result;
+
+    /* Make sure there is something to do.. */
+    if ( src == NULL ) {
+        SDL_SetError("Passed a NULL data source");
+        return NULL;
+    }
+
+    /* See whether or not this data source can handle seeking */
+    if (SDL_SeekIO(src, 0, SDL_IO_SEEK_CUR) < 0 ) {
+        SDL_SetError("Can't seek in this data source");
+        if (closeio)
+            SDL_CloseIO(src);
+        return NULL;
+    }
+
+    decoder = (IMG_AnimationDecoder *)SDL_calloc(1, sizeof(*decoder));
+    if (!decoder) {
+        if (closeio)
+            SDL_CloseIO(src);
+        return NULL;
+    }
+    decoder->src = src;
+    decoder->start = SDL_TellIO(src);
+    decoder->closeio = closeio;
+    decoder->status = IMG_DECODER_STATUS_OK;
+
+    /* Detect the type of image being loaded */
+    for ( i=0; i < SDL_arraysize(supported_anims); ++i ) {
+        if (supported_anims[i].is) {
+            if (!supported_anims[i].is(src))
+                continue;
+        } else {
+            /* magicless format */
+            if (!type || SDL_strcasecmp(type, supported_anims[i].type) != 0)
+                continue;
+        }
+        create = supported_anims[i].create;
+        break;
+    }
+
+    if (create) {
+        result = create(decoder);
+    } else {
+        result = IMG_CreateLoadedAnimationDecoder(decoder, type);
+    }
+    if (!result) {
+        if (closeio)
+            SDL_CloseIO(src);
+        SDL_free(decoder);
+        return NULL;
+    }
+    return decoder;
+}
+
+bool IMG_GetAnimationDecoderSize(IMG_AnimationDecoder *decoder, int *w, int *h)
+{
+    if (!decoder) {
+        return SDL_InvalidParamError("decoder");
+    }
+    if (w) {
+        *w = decoder->w;
+    }
+    if (h) {
+        *h = decoder->h;
+    }
+    return true;
+}
+
+bool IMG_GetAnimationDecoderFrame(IMG_AnimationDecoder *decoder, SDL_Surface *frame, int *delay)
+{
+    SDL_Surface *image = NULL;
+    int image_delay = 0;
+    SDL_Rect dirty;
+    SDL_BlendMode blend;
+    bool result;
+
+    if (!decoder) {
+        return SDL_InvalidParamError("decoder");
+    }
+    if (!frame) {
+        return SDL_InvalidParamError("frame");
+    }
+    if (frame->w != decoder->w || frame->h != decoder->h) {
+        return SDL_SetError("Frame surface must be %dx%d", decoder->w, decoder->h);
+    }
+
+    switch (decoder->status) {
+    case IMG_DECODER_STATUS_COMPLETE:
+        return SDL_SetError("No more frames in animation");
+    case IMG_DECODER_STATUS_FAILED:
+        return SDL_SetError("Animation decoding failed");
+    default:
+        break;
+    }
+
+    decoder->status = decoder->GetNextFrame(decoder, &image, &image_delay, &dirty);
+    if (decoder->status != IMG_DECODER_STATUS_OK) {
+        if (decoder->status == IMG_DECODER_STATUS_COMPLETE) {
+            SDL_SetError("No more frames in animation");
+        }
+        return false;
+    }
+
+    /* Copy the frame as-is, transparent pixels included */
+    if (SDL_SurfaceHasColorKey(image)) {
+        SDL_FillSurfaceRect(frame, NULL, SDL_MapSurfaceRGBA(frame, 0, 0, 0, SDL_ALPHA_TRANSPARENT));
+    }
+    SDL_GetSurfaceBlendMode(image, &blend);
+    SDL_SetSurfaceBlendMode(image, SDL_BLENDMODE_NONE);
+    result = SDL_BlitSurface(image, NULL, frame, NULL);
+    SDL_SetSurfaceBlendMode(image, blend);
+    if (!result) {
+        return false;
+    }
+
+    if (delay) {
+        *delay = image_delay;
+    }
+    return true;
+}
+
+IMG_AnimationDecoderStatus IMG_GetAnimationDecoderStatus(IMG_AnimationDecoder *decoder)
+{
+    if (!decoder) {
+        SDL_InvalidParamError("decoder");
+        return IMG_DECODER_STATUS_FAILED;
+    }
+    return decoder->status;
+}
+
+bool IMG_RewindAnimationDecoder(IMG_AnimationDecoder *decoder)
+{
+    if (!decoder) {
+        return SDL_InvalidParamError("decoder");
+    }
+    if (!decoder->Rewind(decoder)) {
+        decoder->status = IMG_DECODER_STATUS_FAILED;
+        return false;
+    }
+    decoder->status = IMG_DECODER_STATUS_OK;
+    return true;
+}
+
+bool IMG_SeekAnimationDecoder(IMG_AnimationDecoder *decoder, int index)
+{
+    int delay;
+
+    if (!decoder) {
+        return SDL_InvalidParamError("decoder");
+    }
+    if (index < 0) {
+        return SDL_InvalidParamError("index");
+    }
+    if (!decoder->GetFrameDelay(decoder, index, &delay)) {
+        return SDL_SetError("Frame %d is past the end of the animation", index);
+    }
+    if (!decoder->Seek(decoder, index)) {
+        decoder->status = IMG_DECODER_STATUS_FAILED;
+        return false;
+    }
+    decoder->status = IMG_DECODER_STATUS_OK;
+    return true;
+}
+
+bool IMG_SeekAnimationDecoderToTime(IMG_AnimationDecoder *decoder, Uint64 ms, int *index)
+{
+    Uint64 time = 0;
+    int i, delay, frame = -1;
+
+    if (!decoder) {
+        return SDL_InvalidParamError("decoder");
+    }
+
+    /* Find the last frame that starts at or before that time, which skips
+       frames with no delay */
+    for (i = 0; decoder->GetFrameDelay(decoder, i, &delay); ++i) {
+        if (ms < time) {
+            break;
+        }
+        frame = i;
+        if (delay > 0) {
+            time += delay;
+        }
+    }
+    if (frame < 0) {
+        return SDL_SetError("The animation has no frames");
+    }
+    if (time == 0) {
+        /* Every frame has no delay, so the first one is showing */
+        frame = 0;
+    } else if (ms >= time) {
+        return SDL_SetError("Time %" SDL_PRIu64 " is past the end of the animation", ms);
+    }
+
+    if (index) {
+        *index = frame;
+    }
+    return IMG_SeekAnimationDecoder(decoder, frame);
+}
+
+void IMG_CloseAnimationDecoder(IMG_AnimationDecoder *decoder)
+{
+    if (decoder) {
+        decoder->Close(decoder);
+        if (decoder->closeio) {
+            SDL_CloseIO(decoder->src);
+        }
+        SDL_free(decoder);
+    }
+}
+
+typedef struct
+{
+    SDL_Rect rect;
+    SDL_Surface *patch;     /* The pixels of rect, or NULL if nothing changed */
+    int delay;
+} IMG_DeltaFrame;
+
+struct IMG_DeltaAnimation
+{
+    int w, h;
+    SDL_PixelFormat format;
+    SDL_Palette *palette;   /* The palette of indexed animations */
+    int count;
+    IMG_DeltaFrame *frames;
+};
+
+/* Load an animation from a file as a delta animation */
+IMG_DeltaAnimation *IMG_LoadDeltaAnimation(const char *file)
+{
+    SDL_IOStream *src = SDL_IOFromFile(file, "rb");
+    const char *ext = SDL_strrchr(file, '.');
+    if (ext) {
+        ext++;
+    }
+    if (!src) {
+        /* The error message has been set in SDL_IOFromFile */
+        return NULL;
+    }
+    return IMG_LoadDeltaAnimation_IO(src, true, ext);
+}
+
+/* Load an animation from an SDL datasource as a delta animation */
+IMG_DeltaAnimation *IMG_LoadDeltaAnimation_IO(SDL_IOStream *src, bool closeio, const char *type)
+{
+    IMG_AnimationDecoder *decoder;
+    IMG_DeltaAnimation *anim;
+    SDL_Surface *frame;
+    SDL_Surface *converted = NULL;
+    SDL_Palette *source = NULL;
+    int delay;
+    SDL_Rect dirty;
+    int capacity = 0;
+
+    decoder = IMG_CreateAnimationDecoder_IO(src, closeio, type);
+    if (!decoder) {
+        return NULL;
+    }
+
+    anim = (IMG_DeltaAnimation *)SDL_calloc(1, sizeof(*anim));
+    if (!anim) {
+        IMG_CloseAnimationDecoder(decoder);
+        return NULL;
+    }
+    anim->w = decoder->w;
+    anim->h = decoder->h;
+
+    while ((decoder->status = decoder->GetNextFrame(decoder, &frame, &delay, &dirty)) == IMG_DECODER_STATUS_OK) {
+        IMG_DeltaFrame *delta;
+
+        if (anim->count == 0) {
+            /* The first frame is stored completely */
+            dirty.x = 0;
+            dirty.y = 0;
+            dirty.w = anim->w;
+            dirty.h = anim->h;
+
+            source = SDL_GetSurfacePalette(frame);
+            if (frame->format == SDL_PIXELFORMAT_INDEX8 && source) {
+                /* Keep the palette, with the transparent color as alpha so
+                   patches can be copied without a color key */
+                Uint32 colorkey;
+
+                anim->format = frame->format;
+                anim->palette = SDL_CreatePalette(source->ncolors);
+                if (!anim->palette) {
+                    goto error;
+                }
+                SDL_SetPaletteColors(anim->palette, source->colors, 0, source->ncolors);
+                if (SDL_SurfaceHasColorKey(frame) && SDL_GetSurfaceColorKey(frame, &colorkey) &&
+                    (int)colorkey < anim->palette->ncolors) {
+                    anim->palette->colors[colorkey].a = SDL_ALPHA_TRANSPARENT;
+                }
+            } else if (SDL_ISPIXELFORMAT_INDEXED(frame->format) || SDL_ISPIXELFORMAT_FOURCC(frame->format)) {
+                anim->format = SDL_PIXELFORMAT_ARGB8888;
+            } else {
+                anim->format = frame->format;
+            }
+        }
+
+        /* Animations that aren't streamed may have frames in other formats */
+        if (frame->format != anim->format || (anim->palette && SDL_GetSurfacePalette(frame) != source)) {
+            if (converted) {
+                SDL_DestroySurface(converted);
+            }
+            converted = SDL_ConvertSurfaceAndColorspace(frame, anim->format, anim->palette, SDL_GetSurfaceColorspace(frame), 0);
+            if (!converted) {
+                goto error;
+            }
+            frame = converted;
+        }
+
+        if (anim->count == capacity) {
+            IMG_DeltaFrame *frames;
+
+            capacity = capacity ? capacity * 2 : 16;
+            frames = (IMG_DeltaFrame *)SDL_realloc(anim->frames, capacity * sizeof(*anim->frames));
+            if (!frames) {
+                goto error;
+            }
+            anim->frames = frames;
+        }
+
+        delta = &anim->frames[anim->count];
+        delta->rect = dirty;
+        delta->patch = NULL;
+        delta->delay = delay;
+        if (dirty.w > 0 && dirty.h > 0) {
+            const Uint8 *pixels = (const Uint8 *)frame->pixels + dirty.y * frame->pitch + dirty.x * SDL_BYTESPERPIXEL(frame->format);
+
+            delta->patch = SDL_CreateSurface(dirty.w, dirty.h, anim->format);
+            if (!delta->patch) {
+                goto error;
+            }
+            if (anim->palette) {
+                SDL_SetSurfacePalette(delta->patch, anim->palette);
+            }
+            SDL_SetSurfaceBlendMode(delta->patch, SDL_BLENDMODE_NONE);
+            SDL_ConvertPixels(dirty.w, dirty.h, anim->format, pixels, frame->pitch, anim->format, delta->patch->pixels, delta->patch->pitch);
+        }
+        ++anim->count;
+    }
+    if (decoder->status == IMG_DECODER_STATUS_FAILED && anim->count == 0) {
+        goto error;
+    }
+
+    if (converted) {
+        SDL_DestroySurface(converted);
+    }
+    IMG_CloseAnimationDecoder(decoder);
+    return anim;
+
+error:
+    if (converted) {
+        SDL_DestroySurface(converted);
+    }
+    IMG_CloseAnimationDecoder(decoder);
+    IMG_FreeDeltaAnimation(anim);
+    return NULL;
+}
+
+bool IMG_GetDeltaAnimationInfo(IMG_DeltaAnimation *anim, int *w, int *h, SDL_PixelFormat *format, int *count)
+{
+    if (!anim) {
+        return SDL_InvalidParamError("anim");
+    }
+    if (w) {
+        *w = anim->w;
+    }
+    if (h) {
+        *h = anim->h;
+    }
+    if (format) {
+        *format = anim->format;
+    }
+    if (count) {
+        *count = anim->count;
+    }
+    return true;
+}
+
+bool IMG_GetDeltaAnimationFrameInfo(IMG_DeltaAnimation *anim, int index, SDL_Rect *rect, int *delay)
+{
+    if (!anim) {
+        return SDL_InvalidParamError("anim");
+    }
+    if (index < 0 || index >= anim->count) {
+        return SDL_InvalidParamError("index");
+    }
+    if (rect) {
+        *rect = anim->frames[index].rect;
+    }
+    if (delay) {
+        *delay = anim->frames[index].delay;
+    }
+    return true;
+}
+
+bool IMG_ApplyDeltaAnimationFrame(IMG_DeltaAnimation *anim, int index, SDL_Surface *dst)
+{
+    IMG_DeltaFrame *delta;
+
+    if (!anim) {
+        return SDL_InvalidParamError("anim");
+    }
+    if (index < 0 || index >= anim->count) {
+        return SDL_InvalidParamError("index");
+    }
+    if (!dst) {
+        return SDL_InvalidParamError("dst");
+    }
+    if (dst->w != anim->w || dst->h != anim->h) {
+        return SDL_SetError("Frame surface must be %dx%d", anim->w, anim->h);
+    }
+
+    delta = &anim->frames[index];
+    if (!delta->patch) {
+        return true;
+    }
+    return SDL_BlitSurface(delta->patch, NULL, dst, &delta->rect);
+}
+
+bool IMG_UpdateDeltaAnimationTexture(IMG_DeltaAnimation *anim, int index, SDL_Texture *texture)
+{
+    IMG_DeltaFrame *delta;
+    SDL_Surface *patch;
+    bool result;
+
+    if (!anim) {
+        return SDL_InvalidParamError("anim");
+    }
+    if (index < 0 || index >= anim->count) {
+        return SDL_InvalidParamError("index");
+    }
+    if (!texture) {
+        return SDL_InvalidParamError("texture");
+    }
+    if (texture->w != anim->w || texture->h != anim->h) {
+        return SDL_SetError("Texture must be %dx%d", anim->w, anim->h);
+    }
+
+    delta = &anim->frames[index];
+    if (!delta->patch) {
+        return true;
+    }
+    if (texture->format == anim->format && !anim->palette) {
+        return SDL_UpdateTexture(texture, &delta->rect, delta->patch->pixels, delta->patch->pitch);
+    }
+
+    patch = SDL_ConvertSurface(delta->patch, texture->format);
+    if (!patch) {
+        return false;
+    }
+    result = SDL_UpdateTexture(texture, &delta->rect, patch->pixels, patch->pitch);
+    SDL_DestroySurface(patch);
+    return result;
+}
+
+void IMG_FreeDeltaAnimation(IMG_DeltaAnimation *anim)
+{
+    if (anim) {
+        if (anim->frames) {
+            int i;
+            for (i = 0; i < anim->count; ++i) {
+                if (anim->frames[i].patch) {
+                    SDL_DestroySurface(anim->frames[i].patch);
+                }
+            }
+            SDL_free(anim->frames);
+        }
+        if (anim->palette) {
+            SDL_DestroyPalette(anim->palette);
+        }
+        SDL_free(anim);
+    }
+}
@@ -0,0 +1,59 @@
+/*
+  SDL_image:  An example image loading library for use with SDL
+  Copyright (C) 1997-2025 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Interface between the animation decoder and the format specific code */
+
+#ifndef IMG_ANIM_DECODER_H_
+#define IMG_ANIM_DECODER_H_
+
+#include <SDL3_image/SDL_image.h>
+
+struct IMG_AnimationDecoder
+{
+    SDL_IOStream *src;
+    Sint64 start;
+    bool closeio;
+    IMG_AnimationDecoderStatus status;
+
+    /* Set up by the format specific create function */
+    int w, h;
+    void *ctx;
+
+    /* Composite the next frame, returning a surface owned by the decoder
+       and the area of it that changed since the previous frame */
+    IMG_AnimationDecoderStatus (*GetNextFrame)(IMG_AnimationDecoder *decoder, SDL_Surface **frame, int *delay, SDL_Rect *dirty);
+    bool (*Rewind)(IMG_AnimationDecoder *decoder);
+    /* Get the delay of a frame without decoding it, returning false if there is no such frame */
+    bool (*GetFrameDelay)(IMG_AnimationDecoder *decoder, int index, int *delay);
+    /* Set up the canvas so the next frame composited is the one at index,
+       starting from the nearest frame that doesn't depend on earlier ones */
+    bool (*Seek)(IMG_AnimationDecoder *decoder, int index);
+    void (*Close)(IMG_AnimationDecoder *decoder);
+};
+
+/* Set up a decoder reading from decoder->src, which is positioned at decoder->start */
+extern bool IMG_CreateGIFAnimationDecoder(IMG_AnimationDecoder *decoder);
+extern bool IMG_CreateWEBPAnimationDecoder(IMG_AnimationDecoder *decoder);
+
+/* Decode all the remaining frames of a decoder into an animation */
+extern IMG_Animation *IMG_DecodeAnimation(IMG_AnimationDecoder *decoder);
+
+#endif /* IMG_ANIM_DECODER_H_ */
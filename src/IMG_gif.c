@@ -23,6 +23,19 @@
 
 #include <SDL3_image/SDL_image.h>
 
+#include "IMG_anim_decoder.h"
+#include "IMG_quantize.h"
+
+/* We'll have GIF save support by default */
+#if !defined(SDL_IMAGE_SAVE_GIF)
+#  define SDL_IMAGE_SAVE_GIF 1
+#endif
+
+#define GIF_DISPOSE_NA                  0   /* No disposal specified */
+#define GIF_DISPOSE_NONE                1   /* Do not dispose */
+#define GIF_DISPOSE_RESTORE_BACKGROUND  2   /* Restore to background */
+#define GIF_DISPOSE_RESTORE_PREVIOUS    3   /* Restore to previous */
+
 #ifdef LOAD_GIF
 
 /* Code from here to end of file has been adapted from XPaint:           */
@@ -56,11 +69,6 @@
             } while (0)
 /* * * * * */
 
-#define GIF_DISPOSE_NA                  0   /* No disposal specified */
-#define GIF_DISPOSE_NONE                1   /* Do not dispose */
-#define GIF_DISPOSE_RESTORE_BACKGROUND  2   /* Restore to background */
-#define GIF_DISPOSE_RESTORE_PREVIOUS    3   /* Restore to previous */
-
 #define MAXCOLORMAPSIZE     256
 
 #define TRUE    1
@@ -76,7 +84,9 @@
 #define LOCALCOLORMAP   0x80
 #define BitSet(byte, bit)   (((byte) & (bit)) == (bit))
 
-#define ReadOK(file,buffer,len) (SDL_ReadIO(file, buffer, len) == len)
+#define GIF_READ_SIZE       (64 * 1024)
+
+#define ReadOK(state,buffer,len) ReadInput(state, buffer, len)
 
 #define LM_to_uint(a,b)         (((b)<<8)|(a))
 
@@ -99,18 +109,21 @@ typedef struct {
         int disposal;
     } Gif89;
 
-    unsigned char buf[280];
-    int curbit, lastbit, done, last_byte;
-
-    int fresh;
-    int code_size, set_code_size;
-    int max_code, max_code_size;
-    int firstcode, oldcode;
-    int clear_code, end_code;
-    int table[2][(1 << MAX_LWZ_BITS)];
-    int stack[(1 << (MAX_LWZ_BITS)) * 2], *sp;
-
-    int ZeroDataBlock;
+    /* LZW string table, each string is a prefix string plus one byte */
+    Uint16 prefix[(1 << MAX_LWZ_BITS)];
+    Uint16 length[(1 << MAX_LWZ_BITS)];
+    Uint8 suffix[(1 << MAX_LWZ_BITS)];
+    Uint8 first[(1 << MAX_LWZ_BITS)];
+    Uint8 string[(1 << MAX_LWZ_BITS)];
+
+    unsigned char block[256];
+    int block_pos, block_len, done;
+    Uint32 bits;
+    int nbits;
+
+    SDL_IOStream *src;
+    size_t input_pos, input_len;
+    unsigned char input[GIF_READ_SIZE];
 } State_t;
 
 typedef struct
@@ -121,135 +134,48 @@ typedef struct
     int delay;
 } Frame_t;
 
-typedef struct
-{
-    int count;
-    Frame_t *frames;
-} Anim_t;
-
-static int ReadColorMap(SDL_IOStream * src, int number,
-			unsigned char buffer[3][MAXCOLORMAPSIZE], int *flag);
-static int DoExtension(SDL_IOStream * src, int label, State_t * state);
-static int GetDataBlock(SDL_IOStream * src, unsigned char *buf, State_t * state);
-static int GetCode(SDL_IOStream * src, int code_size, int flag, State_t * state);
-static int LWZReadByte(SDL_IOStream * src, int flag, int input_code_size, State_t * state);
-static Image *ReadImage(SDL_IOStream * src, int len, int height, int,
+static bool ReadInput(State_t * state, void *buffer, size_t len);
+static Sint64 TellInput(State_t * state);
+static void UnreadInput(State_t * state);
+static int ReadColorMap(int number,
+			unsigned char buffer[3][MAXCOLORMAPSIZE], int *flag, State_t * state);
+static int DoExtension(int label, State_t * state);
+static int GetDataBlock(unsigned char *buf, State_t * state);
+static int GetCode(int code_size, State_t * state);
+static void ReadImageData(Image *image, int interlace, int input_code_size, State_t * state);
+static Image *ReadImage(int len, int height, int,
 			unsigned char cmap[3][MAXCOLORMAPSIZE],
 			int gray, int interlace, int ignore, State_t * state);
 
-static bool NormalizeFrames(Frame_t *frames, int count)
-{
-    SDL_Surface *image;
-    int i;
-    int lastDispose = GIF_DISPOSE_RESTORE_BACKGROUND;
-    int iRestore = 0;
-    Uint32 fill;
-    SDL_Rect rect;
-
-
-    if (SDL_SurfaceHasColorKey(frames[0].image)) {
-        image = SDL_ConvertSurface(frames[0].image, SDL_PIXELFORMAT_ARGB8888);
-    } else {
-        image = SDL_ConvertSurface(frames[0].image, SDL_PIXELFORMAT_XRGB8888);
-    }
-    if (!image) {
-        return false;
-    }
-
-    fill = SDL_MapSurfaceRGBA(image, 0, 0, 0, SDL_ALPHA_TRANSPARENT);
-
-    rect.x = 0;
-    rect.y = 0;
-    rect.w = image->w;
-    rect.h = image->h;
-
-    for (i = 0; i < count; ++i) {
-        switch (lastDispose) {
-        case GIF_DISPOSE_RESTORE_BACKGROUND:
-            SDL_FillSurfaceRect(image, &rect, fill);
-            break;
-        case GIF_DISPOSE_RESTORE_PREVIOUS:
-            SDL_BlitSurface(frames[iRestore].image, &rect, image, &rect);
-            break;
-        default:
-            break;
-        }
-
-        if (frames[i].disposal != GIF_DISPOSE_RESTORE_PREVIOUS) {
-            iRestore = i;
-        }
-
-        rect.x = (Sint16)frames[i].x;
-        rect.y = (Sint16)frames[i].y;
-        rect.w = frames[i].image->w;
-        rect.h = frames[i].image->h;
-        SDL_BlitSurface(frames[i].image, NULL, image, &rect);
-
-        SDL_DestroySurface(frames[i].image);
-        frames[i].image = SDL_DuplicateSurface(image);
-        if (!frames[i].image) {
-            return false;
-        }
-
-        lastDispose = frames[i].disposal;
-    }
-
-    SDL_DestroySurface( image );
-
-    return true;
-}
-
-static Anim_t *
-IMG_LoadGIF_IO_Internal(SDL_IOStream *src, bool load_anim)
+static bool
+ReadHeader(State_t * state)
 {
     unsigned char buf[16];
-    unsigned char c;
-    unsigned char localColorMap[3][MAXCOLORMAPSIZE];
-    int grayScale;
-    int useGlobalColormap;
-    int bitPixel;
     char version[4];
-    State_t *state = NULL;
-    Image *image = NULL;
-    Anim_t *anim;
-    Frame_t *frames, *frame;
 
-    if (src == NULL) {
-        return NULL;
-    }
-
-    anim = (Anim_t *)SDL_calloc(1, sizeof(*anim));
-    if (!anim) {
-        return NULL;
-    }
-
-    if (!ReadOK(src, buf, 6)) {
+    if (!ReadOK(state, buf, 6)) {
         RWSetMsg("error reading magic number");
-        goto done;
+        return false;
     }
     if (SDL_strncmp((char *) buf, "GIF", 3) != 0) {
         RWSetMsg("not a GIF file");
-        goto done;
+        return false;
     }
     SDL_memcpy(version, (char *) buf + 3, 3);
     version[3] = '\0';
 
     if ((SDL_strcmp(version, "87a") != 0) && (SDL_strcmp(version, "89a") != 0)) {
         RWSetMsg("bad version number, not '87a' or '89a'");
-        goto done;
-    }
-    state = (State_t *)SDL_calloc(1, sizeof(State_t));
-    if (state == NULL) {
-        goto done;
+        return false;
     }
     state->Gif89.transparent = -1;
     state->Gif89.delayTime = -1;
     state->Gif89.inputFlag = -1;
     state->Gif89.disposal = GIF_DISPOSE_NA;
 
-    if (!ReadOK(src, buf, 7)) {
+    if (!ReadOK(state, buf, 7)) {
         RWSetMsg("failed to read screen descriptor");
-        goto done;
+        return false;
     }
     state->GifScreen.Width = LM_to_uint(buf[0], buf[1]);
     state->GifScreen.Height = LM_to_uint(buf[2], buf[3]);
@@ -259,111 +185,167 @@ IMG_LoadGIF_IO_Internal(SDL_IOStream *src, bool load_anim)
     state->GifScreen.AspectRatio = buf[6];
 
     if (BitSet(buf[4], LOCALCOLORMAP)) {    /* Global Colormap */
-        if (ReadColorMap(src, state->GifScreen.BitPixel,
-                         state->GifScreen.ColorMap, &state->GifScreen.GrayScale)) {
+        if (ReadColorMap(state->GifScreen.BitPixel,
+                         state->GifScreen.ColorMap, &state->GifScreen.GrayScale, state)) {
             RWSetMsg("error reading global colormap");
-            goto done;
+            return false;
+        }
+    }
+    return true;
+}
+
+/* The delay of a frame in milliseconds */
+static int
+GetFrameDelay(int delayTime)
+{
+    if (delayTime < 2) {
+        return 100; /* Default animation delay, matching browsers and Qt */
+    }
+    return delayTime * 10;
+}
+
+/* Decode an image, starting right after its ',' separator, using the
+   graphic control settings in state->Gif89 */
+static bool
+ReadFrameImage(State_t * state, Frame_t * frame)
+{
+    unsigned char buf[16];
+    unsigned char localColorMap[3][MAXCOLORMAPSIZE];
+    int grayScale;
+    int useGlobalColormap;
+    int bitPixel;
+    Image *image;
+
+    if (!ReadOK(state, buf, 9)) {
+        RWSetMsg("couldn't read left/top/width/height");
+        return false;
+    }
+    useGlobalColormap = !BitSet(buf[8], LOCALCOLORMAP);
+
+    bitPixel = 1 << ((buf[8] & 0x07) + 1);
+
+    if (!useGlobalColormap) {
+        if (ReadColorMap(bitPixel, localColorMap, &grayScale, state)) {
+            RWSetMsg("error reading local colormap");
+            return false;
         }
+        image = ReadImage(LM_to_uint(buf[4], buf[5]),
+                  LM_to_uint(buf[6], buf[7]),
+                  bitPixel, localColorMap, grayScale,
+                  BitSet(buf[8], INTERLACE),
+                  0, state);
+    } else {
+        image = ReadImage(LM_to_uint(buf[4], buf[5]),
+                  LM_to_uint(buf[6], buf[7]),
+                  state->GifScreen.BitPixel, state->GifScreen.ColorMap,
+                  state->GifScreen.GrayScale, BitSet(buf[8], INTERLACE),
+                  0, state);
+    }
+    if (!image) {
+        return false;
     }
+
+    if (state->Gif89.transparent >= 0) {
+        SDL_SetSurfaceColorKey(image, true, state->Gif89.transparent);
+    }
+
+    frame->image = image;
+    frame->x = LM_to_uint(buf[0], buf[1]);
+    frame->y = LM_to_uint(buf[2], buf[3]);
+    frame->disposal = state->Gif89.disposal;
+    frame->delay = GetFrameDelay(state->Gif89.delayTime);
+    return true;
+}
+
+/* Read up to the next image and decode it.
+   Returns 1 for a frame, 0 at the end of the data and -1 on error */
+static int
+ReadFrame(State_t * state, Frame_t * frame)
+{
+    unsigned char c;
+
     for ( ; ; ) {
-        if (!ReadOK(src, &c, 1)) {
+        if (!ReadOK(state, &c, 1)) {
             RWSetMsg("EOF / read error on image data");
-            goto done;
+            return 0;
         }
         if (c == ';') {     /* GIF terminator */
-            goto done;
+            return 0;
         }
         if (c == '!') {     /* Extension */
-            if (!ReadOK(src, &c, 1)) {
+            if (!ReadOK(state, &c, 1)) {
                 RWSetMsg("EOF / read error on extension function code");
-                goto done;
+                return -1;
             }
-            DoExtension(src, c, state);
+            DoExtension(c, state);
             continue;
         }
         if (c != ',') {     /* Not a valid start character */
             continue;
         }
 
-        if (!ReadOK(src, buf, 9)) {
-            RWSetMsg("couldn't read left/top/width/height");
-            goto done;
-        }
-        useGlobalColormap = !BitSet(buf[8], LOCALCOLORMAP);
-
-        bitPixel = 1 << ((buf[8] & 0x07) + 1);
-
-        if (!useGlobalColormap) {
-            if (ReadColorMap(src, bitPixel, localColorMap, &grayScale)) {
-                RWSetMsg("error reading local colormap");
-                goto done;
-            }
-            image = ReadImage(src, LM_to_uint(buf[4], buf[5]),
-                      LM_to_uint(buf[6], buf[7]),
-                      bitPixel, localColorMap, grayScale,
-                      BitSet(buf[8], INTERLACE),
-                      0, state);
-        } else {
-            image = ReadImage(src, LM_to_uint(buf[4], buf[5]),
-                      LM_to_uint(buf[6], buf[7]),
-                      state->GifScreen.BitPixel, state->GifScreen.ColorMap,
-                      state->GifScreen.GrayScale, BitSet(buf[8], INTERLACE),
-                      0, state);
-        }
+        return ReadFrameImage(state, frame) ? 1 : -1;
+    }
+}
 
-        if (image) {
-            if (state->Gif89.transparent >= 0) {
-                SDL_SetSurfaceColorKey(image, true, state->Gif89.transparent);
-            }
+/* GIF data is made of many tiny blocks, so the stream is read in large
+   chunks and the blocks are served from memory */
+static bool
+ReadInput(State_t * state, void *buffer, size_t len)
+{
+    unsigned char *dst = (unsigned char *)buffer;
+    size_t avail = state->input_len - state->input_pos;
+
+    /* Most reads are sub-blocks of 255 bytes or less, served from memory */
+    if (len <= avail) {
+        SDL_memcpy(dst, &state->input[state->input_pos], len);
+        state->input_pos += len;
+        return true;
+    }
 
-            frames = (Frame_t *)SDL_realloc(anim->frames, (anim->count + 1) * sizeof(*anim->frames));
-            if (!frames) {
-                goto done;
-            }
-            ++anim->count;
-            anim->frames = frames;
-            frame = &anim->frames[anim->count - 1];
-
-            frame->image = image;
-            frame->x = LM_to_uint(buf[0], buf[1]);
-            frame->y = LM_to_uint(buf[2], buf[3]);
-            frame->disposal = state->Gif89.disposal;
-            if (state->Gif89.delayTime < 2) {
-                frame->delay = 100; /* Default animation delay, matching browsers and Qt */
-            } else {
-                frame->delay = state->Gif89.delayTime * 10;
-            }
+    SDL_memcpy(dst, &state->input[state->input_pos], avail);
+    dst += avail;
+    len -= avail;
+    state->input_pos = state->input_len = 0;
 
-            if (!load_anim) {
-                /* We only need one frame, we're done */
-                goto done;
-            }
-        }
+    if (len >= sizeof(state->input)) {
+        return SDL_ReadIO(state->src, dst, len) == len;
     }
 
-done:
-    if (anim->count > 1) {
-        /* Normalize the frames */
-        if (!NormalizeFrames(anim->frames, anim->count)) {
-            int i;
-            for (i = 0; i < anim->count; ++i) {
-                SDL_DestroySurface(anim->frames[i].image);
-            }
-            anim->count = 0;
+    while (state->input_len < len) {
+        size_t amount = SDL_ReadIO(state->src, &state->input[state->input_len], sizeof(state->input) - state->input_len);
+        if (amount == 0) {
+            return false;
         }
+        state->input_len += amount;
     }
-    if (anim->count == 0) {
-        SDL_free(anim->frames);
-        SDL_free(anim);
-        anim = NULL;
+    SDL_memcpy(dst, state->input, len);
+    state->input_pos = len;
+    return true;
+}
+
+/* The position in the stream of the next byte to be read */
+static Sint64
+TellInput(State_t * state)
+{
+    return SDL_TellIO(state->src) - (Sint64)(state->input_len - state->input_pos);
+}
+
+/* Give back buffered bytes that were read past the end of the image */
+static void
+UnreadInput(State_t * state)
+{
+    size_t avail = state->input_len - state->input_pos;
+
+    if (avail > 0) {
+        SDL_SeekIO(state->src, -(Sint64)avail, SDL_IO_SEEK_CUR);
     }
-    SDL_free(state);
-    return anim;
+    state->input_pos = state->input_len = 0;
 }
 
 static int
-ReadColorMap(SDL_IOStream *src, int number,
-             unsigned char buffer[3][MAXCOLORMAPSIZE], int *gray)
+ReadColorMap(int number,
+             unsigned char buffer[3][MAXCOLORMAPSIZE], int *gray, State_t * state)
 {
     int i;
     unsigned char rgb[3];
@@ -372,7 +354,7 @@ ReadColorMap(SDL_IOStream *src, int number,
     flag = 1;
 
     for (i = 0; i < number; ++i) {
-        if (!ReadOK(src, rgb, sizeof(rgb))) {
+        if (!ReadOK(state, rgb, sizeof(rgb))) {
             RWSetMsg("bad colormap");
             return 1;
         }
@@ -396,7 +378,7 @@ ReadColorMap(SDL_IOStream *src, int number,
 }
 
 static int
-DoExtension(SDL_IOStream *src, int label, State_t * state)
+DoExtension(int label, State_t * state)
 {
     unsigned char buf[256];
 
@@ -406,42 +388,42 @@ DoExtension(SDL_IOStream *src, int label, State_t * state)
     case 0xff:          /* Application Extension */
         break;
     case 0xfe:          /* Comment Extension */
-        while (GetDataBlock(src, buf, state) > 0)
+        while (GetDataBlock(buf, state) > 0)
             ;
         return FALSE;
     case 0xf9:          /* Graphic Control Extension */
-        (void) GetDataBlock(src, buf, state);
+        (void) GetDataBlock(buf, state);
         state->Gif89.disposal = (buf[0] >> 2) & 0x7;
         state->Gif89.inputFlag = (buf[0] >> 1) & 0x1;
         state->Gif89.delayTime = LM_to_uint(buf[1], buf[2]);
         if ((buf[0] & 0x1) != 0)
             state->Gif89.transparent = buf[3];
+        else
+            state->Gif89.transparent = -1;
 
-        while (GetDataBlock(src, buf, state) > 0)
+        while (GetDataBlock(buf, state) > 0)
             ;
         return FALSE;
     default:
         break;
     }
 
-    while (GetDataBlock(src, buf, state) > 0)
+    while (GetDataBlock(buf, state) > 0)
         ;
 
     return FALSE;
 }
 
 static int
-GetDataBlock(SDL_IOStream *src, unsigned char *buf, State_t * state)
+GetDataBlock(unsigned char *buf, State_t * state)
 {
     unsigned char count;
 
-    if (!ReadOK(src, &count, 1)) {
+    if (!ReadOK(state, &count, 1)) {
         /* pm_message("error in getting DataBlock size" ); */
         return -1;
     }
-    state->ZeroDataBlock = count == 0;
-
-    if ((count != 0) && (!ReadOK(src, buf, count))) {
+    if ((count != 0) && (!ReadOK(state, buf, count))) {
         /* pm_message("error in reading DataBlock" ); */
         return -1;
     }
@@ -449,185 +431,167 @@ GetDataBlock(SDL_IOStream *src, unsigned char *buf, State_t * state)
 }
 
 static int
-GetCode(SDL_IOStream *src, int code_size, int flag, State_t * state)
+GetCode(int code_size, State_t * state)
 {
-    int i, j, ret;
-    unsigned char count;
-
-    if (flag) {
-        state->curbit = 0;
-        state->lastbit = 0;
-        state->done = FALSE;
-        return 0;
-    }
-    if ((state->curbit + code_size) >= state->lastbit) {
-        if (state->done) {
-            if (state->curbit >= state->lastbit)
-                RWSetMsg("ran off the end of my bits");
-            return -1;
-        }
-        state->buf[0] = state->buf[state->last_byte - 2];
-        state->buf[1] = state->buf[state->last_byte - 1];
-
-        if ((ret = GetDataBlock(src, &state->buf[2], state)) > 0)
-            count = (unsigned char) ret;
-        else {
-            count = 0;
-            state->done = TRUE;
+    int code;
+
+    while (state->nbits < code_size) {
+        if (state->block_pos == state->block_len) {
+            int count = state->done ? 0 : GetDataBlock(state->block, state);
+            if (count <= 0) {
+                state->done = TRUE;
+                return -1;
+            }
+            state->block_pos = 0;
+            state->block_len = count;
         }
-
-        state->last_byte = 2 + count;
-        state->curbit = (state->curbit - state->lastbit) + 16;
-        state->lastbit = (2 + count) * 8;
+        state->bits |= (Uint32)state->block[state->block_pos++] << state->nbits;
+        state->nbits += 8;
     }
-    ret = 0;
-    for (i = state->curbit, j = 0; j < code_size; ++i, ++j)
-        ret |= ((state->buf[i / 8] & (1 << (i % 8))) != 0) << j;
+    code = (int)(state->bits & ((1u << code_size) - 1));
+    state->bits >>= code_size;
+    state->nbits -= code_size;
 
-    state->curbit += code_size;
-
-    return ret;
+    return code;
 }
 
-static int
-LWZReadByte(SDL_IOStream *src, int flag, int input_code_size, State_t * state)
+static Uint8 *
+NextRow(Image *image, int interlace, int *ypos, int *pass)
 {
-    int i, code, incode;
-
-    /* Fixed buffer overflow found by Michael Skladnikiewicz */
-    if (input_code_size > MAX_LWZ_BITS)
-        return -1;
-
-    if (flag) {
-        state->set_code_size = input_code_size;
-        state->code_size = state->set_code_size + 1;
-        state->clear_code = 1 << state->set_code_size;
-        state->end_code = state->clear_code + 1;
-        state->max_code_size = 2 * state->clear_code;
-        state->max_code = state->clear_code + 2;
-
-        GetCode(src, 0, TRUE, state);
-
-        state->fresh = TRUE;
-
-        for (i = 0; i < state->clear_code; ++i) {
-            state->table[0][i] = 0;
-            state->table[1][i] = i;
+    static const int start[4] = { 0, 4, 2, 1 };
+    static const int step[4] = { 8, 8, 4, 2 };
+
+    if (interlace) {
+        *ypos += step[*pass];
+        while (*ypos >= image->h) {
+            if (++*pass == 4) {
+                return NULL;
+            }
+            *ypos = start[*pass];
         }
-        state->table[1][0] = 0;
-        for (; i < (1 << MAX_LWZ_BITS); ++i)
-            state->table[0][i] = 0;
+    } else if (++*ypos == image->h) {
+        return NULL;
+    }
+    return (Uint8 *)image->pixels + *ypos * image->pitch;
+}
 
-        state->sp = state->stack;
+/* Decode the LZW codes of an image, writing the whole string of each code
+   straight into the current row */
+static void
+ReadImageData(Image *image, int interlace, int input_code_size, State_t * state)
+{
+    const int clear_code = 1 << input_code_size;
+    const int end_code = clear_code + 1;
+    const int width = image->w;
+    int code_size = input_code_size + 1;
+    int avail = clear_code + 2;
+    int prev = -1;
+    int code, len, i;
+    int xpos = 0, ypos = 0, pass = 0;
+    Uint8 *row = (image->w > 0 && image->h > 0) ? (Uint8 *)image->pixels : NULL;
 
-        return 0;
-    } else if (state->fresh) {
-        state->fresh = FALSE;
-        do {
-            state->firstcode = state->oldcode = GetCode(src, state->code_size, FALSE, state);
-        } while (state->firstcode == state->clear_code);
-        return state->firstcode;
-    }
-    if (state->sp > state->stack)
-        return *--state->sp;
-
-    while ((code = GetCode(src, state->code_size, FALSE, state)) >= 0) {
-        if (code == state->clear_code) {
-            for (i = 0; i < state->clear_code; ++i) {
-                state->table[0][i] = 0;
-                state->table[1][i] = i;
-            }
-            for (; i < (1 << MAX_LWZ_BITS); ++i)
-                state->table[0][i] = state->table[1][i] = 0;
-            state->code_size = state->set_code_size + 1;
-            state->max_code_size = 2 * state->clear_code;
-            state->max_code = state->clear_code + 2;
-            state->sp = state->stack;
-            state->firstcode = state->oldcode = GetCode(src, state->code_size, FALSE, state);
-            return state->firstcode;
-        } else if (code == state->end_code) {
-            int count;
-            unsigned char buf[260];
-
-            if (state->ZeroDataBlock)
-                return -2;
-
-            while ((count = GetDataBlock(src, buf, state)) > 0)
-                ;
-
-            if (count != 0) {
-            /*
-             * pm_message("missing EOD in data stream (common occurrence)");
-             */
-            }
-            return -2;
+    for (i = 0; i < clear_code; ++i) {
+        state->prefix[i] = 0;
+        state->length[i] = 1;
+        state->suffix[i] = (Uint8)i;
+        state->first[i] = (Uint8)i;
+    }
+    state->block_pos = state->block_len = 0;
+    state->done = FALSE;
+    state->bits = 0;
+    state->nbits = 0;
+
+    while (row && (code = GetCode(code_size, state)) >= 0) {
+        if (code == clear_code) {
+            code_size = input_code_size + 1;
+            avail = clear_code + 2;
+            prev = -1;
+            continue;
+        }
+        if (code == end_code) {
+            break;
+        }
+        if (code > avail || (code == avail && prev < 0)) {
+            RWSetMsg("invalid LWZ data");
+            break;
         }
-        incode = code;
 
-        if (code >= state->max_code) {
-            *state->sp++ = state->firstcode;
-            code = state->oldcode;
+        if (prev >= 0 && avail < (1 << MAX_LWZ_BITS)) {
+            /* A code that isn't in the table yet is the previous string
+               followed by its own first byte */
+            state->prefix[avail] = (Uint16)prev;
+            state->length[avail] = state->length[prev] + 1;
+            state->suffix[avail] = state->first[(code == avail) ? prev : code];
+            state->first[avail] = state->first[prev];
+            if (++avail >= (1 << code_size) && code_size < MAX_LWZ_BITS) {
+                ++code_size;
+            }
         }
-        while (code >= state->clear_code) {
-            /* Guard against buffer overruns */
-            if (code < 0 || code >= (1 << MAX_LWZ_BITS)) {
-                RWSetMsg("invalid LWZ data");
-                return -3;
+        prev = code;
+
+        len = state->length[code];
+        if (len <= width - xpos) {
+            Uint8 *dst = row + xpos + len;
+            while (code >= clear_code) {
+                *--dst = state->suffix[code];
+                code = state->prefix[code];
             }
-            *state->sp++ = state->table[1][code];
-            if (code == state->table[0][code]) {
-                RWSetMsg("circular table entry BIG ERROR");
-                return -3;
+            *--dst = state->suffix[code];
+            xpos += len;
+            if (xpos == width) {
+                xpos = 0;
+                row = NextRow(image, interlace, &ypos, &pass);
             }
-            code = state->table[0][code];
-        }
-
-        /* Guard against buffer overruns */
-        if (code < 0 || code >= (1 << MAX_LWZ_BITS)) {
-            RWSetMsg("invalid LWZ data");
-            return -4;
-        }
-        *state->sp++ = state->firstcode = state->table[1][code];
-
-        if ((code = state->max_code) < (1 << MAX_LWZ_BITS)) {
-            state->table[0][code] = state->oldcode;
-            state->table[1][code] = state->firstcode;
-            ++state->max_code;
-            if ((state->max_code >= state->max_code_size) &&
-                (state->max_code_size < (1 << MAX_LWZ_BITS))) {
-                state->max_code_size *= 2;
-                ++state->code_size;
+        } else {
+            /* The string continues on the next row */
+            const Uint8 *src = state->string;
+            Uint8 *dst = state->string + len;
+            while (code >= clear_code) {
+                *--dst = state->suffix[code];
+                code = state->prefix[code];
+            }
+            *--dst = state->suffix[code];
+            while (row && len > 0) {
+                int count = SDL_min(len, width - xpos);
+                SDL_memcpy(row + xpos, src, count);
+                src += count;
+                len -= count;
+                xpos += count;
+                if (xpos == width) {
+                    xpos = 0;
+                    row = NextRow(image, interlace, &ypos, &pass);
+                }
             }
         }
-        state->oldcode = incode;
+    }
 
-        if (state->sp > state->stack)
-            return *--state->sp;
+    /* Skip anything left up to the block terminator */
+    if (!state->done) {
+        while (GetDataBlock(state->block, state) > 0)
+            ;
     }
-    return code;
 }
 
 static Image *
-ReadImage(SDL_IOStream * src, int len, int height, int cmapSize,
+ReadImage(int len, int height, int cmapSize,
           unsigned char cmap[3][MAXCOLORMAPSIZE],
           int gray, int interlace, int ignore, State_t * state)
 {
     Image *image;
     SDL_Palette *palette;
     unsigned char c;
-    int i, v;
-    int xpos = 0, ypos = 0, pass = 0;
+    int i;
 
     (void) gray; /* unused */
 
     /*
     **  Initialize the compression routines
      */
-    if (!ReadOK(src, &c, 1)) {
+    if (!ReadOK(state, &c, 1)) {
         RWSetMsg("EOF / read error on image data");
         return NULL;
     }
-    if (LWZReadByte(src, TRUE, c, state) < 0) {
+    if (c >= MAX_LWZ_BITS) {
         RWSetMsg("error reading image");
         return NULL;
     }
@@ -635,7 +599,7 @@ ReadImage(SDL_IOStream * src, int len, int height, int cmapSize,
     **  If this is an "uninteresting picture" ignore it.
      */
     if (ignore) {
-        while (LWZReadByte(src, FALSE, c, state) >= 0)
+        while (GetDataBlock(state->block, state) > 0)
             ;
         return NULL;
     }
@@ -646,6 +610,7 @@ ReadImage(SDL_IOStream * src, int len, int height, int cmapSize,
 
     palette = SDL_CreateSurfacePalette(image);
     if (!palette) {
+        SDL_DestroySurface(image);
         return NULL;
     }
     if (cmapSize > palette->ncolors) {
@@ -656,111 +621,743 @@ ReadImage(SDL_IOStream * src, int len, int height, int cmapSize,
         ImageSetCmap(image, i, cmap[CM_RED][i], cmap[CM_GREEN][i], cmap[CM_BLUE][i]);
     }
 
-    while ((v = LWZReadByte(src, FALSE, c, state)) >= 0) {
-        ((Uint8 *)image->pixels)[xpos + ypos * image->pitch] = (Uint8)v;
-        ++xpos;
-        if (xpos == len) {
-            xpos = 0;
-            if (interlace) {
-                switch (pass) {
-                case 0:
-                case 1:
-                    ypos += 8;
-                    break;
-                case 2:
-                    ypos += 4;
-                    break;
-                case 3:
-                    ypos += 2;
-                    break;
-                }
-
-                if (ypos >= height) {
-                    ++pass;
-                    switch (pass) {
-                    case 1:
-                        ypos = 4;
-                        break;
-                    case 2:
-                        ypos = 2;
-                        break;
-                    case 3:
-                        ypos = 1;
-                        break;
-                    default:
-                        goto fini;
-                    }
-                }
-            } else {
-                ++ypos;
-            }
-        }
-        if (ypos >= height)
-            break;
-    }
-
-  fini:
+    ReadImageData(image, interlace, c, state);
 
     return image;
 }
 
-/* Load a GIF type animation from an SDL datasource */
-IMG_Animation *IMG_LoadGIFAnimation_IO(SDL_IOStream *src)
+/* Where a frame is in the stream and how it's shown, found without decoding it */
+typedef struct
 {
-    Anim_t *internal = IMG_LoadGIF_IO_Internal(src, true);
-    if (internal) {
-        IMG_Animation *anim = (IMG_Animation *)SDL_malloc(sizeof(*anim));
-        if (anim) {
-            anim->w = internal->frames[0].image->w;
-            anim->h = internal->frames[0].image->h;
-            anim->count = internal->count;
+    Sint64 offset;              /* Of the image descriptor, from the start of the GIF data */
+    Sint64 size;                /* Up to the end of the image data, or -1 if it runs to the end of the stream */
+    SDL_Rect rect;
+    bool local_colormap;
+    int transparent;
+    int disposal;
+    int delayTime;
+} GIF_FrameInfo;
+
+typedef struct
+{
+    State_t *state;
+    SDL_Surface *canvas;        /* The composited animation frame */
+    SDL_Surface *restore;       /* What was under a frame disposed to previous */
+    Uint32 background;
+    Frame_t pending;            /* The first frame, read when the decoder is created */
+    SDL_Rect last_rect;
+    int last_disposal;
+
+    GIF_FrameInfo *frames;      /* Every frame in the animation */
+    int num_frames;
+    Sint64 end;                 /* The end of the GIF data, from its start */
+    int next_frame;             /* The index of the next frame to be composited */
+    Frame_t *decoded;           /* Frames decoded ahead of time on worker threads */
+} GIF_AnimationContext;
+
+/* Copy an area between two surfaces of the same format */
+static void
+CopyRect(SDL_Surface *src, SDL_Surface *dst, const SDL_Rect *rect)
+{
+    int bpp = SDL_BYTESPERPIXEL(dst->format);
+    const Uint8 *srcp = (const Uint8 *)src->pixels + rect->y * src->pitch + rect->x * bpp;
+    Uint8 *dstp = (Uint8 *)dst->pixels + rect->y * dst->pitch + rect->x * bpp;
+    int i;
 
-            anim->frames = (SDL_Surface **)SDL_calloc(anim->count, sizeof(*anim->frames));
-            anim->delays = (int *)SDL_calloc(anim->count, sizeof(*anim->delays));
+    for (i = 0; i < rect->h; ++i) {
+        SDL_memcpy(dstp, srcp, rect->w * bpp);
+        srcp += src->pitch;
+        dstp += dst->pitch;
+    }
+}
 
-            if (anim->frames && anim->delays) {
-                int i;
+/* Draw the part of an image at x,y that falls in rect onto an indexed
+   canvas with the same palette, leaving transparent pixels alone */
+static void
+BlitIndexed(SDL_Surface *image, int x, int y, SDL_Surface *canvas, const SDL_Rect *rect)
+{
+    const Uint8 *srcp = (const Uint8 *)image->pixels + (rect->y - y) * image->pitch + (rect->x - x);
+    Uint8 *dstp = (Uint8 *)canvas->pixels + rect->y * canvas->pitch + rect->x;
+    Uint32 key;
+    int i, j;
+
+    if (!SDL_SurfaceHasColorKey(image) || !SDL_GetSurfaceColorKey(image, &key)) {
+        for (i = 0; i < rect->h; ++i) {
+            SDL_memcpy(dstp, srcp, rect->w);
+            srcp += image->pitch;
+            dstp += canvas->pitch;
+        }
+        return;
+    }
 
-                for (i = 0; i < anim->count; ++i) {
-                    anim->frames[i] = internal->frames[i].image;
-                    anim->delays[i] = internal->frames[i].delay;
-                }
-            } else {
-                IMG_FreeAnimation(anim);
-                anim = NULL;
+    for (i = 0; i < rect->h; ++i) {
+        for (j = 0; j < rect->w; ++j) {
+            if (srcp[j] != key) {
+                dstp[j] = srcp[j];
             }
         }
-        SDL_free(internal->frames);
-        SDL_free(internal);
-        return anim;
+        srcp += image->pitch;
+        dstp += canvas->pitch;
     }
-    return NULL;
 }
 
-#else
-
-/* Load a GIF type animation from an SDL datasource */
-IMG_Animation *IMG_LoadGIFAnimation_IO(SDL_IOStream *src)
+/* Scan the blocks of the animation without decoding any image data,
+   recording where each frame is and how it's shown */
+static bool
+ScanFrames(GIF_AnimationContext * ctx, Sint64 start)
 {
-    (void)src;
-    return NULL;
-}
+    State_t *state = ctx->state;
+    unsigned char buf[16];
+    unsigned char c;
+    int capacity = 0;
 
-#endif /* LOAD_GIF */
+    for ( ; ; ) {
+        GIF_FrameInfo *info;
 
-#if !defined(__APPLE__) || defined(SDL_IMAGE_USE_COMMON_BACKEND)
+        if (!ReadOK(state, &c, 1) || c == ';') {
+            break;
+        }
+        if (c == '!') {     /* Extension */
+            if (!ReadOK(state, &c, 1)) {
+                break;
+            }
+            DoExtension(c, state);
+            continue;
+        }
+        if (c != ',') {     /* Not a valid start character */
+            continue;
+        }
 
-#ifdef LOAD_GIF
+        if (ctx->num_frames == capacity) {
+            GIF_FrameInfo *frames;
 
-/* See if an image is contained in a data source */
-bool IMG_isGIF(SDL_IOStream *src)
-{
-    Sint64 start;
-    bool is_GIF;
-    char magic[6];
+            capacity = capacity ? capacity * 2 : 16;
+            frames = (GIF_FrameInfo *)SDL_realloc(ctx->frames, capacity * sizeof(*frames));
+            if (!frames) {
+                return false;
+            }
+            ctx->frames = frames;
+        }
+        info = &ctx->frames[ctx->num_frames];
+        info->offset = TellInput(state) - start;
+        info->size = -1;
 
-    if (!src) {
-        return false;
+        if (!ReadOK(state, buf, 9)) {
+            break;
+        }
+        info->rect.x = LM_to_uint(buf[0], buf[1]);
+        info->rect.y = LM_to_uint(buf[2], buf[3]);
+        info->rect.w = LM_to_uint(buf[4], buf[5]);
+        info->rect.h = LM_to_uint(buf[6], buf[7]);
+        info->local_colormap = BitSet(buf[8], LOCALCOLORMAP);
+        info->transparent = state->Gif89.transparent;
+        info->disposal = state->Gif89.disposal;
+        info->delayTime = state->Gif89.delayTime;
+        ++ctx->num_frames;
+
+        /* Skip the local color table, the LZW code size and the image data */
+        if (info->local_colormap) {
+            unsigned char colormap[3 * MAXCOLORMAPSIZE];
+
+            if (!ReadOK(state, colormap, 3 * (1 << ((buf[8] & 0x07) + 1)))) {
+                break;
+            }
+        }
+        if (!ReadOK(state, &c, 1)) {
+            break;
+        }
+        if (c >= MAX_LWZ_BITS) {
+            break;
+        }
+        while (GetDataBlock(state->block, state) > 0)
+            ;
+        info->size = TellInput(state) - start - info->offset;
+    }
+    ctx->end = TellInput(state) - start;
+    return true;
+}
+
+/* Check that every frame uses the global color table and, if the first
+   frame has a transparent color, that they all share it. In that case
+   the animation can be composited with the global palette. */
+static bool
+CanUseIndexedCanvas(const GIF_AnimationContext * ctx, int *transparent)
+{
+    int i;
+
+    *transparent = -1;
+    for (i = 0; i < ctx->num_frames; ++i) {
+        const GIF_FrameInfo *info = &ctx->frames[i];
+
+        if (info->local_colormap) {
+            return false;
+        }
+        if (i == 0) {
+            *transparent = info->transparent;
+        } else if (*transparent >= 0 && info->transparent != *transparent) {
+            return false;
+        }
+    }
+    return ctx->num_frames > 0;
+}
+
+static IMG_AnimationDecoderStatus
+GIF_GetNextFrame(IMG_AnimationDecoder *decoder, SDL_Surface **frame, int *delay, SDL_Rect *dirty)
+{
+    GIF_AnimationContext *ctx = (GIF_AnimationContext *)decoder->ctx;
+    Frame_t next;
+    SDL_Rect rect, bounds;
+
+    if (ctx->pending.image) {
+        next = ctx->pending;
+        ctx->pending.image = NULL;
+    } else if (ctx->decoded) {
+        if (ctx->next_frame >= ctx->num_frames) {
+            return IMG_DECODER_STATUS_COMPLETE;
+        }
+        next = ctx->decoded[ctx->next_frame];
+        ctx->decoded[ctx->next_frame].image = NULL;
+        if (!next.image) {
+            SDL_SetError("Couldn't decode GIF frame %d", ctx->next_frame);
+            return IMG_DECODER_STATUS_FAILED;
+        }
+    } else {
+        switch (ReadFrame(ctx->state, &next)) {
+        case 1:
+            break;
+        case 0:
+            return IMG_DECODER_STATUS_COMPLETE;
+        default:
+            return IMG_DECODER_STATUS_FAILED;
+        }
+    }
+
+    /* Dispose of the previous frame */
+    SDL_zerop(dirty);
+    switch (ctx->last_disposal) {
+    case GIF_DISPOSE_RESTORE_BACKGROUND:
+        SDL_FillSurfaceRect(ctx->canvas, &ctx->last_rect, ctx->background);
+        *dirty = ctx->last_rect;
+        break;
+    case GIF_DISPOSE_RESTORE_PREVIOUS:
+        CopyRect(ctx->restore, ctx->canvas, &ctx->last_rect);
+        *dirty = ctx->last_rect;
+        break;
+    default:
+        break;
+    }
+
+    rect.x = next.x;
+    rect.y = next.y;
+    rect.w = next.image->w;
+    rect.h = next.image->h;
+    bounds.x = 0;
+    bounds.y = 0;
+    bounds.w = ctx->canvas->w;
+    bounds.h = ctx->canvas->h;
+    if (!SDL_GetRectIntersection(&rect, &bounds, &ctx->last_rect)) {
+        SDL_zero(ctx->last_rect);
+    }
+    SDL_GetRectUnion(dirty, &ctx->last_rect, dirty);
+
+    if (next.disposal == GIF_DISPOSE_RESTORE_PREVIOUS) {
+        if (!ctx->restore) {
+            ctx->restore = SDL_CreateSurface(ctx->canvas->w, ctx->canvas->h, ctx->canvas->format);
+            if (!ctx->restore) {
+                SDL_DestroySurface(next.image);
+                return IMG_DECODER_STATUS_FAILED;
+            }
+        }
+        CopyRect(ctx->canvas, ctx->restore, &ctx->last_rect);
+    }
+    if (ctx->canvas->format == SDL_PIXELFORMAT_INDEX8) {
+        BlitIndexed(next.image, next.x, next.y, ctx->canvas, &ctx->last_rect);
+    } else {
+        SDL_BlitSurface(next.image, NULL, ctx->canvas, &rect);
+    }
+    SDL_DestroySurface(next.image);
+
+    ctx->last_disposal = next.disposal;
+    ++ctx->next_frame;
+    *frame = ctx->canvas;
+    *delay = next.delay;
+    return IMG_DECODER_STATUS_OK;
+}
+
+static void
+FreeDecodedFrames(GIF_AnimationContext * ctx)
+{
+    int i;
+
+    if (ctx->decoded) {
+        for (i = 0; i < ctx->num_frames; ++i) {
+            if (ctx->decoded[i].image) {
+                SDL_DestroySurface(ctx->decoded[i].image);
+            }
+        }
+        SDL_free(ctx->decoded);
+        ctx->decoded = NULL;
+    }
+}
+
+/* Decode a frame found by the scan into ctx->pending, leaving the
+   stream right after it so the frames that follow can be read in order */
+static bool
+ReadFrameAt(IMG_AnimationDecoder *decoder, int index)
+{
+    GIF_AnimationContext *ctx = (GIF_AnimationContext *)decoder->ctx;
+    const GIF_FrameInfo *info = &ctx->frames[index];
+
+    if (SDL_SeekIO(decoder->src, decoder->start + info->offset, SDL_IO_SEEK_SET) < 0) {
+        return false;
+    }
+    ctx->state->input_pos = ctx->state->input_len = 0;
+    ctx->state->Gif89.transparent = info->transparent;
+    ctx->state->Gif89.disposal = info->disposal;
+    ctx->state->Gif89.delayTime = info->delayTime;
+    return ReadFrameImage(ctx->state, &ctx->pending);
+}
+
+static bool
+GIF_RewindAnimation(IMG_AnimationDecoder *decoder)
+{
+    GIF_AnimationContext *ctx = (GIF_AnimationContext *)decoder->ctx;
+
+    if (ctx->pending.image) {
+        SDL_DestroySurface(ctx->pending.image);
+        ctx->pending.image = NULL;
+    }
+    FreeDecodedFrames(ctx);
+    if (!ReadFrameAt(decoder, 0)) {
+        return false;
+    }
+    SDL_FillSurfaceRect(ctx->canvas, NULL, ctx->background);
+    ctx->last_disposal = GIF_DISPOSE_NA;
+    ctx->next_frame = 0;
+    return true;
+}
+
+static bool
+GIF_GetFrameDelay(IMG_AnimationDecoder *decoder, int index, int *delay)
+{
+    GIF_AnimationContext *ctx = (GIF_AnimationContext *)decoder->ctx;
+
+    if (index >= ctx->num_frames) {
+        return false;
+    }
+    *delay = GetFrameDelay(ctx->frames[index].delayTime);
+    return true;
+}
+
+static bool
+CoversCanvas(const GIF_AnimationContext * ctx, const SDL_Rect *rect)
+{
+    return rect->x == 0 && rect->y == 0 &&
+           rect->w >= ctx->canvas->w && rect->h >= ctx->canvas->h;
+}
+
+/* A frame can be composited without the frames before it if the previous
+   frame cleared the whole canvas, or if it paints over all of it. Frames
+   disposed to previous bring back what was under them, so they don't count. */
+static bool
+IsKeyFrame(const GIF_AnimationContext * ctx, int index)
+{
+    const GIF_FrameInfo *info = &ctx->frames[index];
+
+    if (index == 0) {
+        return true;
+    }
+    if (info[-1].disposal == GIF_DISPOSE_RESTORE_BACKGROUND && CoversCanvas(ctx, &info[-1].rect)) {
+        return true;
+    }
+    if (info->transparent < 0 && info->disposal != GIF_DISPOSE_RESTORE_PREVIOUS && CoversCanvas(ctx, &info->rect)) {
+        return true;
+    }
+    return false;
+}
+
+static bool
+GIF_SeekAnimation(IMG_AnimationDecoder *decoder, int index)
+{
+    GIF_AnimationContext *ctx = (GIF_AnimationContext *)decoder->ctx;
+    SDL_Surface *frame;
+    SDL_Rect dirty;
+    int key, delay;
+
+    key = index;
+    while (!IsKeyFrame(ctx, key)) {
+        --key;
+    }
+
+    /* Carry on from the current frame if it's between the key frame and the one we want */
+    if (decoder->status != IMG_DECODER_STATUS_OK || ctx->next_frame < key || ctx->next_frame > index) {
+        if (ctx->pending.image) {
+            SDL_DestroySurface(ctx->pending.image);
+            ctx->pending.image = NULL;
+        }
+        FreeDecodedFrames(ctx);
+        if (!ReadFrameAt(decoder, key)) {
+            return false;
+        }
+        SDL_FillSurfaceRect(ctx->canvas, NULL, ctx->background);
+        ctx->last_disposal = GIF_DISPOSE_NA;
+        ctx->next_frame = key;
+    }
+
+    while (ctx->next_frame < index) {
+        switch (GIF_GetNextFrame(decoder, &frame, &delay, &dirty)) {
+        case IMG_DECODER_STATUS_OK:
+            break;
+        case IMG_DECODER_STATUS_COMPLETE:
+            return SDL_SetError("Couldn't read GIF frame %d", ctx->next_frame);
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+GIF_CloseAnimation(IMG_AnimationDecoder *decoder)
+{
+    GIF_AnimationContext *ctx = (GIF_AnimationContext *)decoder->ctx;
+
+    if (ctx->pending.image) {
+        SDL_DestroySurface(ctx->pending.image);
+    }
+    FreeDecodedFrames(ctx);
+    SDL_free(ctx->frames);
+    if (ctx->canvas) {
+        SDL_DestroySurface(ctx->canvas);
+    }
+    if (ctx->restore) {
+        SDL_DestroySurface(ctx->restore);
+    }
+    if (ctx->state) {
+        /* Leave the stream right after the data we actually used */
+        UnreadInput(ctx->state);
+        SDL_free(ctx->state);
+    }
+    SDL_free(ctx);
+}
+
+bool IMG_CreateGIFAnimationDecoder(IMG_AnimationDecoder *decoder)
+{
+    GIF_AnimationContext *ctx;
+    SDL_PixelFormat format;
+    bool indexed;
+    int transparent, background = -1;
+    int ncolors = 0;
+    int w, h, i;
+
+    ctx = (GIF_AnimationContext *)SDL_calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        return false;
+    }
+    decoder->ctx = ctx;
+
+    ctx->state = (State_t *)SDL_calloc(1, sizeof(*ctx->state));
+    if (!ctx->state) {
+        goto error;
+    }
+    ctx->state->src = decoder->src;
+
+    /* Look ahead to find the frames and see whether they can be composited with the global palette */
+    if (!ReadHeader(ctx->state)) {
+        goto error;
+    }
+    if (!ScanFrames(ctx, decoder->start)) {
+        goto error;
+    }
+    if (ctx->num_frames == 0) {
+        RWSetMsg("no images in GIF");
+        goto error;
+    }
+    indexed = CanUseIndexedCanvas(ctx, &transparent);
+
+    /* Go straight back to the first frame, which decides the format of the canvas */
+    if (!ReadFrameAt(decoder, 0)) {
+        goto error;
+    }
+
+    w = ctx->state->GifScreen.Width;
+    h = ctx->state->GifScreen.Height;
+    if (w == 0 || h == 0) {
+        w = ctx->pending.x + ctx->pending.image->w;
+        h = ctx->pending.y + ctx->pending.image->h;
+    }
+
+    if (indexed) {
+        ncolors = (int)ctx->state->GifScreen.BitPixel;
+
+        /* The background is the transparent color, or black if there isn't one */
+        background = transparent;
+        if (background >= ncolors) {
+            ncolors = background + 1;
+        } else if (background < 0) {
+            for (i = 0; i < ncolors; ++i) {
+                if (ctx->state->GifScreen.ColorMap[CM_RED][i] == 0 &&
+                    ctx->state->GifScreen.ColorMap[CM_GREEN][i] == 0 &&
+                    ctx->state->GifScreen.ColorMap[CM_BLUE][i] == 0) {
+                    background = i;
+                    break;
+                }
+            }
+            if (background < 0 && ncolors < MAXCOLORMAPSIZE) {
+                background = ncolors++;
+            }
+        }
+        if (background < 0) {
+            indexed = false;
+        }
+    }
+
+    if (indexed) {
+        SDL_Palette *palette;
+
+        ctx->canvas = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_INDEX8);
+        if (!ctx->canvas) {
+            goto error;
+        }
+        palette = SDL_CreateSurfacePalette(ctx->canvas);
+        if (!palette) {
+            goto error;
+        }
+        palette->ncolors = ncolors;
+        for (i = 0; i < ncolors; ++i) {
+            if (i < (int)ctx->state->GifScreen.BitPixel) {
+                ImageSetCmap(ctx->canvas, i,
+                             ctx->state->GifScreen.ColorMap[CM_RED][i],
+                             ctx->state->GifScreen.ColorMap[CM_GREEN][i],
+                             ctx->state->GifScreen.ColorMap[CM_BLUE][i]);
+            } else {
+                ImageSetCmap(ctx->canvas, i, 0, 0, 0);
+            }
+        }
+        if (transparent >= 0) {
+            palette->colors[transparent].r = 0;
+            palette->colors[transparent].g = 0;
+            palette->colors[transparent].b = 0;
+            palette->colors[transparent].a = SDL_ALPHA_TRANSPARENT;
+            SDL_SetSurfaceColorKey(ctx->canvas, true, transparent);
+        }
+        ctx->background = background;
+    } else {
+        if (SDL_SurfaceHasColorKey(ctx->pending.image)) {
+            format = SDL_PIXELFORMAT_ARGB8888;
+        } else {
+            format = SDL_PIXELFORMAT_XRGB8888;
+        }
+        ctx->canvas = SDL_CreateSurface(w, h, format);
+        if (!ctx->canvas) {
+            goto error;
+        }
+        ctx->background = SDL_MapSurfaceRGBA(ctx->canvas, 0, 0, 0, SDL_ALPHA_TRANSPARENT);
+    }
+    SDL_FillSurfaceRect(ctx->canvas, NULL, ctx->background);
+    ctx->last_disposal = GIF_DISPOSE_NA;
+
+    decoder->w = w;
+    decoder->h = h;
+    decoder->GetNextFrame = GIF_GetNextFrame;
+    decoder->Rewind = GIF_RewindAnimation;
+    decoder->GetFrameDelay = GIF_GetFrameDelay;
+    decoder->Seek = GIF_SeekAnimation;
+    decoder->Close = GIF_CloseAnimation;
+    return true;
+
+error:
+    GIF_CloseAnimation(decoder);
+    decoder->ctx = NULL;
+    return false;
+}
+
+typedef struct
+{
+    GIF_AnimationContext *ctx;
+    const Uint8 *data;
+    size_t size;
+    SDL_AtomicInt next;
+} GIF_DecodeFramesContext;
+
+static int SDLCALL
+GIF_DecodeFrames(void *data)
+{
+    GIF_DecodeFramesContext *job = (GIF_DecodeFramesContext *)data;
+    GIF_AnimationContext *ctx = job->ctx;
+    State_t *state;
+    int i;
+
+    state = (State_t *)SDL_malloc(sizeof(*state));
+    if (!state) {
+        return 0;
+    }
+    state->GifScreen = ctx->state->GifScreen;
+
+    while ((i = SDL_AddAtomicInt(&job->next, 1)) < ctx->num_frames) {
+        const GIF_FrameInfo *info = &ctx->frames[i];
+        Sint64 size = (info->size >= 0) ? info->size : ((Sint64)job->size - info->offset);
+
+        state->src = SDL_IOFromConstMem(job->data + info->offset, (size_t)size);
+        if (!state->src) {
+            continue;
+        }
+        state->input_pos = state->input_len = 0;
+        state->Gif89.transparent = info->transparent;
+        state->Gif89.disposal = info->disposal;
+        state->Gif89.delayTime = info->delayTime;
+        ReadFrameImage(state, &ctx->decoded[i]);
+        SDL_CloseIO(state->src);
+    }
+    SDL_free(state);
+    return 0;
+}
+
+/* Decode the LZW data of every frame after the first on several threads,
+   leaving them to be composited in order. The data is a copy of the whole
+   GIF in memory, which the decoder is reading from. */
+static void
+DecodeFramesInParallel(GIF_AnimationContext * ctx, const Uint8 *data, size_t size, int num_threads)
+{
+    GIF_DecodeFramesContext job;
+    SDL_Thread **threads;
+    int i;
+
+    ctx->decoded = (Frame_t *)SDL_calloc(ctx->num_frames, sizeof(*ctx->decoded));
+    threads = (SDL_Thread **)SDL_calloc(num_threads, sizeof(*threads));
+    if (!ctx->decoded || !threads) {
+        /* Read the frames one at a time instead */
+        SDL_free(ctx->decoded);
+        ctx->decoded = NULL;
+        SDL_free(threads);
+        return;
+    }
+
+    SDL_zero(job);
+    job.ctx = ctx;
+    job.data = data;
+    job.size = size;
+    SDL_SetAtomicInt(&job.next, 1);     /* The first frame was read when the decoder was created */
+
+    /* The calling thread decodes frames too */
+    for (i = 1; i < num_threads; ++i) {
+        threads[i] = SDL_CreateThread(GIF_DecodeFrames, "SDL_image GIF", &job);
+        if (!threads[i]) {
+            break;
+        }
+    }
+    GIF_DecodeFrames(&job);
+    for (i = 1; i < num_threads; ++i) {
+        SDL_WaitThread(threads[i], NULL);
+    }
+    SDL_free(threads);
+}
+
+static int
+GetNumThreads(void)
+{
+    const char *hint = SDL_GetHint(IMG_HINT_GIF_LOAD_THREADS);
+    int num_threads = hint ? SDL_atoi(hint) : 1;
+
+    if (num_threads <= 0) {
+        num_threads = SDL_GetNumLogicalCPUCores();
+    }
+    return num_threads;
+}
+
+/* Load a GIF type animation from an SDL datasource */
+IMG_Animation *IMG_LoadGIFAnimation_IO(SDL_IOStream *src)
+{
+    IMG_AnimationDecoder decoder;
+    IMG_Animation *anim;
+    GIF_AnimationContext *ctx;
+    SDL_IOStream *mem = NULL;
+    void *data = NULL;
+    size_t size = 0;
+    Sint64 start, end;
+    int num_threads;
+
+    if (src == NULL) {
+        return NULL;
+    }
+
+    start = SDL_TellIO(src);
+    SDL_zero(decoder);
+    decoder.src = src;
+    decoder.start = start;
+
+    /* The frames are scanned before they're decoded, and worker threads can't
+       share the stream, so decode from a copy in memory. That way the stream
+       is read only once, and it doesn't need to be able to seek. */
+    data = SDL_LoadFile_IO(src, &size, false);
+    if (data) {
+        mem = SDL_IOFromConstMem(data, size);
+    }
+    if (mem) {
+        decoder.src = mem;
+        decoder.start = 0;
+    } else {
+        SDL_free(data);
+        data = NULL;
+        if (start < 0 || SDL_SeekIO(src, start, SDL_IO_SEEK_SET) < 0) {
+            return NULL;
+        }
+    }
+
+    anim = NULL;
+    num_threads = GetNumThreads();
+    if (IMG_CreateGIFAnimationDecoder(&decoder)) {
+        ctx = (GIF_AnimationContext *)decoder.ctx;
+        num_threads = SDL_min(num_threads, ctx->num_frames - 1);
+        if (mem && num_threads > 1) {
+            DecodeFramesInParallel(ctx, (const Uint8 *)data, size, num_threads);
+        }
+        anim = IMG_DecodeAnimation(&decoder);
+        end = ctx->end;
+        decoder.Close(&decoder);
+
+        if (mem && start >= 0) {
+            /* Leave the stream right after the GIF data, as if it had been read directly */
+            SDL_SeekIO(src, start + end, SDL_IO_SEEK_SET);
+        }
+    }
+    if (mem) {
+        SDL_CloseIO(mem);
+        SDL_free(data);
+    }
+    return anim;
+}
+
+#else
+
+bool IMG_CreateGIFAnimationDecoder(IMG_AnimationDecoder *decoder)
+{
+    (void)decoder;
+    return SDL_SetError("GIF animations are not supported");
+}
+
+/* Load a GIF type animation from an SDL datasource */
+IMG_Animation *IMG_LoadGIFAnimation_IO(SDL_IOStream *src)
+{
+    (void)src;
+    return NULL;
+}
+
+#endif /* LOAD_GIF */
+
+#if !defined(__APPLE__) || defined(SDL_IMAGE_USE_COMMON_BACKEND)
+
+#ifdef LOAD_GIF
+
+/* See if an image is contained in a data source */
+bool IMG_isGIF(SDL_IOStream *src)
+{
+    Sint64 start;
+    bool is_GIF;
+    char magic[6];
+
+    if (!src) {
+        return false;
     }
 
     start = SDL_TellIO(src);
@@ -779,14 +1376,29 @@ bool IMG_isGIF(SDL_IOStream *src)
 /* Load a GIF type image from an SDL datasource */
 SDL_Surface *IMG_LoadGIF_IO(SDL_IOStream *src)
 {
-    SDL_Surface *image = NULL;
-    Anim_t *internal = IMG_LoadGIF_IO_Internal(src, false);
-    if (internal) {
-        image = internal->frames[0].image;
-        SDL_free(internal->frames);
-        SDL_free(internal);
+    State_t *state;
+    Frame_t frame;
+
+    if (src == NULL) {
+        return NULL;
     }
-    return image;
+
+    state = (State_t *)SDL_calloc(1, sizeof(State_t));
+    if (state == NULL) {
+        return NULL;
+    }
+    state->src = src;
+
+    frame.image = NULL;
+    if (ReadHeader(state)) {
+        ReadFrame(state, &frame);
+    }
+
+    /* Leave the stream right after the data we actually used */
+    UnreadInput(state);
+    SDL_free(state);
+
+    return frame.image;
 }
 
 #else
@@ -808,3 +1420,755 @@ SDL_Surface *IMG_LoadGIF_IO(SDL_IOStream *src)
 #endif /* LOAD_GIF */
 
 #endif /* !defined(__APPLE__) || defined(SDL_IMAGE_USE_COMMON_BACKEND) */
+
+/* Encoder settings, filled in from IMG_PROP_GIF_SAVE_* properties */
+struct savegif_options
+{
+    int palette_colors;
+    IMG_DitherMode dither;
+    int loop_count;
+    bool optimize;
+};
+
+#if SDL_IMAGE_SAVE_GIF
+
+/*
+ * Every frame is drawn on a 32-bit canvas, with each pixel made either fully
+ * transparent or opaque. A first pass works out the area of each frame that
+ * differs from what is already on screen, so only that rectangle is stored,
+ * with the pixels in it that don't change left transparent. Frames that
+ * change nothing are merged into the previous one, and a frame is disposed
+ * to background when the next one makes some of its pixels transparent.
+ *
+ * If all the stored pixels fit in the palette, they share the global color
+ * table and are stored exactly. Otherwise each frame is quantized to a local
+ * color table of its own. A second pass draws the frames again and writes
+ * them out with LZW compression.
+ */
+#define GIF_WRITE_SIZE          (64 * 1024)
+#define GIF_LZW_MAX_BITS        12
+#define GIF_LZW_HASH_BITS       13      /* twice the number of LZW codes */
+#define GIF_LZW_HASH_SIZE       (1 << GIF_LZW_HASH_BITS)
+#define GIF_COLOR_HASH_SIZE     1024    /* a power of two, well above 256 */
+
+typedef struct
+{
+    SDL_Rect rect;      /* The area stored, empty if merged into an earlier frame */
+    int disposal;
+    int delay;
+} GIF_FramePlan;
+
+typedef struct
+{
+    SDL_IOStream *dst;
+    bool error;
+
+    /* LZW compression state */
+    Uint32 bits;
+    int nbits;
+    int block_len;
+    Uint8 block[255];
+    Sint32 keys[GIF_LZW_HASH_SIZE];
+    Uint16 codes[GIF_LZW_HASH_SIZE];
+
+    size_t output_len;
+    Uint8 output[GIF_WRITE_SIZE];
+} GIF_Writer;
+
+typedef struct
+{
+    const struct savegif_options *options;
+    int w, h;
+    int count;
+    SDL_Surface **frames;
+    const int *delays;          /* NULL for a still image */
+    GIF_FramePlan *plans;
+
+    SDL_Surface *previous;      /* What is on screen before the current frame */
+    SDL_Surface *current;
+
+    /* The distinct opaque colors of the stored pixels */
+    Uint32 keys[GIF_COLOR_HASH_SIZE];
+    bool used[GIF_COLOR_HASH_SIZE];
+    Uint8 values[GIF_COLOR_HASH_SIZE];
+    int ncolors;
+    bool overflow;
+
+    bool has_transparent;       /* Some stored pixels are transparent */
+    bool global;                /* All frames are stored exactly with the global color table */
+    bool skip_unchanged;        /* Pixels that don't change are stored as transparent */
+    int transparent;            /* The transparent index in the global color table */
+    bool header_written;
+
+    GIF_Writer writer;
+} GIF_Encoder;
+
+static void FlushOutput(GIF_Writer *writer)
+{
+    if (writer->output_len > 0 && !writer->error) {
+        if (SDL_WriteIO(writer->dst, writer->output, writer->output_len) != writer->output_len) {
+            writer->error = true;
+        }
+    }
+    writer->output_len = 0;
+}
+
+static void WriteOutput(GIF_Writer *writer, const void *data, size_t len)
+{
+    const Uint8 *src = (const Uint8 *)data;
+
+    while (len > 0 && !writer->error) {
+        size_t amount = SDL_min(len, sizeof(writer->output) - writer->output_len);
+
+        SDL_memcpy(&writer->output[writer->output_len], src, amount);
+        writer->output_len += amount;
+        src += amount;
+        len -= amount;
+        if (writer->output_len == sizeof(writer->output)) {
+            FlushOutput(writer);
+        }
+    }
+}
+
+static void WriteByte(GIF_Writer *writer, Uint8 value)
+{
+    WriteOutput(writer, &value, 1);
+}
+
+static void WriteWord(GIF_Writer *writer, int value)
+{
+    Uint8 data[2];
+
+    data[0] = (Uint8)(value & 0xFF);
+    data[1] = (Uint8)((value >> 8) & 0xFF);
+    WriteOutput(writer, data, sizeof(data));
+}
+
+/* The number of bits needed for a color table, from 1 to 8 */
+static int GetColorTableBits(int ncolors)
+{
+    int bits = 1;
+
+    while ((1 << bits) < ncolors) {
+        ++bits;
+    }
+    return bits;
+}
+
+static void WriteColorTable(GIF_Writer *writer, const SDL_Color *colors, int ncolors, int bits)
+{
+    int i;
+
+    for (i = 0; i < (1 << bits); ++i) {
+        Uint8 rgb[3] = { 0, 0, 0 };
+
+        if (i < ncolors) {
+            rgb[0] = colors[i].r;
+            rgb[1] = colors[i].g;
+            rgb[2] = colors[i].b;
+        }
+        WriteOutput(writer, rgb, sizeof(rgb));
+    }
+}
+
+static void WriteCode(GIF_Writer *writer, int code, int code_size)
+{
+    writer->bits |= (Uint32)code << writer->nbits;
+    writer->nbits += code_size;
+    while (writer->nbits >= 8) {
+        writer->block[writer->block_len++] = (Uint8)writer->bits;
+        writer->bits >>= 8;
+        writer->nbits -= 8;
+        if (writer->block_len == (int)sizeof(writer->block)) {
+            WriteByte(writer, (Uint8)writer->block_len);
+            WriteOutput(writer, writer->block, writer->block_len);
+            writer->block_len = 0;
+        }
+    }
+}
+
+/* Compress the palette indices of an image into LZW data sub-blocks */
+static void WriteImageData(GIF_Writer *writer, SDL_Surface *indices, int min_code_size)
+{
+    const int clear_code = 1 << min_code_size;
+    int next = clear_code + 2;
+    int code_size = min_code_size + 1;
+    int prefix = -1;
+    int x, y;
+
+    WriteByte(writer, (Uint8)min_code_size);
+    writer->bits = 0;
+    writer->nbits = 0;
+    writer->block_len = 0;
+    SDL_memset(writer->keys, 0xFF, sizeof(writer->keys));
+
+    WriteCode(writer, clear_code, code_size);
+    for (y = 0; y < indices->h; ++y) {
+        const Uint8 *p = (const Uint8 *)indices->pixels + y * indices->pitch;
+
+        for (x = 0; x < indices->w; ++x) {
+            Sint32 key;
+            Uint32 slot;
+
+            if (prefix < 0) {
+                prefix = p[x];
+                continue;
+            }
+
+            /* Extend the current string if it's in the table */
+            key = (prefix << 8) | p[x];
+            slot = ((Uint32)key * 2654435761u) >> (32 - GIF_LZW_HASH_BITS);
+            while (writer->keys[slot] >= 0 && writer->keys[slot] != key) {
+                slot = (slot + 1) & (GIF_LZW_HASH_SIZE - 1);
+            }
+            if (writer->keys[slot] == key) {
+                prefix = writer->codes[slot];
+                continue;
+            }
+
+            WriteCode(writer, prefix, code_size);
+            if (next < (1 << GIF_LZW_MAX_BITS)) {
+                writer->keys[slot] = key;
+                writer->codes[slot] = (Uint16)next++;
+                if (next > (1 << code_size) && code_size < GIF_LZW_MAX_BITS) {
+                    ++code_size;
+                }
+            } else {
+                /* The table is full, start over */
+                WriteCode(writer, clear_code, code_size);
+                SDL_memset(writer->keys, 0xFF, sizeof(writer->keys));
+                next = clear_code + 2;
+                code_size = min_code_size + 1;
+            }
+            prefix = p[x];
+        }
+    }
+    WriteCode(writer, prefix, code_size);
+    WriteCode(writer, clear_code + 1, code_size);
+
+    if (writer->nbits > 0) {
+        WriteCode(writer, 0, 8 - writer->nbits);
+    }
+    if (writer->block_len > 0) {
+        WriteByte(writer, (Uint8)writer->block_len);
+        WriteOutput(writer, writer->block, writer->block_len);
+    }
+    WriteByte(writer, 0);
+}
+
+/* Draw a frame on the canvas, with each pixel either fully transparent or opaque */
+static bool DrawFrame(SDL_Surface *frame, SDL_Surface *canvas)
+{
+    SDL_BlendMode blend = SDL_BLENDMODE_NONE;
+    bool result;
+    int x, y;
+
+    SDL_FillSurfaceRect(canvas, NULL, 0);
+    SDL_GetSurfaceBlendMode(frame, &blend);
+    SDL_SetSurfaceBlendMode(frame, SDL_BLENDMODE_NONE);
+    result = SDL_BlitSurface(frame, NULL, canvas, NULL);
+    SDL_SetSurfaceBlendMode(frame, blend);
+    if (!result) {
+        return false;
+    }
+
+    for (y = 0; y < canvas->h; ++y) {
+        Uint8 *p = (Uint8 *)canvas->pixels + y * canvas->pitch;
+
+        for (x = 0; x < canvas->w; ++x, p += 4) {
+            if (p[3] < 128) {
+                SDL_memset(p, 0, 4);
+            } else {
+                p[3] = 0xFF;
+            }
+        }
+    }
+    return true;
+}
+
+static const Uint32 *GetCanvasRow(SDL_Surface *canvas, int y)
+{
+    return (const Uint32 *)((const Uint8 *)canvas->pixels + y * canvas->pitch);
+}
+
+/* Find the bounding box of the pixels that change between two canvases,
+   or only of those that turn transparent. Returns false if there are none. */
+static bool GetChangedRect(SDL_Surface *previous, SDL_Surface *current, bool cleared_only, SDL_Rect *rect)
+{
+    int minx = current->w, miny = current->h, maxx = -1, maxy = -1;
+    int x, y;
+
+    for (y = 0; y < current->h; ++y) {
+        const Uint32 *p = GetCanvasRow(previous, y);
+        const Uint32 *q = GetCanvasRow(current, y);
+
+        for (x = 0; x < current->w; ++x) {
+            if (cleared_only ? (q[x] == 0 && p[x] != 0) : (q[x] != p[x])) {
+                minx = SDL_min(minx, x);
+                maxx = SDL_max(maxx, x);
+                miny = SDL_min(miny, y);
+                maxy = y;
+            }
+        }
+    }
+    if (maxx < 0) {
+        return false;
+    }
+    rect->x = minx;
+    rect->y = miny;
+    rect->w = maxx - minx + 1;
+    rect->h = maxy - miny + 1;
+    return true;
+}
+
+/* Look up a color in the hash table, returning its slot, which is empty if the color isn't there */
+static Uint32 FindColorSlot(const GIF_Encoder *enc, Uint32 color)
+{
+    Uint32 slot = (color * 2654435761u) >> 22;
+
+    while (enc->used[slot] && enc->keys[slot] != color) {
+        slot = (slot + 1) & (GIF_COLOR_HASH_SIZE - 1);
+    }
+    return slot;
+}
+
+/* Add the colors of the stored area of the current frame to the set */
+static void CountColors(GIF_Encoder *enc, const SDL_Rect *rect)
+{
+    int x, y;
+
+    for (y = rect->y; y < rect->y + rect->h; ++y) {
+        const Uint32 *q = GetCanvasRow(enc->current, y);
+
+        for (x = rect->x; x < rect->x + rect->w; ++x) {
+            Uint32 slot;
+
+            if (q[x] == 0) {
+                enc->has_transparent = true;
+                continue;
+            }
+            if (enc->overflow) {
+                continue;
+            }
+            slot = FindColorSlot(enc, q[x]);
+            if (!enc->used[slot]) {
+                if (enc->ncolors == 256) {
+                    enc->overflow = true;
+                    continue;
+                }
+                enc->used[slot] = true;
+                enc->keys[slot] = q[x];
+                ++enc->ncolors;
+            }
+        }
+    }
+}
+
+static void SwapCanvas(GIF_Encoder *enc)
+{
+    SDL_Surface *swap = enc->previous;
+    enc->previous = enc->current;
+    enc->current = swap;
+}
+
+/* Work out the area stored and the disposal of each frame */
+static bool PlanFrames(GIF_Encoder *enc)
+{
+    int last = -1;  /* The last frame that is stored */
+    int i;
+
+    SDL_FillSurfaceRect(enc->previous, NULL, 0);
+    for (i = 0; i < enc->count; ++i) {
+        GIF_FramePlan *plan = &enc->plans[i];
+        SDL_Rect cleared;
+
+        if (!DrawFrame(enc->frames[i], enc->current)) {
+            return false;
+        }
+        plan->disposal = GIF_DISPOSE_NONE;
+        plan->delay = enc->delays ? enc->delays[i] : 0;
+
+        if (last < 0 || !enc->options->optimize) {
+            /* Store the whole frame, drawn on an empty screen */
+            plan->rect.x = 0;
+            plan->rect.y = 0;
+            plan->rect.w = enc->w;
+            plan->rect.h = enc->h;
+            if (!enc->options->optimize) {
+                plan->disposal = GIF_DISPOSE_RESTORE_BACKGROUND;
+            }
+            SDL_FillSurfaceRect(enc->previous, NULL, 0);
+        } else {
+            GIF_FramePlan *prev = &enc->plans[last];
+            bool disposed = false;
+
+            /* Pixels can only become transparent if the last frame is disposed to background */
+            if (GetChangedRect(enc->previous, enc->current, true, &cleared)) {
+                prev->disposal = GIF_DISPOSE_RESTORE_BACKGROUND;
+                SDL_GetRectUnion(&prev->rect, &cleared, &prev->rect);
+                SDL_FillSurfaceRect(enc->previous, &prev->rect, 0);
+                disposed = true;
+            }
+
+            if (!GetChangedRect(enc->previous, enc->current, false, &plan->rect)) {
+                if (!disposed) {
+                    /* Nothing changes, show the last frame for longer */
+                    prev->delay += plan->delay;
+                    plan->rect.w = 0;
+                    plan->rect.h = 0;
+                    continue;
+                }
+
+                /* The frame still has to be there for the disposal to happen */
+                plan->rect.x = prev->rect.x;
+                plan->rect.y = prev->rect.y;
+                plan->rect.w = 1;
+                plan->rect.h = 1;
+            }
+        }
+        CountColors(enc, &plan->rect);
+        last = i;
+        SwapCanvas(enc);
+    }
+    return true;
+}
+
+static void WriteHeader(GIF_Encoder *enc, const SDL_Color *colors, int ncolors)
+{
+    GIF_Writer *writer = &enc->writer;
+    int bits = 0;
+
+    WriteOutput(writer, "GIF89a", 6);
+    WriteWord(writer, enc->w);
+    WriteWord(writer, enc->h);
+    if (ncolors > 0) {
+        bits = GetColorTableBits(ncolors);
+        WriteByte(writer, (Uint8)(0x80 | ((bits - 1) << 4) | (bits - 1)));
+    } else {
+        WriteByte(writer, 0);
+    }
+    WriteByte(writer, 0);   /* Background color */
+    WriteByte(writer, 0);   /* Aspect ratio */
+    if (ncolors > 0) {
+        WriteColorTable(writer, colors, ncolors, bits);
+    }
+
+    if (enc->delays && enc->options->loop_count != 1) {
+        int loops = enc->options->loop_count ? SDL_min(enc->options->loop_count - 1, 0xFFFF) : 0;
+
+        WriteByte(writer, 0x21);
+        WriteByte(writer, 0xFF);
+        WriteByte(writer, 11);
+        WriteOutput(writer, "NETSCAPE2.0", 11);
+        WriteByte(writer, 3);
+        WriteByte(writer, 1);
+        WriteWord(writer, loops);
+        WriteByte(writer, 0);
+    }
+    enc->header_written = true;
+}
+
+/* Build the global color table from the colors of all the frames */
+static void WriteGlobalHeader(GIF_Encoder *enc)
+{
+    SDL_Color colors[256];
+    int ncolors = 0;
+    int i;
+
+    enc->transparent = -1;
+    if (enc->has_transparent || enc->skip_unchanged) {
+        SDL_zero(colors[0]);
+        enc->transparent = ncolors++;
+    }
+    for (i = 0; i < GIF_COLOR_HASH_SIZE; ++i) {
+        if (enc->used[i]) {
+            const Uint8 *c = (const Uint8 *)&enc->keys[i];
+
+            colors[ncolors].r = c[0];
+            colors[ncolors].g = c[1];
+            colors[ncolors].b = c[2];
+            colors[ncolors].a = c[3];
+            enc->values[i] = (Uint8)ncolors++;
+        }
+    }
+    WriteHeader(enc, colors, ncolors);
+}
+
+/* Write the stored area of the current frame, drawn over the previous one */
+static bool WriteFrame(GIF_Encoder *enc, const GIF_FramePlan *plan)
+{
+    GIF_Writer *writer = &enc->writer;
+    const SDL_Rect *rect = &plan->rect;
+    SDL_Surface *indices;
+    SDL_Surface *patch = NULL;
+    SDL_Color colors[256];
+    int ncolors = 0;
+    int transparent = -1;
+    int bits;
+    int x, y;
+
+    indices = SDL_CreateSurface(rect->w, rect->h, SDL_PIXELFORMAT_INDEX8);
+    if (!indices) {
+        return false;
+    }
+
+    if (enc->global) {
+        for (y = 0; y < rect->h; ++y) {
+            const Uint32 *p = GetCanvasRow(enc->previous, rect->y + y) + rect->x;
+            const Uint32 *q = GetCanvasRow(enc->current, rect->y + y) + rect->x;
+            Uint8 *dst = (Uint8 *)indices->pixels + y * indices->pitch;
+
+            for (x = 0; x < rect->w; ++x) {
+                if (q[x] == 0 || (enc->skip_unchanged && q[x] == p[x])) {
+                    dst[x] = (Uint8)enc->transparent;
+                } else {
+                    dst[x] = enc->values[FindColorSlot(enc, q[x])];
+                }
+            }
+        }
+        transparent = enc->transparent;
+        bits = GetColorTableBits(enc->ncolors + (transparent >= 0 ? 1 : 0));
+    } else {
+        patch = SDL_CreateSurface(rect->w, rect->h, SDL_PIXELFORMAT_RGBA32);
+        if (!patch) {
+            SDL_DestroySurface(indices);
+            return false;
+        }
+        for (y = 0; y < rect->h; ++y) {
+            const Uint32 *p = GetCanvasRow(enc->previous, rect->y + y) + rect->x;
+            const Uint32 *q = GetCanvasRow(enc->current, rect->y + y) + rect->x;
+            Uint32 *dst = (Uint32 *)((Uint8 *)patch->pixels + y * patch->pitch);
+
+            for (x = 0; x < rect->w; ++x) {
+                dst[x] = (q[x] == p[x]) ? 0 : q[x];
+            }
+        }
+        ncolors = IMG_QuantizePixels(patch, indices, colors, enc->options->palette_colors, enc->options->dither, rect->x, rect->y);
+        SDL_DestroySurface(patch);
+        if (ncolors < 0) {
+            SDL_DestroySurface(indices);
+            return false;
+        }
+        if (colors[0].a == 0) {
+            transparent = 0;
+        }
+        bits = GetColorTableBits(ncolors);
+
+        /* A single image uses the global color table */
+        if (!enc->header_written) {
+            WriteHeader(enc, colors, ncolors);
+            ncolors = 0;
+        }
+    }
+
+    if (enc->delays || transparent >= 0) {
+        int delay = SDL_clamp((plan->delay + 5) / 10, 2, 0xFFFF);
+
+        WriteByte(writer, 0x21);
+        WriteByte(writer, 0xF9);
+        WriteByte(writer, 4);
+        WriteByte(writer, (Uint8)((plan->disposal << 2) | (transparent >= 0 ? 0x01 : 0x00)));
+        WriteWord(writer, enc->delays ? delay : 0);
+        WriteByte(writer, (Uint8)(transparent >= 0 ? transparent : 0));
+        WriteByte(writer, 0);
+    }
+
+    WriteByte(writer, ',');
+    WriteWord(writer, rect->x);
+    WriteWord(writer, rect->y);
+    WriteWord(writer, rect->w);
+    WriteWord(writer, rect->h);
+    if (ncolors > 0) {
+        WriteByte(writer, (Uint8)(0x80 | (bits - 1)));   /* Local color table */
+        WriteColorTable(writer, colors, ncolors, bits);
+    } else {
+        WriteByte(writer, 0);
+    }
+    WriteImageData(writer, indices, SDL_max(bits, 2));
+    SDL_DestroySurface(indices);
+
+    return !writer->error;
+}
+
+static bool GIF_SaveFrames(SDL_IOStream *dst, int w, int h, int count, SDL_Surface **frames, const int *delays, const struct savegif_options *options)
+{
+    GIF_Encoder *enc;
+    bool result = false;
+    int stored = 0;
+    int last = -1;
+    int i;
+
+    if (w <= 0 || h <= 0 || w > 0xFFFF || h > 0xFFFF) {
+        return SDL_SetError("GIF images can't be %dx%d", w, h);
+    }
+    for (i = 0; i < count; ++i) {
+        if (!frames[i]) {
+            return SDL_InvalidParamError("frames");
+        }
+    }
+
+    enc = (GIF_Encoder *)SDL_calloc(1, sizeof(*enc));
+    if (!enc) {
+        return false;
+    }
+    enc->options = options;
+    enc->w = w;
+    enc->h = h;
+    enc->count = count;
+    enc->frames = frames;
+    enc->delays = delays;
+    enc->writer.dst = dst;
+    enc->plans = (GIF_FramePlan *)SDL_calloc(count, sizeof(*enc->plans));
+    enc->previous = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    enc->current = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    if (!enc->plans || !enc->previous || !enc->current) {
+        goto done;
+    }
+
+    if (!PlanFrames(enc)) {
+        goto done;
+    }
+    for (i = 0; i < count; ++i) {
+        if (enc->plans[i].rect.w > 0) {
+            ++stored;
+        }
+    }
+
+    /* Store the frames exactly if their colors fit, using a spare entry to
+       leave the pixels that don't change transparent */
+    if (!enc->overflow) {
+        int needed = enc->ncolors + (enc->has_transparent ? 1 : 0);
+
+        if (needed <= options->palette_colors) {
+            enc->global = true;
+            enc->skip_unchanged = (enc->has_transparent || needed < options->palette_colors) && stored > 1;
+        }
+    }
+    if (!enc->global) {
+        enc->skip_unchanged = true;
+    }
+    if (enc->global) {
+        WriteGlobalHeader(enc);
+    } else if (stored > 1) {
+        WriteHeader(enc, NULL, 0);
+    }
+
+    SDL_FillSurfaceRect(enc->previous, NULL, 0);
+    for (i = 0; i < count; ++i) {
+        const GIF_FramePlan *plan = &enc->plans[i];
+
+        if (plan->rect.w == 0) {
+            continue;
+        }
+        if (!DrawFrame(frames[i], enc->current)) {
+            goto done;
+        }
+        if (last >= 0 && enc->plans[last].disposal == GIF_DISPOSE_RESTORE_BACKGROUND) {
+            SDL_FillSurfaceRect(enc->previous, &enc->plans[last].rect, 0);
+        }
+        if (!WriteFrame(enc, plan)) {
+            goto done;
+        }
+        last = i;
+        SwapCanvas(enc);
+    }
+    WriteByte(&enc->writer, ';');
+    FlushOutput(&enc->writer);
+    result = !enc->writer.error;
+
+done:
+    SDL_DestroySurface(enc->previous);
+    SDL_DestroySurface(enc->current);
+    SDL_free(enc->plans);
+    SDL_free(enc);
+    return result;
+}
+
+#endif /* SDL_IMAGE_SAVE_GIF */
+
+static void GIF_GetSaveOptions(SDL_PropertiesID props, struct savegif_options *options)
+{
+    SDL_zerop(options);
+    options->palette_colors = (int)SDL_GetNumberProperty(props, IMG_PROP_GIF_SAVE_PALETTE_COLORS_NUMBER, 256);
+    options->palette_colors = SDL_clamp(options->palette_colors, 2, 256);
+    options->dither = IMG_GetDitherProperty(props, IMG_PROP_GIF_SAVE_DITHER_NUMBER);
+    options->loop_count = (int)SDL_GetNumberProperty(props, IMG_PROP_GIF_SAVE_LOOP_COUNT_NUMBER, 0);
+    options->loop_count = SDL_max(options->loop_count, 0);
+    options->optimize = SDL_GetBooleanProperty(props, IMG_PROP_GIF_SAVE_OPTIMIZE_BOOLEAN, true);
+}
+
+static bool IMG_SaveGIF_IO_Internal(int w, int h, int count, SDL_Surface **frames, const int *delays, SDL_IOStream *dst, bool closeio, const struct savegif_options *options)
+{
+    bool result = false;
+    (void)w;
+    (void)h;
+    (void)count;
+    (void)frames;
+    (void)delays;
+    (void)options;
+
+    if (!dst) {
+        return SDL_SetError("Passed NULL dst");
+    }
+
+#if SDL_IMAGE_SAVE_GIF
+    result = GIF_SaveFrames(dst, w, h, count, frames, delays, options);
+#else
+    result = SDL_SetError("SDL_image built without GIF save support");
+#endif
+
+    if (closeio) {
+        SDL_CloseIO(dst);
+    }
+    return result;
+}
+
+bool IMG_SaveGIF(SDL_Surface *surface, const char *file)
+{
+    SDL_IOStream *dst = SDL_IOFromFile(file, "wb");
+    if (dst) {
+        return IMG_SaveGIF_IO(surface, dst, 1);
+    } else {
+        return false;
+    }
+}
+
+bool IMG_SaveGIF_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio)
+{
+    return IMG_SaveGIFWithProperties(surface, dst, closeio, 0);
+}
+
+bool IMG_SaveGIFWithProperties(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props)
+{
+    struct savegif_options options;
+
+    if (!surface) {
+        if (dst && closeio) {
+            SDL_CloseIO(dst);
+        }
+        return SDL_InvalidParamError("surface");
+    }
+
+    GIF_GetSaveOptions(props, &options);
+    return IMG_SaveGIF_IO_Internal(surface->w, surface->h, 1, &surface, NULL, dst, closeio, &options);
+}
+
+bool IMG_SaveGIFAnimation_IO(IMG_Animation *anim, SDL_IOStream *dst, bool closeio)
+{
+    return IMG_SaveGIFAnimationWithProperties(anim, dst, closeio, 0);
+}
+
+bool IMG_SaveGIFAnimationWithProperties(IMG_Animation *anim, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props)
+{
+    struct savegif_options options;
+
+    if (!anim || anim->count <= 0 || !anim->frames || !anim->delays) {
+        if (dst && closeio) {
+            SDL_CloseIO(dst);
+        }
+        return SDL_InvalidParamError("anim");
+    }
+
+    GIF_GetSaveOptions(props, &options);
+    return IMG_SaveGIF_IO_Internal(anim->w, anim->h, anim->count, anim->frames, anim->delays, dst, closeio, &options);
+}
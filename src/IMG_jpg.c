@@ -44,8 +44,334 @@
 #define WANT_JPEGLIB
 #endif
 
+/* Encoder settings, filled in from IMG_PROP_JPG_SAVE_* properties */
+struct savejpeg_options
+{
+    int quality;
+    bool progressive;
+    bool optimize;
+    IMG_JPGSubsampling subsampling;
+    int restart_interval;
+    IMG_JPGDCTMethod dct_method;
+    int threads;
+};
+
+#if (defined(LOAD_JPG) && defined(WANT_JPEGLIB)) || (SDL_IMAGE_SAVE_JPG && (defined(LOAD_JPG_DYNAMIC) || !defined(WANT_JPEGLIB)))
+
+/* Parallel encoding
+ *
+ * The image is cut into horizontal stripes of whole MCU rows and each stripe
+ * is encoded on its own as a baseline JPEG. Since every stripe starts with
+ * fresh DC predictors and byte-aligned entropy data, the stripes can be
+ * joined into one image by keeping the first stripe's headers, declaring a
+ * restart interval of one stripe and putting RSTn markers between the
+ * entropy-coded segments.
+ */
+#define MIN_STRIPE_MCU_ROWS 4
+
+/* Get the byte offsets of red, green and blue in pixel formats the encoders
+ * can read directly, returns the bytes per pixel or 0 if it needs converting.
+ */
+static int JPEG_GetPixelLayout(SDL_PixelFormat format, int *r, int *g, int *b)
+{
+    switch (format) {
+    case SDL_PIXELFORMAT_RGB24:
+        *r = 0; *g = 1; *b = 2;
+        return 3;
+    case SDL_PIXELFORMAT_BGR24:
+        *r = 2; *g = 1; *b = 0;
+        return 3;
+    case SDL_PIXELFORMAT_RGBA32:
+    case SDL_PIXELFORMAT_RGBX32:
+        *r = 0; *g = 1; *b = 2;
+        return 4;
+    case SDL_PIXELFORMAT_BGRA32:
+    case SDL_PIXELFORMAT_BGRX32:
+        *r = 2; *g = 1; *b = 0;
+        return 4;
+    case SDL_PIXELFORMAT_ARGB32:
+    case SDL_PIXELFORMAT_XRGB32:
+        *r = 1; *g = 2; *b = 3;
+        return 4;
+    case SDL_PIXELFORMAT_ABGR32:
+    case SDL_PIXELFORMAT_XBGR32:
+        *r = 3; *g = 2; *b = 1;
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+typedef bool (*savejpeg_stripe_func)(SDL_Surface *surface, SDL_IOStream *dst, const struct savejpeg_options *options);
+
+struct savejpeg_stripe
+{
+    SDL_Surface *surface;
+    SDL_IOStream *dst;
+    bool result;
+};
+
+struct savejpeg_stripes
+{
+    struct savejpeg_stripe *stripes;
+    int count;
+    SDL_AtomicInt next;
+    const struct savejpeg_options *options;
+    savejpeg_stripe_func encode;
+};
+
+static int SDLCALL JPEG_EncodeStripes(void *data)
+{
+    struct savejpeg_stripes *ctx = (struct savejpeg_stripes *)data;
+    int i;
+
+    while ((i = SDL_AddAtomicInt(&ctx->next, 1)) < ctx->count) {
+        struct savejpeg_stripe *stripe = &ctx->stripes[i];
+        stripe->result = ctx->encode(stripe->surface, stripe->dst, ctx->options);
+    }
+    return 0;
+}
+
+/* Returns the offset of the entropy-coded data, or 0 if the headers can't be parsed */
+static size_t JPEG_FindScanData(const Uint8 *data, size_t size, size_t *sof)
+{
+    size_t pos = 2;
+
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8 ||
+        data[size - 2] != 0xFF || data[size - 1] != 0xD9) {
+        return 0;
+    }
+    while (pos + 4 <= size && data[pos] == 0xFF) {
+        Uint8 marker = data[pos + 1];
+        size_t length = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+
+        if (marker == 0xC0 && sof) {
+            *sof = pos;
+        }
+        pos += 2 + length;
+        if (marker == 0xDA) {
+            return (pos <= size - 2) ? pos : 0;
+        }
+    }
+    return 0;
+}
+
+/* Copy entropy-coded data, renumbering any restart markers already in it */
+static bool JPEG_WriteScanData(SDL_IOStream *dst, Uint8 *data, size_t size, int *restart)
+{
+    size_t i;
+
+    for (i = 0; i + 1 < size; ++i) {
+        if (data[i] == 0xFF && data[i + 1] >= 0xD0 && data[i + 1] <= 0xD7) {
+            data[i + 1] = (Uint8)(0xD0 + (*restart & 7));
+            ++*restart;
+        }
+    }
+    return SDL_WriteIO(dst, data, size) == size;
+}
+
+static bool JPEG_JoinStripes(struct savejpeg_stripe *stripes, int count, int height, int interval, SDL_IOStream *dst)
+{
+    int i, restart = 0;
+
+    for (i = 0; i < count; ++i) {
+        size_t size = (size_t)SDL_TellIO(stripes[i].dst);
+        Uint8 *data = (Uint8 *)SDL_GetPointerProperty(SDL_GetIOProperties(stripes[i].dst), SDL_PROP_IOSTREAM_DYNAMIC_MEMORY_POINTER, NULL);
+        size_t sof = 0;
+        size_t scan = data ? JPEG_FindScanData(data, size, &sof) : 0;
+
+        if (!scan || (i == 0 && !sof)) {
+            return SDL_SetError("Unexpected JPEG stripe layout");
+        }
+
+        if (i == 0) {
+            size_t pos = 2;
+            Uint8 dri[6];
+
+            /* Patch the full image height into the frame header */
+            data[sof + 5] = (Uint8)(height >> 8);
+            data[sof + 6] = (Uint8)height;
+
+            if (SDL_WriteIO(dst, data, 2) != 2) {
+                return false;
+            }
+            while (pos < scan) {
+                size_t length = 2 + (((size_t)data[pos + 2] << 8) | data[pos + 3]);
+
+                if (data[pos + 1] == 0xDA) {
+                    dri[0] = 0xFF;
+                    dri[1] = 0xDD;
+                    dri[2] = 0;
+                    dri[3] = 4;
+                    dri[4] = (Uint8)(interval >> 8);
+                    dri[5] = (Uint8)interval;
+                    if (SDL_WriteIO(dst, dri, sizeof(dri)) != sizeof(dri)) {
+                        return false;
+                    }
+                }
+                if (data[pos + 1] != 0xDD) {
+                    if (SDL_WriteIO(dst, &data[pos], length) != length) {
+                        return false;
+                    }
+                }
+                pos += length;
+            }
+        } else {
+            Uint8 rst[2];
+
+            rst[0] = 0xFF;
+            rst[1] = (Uint8)(0xD0 + (restart & 7));
+            ++restart;
+            if (SDL_WriteIO(dst, rst, sizeof(rst)) != sizeof(rst)) {
+                return false;
+            }
+        }
+
+        /* Everything up to, but not including, the EOI marker */
+        if (!JPEG_WriteScanData(dst, &data[scan], size - 2 - scan, &restart)) {
+            return false;
+        }
+    }
+    return SDL_WriteIO(dst, "\xFF\xD9", 2) == 2;
+}
+
+/* Encode a surface in any layout the encoder accepts, splitting it into
+   stripes of whole MCU rows across threads if it's worth it. This is
+   shared by the libjpeg and tinyjpeg encoders. */
+static bool JPEG_SaveStripes(SDL_Surface *surface, SDL_IOStream *dst, const struct savejpeg_options *options,
+                             int mcu_width, int mcu_height, savejpeg_stripe_func encode)
+{
+    struct savejpeg_options stripe_options;
+    struct savejpeg_stripes ctx;
+    SDL_Thread **threads = NULL;
+    int mcus_per_row = (surface->w + mcu_width - 1) / mcu_width;
+    int mcu_rows = (surface->h + mcu_height - 1) / mcu_height;
+    int stripe_rows, interval, count, num_threads, i;
+    Sint64 start;
+    bool result = false;
+
+    num_threads = options->threads;
+    if (num_threads <= 0) {
+        num_threads = SDL_GetNumLogicalCPUCores();
+    }
+    num_threads = SDL_min(num_threads, mcu_rows / MIN_STRIPE_MCU_ROWS);
+
+    /* Custom Huffman tables and progressive scans can't be cut into stripes */
+    if (num_threads <= 1 || options->progressive || options->optimize) {
+        return encode(surface, dst, options);
+    }
+
+    stripe_rows = (mcu_rows + num_threads - 1) / num_threads;
+    if (options->restart_interval > 0) {
+        /* Every stripe has to end on one of the caller's restart boundaries */
+        while (stripe_rows < mcu_rows && (stripe_rows * mcus_per_row) % options->restart_interval != 0) {
+            ++stripe_rows;
+        }
+        interval = options->restart_interval;
+    } else {
+        stripe_rows = SDL_min(stripe_rows, 65535 / mcus_per_row);
+        interval = stripe_rows * mcus_per_row;
+    }
+    if (stripe_rows <= 0 || stripe_rows >= mcu_rows) {
+        return encode(surface, dst, options);
+    }
+    count = (mcu_rows + stripe_rows - 1) / stripe_rows;
+    num_threads = SDL_min(num_threads, count);
+
+    stripe_options = *options;
+    stripe_options.threads = 1;
+    start = SDL_TellIO(dst);
+
+    SDL_zero(ctx);
+    ctx.count = count;
+    ctx.options = &stripe_options;
+    ctx.encode = encode;
+    ctx.stripes = (struct savejpeg_stripe *)SDL_calloc(count, sizeof(*ctx.stripes));
+    threads = (SDL_Thread **)SDL_calloc(num_threads, sizeof(*threads));
+    if (!ctx.stripes || !threads) {
+        goto done;
+    }
+    for (i = 0; i < count; ++i) {
+        int y = i * stripe_rows * mcu_height;
+        int h = SDL_min(stripe_rows * mcu_height, surface->h - y);
+
+        ctx.stripes[i].surface = SDL_CreateSurfaceFrom(surface->w, h, surface->format, (Uint8 *)surface->pixels + y * surface->pitch, surface->pitch);
+        ctx.stripes[i].dst = SDL_IOFromDynamicMem();
+        if (!ctx.stripes[i].surface || !ctx.stripes[i].dst) {
+            goto done;
+        }
+    }
+
+    /* The calling thread works on stripes too */
+    for (i = 1; i < num_threads; ++i) {
+        threads[i] = SDL_CreateThread(JPEG_EncodeStripes, "SDL_image JPEG", &ctx);
+        if (!threads[i]) {
+            break;
+        }
+    }
+    JPEG_EncodeStripes(&ctx);
+    for (i = 1; i < num_threads; ++i) {
+        SDL_WaitThread(threads[i], NULL);
+    }
+
+    for (i = 0; i < count; ++i) {
+        if (!ctx.stripes[i].result) {
+            SDL_SetError("Couldn't encode JPEG stripe");
+            goto done;
+        }
+    }
+    result = JPEG_JoinStripes(ctx.stripes, count, surface->h, interval, dst);
+    if (!result) {
+        SDL_SeekIO(dst, start, SDL_IO_SEEK_SET);
+    }
+
+done:
+    if (ctx.stripes) {
+        for (i = 0; i < count; ++i) {
+            SDL_DestroySurface(ctx.stripes[i].surface);
+            if (ctx.stripes[i].dst) {
+                SDL_CloseIO(ctx.stripes[i].dst);
+            }
+        }
+        SDL_free(ctx.stripes);
+    }
+    SDL_free(threads);
+    return result;
+}
+
+#endif /* (defined(LOAD_JPG) && defined(WANT_JPEGLIB)) || (SDL_IMAGE_SAVE_JPG && (...)) */
+
 #ifdef LOAD_JPG
 
+static Uint16 EXIF_Read16(const Uint8 *data, bool big_endian)
+{
+    if (big_endian) {
+        return (Uint16)((data[0] << 8) | data[1]);
+    }
+    return (Uint16)((data[1] << 8) | data[0]);
+}
+
+static Uint32 EXIF_Read32(const Uint8 *data, bool big_endian)
+{
+    if (big_endian) {
+        return ((Uint32)data[0] << 24) | ((Uint32)data[1] << 16) | ((Uint32)data[2] << 8) | data[3];
+    }
+    return ((Uint32)data[3] << 24) | ((Uint32)data[2] << 16) | ((Uint32)data[1] << 8) | data[0];
+}
+
+/* Get the largest DCT scale denominator (8, 4, 2 or 1) that keeps the longer
+   side of the image at least min_size pixels */
+static int JPEG_GetScaleDenom(int w, int h, int min_size)
+{
+    int size = SDL_max(w, h);
+    int denom = 8;
+
+    while (denom > 1 && (size + denom - 1) / denom < min_size) {
+        denom /= 2;
+    }
+    return denom;
+}
+
 #ifdef WANT_JPEGLIB
 
 #define USE_JPEGLIB
@@ -58,7 +384,8 @@
     #define FALSE JPEG_FALSE
 #endif
 
-/* Define this for fast loading and not as good image quality */
+/* Define this to default to fast loading and not as good image quality,
+   this can be overridden at runtime with IMG_HINT_JPG_DECODE_MODE */
 /*#define FAST_JPEG*/
 
 /* Define this for quicker (but less perfect) JPEG identification */
@@ -82,6 +409,12 @@ static struct {
     JDIMENSION (*jpeg_write_scanlines) (j_compress_ptr cinfo, JSAMPARRAY scanlines, JDIMENSION num_lines);
     void (*jpeg_finish_compress) (j_compress_ptr cinfo);
     void (*jpeg_destroy_compress) (j_compress_ptr cinfo);
+    void (*jpeg_simple_progression) (j_compress_ptr cinfo);
+    jvirt_barray_ptr * (*jpeg_read_coefficients) (j_decompress_ptr cinfo);
+    void (*jpeg_write_coefficients) (j_compress_ptr cinfo, jvirt_barray_ptr *coef_arrays);
+    void (*jpeg_copy_critical_parameters) (j_decompress_ptr srcinfo, j_compress_ptr dstinfo);
+    void (*jpeg_save_markers) (j_decompress_ptr cinfo, int marker_code, unsigned int length_limit);
+    void (*jpeg_write_marker) (j_compress_ptr cinfo, int marker, const JOCTET *dataptr, unsigned int datalen);
     struct jpeg_error_mgr * (*jpeg_std_error) (struct jpeg_error_mgr * err);
 } lib;
 
@@ -118,6 +451,12 @@ static bool IMG_InitJPG(void)
         FUNCTION_LOADER(jpeg_write_scanlines, JDIMENSION (*) (j_compress_ptr cinfo, JSAMPARRAY scanlines, JDIMENSION num_lines))
         FUNCTION_LOADER(jpeg_finish_compress, void (*) (j_compress_ptr cinfo))
         FUNCTION_LOADER(jpeg_destroy_compress, void (*) (j_compress_ptr cinfo))
+        FUNCTION_LOADER(jpeg_simple_progression, void (*) (j_compress_ptr cinfo))
+        FUNCTION_LOADER(jpeg_read_coefficients, jvirt_barray_ptr * (*) (j_decompress_ptr cinfo))
+        FUNCTION_LOADER(jpeg_write_coefficients, void (*) (j_compress_ptr cinfo, jvirt_barray_ptr *coef_arrays))
+        FUNCTION_LOADER(jpeg_copy_critical_parameters, void (*) (j_decompress_ptr srcinfo, j_compress_ptr dstinfo))
+        FUNCTION_LOADER(jpeg_save_markers, void (*) (j_decompress_ptr cinfo, int marker_code, unsigned int length_limit))
+        FUNCTION_LOADER(jpeg_write_marker, void (*) (j_compress_ptr cinfo, int marker, const JOCTET *dataptr, unsigned int datalen))
         FUNCTION_LOADER(jpeg_std_error, struct jpeg_error_mgr * (*) (struct jpeg_error_mgr * err))
     }
     ++lib.loaded;
@@ -347,10 +686,37 @@ static void output_no_message(j_common_ptr cinfo)
 struct loadjpeg_vars {
     const char *error;
     SDL_Surface *surface;
+    int min_size;
     struct jpeg_decompress_struct cinfo;
     struct my_error_mgr jerr;
 };
 
+/* Apply the decode speed/quality tradeoff selected by IMG_HINT_JPG_DECODE_MODE */
+static void JPEG_SetDecodeMode(j_decompress_ptr cinfo)
+{
+    const char *mode = SDL_GetHint(IMG_HINT_JPG_DECODE_MODE);
+
+    if (!mode || !*mode) {
+#ifdef FAST_JPEG
+        mode = "fastest";
+#else
+        return;
+#endif
+    }
+
+    if (SDL_strcasecmp(mode, "fast") == 0) {
+        cinfo->dct_method = JDCT_IFAST;
+        cinfo->do_fancy_upsampling = FALSE;
+    } else if (SDL_strcasecmp(mode, "fastest") == 0) {
+        cinfo->dct_method = JDCT_FASTEST;
+        cinfo->do_fancy_upsampling = FALSE;
+        cinfo->do_block_smoothing = FALSE;
+    } else {
+        cinfo->dct_method = JDCT_ISLOW;
+        cinfo->do_fancy_upsampling = TRUE;
+    }
+}
+
 /* Load a JPEG type image from an SDL datasource */
 static bool LIBJPEG_LoadJPG_IO(SDL_IOStream *src, struct loadjpeg_vars *vars)
 {
@@ -371,6 +737,12 @@ static bool LIBJPEG_LoadJPG_IO(SDL_IOStream *src, struct loadjpeg_vars *vars)
     jpeg_SDL_IO_src(&vars->cinfo, src);
     lib.jpeg_read_header(&vars->cinfo, TRUE);
 
+    if (vars->min_size > 0) {
+        vars->cinfo.scale_num = 1;
+        vars->cinfo.scale_denom = JPEG_GetScaleDenom(vars->cinfo.image_width, vars->cinfo.image_height, vars->min_size);
+    }
+    JPEG_SetDecodeMode(&vars->cinfo);
+
     if (vars->cinfo.num_components == 4) {
         /* Set 32-bit Raw output */
         vars->cinfo.out_color_space = JCS_CMYK;
@@ -383,12 +755,6 @@ static bool LIBJPEG_LoadJPG_IO(SDL_IOStream *src, struct loadjpeg_vars *vars)
         /* Set 24-bit RGB output */
         vars->cinfo.out_color_space = JCS_RGB;
         vars->cinfo.quantize_colors = FALSE;
-#ifdef FAST_JPEG
-        vars->cinfo.scale_num   = 1;
-        vars->cinfo.scale_denom = 1;
-        vars->cinfo.dct_method = JDCT_FASTEST;
-        vars->cinfo.do_fancy_upsampling = FALSE;
-#endif
         lib.jpeg_calc_output_dimensions(&vars->cinfo);
 
         /* Allocate an output surface to hold the image */
@@ -413,7 +779,8 @@ static bool LIBJPEG_LoadJPG_IO(SDL_IOStream *src, struct loadjpeg_vars *vars)
     return true;
 }
 
-SDL_Surface *IMG_LoadJPG_IO(SDL_IOStream *src)
+/* Load a JPEG image, scaled down while decoding if min_size is positive */
+static SDL_Surface *JPEG_LoadJPG_IO(SDL_IOStream *src, int min_size)
 {
     Sint64 start;
     struct loadjpeg_vars vars;
@@ -429,6 +796,7 @@ SDL_Surface *IMG_LoadJPG_IO(SDL_IOStream *src)
 
     start = SDL_TellIO(src);
     SDL_zero(vars);
+    vars.min_size = min_size;
 
     if (LIBJPEG_LoadJPG_IO(src, &vars)) {
         return vars.surface;
@@ -446,6 +814,11 @@ SDL_Surface *IMG_LoadJPG_IO(SDL_IOStream *src)
     return NULL;
 }
 
+SDL_Surface *IMG_LoadJPG_IO(SDL_IOStream *src)
+{
+    return JPEG_LoadJPG_IO(src, 0);
+}
+
 #define OUTPUT_BUFFER_SIZE   4096
 typedef struct {
     struct jpeg_destination_mgr pub;
@@ -508,8 +881,14 @@ struct savejpeg_vars
     Sint64 original_offset;
 };
 
-static bool JPEG_SaveJPEG_IO(struct savejpeg_vars *vars, SDL_Surface *jpeg_surface, SDL_IOStream *dst, int quality)
+/* Number of rows converted at a time for formats libjpeg can't read */
+#define JPEG_ROW_BATCH  16
+
+static bool JPEG_SaveJPEG_IO(struct savejpeg_vars *vars, SDL_Surface *jpeg_surface, SDL_IOStream *dst, const struct savejpeg_options *options)
 {
+    int bpp, r, g, b;
+    Uint8 *volatile buffer = NULL;
+
     /* Create a compression structure and load the JPEG header */
     vars->cinfo.err = lib.jpeg_std_error(&vars->jerr.errmgr);
     vars->jerr.errmgr.error_exit = my_error_exit;
@@ -531,16 +910,88 @@ static bool JPEG_SaveJPEG_IO(struct savejpeg_vars *vars, SDL_Surface *jpeg_surfa
     vars->cinfo.in_color_space = JCS_RGB;
     vars->cinfo.input_components = 3;
 
+    /* Feed the surface rows directly if libjpeg can read them, otherwise
+     * convert a few rows at a time into a small RGB buffer. */
+    bpp = JPEG_GetPixelLayout(jpeg_surface->format, &r, &g, &b);
+    if (bpp == 3 && r == 0) {
+        /* Already RGB */
+#ifdef JCS_EXTENSIONS
+    } else if (bpp == 3) {
+        vars->cinfo.in_color_space = JCS_EXT_BGR;
+    } else if (bpp == 4) {
+        vars->cinfo.input_components = 4;
+        if (r == 0) {
+            vars->cinfo.in_color_space = JCS_EXT_RGBX;
+        } else if (b == 0) {
+            vars->cinfo.in_color_space = JCS_EXT_BGRX;
+        } else if (r == 1) {
+            vars->cinfo.in_color_space = JCS_EXT_XRGB;
+        } else {
+            vars->cinfo.in_color_space = JCS_EXT_XBGR;
+        }
+#endif
+    } else {
+        buffer = (Uint8 *)(*vars->cinfo.mem->alloc_large)((j_common_ptr)&vars->cinfo, JPOOL_IMAGE, (size_t)jpeg_surface->w * 3 * JPEG_ROW_BATCH);
+    }
+
     lib.jpeg_set_defaults(&vars->cinfo);
-    lib.jpeg_set_quality(&vars->cinfo, quality, TRUE);
+    lib.jpeg_set_quality(&vars->cinfo, options->quality, TRUE);
+
+    /* jpeg_set_defaults() leaves us with 4:2:0, only the luma factors change */
+    switch (options->subsampling) {
+    case IMG_JPG_SUBSAMPLING_444:
+        vars->cinfo.comp_info[0].h_samp_factor = 1;
+        vars->cinfo.comp_info[0].v_samp_factor = 1;
+        break;
+    case IMG_JPG_SUBSAMPLING_422:
+        vars->cinfo.comp_info[0].h_samp_factor = 2;
+        vars->cinfo.comp_info[0].v_samp_factor = 1;
+        break;
+    default:
+        vars->cinfo.comp_info[0].h_samp_factor = 2;
+        vars->cinfo.comp_info[0].v_samp_factor = 2;
+        break;
+    }
+    switch (options->dct_method) {
+    case IMG_JPG_DCT_IFAST:
+        vars->cinfo.dct_method = JDCT_IFAST;
+        break;
+    case IMG_JPG_DCT_FLOAT:
+        vars->cinfo.dct_method = JDCT_FLOAT;
+        break;
+    default:
+        vars->cinfo.dct_method = JDCT_ISLOW;
+        break;
+    }
+    vars->cinfo.optimize_coding = options->optimize ? TRUE : FALSE;
+    vars->cinfo.restart_interval = (unsigned int)options->restart_interval;
+    if (options->progressive) {
+        lib.jpeg_simple_progression(&vars->cinfo);
+    }
+
     lib.jpeg_start_compress(&vars->cinfo, TRUE);
 
     while (vars->cinfo.next_scanline < vars->cinfo.image_height) {
-        JSAMPROW row_pointer[1];
+        JSAMPROW row_pointer[JPEG_ROW_BATCH];
         int offset = vars->cinfo.next_scanline * jpeg_surface->pitch;
 
-        row_pointer[0] = ((Uint8*)jpeg_surface->pixels) + offset;
-        lib.jpeg_write_scanlines(&vars->cinfo, row_pointer, 1);
+        if (buffer) {
+            int i, count = (int)SDL_min(vars->cinfo.image_height - vars->cinfo.next_scanline, JPEG_ROW_BATCH);
+
+            if (!SDL_ConvertPixels(jpeg_surface->w, count, jpeg_surface->format, (Uint8 *)jpeg_surface->pixels + offset, jpeg_surface->pitch,
+                                   SDL_PIXELFORMAT_RGB24, buffer, jpeg_surface->w * 3)) {
+                lib.jpeg_destroy_compress(&vars->cinfo);
+                SDL_SeekIO(dst, vars->original_offset, SDL_IO_SEEK_SET);
+                return false;
+            }
+            for (i = 0; i < count; ++i) {
+                row_pointer[i] = buffer + i * jpeg_surface->w * 3;
+            }
+            lib.jpeg_write_scanlines(&vars->cinfo, row_pointer, count);
+        } else {
+            row_pointer[0] = ((Uint8*)jpeg_surface->pixels) + offset;
+            lib.jpeg_write_scanlines(&vars->cinfo, row_pointer, 1);
+        }
     }
 
     lib.jpeg_finish_compress(&vars->cinfo);
@@ -548,36 +999,368 @@ static bool JPEG_SaveJPEG_IO(struct savejpeg_vars *vars, SDL_Surface *jpeg_surfa
     return true;
 }
 
-static bool IMG_SaveJPG_IO_jpeglib(SDL_Surface *surface, SDL_IOStream *dst, int quality)
+static bool JPEG_SaveJPEG_Stripe(SDL_Surface *jpeg_surface, SDL_IOStream *dst, const struct savejpeg_options *options)
+{
+    struct savejpeg_vars vars;
+
+    SDL_zero(vars);
+    return JPEG_SaveJPEG_IO(&vars, jpeg_surface, dst, options);
+}
+
+static bool IMG_SaveJPG_IO_jpeglib(SDL_Surface *surface, SDL_IOStream *dst, const struct savejpeg_options *options)
 {
     /* The JPEG library reads bytes in R,G,B order, so this is the right
      * encoding for either endianness */
-    struct savejpeg_vars vars;
     static const Uint32 jpg_format = SDL_PIXELFORMAT_RGB24;
     SDL_Surface* jpeg_surface = surface;
+    int mcu_width, mcu_height;
     bool result;
 
     if (!IMG_InitJPG()) {
         return false;
     }
 
-    /* Convert surface to format we can save */
-    if (surface->format != jpg_format) {
+    /* Most formats are converted row by row while encoding, only palettes,
+     * YUV and high dynamic range surfaces need a full RGB copy up front. */
+    if (SDL_ISPIXELFORMAT_INDEXED(surface->format) || SDL_ISPIXELFORMAT_FOURCC(surface->format) ||
+        SDL_ISPIXELFORMAT_10BIT(surface->format) || SDL_ISPIXELFORMAT_FLOAT(surface->format)) {
         jpeg_surface = SDL_ConvertSurface(surface, jpg_format);
         if (!jpeg_surface) {
             return false;
         }
+    } else if (SDL_MUSTLOCK(surface) && !SDL_LockSurface(surface)) {
+        /* The rows are read straight from the surface */
+        return false;
     }
 
-    SDL_zero(vars);
-    result = JPEG_SaveJPEG_IO(&vars, jpeg_surface, dst, quality);
+    /* The MCU size follows from the luma sampling factors */
+    switch (options->subsampling) {
+    case IMG_JPG_SUBSAMPLING_444:
+        mcu_width = 8;
+        mcu_height = 8;
+        break;
+    case IMG_JPG_SUBSAMPLING_422:
+        mcu_width = 16;
+        mcu_height = 8;
+        break;
+    default:
+        mcu_width = 16;
+        mcu_height = 16;
+        break;
+    }
+    result = JPEG_SaveStripes(jpeg_surface, dst, options, mcu_width, mcu_height, JPEG_SaveJPEG_Stripe);
 
     if (jpeg_surface != surface) {
         SDL_DestroySurface(jpeg_surface);
+    } else if (SDL_MUSTLOCK(surface)) {
+        SDL_UnlockSurface(surface);
     }
     return result;
 }
 
+/* Lossless transformations, working on the DCT coefficients like jpegtran */
+
+/* Find the orientation tag in the body of an APP1 Exif marker, returns a pointer to its value */
+static Uint8 *EXIF_FindOrientation(Uint8 *data, Uint32 length, bool *big_endian)
+{
+    Uint8 *tiff;
+    Uint32 size, ifd;
+    Uint16 count, i;
+
+    if (length < 6 + 8 || SDL_memcmp(data, "Exif\0\0", 6) != 0) {
+        return NULL;
+    }
+    tiff = data + 6;
+    size = length - 6;
+    if (tiff[0] == 'M' && tiff[1] == 'M') {
+        *big_endian = true;
+    } else if (tiff[0] == 'I' && tiff[1] == 'I') {
+        *big_endian = false;
+    } else {
+        return NULL;
+    }
+
+    ifd = EXIF_Read32(tiff + 4, *big_endian);
+    if (ifd > size - 2) {
+        return NULL;
+    }
+    count = EXIF_Read16(tiff + ifd, *big_endian);
+    for (i = 0; i < count; ++i) {
+        Uint8 *entry = tiff + ifd + 2 + i * 12;
+
+        if (entry + 12 > tiff + size) {
+            break;
+        }
+        if (EXIF_Read16(entry, *big_endian) == 0x0112 &&
+            EXIF_Read16(entry + 2, *big_endian) == 3 /* SHORT */) {
+            return entry + 8;
+        }
+    }
+    return NULL;
+}
+
+struct transformjpeg_vars
+{
+    struct jpeg_decompress_struct srcinfo;
+    struct jpeg_compress_struct dstinfo;
+    struct my_error_mgr jerr;
+    Sint64 src_offset;
+    Sint64 dst_offset;
+    const char *error;
+    Uint8 *orientation;     /* The Exif orientation value, reset to 1 in the output */
+    bool big_endian;
+};
+
+static void JPEG_TransformBlock(const JCOEF *src, JCOEF *dst, bool transpose, bool flip_x, bool flip_y)
+{
+    int u, v;
+
+    for (v = 0; v < DCTSIZE; ++v) {
+        for (u = 0; u < DCTSIZE; ++u) {
+            JCOEF coef = transpose ? src[u * DCTSIZE + v] : src[v * DCTSIZE + u];
+
+            /* Mirroring a block negates its odd frequencies along that axis */
+            if ((flip_x && (u & 1)) != (flip_y && (v & 1))) {
+                coef = (JCOEF)-coef;
+            }
+            dst[v * DCTSIZE + u] = coef;
+        }
+    }
+}
+
+static bool JPEG_TransformJPG_IO(struct transformjpeg_vars *vars, SDL_IOStream *src, SDL_IOStream *dst, IMG_JPGTransform transform, const SDL_Rect *crop)
+{
+    jvirt_barray_ptr *src_coefs;
+    jvirt_barray_ptr *dst_coefs;
+    jpeg_saved_marker_ptr marker;
+    IMG_JPGTransform applied = transform;
+    bool transpose, flip_x, flip_y;
+    int imcu_w, imcu_h, x0, y0, w, h, ci, m;
+
+    vars->srcinfo.err = lib.jpeg_std_error(&vars->jerr.errmgr);
+    vars->dstinfo.err = &vars->jerr.errmgr;
+    vars->jerr.errmgr.error_exit = my_error_exit;
+    vars->jerr.errmgr.output_message = output_no_message;
+    vars->src_offset = SDL_TellIO(src);
+    vars->dst_offset = SDL_TellIO(dst);
+
+    if (setjmp(vars->jerr.escape)) {
+        /* If we get here, libjpeg found an error */
+        lib.jpeg_destroy_compress(&vars->dstinfo);
+        lib.jpeg_destroy_decompress(&vars->srcinfo);
+        SDL_SeekIO(src, vars->src_offset, SDL_IO_SEEK_SET);
+        SDL_SeekIO(dst, vars->dst_offset, SDL_IO_SEEK_SET);
+        if (vars->error) {
+            return SDL_SetError("%s", vars->error);
+        }
+        return SDL_SetError("Error transforming JPEG with libjpeg");
+    }
+
+    lib.jpeg_create_decompress(&vars->srcinfo);
+    lib.jpeg_create_compress(&vars->dstinfo);
+    jpeg_SDL_IO_src(&vars->srcinfo, src);
+    lib.jpeg_save_markers(&vars->srcinfo, JPEG_COM, 0xFFFF);
+    for (m = 0; m < 16; ++m) {
+        lib.jpeg_save_markers(&vars->srcinfo, JPEG_APP0 + m, 0xFFFF);
+    }
+    lib.jpeg_read_header(&vars->srcinfo, TRUE);
+
+    if (transform == IMG_JPG_TRANSFORM_EXIF) {
+        static const IMG_JPGTransform orientations[] = {
+            IMG_JPG_TRANSFORM_NONE,
+            IMG_JPG_TRANSFORM_NONE,
+            IMG_JPG_TRANSFORM_FLIP_H,
+            IMG_JPG_TRANSFORM_ROTATE_180,
+            IMG_JPG_TRANSFORM_FLIP_V,
+            IMG_JPG_TRANSFORM_TRANSPOSE,
+            IMG_JPG_TRANSFORM_ROTATE_90,
+            IMG_JPG_TRANSFORM_TRANSVERSE,
+            IMG_JPG_TRANSFORM_ROTATE_270
+        };
+        Uint16 value = 1;
+
+        for (marker = vars->srcinfo.marker_list; marker && !vars->orientation; marker = marker->next) {
+            if (marker->marker == JPEG_APP0 + 1) {
+                vars->orientation = EXIF_FindOrientation(marker->data, marker->data_length, &vars->big_endian);
+            }
+        }
+        if (vars->orientation) {
+            value = EXIF_Read16(vars->orientation, vars->big_endian);
+        }
+        applied = (value < SDL_arraysize(orientations)) ? orientations[value] : IMG_JPG_TRANSFORM_NONE;
+    }
+
+    switch (applied) {
+    case IMG_JPG_TRANSFORM_FLIP_H:
+        transpose = false; flip_x = true; flip_y = false;
+        break;
+    case IMG_JPG_TRANSFORM_FLIP_V:
+        transpose = false; flip_x = false; flip_y = true;
+        break;
+    case IMG_JPG_TRANSFORM_TRANSPOSE:
+        transpose = true; flip_x = false; flip_y = false;
+        break;
+    case IMG_JPG_TRANSFORM_TRANSVERSE:
+        transpose = true; flip_x = true; flip_y = true;
+        break;
+    case IMG_JPG_TRANSFORM_ROTATE_90:
+        transpose = true; flip_x = true; flip_y = false;
+        break;
+    case IMG_JPG_TRANSFORM_ROTATE_180:
+        transpose = false; flip_x = true; flip_y = true;
+        break;
+    case IMG_JPG_TRANSFORM_ROTATE_270:
+        transpose = true; flip_x = false; flip_y = true;
+        break;
+    default:
+        transpose = false; flip_x = false; flip_y = false;
+        break;
+    }
+
+    /* Work out the source area in whole iMCUs */
+    imcu_w = vars->srcinfo.max_h_samp_factor * DCTSIZE;
+    imcu_h = vars->srcinfo.max_v_samp_factor * DCTSIZE;
+    x0 = 0;
+    y0 = 0;
+    w = (int)vars->srcinfo.image_width;
+    h = (int)vars->srcinfo.image_height;
+    if (crop) {
+        SDL_Rect image = { 0, 0, w, h };
+        SDL_Rect area;
+
+        if (!SDL_GetRectIntersection(crop, &image, &area)) {
+            vars->error = "Crop area is outside the image";
+            longjmp(vars->jerr.escape, 1);
+        }
+        x0 = (area.x / imcu_w) * imcu_w;
+        y0 = (area.y / imcu_h) * imcu_h;
+        w = area.x + area.w - x0;
+        h = area.y + area.h - y0;
+    }
+    /* Partial iMCUs can't be mirrored, they'd end up inside the image */
+    if (transpose ? flip_y : flip_x) {
+        w = (w / imcu_w) * imcu_w;
+    }
+    if (transpose ? flip_x : flip_y) {
+        h = (h / imcu_h) * imcu_h;
+    }
+    if (w <= 0 || h <= 0) {
+        vars->error = "Image is too small to transform";
+        longjmp(vars->jerr.escape, 1);
+    }
+
+    /* Request the output coefficient arrays, they're allocated along with the input */
+    dst_coefs = (jvirt_barray_ptr *)(*vars->srcinfo.mem->alloc_small)((j_common_ptr)&vars->srcinfo, JPOOL_IMAGE, sizeof(jvirt_barray_ptr) * vars->srcinfo.num_components);
+    for (ci = 0; ci < vars->srcinfo.num_components; ++ci) {
+        jpeg_component_info *comp = &vars->srcinfo.comp_info[ci];
+        JDIMENSION bw = (JDIMENSION)((w + imcu_w - 1) / imcu_w * comp->h_samp_factor);
+        JDIMENSION bh = (JDIMENSION)((h + imcu_h - 1) / imcu_h * comp->v_samp_factor);
+
+        dst_coefs[ci] = (*vars->srcinfo.mem->request_virt_barray)((j_common_ptr)&vars->srcinfo, JPOOL_IMAGE, FALSE,
+                                                                  transpose ? bh : bw, transpose ? bw : bh,
+                                                                  (JDIMENSION)(transpose ? comp->h_samp_factor : comp->v_samp_factor));
+    }
+
+    src_coefs = lib.jpeg_read_coefficients(&vars->srcinfo);
+
+    lib.jpeg_copy_critical_parameters(&vars->srcinfo, &vars->dstinfo);
+    vars->dstinfo.image_width = (JDIMENSION)(transpose ? h : w);
+    vars->dstinfo.image_height = (JDIMENSION)(transpose ? w : h);
+#if JPEG_LIB_VERSION >= 70
+    vars->dstinfo.jpeg_width = vars->dstinfo.image_width;
+    vars->dstinfo.jpeg_height = vars->dstinfo.image_height;
+#endif
+    if (transpose) {
+        int i, j, t;
+
+        for (ci = 0; ci < vars->dstinfo.num_components; ++ci) {
+            jpeg_component_info *comp = &vars->dstinfo.comp_info[ci];
+
+            t = comp->h_samp_factor;
+            comp->h_samp_factor = comp->v_samp_factor;
+            comp->v_samp_factor = t;
+        }
+        for (t = 0; t < NUM_QUANT_TBLS; ++t) {
+            JQUANT_TBL *qtbl = vars->dstinfo.quant_tbl_ptrs[t];
+
+            if (!qtbl) {
+                continue;
+            }
+            for (i = 0; i < DCTSIZE; ++i) {
+                for (j = i + 1; j < DCTSIZE; ++j) {
+                    UINT16 q = qtbl->quantval[i * DCTSIZE + j];
+                    qtbl->quantval[i * DCTSIZE + j] = qtbl->quantval[j * DCTSIZE + i];
+                    qtbl->quantval[j * DCTSIZE + i] = q;
+                }
+            }
+        }
+    }
+    if (vars->srcinfo.progressive_mode) {
+        lib.jpeg_simple_progression(&vars->dstinfo);
+    } else {
+        vars->dstinfo.optimize_coding = TRUE;
+    }
+
+    /* Move the blocks over */
+    for (ci = 0; ci < vars->srcinfo.num_components; ++ci) {
+        jpeg_component_info *comp = &vars->srcinfo.comp_info[ci];
+        JDIMENSION bx0 = (JDIMENSION)(x0 / imcu_w * comp->h_samp_factor);
+        JDIMENSION by0 = (JDIMENSION)(y0 / imcu_h * comp->v_samp_factor);
+        JDIMENSION bw = (JDIMENSION)((w + imcu_w - 1) / imcu_w * comp->h_samp_factor);
+        JDIMENSION bh = (JDIMENSION)((h + imcu_h - 1) / imcu_h * comp->v_samp_factor);
+        JDIMENSION ow = transpose ? bh : bw;
+        JDIMENSION oh = transpose ? bw : bh;
+        JDIMENSION ox, oy;
+
+        for (oy = 0; oy < oh; ++oy) {
+            JBLOCKROW dst_row = (*vars->srcinfo.mem->access_virt_barray)((j_common_ptr)&vars->srcinfo, dst_coefs[ci], oy, 1, TRUE)[0];
+            JDIMENSION ty = flip_y ? oh - 1 - oy : oy;
+            JBLOCKROW src_row = NULL;
+
+            if (!transpose) {
+                src_row = (*vars->srcinfo.mem->access_virt_barray)((j_common_ptr)&vars->srcinfo, src_coefs[ci], by0 + ty, 1, FALSE)[0];
+            }
+            for (ox = 0; ox < ow; ++ox) {
+                JDIMENSION tx = flip_x ? ow - 1 - ox : ox;
+
+                if (transpose) {
+                    src_row = (*vars->srcinfo.mem->access_virt_barray)((j_common_ptr)&vars->srcinfo, src_coefs[ci], by0 + tx, 1, FALSE)[0];
+                    JPEG_TransformBlock(src_row[bx0 + ty], dst_row[ox], transpose, flip_x, flip_y);
+                } else {
+                    JPEG_TransformBlock(src_row[bx0 + tx], dst_row[ox], transpose, flip_x, flip_y);
+                }
+            }
+        }
+    }
+
+    jpeg_SDL_IO_dest(&vars->dstinfo, dst);
+    lib.jpeg_write_coefficients(&vars->dstinfo, dst_coefs);
+
+    /* Copy the markers, except the ones libjpeg writes itself */
+    for (marker = vars->srcinfo.marker_list; marker; marker = marker->next) {
+        if (vars->dstinfo.write_JFIF_header && marker->marker == JPEG_APP0 &&
+            marker->data_length >= 5 && SDL_memcmp(marker->data, "JFIF", 5) == 0) {
+            continue;
+        }
+        if (vars->dstinfo.write_Adobe_marker && marker->marker == JPEG_APP0 + 14 &&
+            marker->data_length >= 5 && SDL_memcmp(marker->data, "Adobe", 5) == 0) {
+            continue;
+        }
+        if (vars->orientation && vars->orientation >= marker->data && vars->orientation < marker->data + marker->data_length) {
+            /* The image is upright now */
+            vars->orientation[vars->big_endian ? 0 : 1] = 0;
+            vars->orientation[vars->big_endian ? 1 : 0] = 1;
+        }
+        lib.jpeg_write_marker(&vars->dstinfo, marker->marker, marker->data, marker->data_length);
+    }
+
+    lib.jpeg_finish_compress(&vars->dstinfo);
+    lib.jpeg_destroy_compress(&vars->dstinfo);
+    lib.jpeg_finish_decompress(&vars->srcinfo);
+    lib.jpeg_destroy_decompress(&vars->srcinfo);
+    return true;
+}
+
 #elif defined(USE_STBIMAGE)
 
 extern SDL_Surface *IMG_LoadSTB_IO(SDL_IOStream *src);
@@ -709,21 +1492,13 @@ static void IMG_SaveJPG_IO_tinyjpeg_callback(void* context, void* data, int size
     SDL_WriteIO((SDL_IOStream*) context, data, size);
 }
 
-static bool IMG_SaveJPG_IO_tinyjpeg(SDL_Surface *surface, SDL_IOStream *dst, int quality)
+static bool TJE_SaveJPEG_IO(SDL_Surface *jpeg_surface, SDL_IOStream *dst, const struct savejpeg_options *options)
 {
-    /* The JPEG library reads bytes in R,G,B order, so this is the right
-     * encoding for either endianness */
-    static const Uint32 jpg_format = SDL_PIXELFORMAT_RGB24;
-    SDL_Surface* jpeg_surface = surface;
-    bool result = false;
+    int quality = options->quality;
+    int bpp, r, g, b;
+    bool result;
 
-    /* Convert surface to format we can save */
-    if (surface->format != jpg_format) {
-        jpeg_surface = SDL_ConvertSurface(surface, jpg_format);
-        if (!jpeg_surface) {
-            return false;
-        }
-    }
+    bpp = JPEG_GetPixelLayout(jpeg_surface->format, &r, &g, &b);
 
     /* Quality for tinyjpeg is from 1-3:
      * 0  - 33  - Lowest quality
@@ -734,44 +1509,99 @@ static bool IMG_SaveJPG_IO_tinyjpeg(SDL_Surface *surface, SDL_IOStream *dst, int
     else if (quality < 67) quality = 2;
     else                   quality = 3;
 
-    result = tje_encode_with_func(
+    result = tje_encode_with_func_offsets(
         IMG_SaveJPG_IO_tinyjpeg_callback,
         dst,
         quality,
         jpeg_surface->w,
         jpeg_surface->h,
-        3,
+        bpp,
+        r,
+        g,
+        b,
         jpeg_surface->pixels,
         jpeg_surface->pitch
     );
 
-    if (jpeg_surface != surface) {
-        SDL_DestroySurface(jpeg_surface);
-    }
-
     if (!result) {
         SDL_SetError("tinyjpeg error");
     }
     return result;
 }
 
+static bool IMG_SaveJPG_IO_tinyjpeg(SDL_Surface *surface, SDL_IOStream *dst, const struct savejpeg_options *options)
+{
+    /* The JPEG library reads bytes in R,G,B order, so this is the right
+     * encoding for either endianness */
+    static const Uint32 jpg_format = SDL_PIXELFORMAT_RGB24;
+    struct savejpeg_options tje_options;
+    SDL_Surface* jpeg_surface = surface;
+    int r, g, b;
+    bool result = false;
+
+    /* Convert surface to format we can save */
+    if (!JPEG_GetPixelLayout(surface->format, &r, &g, &b)) {
+        jpeg_surface = SDL_ConvertSurface(surface, jpg_format);
+        if (!jpeg_surface) {
+            return false;
+        }
+    } else if (SDL_MUSTLOCK(surface) && !SDL_LockSurface(surface)) {
+        /* The rows are read straight from the surface */
+        return false;
+    }
+
+    /* tinyjpeg only writes baseline 4:4:4 with the standard Huffman tables */
+    tje_options = *options;
+    tje_options.progressive = false;
+    tje_options.optimize = false;
+    tje_options.restart_interval = 0;
+    result = JPEG_SaveStripes(jpeg_surface, dst, &tje_options, 8, 8, TJE_SaveJPEG_IO);
+
+    if (jpeg_surface != surface) {
+        SDL_DestroySurface(jpeg_surface);
+    } else if (SDL_MUSTLOCK(surface)) {
+        SDL_UnlockSurface(surface);
+    }
+    return result;
+}
+
 #endif /* SDL_IMAGE_SAVE_JPG && (defined(LOAD_JPG_DYNAMIC) || !defined(WANT_JPEGLIB)) */
 
-bool IMG_SaveJPG(SDL_Surface *surface, const char *file, int quality)
+static void JPEG_GetSaveOptions(SDL_PropertiesID props, int quality, struct savejpeg_options *options)
 {
-    SDL_IOStream *dst = SDL_IOFromFile(file, "wb");
-    if (dst) {
-        return IMG_SaveJPG_IO(surface, dst, 1, quality);
-    } else {
-        return false;
+    IMG_JPGPreset preset = (IMG_JPGPreset)SDL_GetNumberProperty(props, IMG_PROP_JPG_SAVE_PRESET_NUMBER, IMG_JPG_PRESET_DEFAULT);
+
+    SDL_zerop(options);
+    options->subsampling = IMG_JPG_SUBSAMPLING_420;
+    options->dct_method = IMG_JPG_DCT_ISLOW;
+    switch (preset) {
+    case IMG_JPG_PRESET_FAST:
+        options->dct_method = IMG_JPG_DCT_IFAST;
+        break;
+    case IMG_JPG_PRESET_SMALL:
+        options->progressive = true;
+        options->optimize = true;
+        break;
+    default:
+        break;
     }
+
+    options->quality = (int)SDL_GetNumberProperty(props, IMG_PROP_JPG_SAVE_QUALITY_NUMBER, quality);
+    options->quality = SDL_clamp(options->quality, 0, 100);
+    options->progressive = SDL_GetBooleanProperty(props, IMG_PROP_JPG_SAVE_PROGRESSIVE_BOOLEAN, options->progressive);
+    options->optimize = SDL_GetBooleanProperty(props, IMG_PROP_JPG_SAVE_OPTIMIZE_BOOLEAN, options->optimize);
+    options->subsampling = (IMG_JPGSubsampling)SDL_GetNumberProperty(props, IMG_PROP_JPG_SAVE_SUBSAMPLING_NUMBER, options->subsampling);
+    options->restart_interval = (int)SDL_GetNumberProperty(props, IMG_PROP_JPG_SAVE_RESTART_INTERVAL_NUMBER, 0);
+    options->restart_interval = SDL_clamp(options->restart_interval, 0, 65535);
+    options->dct_method = (IMG_JPGDCTMethod)SDL_GetNumberProperty(props, IMG_PROP_JPG_SAVE_DCT_METHOD_NUMBER, options->dct_method);
+    options->threads = (int)SDL_GetNumberProperty(props, IMG_PROP_JPG_SAVE_THREADS_NUMBER, 1);
 }
 
-bool IMG_SaveJPG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, int quality)
+static bool IMG_SaveJPG_IO_Internal(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, const struct savejpeg_options *options)
 {
     bool result = false;
     (void)surface;
-    (void)quality;
+    (void)options;
 
     if (!dst) {
         return SDL_SetError("Passed NULL dst");
@@ -780,13 +1610,13 @@ bool IMG_SaveJPG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, int q
 #if SDL_IMAGE_SAVE_JPG
 #ifdef USE_JPEGLIB
     if (!result) {
-        result = IMG_SaveJPG_IO_jpeglib(surface, dst, quality);
+        result = IMG_SaveJPG_IO_jpeglib(surface, dst, options);
     }
 #endif
 
 #if defined(LOAD_JPG_DYNAMIC) || !defined(WANT_JPEGLIB)
     if (!result) {
-        result = IMG_SaveJPG_IO_tinyjpeg(surface, dst, quality);
+        result = IMG_SaveJPG_IO_tinyjpeg(surface, dst, options);
     }
 #endif
 
@@ -799,3 +1629,250 @@ bool IMG_SaveJPG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, int q
     }
     return result;
 }
+
+bool IMG_SaveJPG(SDL_Surface *surface, const char *file, int quality)
+{
+    SDL_IOStream *dst = SDL_IOFromFile(file, "wb");
+    if (dst) {
+        return IMG_SaveJPG_IO(surface, dst, 1, quality);
+    } else {
+        return false;
+    }
+}
+
+bool IMG_SaveJPG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, int quality)
+{
+    struct savejpeg_options options;
+
+    JPEG_GetSaveOptions(0, quality, &options);
+    return IMG_SaveJPG_IO_Internal(surface, dst, closeio, &options);
+}
+
+bool IMG_SaveJPGWithProperties(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props)
+{
+    struct savejpeg_options options;
+
+    JPEG_GetSaveOptions(props, 90, &options);
+    return IMG_SaveJPG_IO_Internal(surface, dst, closeio, &options);
+}
+
+bool IMG_TransformJPG_IO(SDL_IOStream *src, SDL_IOStream *dst, bool closeio, IMG_JPGTransform transform, const SDL_Rect *crop)
+{
+    bool result = false;
+    (void)transform;
+    (void)crop;
+
+    if (!src) {
+        result = SDL_SetError("Passed NULL src");
+    } else if (!dst) {
+        result = SDL_SetError("Passed NULL dst");
+    } else {
+#ifdef USE_JPEGLIB
+        if (IMG_InitJPG()) {
+            struct transformjpeg_vars vars;
+
+            SDL_zero(vars);
+            result = JPEG_TransformJPG_IO(&vars, src, dst, transform, crop);
+        }
+#else
+        result = SDL_SetError("SDL_image built without libjpeg, lossless JPEG transforms are not supported");
+#endif
+    }
+
+    if (closeio) {
+        if (src) {
+            SDL_CloseIO(src);
+        }
+        if (dst) {
+            SDL_CloseIO(dst);
+        }
+    }
+    return result;
+}
+
+#ifdef LOAD_JPG
+
+#ifndef USE_JPEGLIB
+/* Decode the full image and scale it down to the size DCT scaling would give */
+static SDL_Surface *JPEG_LoadJPG_IO(SDL_IOStream *src, int min_size)
+{
+    SDL_Surface *surface;
+    SDL_Surface *scaled;
+    int denom;
+
+    surface = IMG_LoadJPG_IO(src);
+    if (!surface || min_size <= 0) {
+        return surface;
+    }
+
+    denom = JPEG_GetScaleDenom(surface->w, surface->h, min_size);
+    if (denom == 1) {
+        return surface;
+    }
+    scaled = SDL_ScaleSurface(surface, (surface->w + denom - 1) / denom, (surface->h + denom - 1) / denom, SDL_SCALEMODE_LINEAR);
+    SDL_DestroySurface(surface);
+    return scaled;
+}
+#endif /* !USE_JPEGLIB */
+
+/* Find the JPEG thumbnail in IFD1 of the body of an APP1 Exif marker */
+static bool EXIF_FindThumbnail(const Uint8 *data, Uint32 length, Uint32 *offset, Uint32 *size)
+{
+    const Uint8 *tiff;
+    Uint32 tiff_size, ifd, thumb_offset = 0, thumb_size = 0;
+    Uint16 count, i;
+    bool big_endian;
+
+    if (length < 6 + 8 || SDL_memcmp(data, "Exif\0\0", 6) != 0) {
+        return false;
+    }
+    tiff = data + 6;
+    tiff_size = length - 6;
+    if (tiff[0] == 'M' && tiff[1] == 'M') {
+        big_endian = true;
+    } else if (tiff[0] == 'I' && tiff[1] == 'I') {
+        big_endian = false;
+    } else {
+        return false;
+    }
+
+    /* Skip IFD0 to get to IFD1, which describes the thumbnail */
+    ifd = EXIF_Read32(tiff + 4, big_endian);
+    if (ifd > tiff_size - 2) {
+        return false;
+    }
+    count = EXIF_Read16(tiff + ifd, big_endian);
+    if (ifd + 2 + count * 12 > tiff_size - 4) {
+        return false;
+    }
+    ifd = EXIF_Read32(tiff + ifd + 2 + count * 12, big_endian);
+    if (ifd == 0 || ifd > tiff_size - 2) {
+        return false;
+    }
+
+    count = EXIF_Read16(tiff + ifd, big_endian);
+    for (i = 0; i < count; ++i) {
+        const Uint8 *entry = tiff + ifd + 2 + i * 12;
+        Uint16 tag, type;
+        Uint32 value;
+
+        if (entry + 12 > tiff + tiff_size) {
+            break;
+        }
+        tag = EXIF_Read16(entry, big_endian);
+        type = EXIF_Read16(entry + 2, big_endian);
+        if (type == 4 /* LONG */) {
+            value = EXIF_Read32(entry + 8, big_endian);
+        } else if (type == 3 /* SHORT */) {
+            value = EXIF_Read16(entry + 8, big_endian);
+        } else {
+            continue;
+        }
+        if (tag == 0x0201) {
+            thumb_offset = value;
+        } else if (tag == 0x0202) {
+            thumb_size = value;
+        }
+    }
+
+    if (thumb_offset == 0 || thumb_size == 0 ||
+        thumb_offset > tiff_size || thumb_size > tiff_size - thumb_offset) {
+        return false;
+    }
+    *offset = 6 + thumb_offset;
+    *size = thumb_size;
+    return true;
+}
+
+/* Look through the markers in front of the image data for an EXIF thumbnail */
+static SDL_Surface *JPEG_LoadExifThumbnail(SDL_IOStream *src)
+{
+    SDL_Surface *thumbnail = NULL;
+    Uint8 magic[4];
+
+    if (SDL_ReadIO(src, magic, 2) != 2 || magic[0] != 0xFF || magic[1] != 0xD8) {
+        return NULL;
+    }
+
+    for (;;) {
+        Uint16 length;
+
+        if (SDL_ReadIO(src, magic, 4) != 4 || magic[0] != 0xFF) {
+            break;
+        }
+        while (magic[1] == 0xFF) {
+            /* Fill bytes before the marker */
+            magic[1] = magic[2];
+            magic[2] = magic[3];
+            if (SDL_ReadIO(src, &magic[3], 1) != 1) {
+                return NULL;
+            }
+        }
+
+        /* EXIF data comes right after SOI, optionally after other APPn markers */
+        if ((magic[1] < 0xE0 || magic[1] > 0xEF) && magic[1] != 0xFE) {
+            break;
+        }
+        length = (Uint16)((magic[2] << 8) | magic[3]);
+        if (length < 2) {
+            break;
+        }
+        length -= 2;
+
+        if (magic[1] == 0xE1 && length >= 6 + 8) {
+            Uint8 *data = (Uint8 *)SDL_malloc(length);
+            Uint32 offset, size;
+
+            if (!data) {
+                break;
+            }
+            if (SDL_ReadIO(src, data, length) == length &&
+                EXIF_FindThumbnail(data, length, &offset, &size)) {
+                SDL_IOStream *io = SDL_IOFromConstMem(data + offset, size);
+                if (io) {
+                    thumbnail = IMG_LoadJPG_IO(io);
+                    SDL_CloseIO(io);
+                }
+                SDL_free(data);
+                break;
+            }
+            SDL_free(data);
+        } else if (SDL_SeekIO(src, length, SDL_IO_SEEK_CUR) < 0) {
+            break;
+        }
+    }
+    return thumbnail;
+}
+
+#endif /* LOAD_JPG */
+
+SDL_Surface *IMG_LoadJPGThumbnail_IO(SDL_IOStream *src, int size)
+{
+#ifdef LOAD_JPG
+    Sint64 start;
+    SDL_Surface *thumbnail;
+
+    if (!src) {
+        /* The error message has been set in SDL_IOFromFile */
+        return NULL;
+    }
+
+    start = SDL_TellIO(src);
+    thumbnail = JPEG_LoadExifThumbnail(src);
+    if (thumbnail && thumbnail->w < size && thumbnail->h < size) {
+        SDL_DestroySurface(thumbnail);
+        thumbnail = NULL;
+    }
+    SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
+
+    if (!thumbnail) {
+        thumbnail = JPEG_LoadJPG_IO(src, SDL_max(size, 1));
+    }
+    return thumbnail;
+#else
+    (void)src;
+    (void)size;
+    SDL_SetError("SDL_image built without JPEG support");
+    return NULL;
+#endif
+}
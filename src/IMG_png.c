@@ -23,6 +23,8 @@
 
 #include <SDL3_image/SDL_image.h>
 
+#include "IMG_quantize.h"
+
 /* We'll have PNG save support by default */
 #if !defined(SDL_IMAGE_SAVE_PNG)
 #  define SDL_IMAGE_SAVE_PNG 1
@@ -108,8 +110,18 @@ static struct {
     void (*png_set_packing) (png_structrp png_ptr);
     void (*png_set_read_fn) (png_structrp png_ptr, png_voidp io_ptr, png_rw_ptr read_data_fn);
     void (*png_set_strip_16) (png_structrp png_ptr);
+    void (*png_set_swap) (png_structrp png_ptr);
     int (*png_set_interlace_handling) (png_structrp png_ptr);
     int (*png_sig_cmp) (png_const_bytep sig, png_size_t start, png_size_t num_to_check);
+    void (*png_error) (png_const_structrp png_ptr, png_const_charp error_message);
+    void (*png_set_progressive_read_fn) (png_structrp png_ptr, png_voidp progressive_ptr, png_progressive_info_ptr info_fn, png_progressive_row_ptr row_fn, png_progressive_end_ptr end_fn);
+    png_voidp (*png_get_progressive_ptr) (png_const_structrp png_ptr);
+    void (*png_process_data) (png_structrp png_ptr, png_inforp info_ptr, png_bytep buffer, png_size_t buffer_size);
+    void (*png_progressive_combine_row) (png_const_structrp png_ptr, png_bytep old_row, png_const_bytep new_row);
+    void (*png_set_crc_action) (png_structrp png_ptr, int crit_action, int ancil_action);
+#ifdef PNG_IGNORE_ADLER32
+    int (*png_set_option) (png_structrp png_ptr, int option, int onoff);
+#endif
 #ifdef PNG_SETJMP_SUPPORTED
 #ifndef LIBPNG_VERSION_12
     jmp_buf* (*png_set_longjmp_fn) (png_structrp, png_longjmp_ptr, size_t);
@@ -125,6 +137,9 @@ static struct {
     void (*png_write_png) (png_structrp png_ptr, png_inforp info_ptr, int transforms, png_voidp params);
     void (*png_set_PLTE) (png_structrp png_ptr, png_inforp info_ptr, png_const_colorp palette, int num_palette);
     void (*png_set_tRNS) (png_structrp png_ptr, png_inforp info_ptr, png_const_bytep trans_alpha, int num_trans, png_const_color_16p trans_color);
+    void (*png_set_compression_level) (png_structrp png_ptr, int level);
+    void (*png_set_compression_strategy) (png_structrp png_ptr, int strategy);
+    void (*png_set_filter) (png_structrp png_ptr, int method, int filters);
 #endif
 } lib;
 
@@ -163,8 +178,18 @@ static bool IMG_InitPNG(void)
         FUNCTION_LOADER(png_set_packing, void (*) (png_structrp png_ptr))
         FUNCTION_LOADER(png_set_read_fn, void (*) (png_structrp png_ptr, png_voidp io_ptr, png_rw_ptr read_data_fn))
         FUNCTION_LOADER(png_set_strip_16, void (*) (png_structrp png_ptr))
+        FUNCTION_LOADER(png_set_swap, void (*) (png_structrp png_ptr))
         FUNCTION_LOADER(png_set_interlace_handling, int (*) (png_structrp png_ptr))
         FUNCTION_LOADER(png_sig_cmp, int (*) (png_const_bytep sig, png_size_t start, png_size_t num_to_check))
+        FUNCTION_LOADER(png_error, void (*) (png_const_structrp png_ptr, png_const_charp error_message))
+        FUNCTION_LOADER(png_set_progressive_read_fn, void (*) (png_structrp png_ptr, png_voidp progressive_ptr, png_progressive_info_ptr info_fn, png_progressive_row_ptr row_fn, png_progressive_end_ptr end_fn))
+        FUNCTION_LOADER(png_get_progressive_ptr, png_voidp (*) (png_const_structrp png_ptr))
+        FUNCTION_LOADER(png_process_data, void (*) (png_structrp png_ptr, png_inforp info_ptr, png_bytep buffer, png_size_t buffer_size))
+        FUNCTION_LOADER(png_progressive_combine_row, void (*) (png_const_structrp png_ptr, png_bytep old_row, png_const_bytep new_row))
+        FUNCTION_LOADER(png_set_crc_action, void (*) (png_structrp png_ptr, int crit_action, int ancil_action))
+#ifdef PNG_IGNORE_ADLER32
+        FUNCTION_LOADER(png_set_option, int (*) (png_structrp png_ptr, int option, int onoff))
+#endif
 #ifdef PNG_SETJMP_SUPPORTED
 #ifndef LIBPNG_VERSION_12
         FUNCTION_LOADER(png_set_longjmp_fn, jmp_buf* (*) (png_structrp, png_longjmp_ptr, size_t))
@@ -180,6 +205,9 @@ static bool IMG_InitPNG(void)
         FUNCTION_LOADER(png_write_png, void (*) (png_structrp png_ptr, png_inforp info_ptr, int transforms, png_voidp params))
         FUNCTION_LOADER(png_set_PLTE, void (*) (png_structrp png_ptr, png_inforp info_ptr, png_const_colorp palette, int num_palette))
         FUNCTION_LOADER(png_set_tRNS, void (*) (png_structrp png_ptr, png_inforp info_ptr, png_const_bytep trans_alpha, int num_trans, png_const_color_16p trans_color))
+        FUNCTION_LOADER(png_set_compression_level, void (*) (png_structrp png_ptr, int level))
+        FUNCTION_LOADER(png_set_compression_strategy, void (*) (png_structrp png_ptr, int strategy))
+        FUNCTION_LOADER(png_set_filter, void (*) (png_structrp png_ptr, int method, int filters))
 #endif
     }
     ++lib.loaded;
@@ -242,61 +270,41 @@ struct loadpng_vars {
     png_structp png_ptr;
     png_infop info_ptr;
     png_bytep *row_pointers;
+    int num_passes;
 };
 
-static bool LIBPNG_LoadPNG_IO(SDL_IOStream *src, struct loadpng_vars *vars)
+/* Set up the transformations for the image described by info_ptr and create
+   the surface the rows will be decoded into */
+static bool LIBPNG_CreateSurface(struct loadpng_vars *vars)
 {
     png_uint_32 width, height;
     int bit_depth, color_type, interlace_type, num_channels;
     Uint32 format;
-    int row, i;
+    int i;
     int ckey;
     png_color_16 *transv;
+    bool keep_16;
 
-    /* Create the PNG loading context structure */
-    vars->png_ptr = lib.png_create_read_struct(PNG_LIBPNG_VER_STRING,
-                      NULL,NULL,NULL);
-    if (vars->png_ptr == NULL) {
-        vars->error = "Couldn't allocate memory for PNG file or incompatible PNG dll";
-        return false;
-    }
-
-     /* Allocate/initialize the memory for image information.  REQUIRED. */
-    vars->info_ptr = lib.png_create_info_struct(vars->png_ptr);
-    if (vars->info_ptr == NULL) {
-        vars->error = "Couldn't create image information for PNG file";
-        return false;
-    }
-
-    /* Set error handling if you are using setjmp/longjmp method (this is
-     * the normal method of doing things with libpng).  REQUIRED unless you
-     * set up your own error handlers in png_create_read_struct() earlier.
-     */
-
-#ifdef PNG_SETJMP_SUPPORTED
-#ifndef LIBPNG_VERSION_12
-    if (setjmp(*lib.png_set_longjmp_fn(vars->png_ptr, longjmp, sizeof(jmp_buf))))
-#else
-    if (setjmp(vars->png_ptr->jmpbuf))
-#endif
-    {
-        vars->error = "Error reading the PNG file.";
-        return false;
-    }
-#endif
-    /* Set up the input control */
-    lib.png_set_read_fn(vars->png_ptr, src, png_read_data);
-
-    /* Read PNG header info */
-    lib.png_read_info(vars->png_ptr, vars->info_ptr);
     lib.png_get_IHDR(vars->png_ptr, vars->info_ptr, &width, &height, &bit_depth,
             &color_type, &interlace_type, NULL, NULL);
 
-    /* tell libpng to strip 16 bit/color files down to 8 bits/color */
-    lib.png_set_strip_16(vars->png_ptr);
+    keep_16 = (bit_depth == 16 && SDL_GetHintBoolean(IMG_HINT_PNG_LOAD_16BIT, false));
+    if (keep_16) {
+        /* PNG samples are big endian, SDL's 16-bit array formats are native */
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+        lib.png_set_swap(vars->png_ptr);
+#endif
+        /* Output is always RGB48 or RGBA64 */
+        if (color_type == PNG_COLOR_TYPE_GRAY) {
+            lib.png_set_gray_to_rgb(vars->png_ptr);
+        }
+    } else {
+        /* tell libpng to strip 16 bit/color files down to 8 bits/color */
+        lib.png_set_strip_16(vars->png_ptr);
+    }
 
     /* tell libpng to de-interlace (if the image is interlaced) */
-    lib.png_set_interlace_handling(vars->png_ptr);
+    vars->num_passes = lib.png_set_interlace_handling(vars->png_ptr);
 
     /* Extract multiple pixels with bit depths of 1, 2, and 4 from a single
      * byte into separate bytes (useful for paletted and grayscale images).
@@ -341,6 +349,9 @@ static bool LIBPNG_LoadPNG_IO(SDL_IOStream *src, struct loadpng_vars *vars)
         } else if (color_type == PNG_COLOR_TYPE_GRAY) {
             /* This will be turned into PNG_COLOR_TYPE_GRAY_ALPHA, so expand to RGBA */
             lib.png_set_gray_to_rgb(vars->png_ptr);
+        } else if (keep_16) {
+            /* Color keys aren't supported on 16-bit formats, use an alpha channel */
+            lib.png_set_expand(vars->png_ptr);
         } else {
             ckey = 0; /* actual value will be set later */
         }
@@ -356,9 +367,9 @@ static bool LIBPNG_LoadPNG_IO(SDL_IOStream *src, struct loadpng_vars *vars)
 
     format = SDL_PIXELFORMAT_UNKNOWN;
     if (num_channels == 3) {
-       format = SDL_PIXELFORMAT_RGB24;
+       format = (bit_depth == 16) ? SDL_PIXELFORMAT_RGB48 : SDL_PIXELFORMAT_RGB24;
     } else if (num_channels == 4) {
-       format = SDL_PIXELFORMAT_RGBA32;
+       format = (bit_depth == 16) ? SDL_PIXELFORMAT_RGBA64 : SDL_PIXELFORMAT_RGBA32;
     } else {
        /* Not sure they are all supported by png */
        switch (bit_depth * num_channels) {
@@ -402,28 +413,6 @@ static bool LIBPNG_LoadPNG_IO(SDL_IOStream *src, struct loadpng_vars *vars)
         SDL_SetSurfaceColorKey(vars->surface, true, ckey);
     }
 
-    /* Create the array of pointers to image data */
-    vars->row_pointers = (png_bytep*) SDL_malloc(sizeof(png_bytep)*height);
-    if (!vars->row_pointers) {
-        vars->error = "Out of memory";
-        return false;
-    }
-    for (row = 0; row < (int)height; row++) {
-        vars->row_pointers[row] = (png_bytep)
-                (Uint8 *)vars->surface->pixels + row*vars->surface->pitch;
-    }
-
-    /* Read the entire image in one go */
-    lib.png_read_image(vars->png_ptr, vars->row_pointers);
-
-    /* and we're done!  (png_read_end() can be omitted if no processing of
-     * post-IDAT text/time/etc. is desired)
-     * In some cases it can't read PNG's created by some popular programs (ACDSEE),
-     * we do not want to process comments, so we omit png_read_end
-
-    lib.png_read_end(png_ptr, info_ptr);
-    */
-
     /* Load the palette, if any */
     if (SDL_ISPIXELFORMAT_INDEXED(vars->surface->format)) {
         SDL_Palette *palette;
@@ -461,6 +450,88 @@ static bool LIBPNG_LoadPNG_IO(SDL_IOStream *src, struct loadpng_vars *vars)
     return true;
 }
 
+/* Don't compute or verify checksums, if IMG_HINT_PNG_SKIP_CHECKSUMS is set */
+static void LIBPNG_SetChecksumHandling(png_structrp png_ptr)
+{
+    if (SDL_GetHintBoolean(IMG_HINT_PNG_SKIP_CHECKSUMS, false)) {
+        lib.png_set_crc_action(png_ptr, PNG_CRC_QUIET_USE, PNG_CRC_QUIET_USE);
+#ifdef PNG_IGNORE_ADLER32
+        lib.png_set_option(png_ptr, PNG_IGNORE_ADLER32, PNG_OPTION_ON);
+#endif
+    }
+}
+
+static bool LIBPNG_LoadPNG_IO(SDL_IOStream *src, struct loadpng_vars *vars)
+{
+    int row;
+
+    /* Create the PNG loading context structure */
+    vars->png_ptr = lib.png_create_read_struct(PNG_LIBPNG_VER_STRING,
+                      NULL,NULL,NULL);
+    if (vars->png_ptr == NULL) {
+        vars->error = "Couldn't allocate memory for PNG file or incompatible PNG dll";
+        return false;
+    }
+    LIBPNG_SetChecksumHandling(vars->png_ptr);
+
+     /* Allocate/initialize the memory for image information.  REQUIRED. */
+    vars->info_ptr = lib.png_create_info_struct(vars->png_ptr);
+    if (vars->info_ptr == NULL) {
+        vars->error = "Couldn't create image information for PNG file";
+        return false;
+    }
+
+    /* Set error handling if you are using setjmp/longjmp method (this is
+     * the normal method of doing things with libpng).  REQUIRED unless you
+     * set up your own error handlers in png_create_read_struct() earlier.
+     */
+
+#ifdef PNG_SETJMP_SUPPORTED
+#ifndef LIBPNG_VERSION_12
+    if (setjmp(*lib.png_set_longjmp_fn(vars->png_ptr, longjmp, sizeof(jmp_buf))))
+#else
+    if (setjmp(vars->png_ptr->jmpbuf))
+#endif
+    {
+        vars->error = "Error reading the PNG file.";
+        return false;
+    }
+#endif
+    /* Set up the input control */
+    lib.png_set_read_fn(vars->png_ptr, src, png_read_data);
+
+    /* Read PNG header info */
+    lib.png_read_info(vars->png_ptr, vars->info_ptr);
+
+    if (!LIBPNG_CreateSurface(vars)) {
+        return false;
+    }
+
+    /* Create the array of pointers to image data */
+    vars->row_pointers = (png_bytep*) SDL_malloc(sizeof(png_bytep)*vars->surface->h);
+    if (!vars->row_pointers) {
+        vars->error = "Out of memory";
+        return false;
+    }
+    for (row = 0; row < vars->surface->h; row++) {
+        vars->row_pointers[row] = (png_bytep)
+                (Uint8 *)vars->surface->pixels + row*vars->surface->pitch;
+    }
+
+    /* Read the entire image in one go */
+    lib.png_read_image(vars->png_ptr, vars->row_pointers);
+
+    /* and we're done!  (png_read_end() can be omitted if no processing of
+     * post-IDAT text/time/etc. is desired)
+     * In some cases it can't read PNG's created by some popular programs (ACDSEE),
+     * we do not want to process comments, so we omit png_read_end
+
+    lib.png_read_end(png_ptr, info_ptr);
+    */
+
+    return true;
+}
+
 SDL_Surface *IMG_LoadPNG_IO(SDL_IOStream *src)
 {
     Sint64 start;
@@ -534,10 +605,12 @@ bool IMG_isPNG(SDL_IOStream *src)
     return is_PNG;
 }
 
+static SDL_Surface *MINIZ_LoadPNG_IO(SDL_IOStream *src);
+
 /* Load a PNG type image from an SDL datasource */
 SDL_Surface *IMG_LoadPNG_IO(SDL_IOStream *src)
 {
-    return IMG_LoadSTB_IO(src);
+    return MINIZ_LoadPNG_IO(src);
 }
 
 #endif /* WANT_LIBPNG */
@@ -560,146 +633,1813 @@ SDL_Surface *IMG_LoadPNG_IO(SDL_IOStream *src)
 
 #endif /* LOAD_PNG */
 
-#if SDL_IMAGE_SAVE_PNG
+#ifdef LOAD_PNG
 
-static const Uint32 png_format = SDL_PIXELFORMAT_RGBA32;
+/* Animated PNG support
+ *
+ * Each frame's image data is wrapped up with the IHDR and the other header
+ * chunks as a standalone PNG, decoded with IMG_LoadPNG_IO() and composited
+ * onto a single RGBA canvas, which is copied out for every frame.
+ */
+#define APNG_DISPOSE_OP_NONE        0
+#define APNG_DISPOSE_OP_BACKGROUND  1
+#define APNG_DISPOSE_OP_PREVIOUS    2
 
-#ifdef USE_LIBPNG
+#define APNG_BLEND_OP_SOURCE        0
+#define APNG_BLEND_OP_OVER          1
 
-static void png_write_data(png_structp png_ptr, png_bytep src, png_size_t size)
-{
-    SDL_IOStream *dst = (SDL_IOStream *)lib.png_get_io_ptr(png_ptr);
-    SDL_WriteIO(dst, src, size);
-}
+#define APNG_CHUNK(a, b, c, d)  (((Uint32)(a) << 24) | ((Uint32)(b) << 16) | ((Uint32)(c) << 8) | (Uint32)(d))
 
-static void png_flush_data(png_structp png_ptr)
+static const Uint8 png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+
+struct apng_frame
 {
-    (void)png_ptr;
-}
+    Uint32 w, h;
+    Uint32 x, y;
+    Uint16 delay_num, delay_den;
+    Uint8 dispose_op;
+    Uint8 blend_op;
+};
 
-struct savepng_vars {
-    png_structp png_ptr;
-    png_infop info_ptr;
+struct loadapng_vars
+{
     const char *error;
-    png_colorp color_ptr;
-    png_bytep *row_pointers;
-    SDL_Surface *source;
+    bool animated;
+    Uint8 ihdr[13];
+    bool skip_checksums;        /* IMG_HINT_PNG_SKIP_CHECKSUMS is set */
+    Uint8 *chunk;               /* data of the chunk being read */
+    Uint32 chunk_capacity;
+    Uint8 *header;              /* chunks between IHDR and the image data, e.g. PLTE and tRNS */
+    size_t header_size;
+    size_t header_capacity;
+    Uint8 *image;               /* standalone PNG of the current frame */
+    size_t image_size;
+    size_t image_capacity;
+    bool has_frame;
+    struct apng_frame frame;
+    SDL_Surface *canvas;
+    SDL_Surface *previous;      /* canvas area under a frame with APNG_DISPOSE_OP_PREVIOUS */
+    IMG_Animation *anim;
 };
 
-static bool LIBPNG_SavePNG_IO(struct savepng_vars *vars, SDL_Surface *surface, SDL_IOStream *dst)
+static Uint32 APNG_Read32(const Uint8 *data)
 {
-    Uint8 transparent_table[256];
-    SDL_Palette *palette;
-    int png_color_type;
+    return ((Uint32)data[0] << 24) | ((Uint32)data[1] << 16) | ((Uint32)data[2] << 8) | data[3];
+}
 
-    vars->source = surface;
+static void APNG_Write32(Uint8 *data, Uint32 value)
+{
+    data[0] = (Uint8)(value >> 24);
+    data[1] = (Uint8)(value >> 16);
+    data[2] = (Uint8)(value >> 8);
+    data[3] = (Uint8)value;
+}
 
-    vars->png_ptr = lib.png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-    if (vars->png_ptr == NULL) {
-        vars->error = "Couldn't allocate memory for PNG file or incompatible PNG dll";
-        return false;
+static bool APNG_Append(Uint8 **buffer, size_t *size, size_t *capacity, const void *data, size_t length)
+{
+    if (*size + length > *capacity) {
+        size_t new_capacity = SDL_max(*capacity * 2, *size + length);
+        Uint8 *new_buffer = (Uint8 *)SDL_realloc(*buffer, new_capacity);
+        if (!new_buffer) {
+            return false;
+        }
+        *buffer = new_buffer;
+        *capacity = new_capacity;
     }
+    SDL_memcpy(*buffer + *size, data, length);
+    *size += length;
+    return true;
+}
 
-    vars->info_ptr = lib.png_create_info_struct(vars->png_ptr);
-    if (vars->info_ptr == NULL) {
-        vars->error = "Couldn't create image information for PNG file";
+/* Append a complete chunk, with length and CRC, to a buffer */
+static bool APNG_AppendChunk(Uint8 **buffer, size_t *size, size_t *capacity, Uint32 type, const Uint8 *data, Uint32 length)
+{
+    Uint8 header[8];
+    Uint8 footer[4];
+    Uint32 crc;
+
+    APNG_Write32(header, length);
+    APNG_Write32(header + 4, type);
+    crc = SDL_crc32(0, header + 4, 4);
+    crc = SDL_crc32(crc, data, length);
+    APNG_Write32(footer, crc);
+
+    return APNG_Append(buffer, size, capacity, header, sizeof(header)) &&
+           APNG_Append(buffer, size, capacity, data, length) &&
+           APNG_Append(buffer, size, capacity, footer, sizeof(footer));
+}
+
+/* Read the next chunk into vars->chunk, verifying its CRC unless checksums are skipped */
+static bool APNG_ReadChunk(SDL_IOStream *src, struct loadapng_vars *vars, Uint32 *type, Uint32 *length)
+{
+    Uint8 header[8];
+    Uint8 footer[4];
+    Uint32 crc;
+
+    if (SDL_ReadIO(src, header, sizeof(header)) != sizeof(header)) {
+        vars->error = "Unexpected end of PNG file";
         return false;
     }
-#ifdef PNG_SETJMP_SUPPORTED
-#ifndef LIBPNG_VERSION_12
-    if (setjmp(*lib.png_set_longjmp_fn(vars->png_ptr, longjmp, sizeof (jmp_buf))))
-#else
-    if (setjmp(vars->png_ptr->jmpbuf))
-#endif
-#endif
-    {
-        vars->error = "Error writing the PNG file.";
+    *length = APNG_Read32(header);
+    *type = APNG_Read32(header + 4);
+    if (*length > 0x7FFFFFFF) {
+        vars->error = "Invalid PNG chunk length";
         return false;
     }
 
-    palette = SDL_GetSurfacePalette(surface);
-    if (palette) {
-        const int ncolors = palette->ncolors;
-        int i;
-        int last_transparent = -1;
-
-        vars->color_ptr = (png_colorp)SDL_malloc(sizeof(png_color) * ncolors);
-        if (vars->color_ptr == NULL) {
-            vars->error = "Couldn't create palette for PNG file";
+    if (*length > vars->chunk_capacity) {
+        Uint8 *chunk = (Uint8 *)SDL_realloc(vars->chunk, *length);
+        if (!chunk) {
             return false;
         }
-        for (i = 0; i < ncolors; i++) {
-            vars->color_ptr[i].red = palette->colors[i].r;
-            vars->color_ptr[i].green = palette->colors[i].g;
-            vars->color_ptr[i].blue = palette->colors[i].b;
-            if (palette->colors[i].a != 255) {
-                last_transparent = i;
-            }
-        }
-        lib.png_set_PLTE(vars->png_ptr, vars->info_ptr, vars->color_ptr, ncolors);
-        png_color_type = PNG_COLOR_TYPE_PALETTE;
-
-        if (last_transparent >= 0) {
-            for (i = 0; i <= last_transparent; ++i) {
-                transparent_table[i] = palette->colors[i].a;
-            }
-            lib.png_set_tRNS(vars->png_ptr, vars->info_ptr, transparent_table, last_transparent + 1, NULL);
-        }
-    }
-    else if (surface->format == SDL_PIXELFORMAT_RGB24) {
-        /* If the surface is exactly the right RGB format it is just passed through */
-        png_color_type = PNG_COLOR_TYPE_RGB;
-    }
-    else if (!SDL_ISPIXELFORMAT_ALPHA(surface->format)) {
-        /* If the surface is not exactly the right RGB format but does not have alpha
-           information, it should be converted to RGB24 before being passed through */
-        png_color_type = PNG_COLOR_TYPE_RGB;
-        vars->source = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGB24);
+        vars->chunk = chunk;
+        vars->chunk_capacity = *length;
     }
-    else if (surface->format != png_format) {
-        /* Otherwise, (surface has alpha data), and it is not in the exact right
-           format , so it should be converted to that */
-        png_color_type = PNG_COLOR_TYPE_RGB_ALPHA;
-        vars->source = SDL_ConvertSurface(surface, png_format);
-    } else {
-        png_color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+    if (SDL_ReadIO(src, vars->chunk, *length) != *length ||
+        SDL_ReadIO(src, footer, sizeof(footer)) != sizeof(footer)) {
+        vars->error = "Unexpected end of PNG file";
+        return false;
     }
 
-    lib.png_set_write_fn(vars->png_ptr, dst, png_write_data, png_flush_data);
-
-    lib.png_set_IHDR(vars->png_ptr, vars->info_ptr, surface->w, surface->h,
-                     8, png_color_type, PNG_INTERLACE_NONE,
-                     PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-
-    if (vars->source) {
-        int row;
-        vars->row_pointers = (png_bytep *) SDL_malloc(sizeof(png_bytep) * vars->source->h);
-        if (!vars->row_pointers) {
-            vars->error = "Out of memory";
+    if (!vars->skip_checksums) {
+        crc = SDL_crc32(0, header + 4, 4);
+        crc = SDL_crc32(crc, vars->chunk, *length);
+        if (crc != APNG_Read32(footer)) {
+            vars->error = "PNG chunk CRC mismatch";
             return false;
         }
-        for (row = 0; row < (int)vars->source->h; row++) {
-            vars->row_pointers[row] = (png_bytep) (Uint8 *) vars->source->pixels + row * vars->source->pitch;
-        }
-
-        lib.png_set_rows(vars->png_ptr, vars->info_ptr, vars->row_pointers);
-        lib.png_write_png(vars->png_ptr, vars->info_ptr, PNG_TRANSFORM_IDENTITY, NULL);
     }
-
     return true;
 }
 
-static bool IMG_SavePNG_IO_libpng(SDL_Surface *surface, SDL_IOStream *dst)
+/* Start the standalone PNG for a new frame */
+static bool APNG_StartFrame(struct loadapng_vars *vars, const Uint8 *fctl, Uint32 length)
 {
-    struct savepng_vars vars;
-    bool result;
+    struct apng_frame *frame = &vars->frame;
+    Uint8 ihdr[13];
 
-    if (!IMG_InitPNG()) {
+    if (length < 26) {
+        vars->error = "Invalid APNG frame control chunk";
+        return false;
+    }
+    frame->w = APNG_Read32(fctl + 4);
+    frame->h = APNG_Read32(fctl + 8);
+    frame->x = APNG_Read32(fctl + 12);
+    frame->y = APNG_Read32(fctl + 16);
+    frame->delay_num = (Uint16)((fctl[20] << 8) | fctl[21]);
+    frame->delay_den = (Uint16)((fctl[22] << 8) | fctl[23]);
+    frame->dispose_op = fctl[24];
+    frame->blend_op = fctl[25];
+
+    if (frame->w == 0 || frame->h == 0 ||
+        frame->x > (Uint32)vars->canvas->w || frame->w > (Uint32)vars->canvas->w - frame->x ||
+        frame->y > (Uint32)vars->canvas->h || frame->h > (Uint32)vars->canvas->h - frame->y) {
+        vars->error = "APNG frame is outside of the image";
         return false;
     }
 
-    SDL_zero(vars);
-    result = LIBPNG_SavePNG_IO(&vars, surface, dst);
+    SDL_memcpy(ihdr, vars->ihdr, sizeof(ihdr));
+    APNG_Write32(ihdr, frame->w);
+    APNG_Write32(ihdr + 4, frame->h);
+
+    vars->image_size = 0;
+    if (!APNG_Append(&vars->image, &vars->image_size, &vars->image_capacity, png_signature, sizeof(png_signature)) ||
+        !APNG_AppendChunk(&vars->image, &vars->image_size, &vars->image_capacity, APNG_CHUNK('I', 'H', 'D', 'R'), ihdr, sizeof(ihdr)) ||
+        !APNG_Append(&vars->image, &vars->image_size, &vars->image_capacity, vars->header, vars->header_size)) {
+        return false;
+    }
+    vars->has_frame = true;
+    return true;
+}
+
+/* Copy a rectangle between two RGBA32 surfaces */
+static void APNG_CopyRect(SDL_Surface *src, int src_x, int src_y, SDL_Surface *dst, int dst_x, int dst_y, int w, int h)
+{
+    int y;
+
+    for (y = 0; y < h; ++y) {
+        SDL_memcpy((Uint8 *)dst->pixels + (dst_y + y) * dst->pitch + dst_x * 4,
+                   (Uint8 *)src->pixels + (src_y + y) * src->pitch + src_x * 4,
+                   (size_t)w * 4);
+    }
+}
+
+/* Composite an RGBA32 frame onto the canvas with the PNG "over" operator */
+static void APNG_BlendOver(SDL_Surface *src, SDL_Surface *dst, int dst_x, int dst_y)
+{
+    int x, y;
+
+    for (y = 0; y < src->h; ++y) {
+        const Uint8 *s = (const Uint8 *)src->pixels + y * src->pitch;
+        Uint8 *d = (Uint8 *)dst->pixels + (dst_y + y) * dst->pitch + dst_x * 4;
+
+        for (x = 0; x < src->w; ++x, s += 4, d += 4) {
+            Uint32 sa = s[3];
+
+            if (sa == 0xFF) {
+                SDL_memcpy(d, s, 4);
+            } else if (sa != 0) {
+                Uint32 da = d[3] * (0xFF - sa) / 0xFF;
+                Uint32 a = sa + da;
+
+                d[0] = (Uint8)((s[0] * sa + d[0] * da) / a);
+                d[1] = (Uint8)((s[1] * sa + d[1] * da) / a);
+                d[2] = (Uint8)((s[2] * sa + d[2] * da) / a);
+                d[3] = (Uint8)a;
+            }
+        }
+    }
+}
+
+/* Decode the current frame, composite it and add a copy of the canvas to the animation */
+static bool APNG_FinishFrame(struct loadapng_vars *vars)
+{
+    struct apng_frame *frame = &vars->frame;
+    IMG_Animation *anim = vars->anim;
+    SDL_IOStream *io;
+    SDL_Surface *image;
+    SDL_Surface **frames;
+    int *delays;
+    Uint8 dispose_op;
+    bool result = false;
+
+    vars->has_frame = false;
+    if (!APNG_AppendChunk(&vars->image, &vars->image_size, &vars->image_capacity, APNG_CHUNK('I', 'E', 'N', 'D'), NULL, 0)) {
+        return false;
+    }
+
+    io = SDL_IOFromConstMem(vars->image, vars->image_size);
+    if (!io) {
+        return false;
+    }
+    image = IMG_LoadPNG_IO(io);
+    SDL_CloseIO(io);
+    if (!image) {
+        return false;
+    }
+    if (image->format != SDL_PIXELFORMAT_RGBA32) {
+        /* This also turns a color key into transparent pixels */
+        SDL_Surface *converted = SDL_ConvertSurface(image, SDL_PIXELFORMAT_RGBA32);
+        SDL_DestroySurface(image);
+        image = converted;
+        if (!image) {
+            return false;
+        }
+    }
+
+    frames = (SDL_Surface **)SDL_realloc(anim->frames, (anim->count + 1) * sizeof(*anim->frames));
+    if (!frames) {
+        goto done;
+    }
+    anim->frames = frames;
+    delays = (int *)SDL_realloc(anim->delays, (anim->count + 1) * sizeof(*anim->delays));
+    if (!delays) {
+        goto done;
+    }
+    anim->delays = delays;
+
+    /* The first frame can't be restored to a previous state */
+    dispose_op = frame->dispose_op;
+    if (dispose_op == APNG_DISPOSE_OP_PREVIOUS && anim->count == 0) {
+        dispose_op = APNG_DISPOSE_OP_BACKGROUND;
+    }
+    if (dispose_op == APNG_DISPOSE_OP_PREVIOUS) {
+        if (!vars->previous) {
+            vars->previous = SDL_CreateSurface(vars->canvas->w, vars->canvas->h, SDL_PIXELFORMAT_RGBA32);
+            if (!vars->previous) {
+                goto done;
+            }
+        }
+        APNG_CopyRect(vars->canvas, frame->x, frame->y, vars->previous, 0, 0, image->w, image->h);
+    }
+
+    if (frame->blend_op == APNG_BLEND_OP_OVER) {
+        APNG_BlendOver(image, vars->canvas, frame->x, frame->y);
+    } else {
+        APNG_CopyRect(image, 0, 0, vars->canvas, frame->x, frame->y, image->w, image->h);
+    }
+
+    anim->frames[anim->count] = SDL_DuplicateSurface(vars->canvas);
+    if (!anim->frames[anim->count]) {
+        goto done;
+    }
+    if (frame->delay_den == 0) {
+        anim->delays[anim->count] = frame->delay_num * 1000 / 100;
+    } else {
+        anim->delays[anim->count] = frame->delay_num * 1000 / frame->delay_den;
+    }
+    ++anim->count;
+
+    if (dispose_op == APNG_DISPOSE_OP_BACKGROUND) {
+        SDL_Rect rect;
+
+        rect.x = frame->x;
+        rect.y = frame->y;
+        rect.w = image->w;
+        rect.h = image->h;
+        SDL_FillSurfaceRect(vars->canvas, &rect, 0);
+    } else if (dispose_op == APNG_DISPOSE_OP_PREVIOUS) {
+        APNG_CopyRect(vars->previous, 0, 0, vars->canvas, frame->x, frame->y, image->w, image->h);
+    }
+    result = true;
+
+done:
+    SDL_DestroySurface(image);
+    return result;
+}
+
+static bool APNG_LoadAnimation_IO(SDL_IOStream *src, struct loadapng_vars *vars)
+{
+    Uint8 signature[8];
+    Uint32 type, length;
+    bool in_image_data = false;
+
+    if (SDL_ReadIO(src, signature, sizeof(signature)) != sizeof(signature) ||
+        SDL_memcmp(signature, png_signature, sizeof(signature)) != 0) {
+        vars->error = "Not a PNG file";
+        return false;
+    }
+    if (!APNG_ReadChunk(src, vars, &type, &length)) {
+        return false;
+    }
+    if (type != APNG_CHUNK('I', 'H', 'D', 'R') || length != sizeof(vars->ihdr)) {
+        vars->error = "PNG file is missing IHDR";
+        return false;
+    }
+    SDL_memcpy(vars->ihdr, vars->chunk, sizeof(vars->ihdr));
+
+    vars->canvas = SDL_CreateSurface((int)APNG_Read32(vars->ihdr), (int)APNG_Read32(vars->ihdr + 4), SDL_PIXELFORMAT_RGBA32);
+    if (!vars->canvas) {
+        return false;
+    }
+    vars->anim->w = vars->canvas->w;
+    vars->anim->h = vars->canvas->h;
+
+    for (;;) {
+        if (!APNG_ReadChunk(src, vars, &type, &length)) {
+            return false;
+        }
+
+        switch (type) {
+        case APNG_CHUNK('a', 'c', 'T', 'L'):
+            vars->animated = true;
+            break;
+
+        case APNG_CHUNK('f', 'c', 'T', 'L'):
+            if (vars->has_frame && !APNG_FinishFrame(vars)) {
+                return false;
+            }
+            if (!APNG_StartFrame(vars, vars->chunk, length)) {
+                return false;
+            }
+            break;
+
+        case APNG_CHUNK('I', 'D', 'A', 'T'):
+            if (!vars->animated) {
+                /* A plain PNG image, the caller loads it as a single frame */
+                return false;
+            }
+            in_image_data = true;
+            /* The default image is only part of the animation if it has a frame control chunk */
+            if (vars->has_frame &&
+                !APNG_AppendChunk(&vars->image, &vars->image_size, &vars->image_capacity, type, vars->chunk, length)) {
+                return false;
+            }
+            break;
+
+        case APNG_CHUNK('f', 'd', 'A', 'T'):
+            if (!vars->has_frame || length < 4) {
+                vars->error = "Unexpected APNG frame data chunk";
+                return false;
+            }
+            in_image_data = true;
+            /* Skip the sequence number to turn it into an IDAT chunk */
+            if (!APNG_AppendChunk(&vars->image, &vars->image_size, &vars->image_capacity, APNG_CHUNK('I', 'D', 'A', 'T'), vars->chunk + 4, length - 4)) {
+                return false;
+            }
+            break;
+
+        case APNG_CHUNK('I', 'E', 'N', 'D'):
+            if (vars->has_frame && !APNG_FinishFrame(vars)) {
+                return false;
+            }
+            if (vars->anim->count == 0) {
+                vars->error = "APNG file doesn't have any frames";
+                return false;
+            }
+            return true;
+
+        default:
+            /* Keep the palette, transparency and color information for the frames */
+            if (!in_image_data &&
+                !APNG_AppendChunk(&vars->header, &vars->header_size, &vars->header_capacity, type, vars->chunk, length)) {
+                return false;
+            }
+            break;
+        }
+    }
+}
+
+/* Load an animated PNG from an SDL datasource */
+IMG_Animation *IMG_LoadPNGAnimation_IO(SDL_IOStream *src)
+{
+    Sint64 start;
+    struct loadapng_vars vars;
+    bool success;
+
+    if (!src) {
+        /* The error message has been set in SDL_IOFromFile */
+        return NULL;
+    }
+
+    start = SDL_TellIO(src);
+    SDL_zero(vars);
+    vars.skip_checksums = SDL_GetHintBoolean(IMG_HINT_PNG_SKIP_CHECKSUMS, false);
+
+    vars.anim = (IMG_Animation *)SDL_calloc(1, sizeof(*vars.anim));
+    if (!vars.anim) {
+        return NULL;
+    }
+
+    success = APNG_LoadAnimation_IO(src, &vars);
+    SDL_free(vars.chunk);
+    SDL_free(vars.header);
+    SDL_free(vars.image);
+    SDL_DestroySurface(vars.canvas);
+    SDL_DestroySurface(vars.previous);
+    if (success) {
+        return vars.anim;
+    }
+
+    /* this may clobber a set error if seek fails: don't care. */
+    SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
+
+    if (!vars.animated && !vars.error && vars.anim->w > 0) {
+        /* Create a single frame animation from a plain PNG image */
+        vars.anim->frames = (SDL_Surface **)SDL_calloc(1, sizeof(*vars.anim->frames));
+        vars.anim->delays = (int *)SDL_calloc(1, sizeof(*vars.anim->delays));
+        if (vars.anim->frames && vars.anim->delays) {
+            vars.anim->frames[0] = IMG_LoadPNG_IO(src);
+            if (vars.anim->frames[0]) {
+                vars.anim->count = 1;
+                return vars.anim;
+            }
+        }
+    }
+    IMG_FreeAnimation(vars.anim);
+    if (vars.error) {
+        SDL_SetError("%s", vars.error);
+    }
+    return NULL;
+}
+
+#else
+
+/* Load an animated PNG from an SDL datasource */
+IMG_Animation *IMG_LoadPNGAnimation_IO(SDL_IOStream *src)
+{
+    (void)src;
+    return NULL;
+}
+
+#endif /* LOAD_PNG */
+
+/* Incremental decoding, for data that arrives a piece at a time */
+struct IMG_PNGStream
+{
+    IMG_PNGRowCallback callback;
+    void *userdata;
+    bool failed;
+    bool done;
+#ifdef USE_LIBPNG
+    struct loadpng_vars vars;
+#elif defined(LOAD_PNG)
+    SDL_IOStream *data;
+#endif
+};
+
+#ifdef USE_LIBPNG
+static void png_stream_info(png_structp png_ptr, png_infop info_ptr)
+{
+    IMG_PNGStream *stream = (IMG_PNGStream *)lib.png_get_progressive_ptr(png_ptr);
+    (void)info_ptr;
+
+    if (!LIBPNG_CreateSurface(&stream->vars)) {
+        if (!stream->vars.error) {
+            stream->vars.error = "Couldn't create surface for PNG image";
+        }
+        lib.png_error(png_ptr, stream->vars.error);
+    }
+}
+
+static void png_stream_row(png_structp png_ptr, png_bytep new_row, png_uint_32 row_num, int pass)
+{
+    IMG_PNGStream *stream = (IMG_PNGStream *)lib.png_get_progressive_ptr(png_ptr);
+    SDL_Surface *surface = stream->vars.surface;
+
+    /* Interlaced images don't have new data for every row in every pass */
+    if (!new_row || row_num >= (png_uint_32)surface->h) {
+        return;
+    }
+    lib.png_progressive_combine_row(png_ptr, (Uint8 *)surface->pixels + row_num * surface->pitch, new_row);
+
+    if (stream->callback) {
+        stream->callback(stream->userdata, surface, (int)row_num, pass);
+    }
+}
+
+static void png_stream_end(png_structp png_ptr, png_infop info_ptr)
+{
+    IMG_PNGStream *stream = (IMG_PNGStream *)lib.png_get_progressive_ptr(png_ptr);
+    (void)info_ptr;
+
+    stream->done = true;
+}
+#endif /* USE_LIBPNG */
+
+IMG_PNGStream *IMG_CreatePNGStream(IMG_PNGRowCallback callback, void *userdata)
+{
+#ifdef LOAD_PNG
+    IMG_PNGStream *stream;
+
+#ifdef USE_LIBPNG
+    if (!IMG_InitPNG()) {
+        return NULL;
+    }
+#endif
+
+    stream = (IMG_PNGStream *)SDL_calloc(1, sizeof(*stream));
+    if (!stream) {
+        return NULL;
+    }
+    stream->callback = callback;
+    stream->userdata = userdata;
+
+#ifdef USE_LIBPNG
+    stream->vars.png_ptr = lib.png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (stream->vars.png_ptr) {
+        stream->vars.info_ptr = lib.png_create_info_struct(stream->vars.png_ptr);
+    }
+    if (!stream->vars.info_ptr) {
+        SDL_SetError("Couldn't allocate memory for PNG file or incompatible PNG dll");
+        IMG_ClosePNGStream(stream);
+        return NULL;
+    }
+    LIBPNG_SetChecksumHandling(stream->vars.png_ptr);
+    lib.png_set_progressive_read_fn(stream->vars.png_ptr, stream, png_stream_info, png_stream_row, png_stream_end);
+#else
+    /* The other backends decode the whole image once all the data is in */
+    stream->data = SDL_IOFromDynamicMem();
+    if (!stream->data) {
+        SDL_free(stream);
+        return NULL;
+    }
+#endif
+    return stream;
+#else
+    (void)callback;
+    (void)userdata;
+    SDL_SetError("SDL_image built without PNG support");
+    return NULL;
+#endif /* LOAD_PNG */
+}
+
+bool IMG_FeedPNGStream(IMG_PNGStream *stream, const void *data, size_t size)
+{
+    if (!stream) {
+        return SDL_InvalidParamError("stream");
+    }
+    if (!data && size > 0) {
+        return SDL_InvalidParamError("data");
+    }
+    if (stream->failed) {
+        return SDL_SetError("PNG stream has already failed");
+    }
+    if (stream->done || size == 0) {
+        return true;
+    }
+
+#ifdef USE_LIBPNG
+#ifdef PNG_SETJMP_SUPPORTED
+#ifndef LIBPNG_VERSION_12
+    if (setjmp(*lib.png_set_longjmp_fn(stream->vars.png_ptr, longjmp, sizeof(jmp_buf))))
+#else
+    if (setjmp(stream->vars.png_ptr->jmpbuf))
+#endif
+    {
+        stream->failed = true;
+        return SDL_SetError("%s", stream->vars.error ? stream->vars.error : "Error reading the PNG file.");
+    }
+#endif
+    lib.png_process_data(stream->vars.png_ptr, stream->vars.info_ptr, (png_bytep)data, size);
+    return true;
+#elif defined(LOAD_PNG)
+    if (SDL_WriteIO(stream->data, data, size) != size) {
+        stream->failed = true;
+        return false;
+    }
+    return true;
+#else
+    return SDL_Unsupported();
+#endif
+}
+
+SDL_Surface *IMG_ClosePNGStream(IMG_PNGStream *stream)
+{
+    SDL_Surface *surface = NULL;
+
+    if (!stream) {
+        SDL_InvalidParamError("stream");
+        return NULL;
+    }
+
+#ifdef USE_LIBPNG
+    if (stream->vars.png_ptr) {
+        lib.png_destroy_read_struct(&stream->vars.png_ptr,
+                                stream->vars.info_ptr ? &stream->vars.info_ptr : (png_infopp)0,
+                                (png_infopp)0);
+    }
+    if (stream->done) {
+        surface = stream->vars.surface;
+    } else {
+        SDL_DestroySurface(stream->vars.surface);
+        if (!stream->failed) {
+            SDL_SetError("Incomplete PNG image");
+        }
+    }
+#elif defined(LOAD_PNG)
+    if (!stream->failed && SDL_SeekIO(stream->data, 0, SDL_IO_SEEK_SET) == 0) {
+        surface = IMG_LoadPNG_IO(stream->data);
+        if (surface && stream->callback) {
+            int row;
+
+            for (row = 0; row < surface->h; ++row) {
+                stream->callback(stream->userdata, surface, row, 0);
+            }
+        }
+    }
+    SDL_CloseIO(stream->data);
+#endif
+    SDL_free(stream);
+    return surface;
+}
+
+#if SDL_IMAGE_SAVE_PNG || (defined(LOAD_PNG) && defined(USE_STBIMAGE))
+/* The miniz encoder is always built, it's also used for multithreaded saving.
+ * With stb_image, the inflater is used to decode PNG images as well.
+ */
+/* Replace C runtime functions with SDL C runtime functions for building on Windows */
+#define MINIZ_NO_STDIO
+#define MINIZ_NO_TIME
+#define MINIZ_SDL_MALLOC
+#define MZ_ASSERT(x) SDL_assert(x)
+#undef memcpy
+#define memcpy  SDL_memcpy
+#undef memset
+#define memset  SDL_memset
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+#define MINIZ_LITTLE_ENDIAN 1
+#else
+#define MINIZ_LITTLE_ENDIAN 0
+#endif
+#define MINIZ_USE_UNALIGNED_LOADS_AND_STORES 0
+#define MINIZ_SDL_NOUNUSED
+#if !SDL_IMAGE_SAVE_PNG
+#define MINIZ_NO_DEFLATE_APIS
+#endif
+#if defined(LOAD_PNG) && defined(USE_STBIMAGE)
+#define MINIZ_SDL_INFLATE
+#endif
+#include "miniz.h"
+#endif /* SDL_IMAGE_SAVE_PNG || (LOAD_PNG && USE_STBIMAGE) */
+
+#if defined(LOAD_PNG) && defined(USE_STBIMAGE)
+
+#include <SDL3/SDL_intrin.h>
+
+/* PNG decoding with miniz
+ *
+ * The image data is inflated into tinfl's 32K window, and every scanline is
+ * unfiltered as soon as it's complete, straight into the surface pixels, so
+ * the decompressed image is never held in memory as a whole. Scanlines that
+ * are contiguous in the window are unfiltered in place, the others are
+ * gathered into a single scanline buffer first.
+ *
+ * The surfaces are the same as stb_image creates. Interlaced and 16-bit
+ * images, and anything else unusual, are still loaded by stb_image.
+ */
+#define PNG_READ_SIZE (64 * 1024)
+
+#define PNG_COLOR_GRAY          0
+#define PNG_COLOR_RGB           2
+#define PNG_COLOR_PALETTE       3
+#define PNG_COLOR_GRAY_ALPHA    4
+#define PNG_COLOR_RGBA          6
+
+typedef void (*MINIZ_UnfilterFunc)(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length);
+
+struct loadpng_miniz_vars
+{
+    const char *error;
+    bool fallback;              /* the image should be loaded by stb_image */
+    Uint32 w, h;
+    Uint8 depth;
+    Uint8 color_type;
+    int bpp;                    /* bytes per complete pixel, at least 1 */
+    MINIZ_UnfilterFunc unfilter; /* picked for bpp and the CPU */
+    size_t row_bytes;           /* scanline length without the filter byte */
+    bool direct;                /* scanlines are unfiltered into the surface as is */
+    SDL_Color palette[256];
+    bool has_palette;
+    bool has_trns;
+    Uint16 trns[3];
+    SDL_Surface *surface;
+    Uint32 y;                   /* next scanline */
+    Uint8 *buffer;              /* input, window and scanline buffers */
+    Uint8 *input;
+    Uint8 *window;
+    size_t window_pos;
+    Uint8 *scanline;            /* scanline with its filter byte, split in the window */
+    size_t scanline_size;
+    Uint8 *rows[2];             /* unfiltered scanlines, when not direct */
+    bool skip_checksums;        /* IMG_HINT_PNG_SKIP_CHECKSUMS is set */
+    int zlib_header;            /* zlib header bytes left to skip, when not checking the Adler-32 */
+    bool inflate_done;
+    tinfl_decompressor inflator;
+};
+
+/* Chunk CRCs are checked 4 bytes at a time with slicing-by-4 tables, which
+ * is several times faster than SDL_crc32() on large IDAT chunks.
+ */
+static Uint32 png_crc_table[4][256];
+static SDL_InitState png_crc_init;
+
+static void MINIZ_InitCRC32(void)
+{
+    if (SDL_ShouldInit(&png_crc_init)) {
+        Uint32 i;
+        int k;
+
+        for (i = 0; i < 256; ++i) {
+            Uint32 crc = i;
+
+            for (k = 0; k < 8; ++k) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : (crc >> 1);
+            }
+            png_crc_table[0][i] = crc;
+        }
+        for (i = 0; i < 256; ++i) {
+            for (k = 1; k < 4; ++k) {
+                Uint32 crc = png_crc_table[k - 1][i];
+
+                png_crc_table[k][i] = (crc >> 8) ^ png_crc_table[0][crc & 0xff];
+            }
+        }
+        SDL_SetInitialized(&png_crc_init, true);
+    }
+}
+
+static Uint32 MINIZ_CRC32(Uint32 crc, const Uint8 *data, size_t length)
+{
+    crc = ~crc;
+    while (length >= 4) {
+        crc ^= (Uint32)data[0] | ((Uint32)data[1] << 8) | ((Uint32)data[2] << 16) | ((Uint32)data[3] << 24);
+        crc = png_crc_table[3][crc & 0xff] ^
+              png_crc_table[2][(crc >> 8) & 0xff] ^
+              png_crc_table[1][(crc >> 16) & 0xff] ^
+              png_crc_table[0][crc >> 24];
+        data += 4;
+        length -= 4;
+    }
+    while (length--) {
+        crc = png_crc_table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/* Equivalent to the predictor in the PNG specification, but written so that
+ * it compiles to conditional moves rather than branches.
+ */
+SDL_FORCE_INLINE int MINIZ_UnfilterPaeth(int a, int b, int c)
+{
+    int threshold = c * 3 - (a + b);
+    int lo = (a < b) ? a : b;
+    int hi = (a < b) ? b : a;
+    int t = (hi <= threshold) ? lo : c;
+
+    return (threshold <= lo) ? hi : t;
+}
+
+/* With a constant bpp the compiler unrolls the inner loops, and the Up
+ * filter becomes a vector add.
+ */
+SDL_FORCE_INLINE void MINIZ_UnfilterRowN(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length, const int bpp)
+{
+    size_t i;
+
+    switch (type) {
+    case 0:
+        SDL_memcpy(out, in, length);
+        break;
+    case 1:
+        for (i = 0; i < (size_t)bpp; ++i) {
+            out[i] = in[i];
+        }
+        for (; i < length; ++i) {
+            out[i] = (Uint8)(in[i] + out[i - bpp]);
+        }
+        break;
+    case 2:
+        for (i = 0; i < length; ++i) {
+            out[i] = (Uint8)(in[i] + prev[i]);
+        }
+        break;
+    case 3:
+        for (i = 0; i < (size_t)bpp; ++i) {
+            out[i] = (Uint8)(in[i] + (prev[i] >> 1));
+        }
+        for (; i < length; ++i) {
+            out[i] = (Uint8)(in[i] + ((out[i - bpp] + prev[i]) >> 1));
+        }
+        break;
+    case 4:
+        for (i = 0; i < (size_t)bpp; ++i) {
+            out[i] = (Uint8)(in[i] + prev[i]);
+        }
+        for (; i < length; ++i) {
+            out[i] = (Uint8)(in[i] + MINIZ_UnfilterPaeth(out[i - bpp], prev[i], prev[i - bpp]));
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+#ifdef SDL_SSE2_INTRINSICS
+/* The Sub, Average and Paeth filters depend on the pixel to the left, so for
+ * 3 and 4 byte pixels they're vectorized across the channels of one pixel at
+ * a time, the same way as libpng does it.
+ */
+SDL_FORCE_INLINE SDL_TARGETING("sse2") __m128i MINIZ_LoadPixel(const Uint8 *p, const int bpp)
+{
+    Uint32 value = 0;
+
+    SDL_memcpy(&value, p, bpp);
+    return _mm_cvtsi32_si128((int)value);
+}
+
+SDL_FORCE_INLINE SDL_TARGETING("sse2") void MINIZ_StorePixel(Uint8 *p, __m128i pixel, const int bpp)
+{
+    Uint32 value = (Uint32)_mm_cvtsi128_si32(pixel);
+
+    SDL_memcpy(p, &value, bpp);
+}
+
+SDL_FORCE_INLINE SDL_TARGETING("sse2") void MINIZ_UnfilterRowSSE2(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length, const int bpp)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = zero;   /* left */
+    __m128i c = zero;   /* upper left */
+    size_t i;
+
+    switch (type) {
+    case 1:
+        for (i = 0; i < length; i += bpp) {
+            a = _mm_add_epi8(a, MINIZ_LoadPixel(in + i, bpp));
+            MINIZ_StorePixel(out + i, a, bpp);
+        }
+        break;
+    case 3:
+        for (i = 0; i < length; i += bpp) {
+            __m128i b = MINIZ_LoadPixel(prev + i, bpp);
+            /* _mm_avg_epu8() rounds up, the PNG average rounds down */
+            __m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1)));
+
+            a = _mm_add_epi8(avg, MINIZ_LoadPixel(in + i, bpp));
+            MINIZ_StorePixel(out + i, a, bpp);
+        }
+        break;
+    case 4:
+        /* Work with 16-bit lanes, so the differences don't overflow */
+        for (i = 0; i < length; i += bpp) {
+            __m128i b = _mm_unpacklo_epi8(MINIZ_LoadPixel(prev + i, bpp), zero);
+            __m128i pa = _mm_sub_epi16(b, c);
+            __m128i pb = _mm_sub_epi16(a, c);
+            __m128i pc = _mm_add_epi16(pa, pb);
+            __m128i smallest, nearest, mask;
+
+            pa = _mm_max_epi16(pa, _mm_sub_epi16(zero, pa));
+            pb = _mm_max_epi16(pb, _mm_sub_epi16(zero, pb));
+            pc = _mm_max_epi16(pc, _mm_sub_epi16(zero, pc));
+            smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+
+            /* Prefer a, then b, then c when they're equally near */
+            mask = _mm_cmpeq_epi16(smallest, pb);
+            nearest = _mm_or_si128(_mm_and_si128(mask, b), _mm_andnot_si128(mask, c));
+            mask = _mm_cmpeq_epi16(smallest, pa);
+            nearest = _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, nearest));
+
+            a = _mm_add_epi8(nearest, _mm_unpacklo_epi8(MINIZ_LoadPixel(in + i, bpp), zero));
+            a = _mm_and_si128(a, _mm_set1_epi16(0xff));
+            MINIZ_StorePixel(out + i, _mm_packus_epi16(a, a), bpp);
+            c = b;
+        }
+        break;
+    default:
+        MINIZ_UnfilterRowN(type, in, prev, out, length, bpp);
+        break;
+    }
+}
+
+static void SDL_TARGETING("sse2") MINIZ_UnfilterRow3SSE2(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length)
+{
+    MINIZ_UnfilterRowSSE2(type, in, prev, out, length, 3);
+}
+
+static void SDL_TARGETING("sse2") MINIZ_UnfilterRow4SSE2(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length)
+{
+    MINIZ_UnfilterRowSSE2(type, in, prev, out, length, 4);
+}
+#endif /* SDL_SSE2_INTRINSICS */
+
+static void MINIZ_UnfilterRow1(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length)
+{
+    MINIZ_UnfilterRowN(type, in, prev, out, length, 1);
+}
+
+static void MINIZ_UnfilterRow2(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length)
+{
+    MINIZ_UnfilterRowN(type, in, prev, out, length, 2);
+}
+
+static void MINIZ_UnfilterRow3(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length)
+{
+    MINIZ_UnfilterRowN(type, in, prev, out, length, 3);
+}
+
+static void MINIZ_UnfilterRow4(int type, const Uint8 *in, const Uint8 *prev, Uint8 *out, size_t length)
+{
+    MINIZ_UnfilterRowN(type, in, prev, out, length, 4);
+}
+
+/* Pixels are at most 4 bytes, 16-bit images are left to stb_image.
+ * The SSE2 versions are only used if the CPU has it, since SDL_SSE2_INTRINSICS
+ * is also defined for 32-bit x86 builds that target older processors.
+ */
+static MINIZ_UnfilterFunc MINIZ_GetUnfilterFunc(int bpp)
+{
+    switch (bpp) {
+    case 1:
+        return MINIZ_UnfilterRow1;
+    case 2:
+        return MINIZ_UnfilterRow2;
+    case 3:
+#ifdef SDL_SSE2_INTRINSICS
+        if (SDL_HasSSE2()) {
+            return MINIZ_UnfilterRow3SSE2;
+        }
+#endif
+        return MINIZ_UnfilterRow3;
+    default:
+#ifdef SDL_SSE2_INTRINSICS
+        if (SDL_HasSSE2()) {
+            return MINIZ_UnfilterRow4SSE2;
+        }
+#endif
+        return MINIZ_UnfilterRow4;
+    }
+}
+
+static Uint8 MINIZ_GetSample(const Uint8 *row, Uint32 x, int depth)
+{
+    size_t bit;
+
+    if (depth == 8) {
+        return row[x];
+    }
+    bit = (size_t)x * depth;
+    return (Uint8)((row[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1));
+}
+
+/* Convert an unfiltered scanline that doesn't match the surface format */
+static void MINIZ_ExpandRow(struct loadpng_miniz_vars *vars, const Uint8 *row, Uint8 *dst)
+{
+    /* Gray samples are scaled up to 8 bits, the same way as stb_image does */
+    static const Uint8 depth_scale[9] = { 0, 0xff, 0x55, 0, 0x11, 0, 0, 0, 0x01 };
+    Uint8 scale = (vars->color_type == PNG_COLOR_GRAY) ? depth_scale[vars->depth] : 1;
+    Uint32 x;
+
+    switch (vars->color_type) {
+    case PNG_COLOR_GRAY:
+        if (vars->has_trns) {
+            Uint8 key = (Uint8)((vars->trns[0] & 0xff) * scale);
+
+            for (x = 0; x < vars->w; ++x) {
+                Uint8 gray = (Uint8)(MINIZ_GetSample(row, x, vars->depth) * scale);
+
+                *dst++ = gray;
+                *dst++ = gray;
+                *dst++ = gray;
+                *dst++ = (gray == key) ? SDL_ALPHA_TRANSPARENT : SDL_ALPHA_OPAQUE;
+            }
+            break;
+        }
+        SDL_FALLTHROUGH;
+    case PNG_COLOR_PALETTE:
+        for (x = 0; x < vars->w; ++x) {
+            *dst++ = (Uint8)(MINIZ_GetSample(row, x, vars->depth) * scale);
+        }
+        break;
+    case PNG_COLOR_RGB:
+        {
+            Uint8 r = (Uint8)vars->trns[0];
+            Uint8 g = (Uint8)vars->trns[1];
+            Uint8 b = (Uint8)vars->trns[2];
+
+            for (x = 0; x < vars->w; ++x, row += 3) {
+                *dst++ = row[0];
+                *dst++ = row[1];
+                *dst++ = row[2];
+                *dst++ = (row[0] == r && row[1] == g && row[2] == b) ? SDL_ALPHA_TRANSPARENT : SDL_ALPHA_OPAQUE;
+            }
+        }
+        break;
+    case PNG_COLOR_GRAY_ALPHA:
+        for (x = 0; x < vars->w; ++x, row += 2) {
+            *dst++ = row[0];
+            *dst++ = row[0];
+            *dst++ = row[0];
+            *dst++ = row[1];
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+static bool MINIZ_ReadRow(struct loadpng_miniz_vars *vars, const Uint8 *scanline)
+{
+    SDL_Surface *surface = vars->surface;
+    Uint8 *dst = (Uint8 *)surface->pixels + (size_t)vars->y * surface->pitch;
+    int type = scanline[0];
+
+    if (type > 4) {
+        vars->error = "Invalid PNG filter type";
+        return false;
+    }
+
+    if (vars->direct) {
+        const Uint8 *prev = (vars->y > 0) ? dst - surface->pitch : vars->rows[1];
+
+        vars->unfilter(type, scanline + 1, prev, dst, vars->row_bytes);
+    } else {
+        Uint8 *row = vars->rows[vars->y & 1];
+        const Uint8 *prev = vars->rows[~vars->y & 1];
+
+        vars->unfilter(type, scanline + 1, prev, row, vars->row_bytes);
+        MINIZ_ExpandRow(vars, row, dst);
+    }
+    ++vars->y;
+    return true;
+}
+
+/* Split inflated data into scanlines, data past the last scanline is ignored */
+static bool MINIZ_ReadRows(struct loadpng_miniz_vars *vars, const Uint8 *data, size_t length)
+{
+    const size_t size = 1 + vars->row_bytes;
+
+    while (length > 0 && vars->y < vars->h) {
+        if (vars->scanline_size == 0 && length >= size) {
+            if (!MINIZ_ReadRow(vars, data)) {
+                return false;
+            }
+            data += size;
+            length -= size;
+        } else {
+            size_t amount = SDL_min(length, size - vars->scanline_size);
+
+            SDL_memcpy(vars->scanline + vars->scanline_size, data, amount);
+            vars->scanline_size += amount;
+            data += amount;
+            length -= amount;
+            if (vars->scanline_size == size) {
+                vars->scanline_size = 0;
+                if (!MINIZ_ReadRow(vars, vars->scanline)) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+static bool MINIZ_Inflate(struct loadpng_miniz_vars *vars, const Uint8 *data, size_t length)
+{
+    /* tinfl always computes the Adler-32 of zlib streams, so to skip it the
+     * header is skipped here, the rest is inflated as raw deflate data and
+     * the trailer is ignored.
+     */
+    mz_uint32 flags = vars->skip_checksums ? TINFL_FLAG_HAS_MORE_INPUT : (TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_HAS_MORE_INPUT);
+
+    while (vars->zlib_header > 0 && length > 0) {
+        --vars->zlib_header;
+        ++data;
+        --length;
+    }
+
+    while (!vars->inflate_done) {
+        size_t in_size = length;
+        size_t out_size = TINFL_LZ_DICT_SIZE - vars->window_pos;
+        tinfl_status status;
+
+        status = tinfl_decompress(&vars->inflator, data, &in_size,
+                                  vars->window, vars->window + vars->window_pos, &out_size,
+                                  flags);
+        data += in_size;
+        length -= in_size;
+        if (out_size > 0 && !MINIZ_ReadRows(vars, vars->window + vars->window_pos, out_size)) {
+            return false;
+        }
+        vars->window_pos = (vars->window_pos + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+
+        if (status == TINFL_STATUS_DONE) {
+            vars->inflate_done = true;
+        } else if (status < 0) {
+            vars->error = "Corrupt PNG image data";
+            return false;
+        } else if (status == TINFL_STATUS_NEEDS_MORE_INPUT) {
+            break;
+        }
+    }
+    return true;
+}
+
+static bool MINIZ_ReadIHDR(struct loadpng_miniz_vars *vars, const Uint8 *ihdr)
+{
+    static const int channels[7] = { 1, 0, 3, 1, 2, 0, 4 };
+    Uint8 depth = ihdr[8];
+    Uint8 color_type = ihdr[9];
+    size_t bits;
+
+    vars->w = APNG_Read32(ihdr);
+    vars->h = APNG_Read32(ihdr + 4);
+    if (vars->w == 0 || vars->h == 0 || vars->w > SDL_MAX_SINT32 || vars->h > SDL_MAX_SINT32) {
+        vars->error = "Invalid PNG image size";
+        return false;
+    }
+
+    /* Compression, filter and interlace methods */
+    if (ihdr[10] != 0 || ihdr[11] != 0 || ihdr[12] != 0) {
+        vars->fallback = true;
+        return false;
+    }
+
+    switch (color_type) {
+    case PNG_COLOR_GRAY:
+    case PNG_COLOR_PALETTE:
+        if (depth != 1 && depth != 2 && depth != 4 && depth != 8) {
+            vars->fallback = true;
+            return false;
+        }
+        break;
+    case PNG_COLOR_RGB:
+    case PNG_COLOR_GRAY_ALPHA:
+    case PNG_COLOR_RGBA:
+        if (depth != 8) {
+            vars->fallback = true;
+            return false;
+        }
+        break;
+    default:
+        vars->fallback = true;
+        return false;
+    }
+
+    vars->depth = depth;
+    vars->color_type = color_type;
+    bits = (size_t)channels[color_type] * depth;
+    vars->bpp = (int)SDL_max(bits / 8, 1);
+    vars->unfilter = MINIZ_GetUnfilterFunc(vars->bpp);
+    vars->row_bytes = (vars->w * bits + 7) / 8;
+    return true;
+}
+
+static bool MINIZ_CreateSurface(struct loadpng_miniz_vars *vars)
+{
+    SDL_PixelFormat format;
+    size_t size;
+
+    switch (vars->color_type) {
+    case PNG_COLOR_GRAY:
+        format = vars->has_trns ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_INDEX8;
+        break;
+    case PNG_COLOR_RGB:
+        format = vars->has_trns ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGB24;
+        break;
+    case PNG_COLOR_PALETTE:
+        if (!vars->has_palette) {
+            vars->error = "Missing PLTE chunk in PNG file";
+            return false;
+        }
+        format = SDL_PIXELFORMAT_INDEX8;
+        break;
+    default:
+        format = SDL_PIXELFORMAT_RGBA32;
+        break;
+    }
+    vars->direct = (vars->depth == 8 && vars->row_bytes == (size_t)SDL_BYTESPERPIXEL(format) * vars->w);
+
+    vars->surface = SDL_CreateSurface((int)vars->w, (int)vars->h, format);
+    if (!vars->surface) {
+        return false;
+    }
+
+    if (format == SDL_PIXELFORMAT_INDEX8) {
+        SDL_Palette *palette = SDL_CreateSurfacePalette(vars->surface);
+        bool has_colorkey = false;
+        int colorkey_index = -1;
+        bool has_alpha = false;
+        int i;
+
+        if (!palette) {
+            return false;
+        }
+        for (i = 0; i < palette->ncolors; i++) {
+            if (vars->color_type == PNG_COLOR_GRAY) {
+                palette->colors[i].r = (Uint8)i;
+                palette->colors[i].g = (Uint8)i;
+                palette->colors[i].b = (Uint8)i;
+                continue;
+            }
+
+            palette->colors[i] = vars->palette[i];
+            if (palette->colors[i].a != SDL_ALPHA_OPAQUE) {
+                if (palette->colors[i].a == SDL_ALPHA_TRANSPARENT && !has_colorkey) {
+                    has_colorkey = true;
+                    colorkey_index = i;
+                } else {
+                    /* Partial opacity or multiple colorkeys */
+                    has_alpha = true;
+                }
+            }
+        }
+        if (has_alpha) {
+            SDL_SetSurfaceBlendMode(vars->surface, SDL_BLENDMODE_BLEND);
+        } else if (has_colorkey) {
+            SDL_SetSurfaceColorKey(vars->surface, true, colorkey_index);
+        }
+    }
+
+    /* Input, window, split scanline and two unfiltered scanlines, zeroed for
+     * the scanline above the first one.
+     */
+    size = PNG_READ_SIZE + TINFL_LZ_DICT_SIZE + (1 + vars->row_bytes) + 2 * vars->row_bytes;
+    vars->buffer = (Uint8 *)SDL_calloc(1, size);
+    if (!vars->buffer) {
+        return false;
+    }
+    vars->input = vars->buffer;
+    vars->window = vars->input + PNG_READ_SIZE;
+    vars->scanline = vars->window + TINFL_LZ_DICT_SIZE;
+    vars->rows[0] = vars->scanline + 1 + vars->row_bytes;
+    vars->rows[1] = vars->rows[0] + vars->row_bytes;
+    tinfl_init(&vars->inflator);
+    return true;
+}
+
+/* Read the data of a chunk into a buffer and verify its CRC */
+static bool MINIZ_ReadChunkData(SDL_IOStream *src, struct loadpng_miniz_vars *vars, const Uint8 *header, Uint8 *data, Uint32 length)
+{
+    Uint8 footer[4];
+
+    if (SDL_ReadIO(src, data, length) != length ||
+        SDL_ReadIO(src, footer, sizeof(footer)) != sizeof(footer)) {
+        vars->error = "Unexpected end of PNG file";
+        return false;
+    }
+    if (!vars->skip_checksums) {
+        Uint32 crc = MINIZ_CRC32(0, header + 4, 4);
+
+        crc = MINIZ_CRC32(crc, data, length);
+        if (crc != APNG_Read32(footer)) {
+            vars->error = "PNG chunk CRC mismatch";
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Stream the data of an IDAT chunk through the inflater */
+static bool MINIZ_ReadIDAT(SDL_IOStream *src, struct loadpng_miniz_vars *vars, const Uint8 *header, Uint32 length)
+{
+    Uint8 footer[4];
+    Uint32 crc = 0;
+
+    if (!vars->skip_checksums) {
+        crc = MINIZ_CRC32(0, header + 4, 4);
+    }
+
+    while (length > 0) {
+        size_t amount = SDL_min(length, (Uint32)PNG_READ_SIZE);
+
+        if (SDL_ReadIO(src, vars->input, amount) != amount) {
+            vars->error = "Unexpected end of PNG file";
+            return false;
+        }
+        if (!vars->skip_checksums) {
+            crc = MINIZ_CRC32(crc, vars->input, amount);
+        }
+        if (!MINIZ_Inflate(vars, vars->input, amount)) {
+            return false;
+        }
+        length -= (Uint32)amount;
+    }
+
+    if (SDL_ReadIO(src, footer, sizeof(footer)) != sizeof(footer)) {
+        vars->error = "Unexpected end of PNG file";
+        return false;
+    }
+    if (!vars->skip_checksums && crc != APNG_Read32(footer)) {
+        vars->error = "PNG chunk CRC mismatch";
+        return false;
+    }
+    return true;
+}
+
+static bool MINIZ_ReadChunks(SDL_IOStream *src, struct loadpng_miniz_vars *vars)
+{
+    Uint8 signature[8];
+    Uint8 header[8];
+    Uint8 data[768];
+    Uint32 type, length;
+    int i;
+
+    if (SDL_ReadIO(src, signature, sizeof(signature)) != sizeof(signature) ||
+        SDL_memcmp(signature, png_signature, sizeof(signature)) != 0) {
+        vars->error = "Not a PNG file";
+        return false;
+    }
+
+    /* The IHDR chunk has to come first, anything else (e.g. Apple's CgBI) is left to stb_image */
+    if (SDL_ReadIO(src, header, sizeof(header)) != sizeof(header) ||
+        APNG_Read32(header) != 13 || APNG_Read32(header + 4) != APNG_CHUNK('I', 'H', 'D', 'R')) {
+        vars->fallback = true;
+        return false;
+    }
+    if (!MINIZ_ReadChunkData(src, vars, header, data, 13) ||
+        !MINIZ_ReadIHDR(vars, data)) {
+        return false;
+    }
+
+    /* Unused palette entries will be opaque white */
+    for (i = 0; i < (int)SDL_arraysize(vars->palette); ++i) {
+        vars->palette[i].r = 0xff;
+        vars->palette[i].g = 0xff;
+        vars->palette[i].b = 0xff;
+        vars->palette[i].a = SDL_ALPHA_OPAQUE;
+    }
+
+    for (;;) {
+        if (SDL_ReadIO(src, header, sizeof(header)) != sizeof(header)) {
+            vars->error = "Unexpected end of PNG file";
+            return false;
+        }
+        length = APNG_Read32(header);
+        type = APNG_Read32(header + 4);
+        if (length > 0x7FFFFFFF) {
+            vars->error = "Invalid PNG chunk length";
+            return false;
+        }
+
+        switch (type) {
+        case APNG_CHUNK('I', 'D', 'A', 'T'):
+            if (!vars->surface && !MINIZ_CreateSurface(vars)) {
+                return false;
+            }
+            if (!MINIZ_ReadIDAT(src, vars, header, length)) {
+                return false;
+            }
+            break;
+
+        case APNG_CHUNK('P', 'L', 'T', 'E'):
+            if (length > sizeof(data) || (length % 3) != 0) {
+                vars->error = "Invalid PLTE chunk in PNG file";
+                return false;
+            }
+            if (!MINIZ_ReadChunkData(src, vars, header, data, length)) {
+                return false;
+            }
+            for (i = 0; i < (int)(length / 3); ++i) {
+                vars->palette[i].r = data[i * 3 + 0];
+                vars->palette[i].g = data[i * 3 + 1];
+                vars->palette[i].b = data[i * 3 + 2];
+            }
+            vars->has_palette = true;
+            break;
+
+        case APNG_CHUNK('t', 'R', 'N', 'S'):
+            if (length > sizeof(data)) {
+                vars->error = "Invalid tRNS chunk in PNG file";
+                return false;
+            }
+            if (!MINIZ_ReadChunkData(src, vars, header, data, length)) {
+                return false;
+            }
+            if (vars->surface) {
+                /* Too late to affect the image, ignore it */
+                break;
+            }
+            if (vars->color_type == PNG_COLOR_PALETTE && length <= 256) {
+                for (i = 0; i < (int)length; ++i) {
+                    vars->palette[i].a = data[i];
+                }
+                vars->has_trns = true;
+            } else if (vars->color_type == PNG_COLOR_GRAY && length == 2) {
+                vars->trns[0] = (Uint16)((data[0] << 8) | data[1]);
+                vars->has_trns = true;
+            } else if (vars->color_type == PNG_COLOR_RGB && length == 6) {
+                for (i = 0; i < 3; ++i) {
+                    vars->trns[i] = (Uint16)((data[i * 2] << 8) | data[i * 2 + 1]);
+                }
+                vars->has_trns = true;
+            }
+            break;
+
+        case APNG_CHUNK('I', 'E', 'N', 'D'):
+            if (vars->y != vars->h) {
+                vars->error = "Not enough PNG image data";
+                return false;
+            }
+            /* Leave the stream at the end of the image */
+            SDL_SeekIO(src, (Sint64)length + 4, SDL_IO_SEEK_CUR);
+            return true;
+
+        default:
+            if (!(type & 0x20000000)) {
+                /* A critical chunk we don't know about */
+                vars->fallback = true;
+                return false;
+            }
+            if (SDL_SeekIO(src, (Sint64)length + 4, SDL_IO_SEEK_CUR) < 0) {
+                vars->error = "Unexpected end of PNG file";
+                return false;
+            }
+            break;
+        }
+    }
+}
+
+static SDL_Surface *MINIZ_LoadPNG_IO(SDL_IOStream *src)
+{
+    Sint64 start;
+    struct loadpng_miniz_vars *vars;
+    SDL_Surface *surface = NULL;
+    bool fallback = false;
+
+    if (!src) {
+        /* The error message has been set in SDL_IOFromFile */
+        return NULL;
+    }
+    start = SDL_TellIO(src);
+
+    MINIZ_InitCRC32();
+
+    /* The inflater is too big to live on the stack */
+    vars = (struct loadpng_miniz_vars *)SDL_calloc(1, sizeof(*vars));
+    if (!vars) {
+        return NULL;
+    }
+    vars->skip_checksums = SDL_GetHintBoolean(IMG_HINT_PNG_SKIP_CHECKSUMS, false);
+    if (vars->skip_checksums) {
+        vars->zlib_header = 2;
+    }
+
+    if (MINIZ_ReadChunks(src, vars)) {
+        surface = vars->surface;
+        vars->surface = NULL;
+    } else {
+        fallback = vars->fallback;
+        SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
+        if (vars->error) {
+            SDL_SetError("%s", vars->error);
+        }
+        SDL_DestroySurface(vars->surface);
+    }
+    SDL_free(vars->buffer);
+    SDL_free(vars);
+
+    if (fallback) {
+        surface = IMG_LoadSTB_IO(src);
+    }
+    return surface;
+}
+
+#endif /* LOAD_PNG && USE_STBIMAGE */
+
+/* Encoder settings, filled in from IMG_PROP_PNG_SAVE_* properties */
+struct savepng_options
+{
+    int level;
+    IMG_PNGStrategy strategy;
+    IMG_PNGFilter filter;
+    int threads;
+    int palette_colors;
+    IMG_DitherMode dither;
+};
+
+#if SDL_IMAGE_SAVE_PNG
+
+static const Uint32 png_format = SDL_PIXELFORMAT_RGBA32;
+
+/* The smallest PNG bit depth that can hold indices into a palette */
+static int PNG_GetPaletteDepth(int ncolors)
+{
+    if (ncolors <= 2) {
+        return 1;
+    } else if (ncolors <= 4) {
+        return 2;
+    } else if (ncolors <= 16) {
+        return 4;
+    } else {
+        return 8;
+    }
+}
+
+/* Reduce a surface to an 8-bit palette of at most max_colors colors */
+static SDL_Surface *PNG_QuantizeSurface(SDL_Surface *surface, int max_colors, IMG_DitherMode dither)
+{
+    SDL_Color colors[256];
+    SDL_Surface *rgba = surface;
+    SDL_Surface *result = NULL;
+    SDL_Palette *palette;
+    int ncolors;
+
+    if (surface->format != SDL_PIXELFORMAT_RGBA32 || SDL_MUSTLOCK(surface)) {
+        rgba = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+        if (!rgba) {
+            return NULL;
+        }
+    }
+
+    result = SDL_CreateSurface(surface->w, surface->h, SDL_PIXELFORMAT_INDEX8);
+    if (!result) {
+        goto done;
+    }
+    ncolors = IMG_QuantizePixels(rgba, result, colors, max_colors, dither, 0, 0);
+    palette = (ncolors > 0) ? SDL_CreatePalette(ncolors) : NULL;
+    if (!palette) {
+        SDL_DestroySurface(result);
+        result = NULL;
+        goto done;
+    }
+    SDL_SetPaletteColors(palette, colors, 0, ncolors);
+    SDL_SetSurfacePalette(result, palette);
+    SDL_DestroyPalette(palette);
+
+done:
+    if (rgba != surface) {
+        SDL_DestroySurface(rgba);
+    }
+    return result;
+}
+
+#ifdef USE_LIBPNG
+
+static void png_write_data(png_structp png_ptr, png_bytep src, png_size_t size)
+{
+    SDL_IOStream *dst = (SDL_IOStream *)lib.png_get_io_ptr(png_ptr);
+    SDL_WriteIO(dst, src, size);
+}
+
+static void png_flush_data(png_structp png_ptr)
+{
+    (void)png_ptr;
+}
+
+struct savepng_vars {
+    png_structp png_ptr;
+    png_infop info_ptr;
+    const char *error;
+    png_colorp color_ptr;
+    png_bytep *row_pointers;
+    SDL_Surface *source;
+    int bit_depth;
+    int transforms;
+};
+
+static int LIBPNG_GetStrategy(IMG_PNGStrategy strategy)
+{
+    /* These are the zlib Z_* strategy values, zlib.h isn't included by every version of png.h */
+    switch (strategy) {
+    case IMG_PNG_STRATEGY_FILTERED:
+        return 1;
+    case IMG_PNG_STRATEGY_HUFFMAN_ONLY:
+        return 2;
+    case IMG_PNG_STRATEGY_RLE:
+        return 3;
+    case IMG_PNG_STRATEGY_FIXED:
+        return 4;
+    default:
+        return 0;
+    }
+}
+
+static int LIBPNG_GetFilters(IMG_PNGFilter filter)
+{
+    switch (filter) {
+    case IMG_PNG_FILTER_NONE:
+        return PNG_FILTER_NONE;
+    case IMG_PNG_FILTER_SUB:
+        return PNG_FILTER_SUB;
+    case IMG_PNG_FILTER_UP:
+        return PNG_FILTER_UP;
+    case IMG_PNG_FILTER_AVERAGE:
+        return PNG_FILTER_AVG;
+    case IMG_PNG_FILTER_PAETH:
+        return PNG_FILTER_PAETH;
+    default:
+        return PNG_ALL_FILTERS;
+    }
+}
+
+/* Get the color type and write transforms for the formats libpng can take without conversion */
+static bool LIBPNG_GetSaveLayout(SDL_PixelFormat format, int *color_type, int *transforms)
+{
+    switch (format) {
+    case SDL_PIXELFORMAT_RGB24:
+        *color_type = PNG_COLOR_TYPE_RGB;
+        *transforms = PNG_TRANSFORM_IDENTITY;
+        return true;
+    case SDL_PIXELFORMAT_BGR24:
+        *color_type = PNG_COLOR_TYPE_RGB;
+        *transforms = PNG_TRANSFORM_BGR;
+        return true;
+    case SDL_PIXELFORMAT_RGBA32:
+        *color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+        *transforms = PNG_TRANSFORM_IDENTITY;
+        return true;
+    case SDL_PIXELFORMAT_BGRA32:
+        *color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+        *transforms = PNG_TRANSFORM_BGR;
+        return true;
+    case SDL_PIXELFORMAT_ARGB32:
+        *color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+        *transforms = PNG_TRANSFORM_SWAP_ALPHA;
+        return true;
+    case SDL_PIXELFORMAT_ABGR32:
+        *color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+        *transforms = PNG_TRANSFORM_BGR | PNG_TRANSFORM_SWAP_ALPHA;
+        return true;
+    case SDL_PIXELFORMAT_RGBX32:
+        *color_type = PNG_COLOR_TYPE_RGB;
+        *transforms = PNG_TRANSFORM_STRIP_FILLER_AFTER;
+        return true;
+    case SDL_PIXELFORMAT_BGRX32:
+        *color_type = PNG_COLOR_TYPE_RGB;
+        *transforms = PNG_TRANSFORM_BGR | PNG_TRANSFORM_STRIP_FILLER_AFTER;
+        return true;
+    case SDL_PIXELFORMAT_XRGB32:
+        *color_type = PNG_COLOR_TYPE_RGB;
+        *transforms = PNG_TRANSFORM_STRIP_FILLER_BEFORE;
+        return true;
+    case SDL_PIXELFORMAT_XBGR32:
+        *color_type = PNG_COLOR_TYPE_RGB;
+        *transforms = PNG_TRANSFORM_BGR | PNG_TRANSFORM_STRIP_FILLER_BEFORE;
+        return true;
+    default:
+        return false;
+    }
+}
+
+static bool LIBPNG_SavePNG_IO(struct savepng_vars *vars, SDL_Surface *surface, SDL_IOStream *dst, const struct savepng_options *options)
+{
+    Uint8 transparent_table[256];
+    SDL_Palette *palette;
+    int png_color_type;
+
+    vars->source = surface;
+    vars->bit_depth = 8;
+    vars->transforms = PNG_TRANSFORM_IDENTITY;
+
+    vars->png_ptr = lib.png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if (vars->png_ptr == NULL) {
+        vars->error = "Couldn't allocate memory for PNG file or incompatible PNG dll";
+        return false;
+    }
+
+    vars->info_ptr = lib.png_create_info_struct(vars->png_ptr);
+    if (vars->info_ptr == NULL) {
+        vars->error = "Couldn't create image information for PNG file";
+        return false;
+    }
+#ifdef PNG_SETJMP_SUPPORTED
+#ifndef LIBPNG_VERSION_12
+    if (setjmp(*lib.png_set_longjmp_fn(vars->png_ptr, longjmp, sizeof (jmp_buf))))
+#else
+    if (setjmp(vars->png_ptr->jmpbuf))
+#endif
+#endif
+    {
+        vars->error = "Error writing the PNG file.";
+        return false;
+    }
+
+    palette = SDL_GetSurfacePalette(surface);
+    if (palette) {
+        const int ncolors = palette->ncolors;
+        int i;
+        int last_transparent = -1;
+
+        vars->color_ptr = (png_colorp)SDL_malloc(sizeof(png_color) * ncolors);
+        if (vars->color_ptr == NULL) {
+            vars->error = "Couldn't create palette for PNG file";
+            return false;
+        }
+        for (i = 0; i < ncolors; i++) {
+            vars->color_ptr[i].red = palette->colors[i].r;
+            vars->color_ptr[i].green = palette->colors[i].g;
+            vars->color_ptr[i].blue = palette->colors[i].b;
+            if (palette->colors[i].a != 255) {
+                last_transparent = i;
+            }
+        }
+        lib.png_set_PLTE(vars->png_ptr, vars->info_ptr, vars->color_ptr, ncolors);
+        png_color_type = PNG_COLOR_TYPE_PALETTE;
+
+        if (surface->format == SDL_PIXELFORMAT_INDEX8) {
+            /* Small palettes are written with fewer bits per pixel, libpng packs the indices */
+            vars->bit_depth = PNG_GetPaletteDepth(ncolors);
+            if (vars->bit_depth < 8) {
+                vars->transforms |= PNG_TRANSFORM_PACKING;
+            }
+        }
+
+        if (last_transparent >= 0) {
+            for (i = 0; i <= last_transparent; ++i) {
+                transparent_table[i] = palette->colors[i].a;
+            }
+            lib.png_set_tRNS(vars->png_ptr, vars->info_ptr, transparent_table, last_transparent + 1, NULL);
+        }
+    }
+    else if (LIBPNG_GetSaveLayout(surface->format, &png_color_type, &vars->transforms)) {
+        /* If libpng can reorder or strip the channels itself, the surface is just passed through */
+    }
+    else if (!SDL_ISPIXELFORMAT_ALPHA(surface->format)) {
+        /* If the surface is not exactly the right RGB format but does not have alpha
+           information, it should be converted to RGB24 before being passed through */
+        png_color_type = PNG_COLOR_TYPE_RGB;
+        vars->source = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGB24);
+    }
+    else {
+        /* Otherwise, (surface has alpha data), and it is not in the exact right
+           format , so it should be converted to that */
+        png_color_type = PNG_COLOR_TYPE_RGB_ALPHA;
+        vars->source = SDL_ConvertSurface(surface, png_format);
+    }
+
+    lib.png_set_write_fn(vars->png_ptr, dst, png_write_data, png_flush_data);
+
+    lib.png_set_IHDR(vars->png_ptr, vars->info_ptr, surface->w, surface->h,
+                     vars->bit_depth, png_color_type, PNG_INTERLACE_NONE,
+                     PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+
+    lib.png_set_compression_level(vars->png_ptr, options->level);
+    if (options->strategy != IMG_PNG_STRATEGY_DEFAULT) {
+        lib.png_set_compression_strategy(vars->png_ptr, LIBPNG_GetStrategy(options->strategy));
+    }
+    if (options->filter != IMG_PNG_FILTER_DEFAULT) {
+        lib.png_set_filter(vars->png_ptr, PNG_FILTER_TYPE_BASE, LIBPNG_GetFilters(options->filter));
+    }
+
+    if (vars->source) {
+        int row;
+        vars->row_pointers = (png_bytep *) SDL_malloc(sizeof(png_bytep) * vars->source->h);
+        if (!vars->row_pointers) {
+            vars->error = "Out of memory";
+            return false;
+        }
+        for (row = 0; row < (int)vars->source->h; row++) {
+            vars->row_pointers[row] = (png_bytep) (Uint8 *) vars->source->pixels + row * vars->source->pitch;
+        }
+
+        lib.png_set_rows(vars->png_ptr, vars->info_ptr, vars->row_pointers);
+        lib.png_write_png(vars->png_ptr, vars->info_ptr, vars->transforms, NULL);
+    }
+
+    return true;
+}
+
+static bool IMG_SavePNG_IO_libpng(SDL_Surface *surface, SDL_IOStream *dst, const struct savepng_options *options)
+{
+    struct savepng_vars vars;
+    bool result;
+
+    if (!IMG_InitPNG()) {
+        return false;
+    }
+
+    SDL_zero(vars);
+    result = LIBPNG_SavePNG_IO(&vars, surface, dst, options);
 
     if (vars.png_ptr) {
         lib.png_destroy_write_struct(&vars.png_ptr, &vars.info_ptr);
@@ -726,88 +2466,641 @@ static bool IMG_SavePNG_IO_libpng(SDL_Surface *surface, SDL_IOStream *dst)
 
 #endif /* USE_LIBPNG */
 
-#if defined(LOAD_PNG_DYNAMIC) || !defined(WANT_LIBPNG)
-/* Replace C runtime functions with SDL C runtime functions for building on Windows */
-#define MINIZ_NO_STDIO
-#define MINIZ_NO_TIME
-#define MINIZ_SDL_MALLOC
-#define MZ_ASSERT(x) SDL_assert(x)
-#undef memcpy
-#define memcpy  SDL_memcpy
-#undef memset
-#define memset  SDL_memset
-#if SDL_BYTEORDER == SDL_LIL_ENDIAN
-#define MINIZ_LITTLE_ENDIAN 1
-#else
-#define MINIZ_LITTLE_ENDIAN 0
-#endif
-#define MINIZ_USE_UNALIGNED_LOADS_AND_STORES 0
-#define MINIZ_SDL_NOUNUSED
-#include "miniz.h"
+/* Streaming and parallel encoding
+ *
+ * Rows are converted to RGBA and filtered one at a time, so the image is
+ * never copied as a whole. With a single thread the compressed data is
+ * written out as IDAT chunks as soon as a chunk's worth is available.
+ *
+ * With more threads, the image is cut into horizontal stripes of rows, which
+ * are filtered and deflated independently as raw deflate data into memory.
+ * Filtering only looks at the row above, which is always available, so it
+ * gives the same result as a single pass. Every stripe but the last ends
+ * with a sync flush, leaving it byte aligned without a final block, so the
+ * stripes can be concatenated into one zlib stream like pigz does. The
+ * Adler-32 checksums of the stripes are combined for the zlib trailer.
+ */
+#define MIN_STRIPE_BYTES (256 * 1024)
+#define IDAT_CHUNK_SIZE (64 * 1024)
+
+/* The number of dictionary probes for each compression level, as used by tdefl_create_comp_flags_from_zip_params() */
+static const mz_uint png_num_probes[10] = { 0, 1, 6, 32, 16, 32, 128, 256, 512, 768 };
+
+/* Compressed data, written as IDAT chunks to dst when it fills up, or kept in memory if dst is NULL */
+struct savepng_output
+{
+    SDL_IOStream *dst;
+    Uint8 *data;
+    size_t size;
+    size_t capacity;
+};
+
+struct savepng_stripe
+{
+    int y;
+    int h;
+    struct savepng_output output;
+    Uint32 adler;
+    bool result;
+};
+
+struct savepng_stripes
+{
+    SDL_Surface *surface;
+    int depth;          /* 32 for RGBA rows, or the bit depth of palette rows */
+    int bpp;            /* bytes per complete pixel, as used by the row filters */
+    int row_length;
+    struct savepng_stripe *stripes;
+    int count;
+    SDL_AtomicInt next;
+    const struct savepng_options *options;
+};
+
+static mz_uint MINIZ_GetCompressionFlags(const struct savepng_options *options)
+{
+    mz_uint flags = png_num_probes[options->level] | TDEFL_COMPUTE_ADLER32;
+
+    if (options->level == 0) {
+        return flags | TDEFL_FORCE_ALL_RAW_BLOCKS;
+    }
+    if (options->level <= 3) {
+        flags |= TDEFL_GREEDY_PARSING_FLAG;
+    }
+    switch (options->strategy) {
+    case IMG_PNG_STRATEGY_FILTERED:
+        flags |= TDEFL_FILTER_MATCHES;
+        break;
+    case IMG_PNG_STRATEGY_HUFFMAN_ONLY:
+        flags &= ~TDEFL_MAX_PROBES_MASK;
+        break;
+    case IMG_PNG_STRATEGY_RLE:
+        flags |= TDEFL_RLE_MATCHES;
+        break;
+    case IMG_PNG_STRATEGY_FIXED:
+        flags |= TDEFL_FORCE_ALL_STATIC_BLOCKS;
+        break;
+    default:
+        break;
+    }
+    return flags;
+}
+
+static Uint8 MINIZ_Paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = SDL_abs(p - a);
+    int pb = SDL_abs(p - b);
+    int pc = SDL_abs(p - c);
+
+    if (pa <= pb && pa <= pc) {
+        return (Uint8)a;
+    } else if (pb <= pc) {
+        return (Uint8)b;
+    } else {
+        return (Uint8)c;
+    }
+}
+
+/* Filter a row with the given PNG filter type, writing the filter byte followed by the filtered data */
+static void MINIZ_FilterRow(int type, const Uint8 *row, const Uint8 *prev, int bpp, int length, Uint8 *out)
+{
+    int i;
+
+    *out++ = (Uint8)type;
+    switch (type) {
+    case 1:
+        for (i = 0; i < length; ++i) {
+            out[i] = (Uint8)(row[i] - (i >= bpp ? row[i - bpp] : 0));
+        }
+        break;
+    case 2:
+        for (i = 0; i < length; ++i) {
+            out[i] = (Uint8)(row[i] - prev[i]);
+        }
+        break;
+    case 3:
+        for (i = 0; i < length; ++i) {
+            out[i] = (Uint8)(row[i] - (((i >= bpp ? row[i - bpp] : 0) + prev[i]) >> 1));
+        }
+        break;
+    case 4:
+        for (i = 0; i < length; ++i) {
+            if (i >= bpp) {
+                out[i] = (Uint8)(row[i] - MINIZ_Paeth(row[i - bpp], prev[i], prev[i - bpp]));
+            } else {
+                out[i] = (Uint8)(row[i] - prev[i]);
+            }
+        }
+        break;
+    default:
+        SDL_memcpy(out, row, length);
+        break;
+    }
+}
+
+/* The usual heuristic for adaptive filtering: the sum of the filtered bytes taken as signed values */
+static Uint32 MINIZ_FilterCost(const Uint8 *filtered, int length)
+{
+    Uint32 cost = 0;
+    int i;
+
+    for (i = 0; i < length; ++i) {
+        cost += (Uint32)SDL_abs((Sint8)filtered[i]);
+    }
+    return cost;
+}
+
+/* Filter a row as requested by the options, returns the buffer holding the result */
+static const Uint8 *MINIZ_FilterImageRow(IMG_PNGFilter filter, const Uint8 *row, const Uint8 *prev, int bpp, int length, Uint8 *buffer, Uint8 *scratch)
+{
+    if (filter == IMG_PNG_FILTER_ADAPTIVE) {
+        Uint8 *best = buffer;
+        Uint8 *candidate = scratch;
+        Uint32 best_cost = 0;
+        int type;
+
+        for (type = 0; type <= 4; ++type) {
+            Uint32 cost;
+
+            MINIZ_FilterRow(type, row, prev, bpp, length, candidate);
+            cost = MINIZ_FilterCost(candidate + 1, length);
+            if (type == 0 || cost < best_cost) {
+                Uint8 *swap = best;
+                best = candidate;
+                candidate = swap;
+                best_cost = cost;
+            }
+        }
+        return best;
+    } else {
+        int type = 0;
+
+        switch (filter) {
+        case IMG_PNG_FILTER_SUB:
+            type = 1;
+            break;
+        case IMG_PNG_FILTER_UP:
+            type = 2;
+            break;
+        case IMG_PNG_FILTER_AVERAGE:
+            type = 3;
+            break;
+        case IMG_PNG_FILTER_PAETH:
+            type = 4;
+            break;
+        default:
+            break;
+        }
+        MINIZ_FilterRow(type, row, prev, bpp, length, buffer);
+        return buffer;
+    }
+}
+
+static bool MINIZ_WriteChunk(SDL_IOStream *dst, const char *type, const Uint8 *data, size_t length)
+{
+    Uint32 crc;
+
+    crc = SDL_crc32(0, type, 4);
+    crc = SDL_crc32(crc, data, length);
+    return SDL_WriteU32BE(dst, (Uint32)length) &&
+           SDL_WriteIO(dst, type, 4) == 4 &&
+           SDL_WriteIO(dst, data, length) == length &&
+           SDL_WriteU32BE(dst, crc);
+}
+
+static bool MINIZ_FlushOutput(struct savepng_output *output)
+{
+    size_t offset = 0;
+
+    /* Chunks are limited to 2^31-1 bytes, a stripe kept in memory may need several */
+    while (offset < output->size) {
+        size_t length = SDL_min(output->size - offset, 0x40000000);
+
+        if (!MINIZ_WriteChunk(output->dst, "IDAT", output->data + offset, length)) {
+            return false;
+        }
+        offset += length;
+    }
+    output->size = 0;
+    return true;
+}
+
+static mz_bool MINIZ_PutOutput(const void *data, int len, void *userdata)
+{
+    struct savepng_output *output = (struct savepng_output *)userdata;
+    const Uint8 *bytes = (const Uint8 *)data;
+    size_t length = (size_t)len;
+
+    while (length > 0) {
+        size_t count;
+
+        if (output->size == output->capacity) {
+            if (output->dst) {
+                if (!MINIZ_FlushOutput(output)) {
+                    return MZ_FALSE;
+                }
+            } else {
+                size_t capacity = SDL_max(output->capacity * 2, IDAT_CHUNK_SIZE);
+                Uint8 *buffer = (Uint8 *)SDL_realloc(output->data, capacity);
+                if (!buffer) {
+                    return MZ_FALSE;
+                }
+                output->data = buffer;
+                output->capacity = capacity;
+            }
+        }
+        count = SDL_min(length, output->capacity - output->size);
+        SDL_memcpy(output->data + output->size, bytes, count);
+        output->size += count;
+        bytes += count;
+        length -= count;
+    }
+    return MZ_TRUE;
+}
+
+/* Get a row of the image as RGBA or packed palette indices, converting it into buffer if needed */
+static const Uint8 *MINIZ_GetRow(struct savepng_stripes *ctx, int y, Uint8 *buffer)
+{
+    SDL_Surface *surface = ctx->surface;
+    const Uint8 *row = (const Uint8 *)surface->pixels + y * surface->pitch;
+
+    if (surface->format == png_format || ctx->depth == 8) {
+        return row;
+    }
+    if (ctx->depth < 8) {
+        int x;
+
+        SDL_memset(buffer, 0, ctx->row_length);
+        for (x = 0; x < surface->w; ++x) {
+            int bit = x * ctx->depth;
+            buffer[bit >> 3] |= (Uint8)(row[x] << (8 - ctx->depth - (bit & 7)));
+        }
+        return buffer;
+    }
+    if (!SDL_ConvertPixels(surface->w, 1, surface->format, row, surface->pitch, png_format, buffer, surface->w * 4)) {
+        return NULL;
+    }
+    return buffer;
+}
+
+static bool MINIZ_EncodeStripe(struct savepng_stripes *ctx, struct savepng_stripe *stripe)
+{
+    SDL_Surface *surface = ctx->surface;
+    int bpp = ctx->bpp;
+    int length = ctx->row_length;
+    bool last = (stripe->y + stripe->h == surface->h);
+    tdefl_compressor *compressor;
+    Uint8 *buffer, *rows[2];
+    const Uint8 *prev;
+    bool result = false;
+    int y;
+
+    compressor = (tdefl_compressor *)SDL_malloc(sizeof(*compressor));
+    buffer = (Uint8 *)SDL_calloc(2, (1 + length) + length);
+    if (!compressor || !buffer) {
+        goto done;
+    }
+    rows[0] = buffer + 2 * (1 + length);
+    rows[1] = rows[0] + length;
+
+    if (stripe->y > 0) {
+        prev = MINIZ_GetRow(ctx, stripe->y - 1, rows[1]);
+        if (!prev) {
+            goto done;
+        }
+    } else {
+        /* The row above the image is all zero */
+        prev = rows[1];
+    }
+
+    if (tdefl_init(compressor, MINIZ_PutOutput, &stripe->output, (int)MINIZ_GetCompressionFlags(ctx->options)) != TDEFL_STATUS_OKAY) {
+        goto done;
+    }
+    for (y = stripe->y; y < stripe->y + stripe->h; ++y) {
+        /* Convert into whichever buffer doesn't hold the previous row */
+        const Uint8 *row = MINIZ_GetRow(ctx, y, (prev == rows[0]) ? rows[1] : rows[0]);
+        const Uint8 *filtered;
+
+        if (!row) {
+            goto done;
+        }
+        filtered = MINIZ_FilterImageRow(ctx->options->filter, row, prev, bpp, length, buffer, buffer + 1 + length);
+        if (tdefl_compress_buffer(compressor, filtered, 1 + length, TDEFL_NO_FLUSH) != TDEFL_STATUS_OKAY) {
+            goto done;
+        }
+        prev = row;
+    }
+    if (last) {
+        result = (tdefl_compress_buffer(compressor, NULL, 0, TDEFL_FINISH) == TDEFL_STATUS_DONE);
+    } else {
+        result = (tdefl_compress_buffer(compressor, NULL, 0, TDEFL_SYNC_FLUSH) == TDEFL_STATUS_OKAY);
+    }
+    stripe->adler = compressor->m_adler32;
+
+done:
+    SDL_free(compressor);
+    SDL_free(buffer);
+    return result;
+}
+
+static int SDLCALL MINIZ_EncodeStripes(void *data)
+{
+    struct savepng_stripes *ctx = (struct savepng_stripes *)data;
+    int i;
+
+    while ((i = SDL_AddAtomicInt(&ctx->next, 1)) < ctx->count) {
+        struct savepng_stripe *stripe = &ctx->stripes[i];
+        stripe->result = MINIZ_EncodeStripe(ctx, stripe);
+    }
+    return 0;
+}
+
+/* Combine the Adler-32 of two blocks of data, the same way as zlib's adler32_combine() */
+static Uint32 MINIZ_CombineAdler32(Uint32 adler1, Uint32 adler2, Uint64 length2)
+{
+    const Uint32 base = 65521;
+    Uint32 rem = (Uint32)(length2 % base);
+    Uint32 sum1 = adler1 & 0xFFFF;
+    Uint32 sum2 = (Uint32)(((Uint64)rem * sum1) % base);
+
+    sum1 += (adler2 & 0xFFFF) + base - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + base - rem;
+    if (sum1 >= base) {
+        sum1 -= base;
+    }
+    if (sum1 >= base) {
+        sum1 -= base;
+    }
+    if (sum2 >= (base << 1)) {
+        sum2 -= (base << 1);
+    }
+    if (sum2 >= base) {
+        sum2 -= base;
+    }
+    return sum1 | (sum2 << 16);
+}
+
+static int MINIZ_GetNumThreads(SDL_Surface *surface, const struct savepng_options *options)
+{
+    Uint64 size = (Uint64)surface->h * surface->w * 4;
+    int num_threads = options->threads;
+
+    if (num_threads <= 0) {
+        num_threads = SDL_GetNumLogicalCPUCores();
+    }
+    return (int)SDL_min((Uint64)num_threads, SDL_max(size / MIN_STRIPE_BYTES, 1));
+}
 
-static bool IMG_SavePNG_IO_miniz(SDL_Surface *surface, SDL_IOStream *dst)
+static bool IMG_SavePNG_IO_miniz(SDL_Surface *surface, SDL_IOStream *dst, const struct savepng_options *options)
 {
-    size_t size = 0;
-    void *png = NULL;
+    static const Uint8 iend[1] = { 0 };
+    struct savepng_stripes ctx;
+    SDL_Thread **threads = NULL;
+    SDL_Surface *source = surface;
+    SDL_Palette *palette = NULL;
+    Uint8 ihdr[13], header[2], trailer[4];
+    Uint8 plte[3 * 256], trns[256];
+    int num_trans = 0;
+    Uint32 adler = 1;
+    Sint64 start = -1;
+    int num_threads, stripe_rows, level, i;
     bool result = false;
 
     if (!dst) {
         return SDL_SetError("Passed NULL dst");
     }
 
-    if (surface->format == png_format) {
-        png = tdefl_write_image_to_png_file_in_memory(surface->pixels, surface->w, surface->h, SDL_BYTESPERPIXEL(surface->format), surface->pitch, &size);
+    /* Rows are converted as they're encoded, unless that takes more than the pixel data,
+     * or the surface has a high dynamic range and needs its colorspace taken into account */
+    if (surface->format == SDL_PIXELFORMAT_INDEX8 && !SDL_SurfaceHasColorKey(surface) && !SDL_MUSTLOCK(surface)) {
+        palette = SDL_GetSurfacePalette(surface);
+    }
+    if (!palette &&
+        (SDL_ISPIXELFORMAT_INDEXED(surface->format) || SDL_ISPIXELFORMAT_FOURCC(surface->format) ||
+         SDL_ISPIXELFORMAT_10BIT(surface->format) || SDL_ISPIXELFORMAT_FLOAT(surface->format) ||
+         SDL_SurfaceHasColorKey(surface) || SDL_MUSTLOCK(surface))) {
+        source = SDL_ConvertSurface(surface, png_format);
+        if (!source) {
+            return false;
+        }
+    }
+
+    num_threads = MINIZ_GetNumThreads(source, options);
+    stripe_rows = SDL_max((source->h + num_threads - 1) / num_threads, 1);
+
+    SDL_zero(ctx);
+    ctx.surface = source;
+    if (palette) {
+        ctx.depth = PNG_GetPaletteDepth(palette->ncolors);
+        ctx.bpp = 1;
     } else {
-        SDL_Surface *cvt = SDL_ConvertSurface(surface, png_format);
-        if (cvt) {
-            png = tdefl_write_image_to_png_file_in_memory(cvt->pixels, cvt->w, cvt->h, SDL_BYTESPERPIXEL(cvt->format), cvt->pitch, &size);
-            SDL_DestroySurface(cvt);
+        ctx.depth = 32;
+        ctx.bpp = 4;
+    }
+    ctx.row_length = (source->w * ctx.depth + 7) / 8;
+    ctx.count = (source->h + stripe_rows - 1) / stripe_rows;
+    ctx.options = options;
+    ctx.stripes = (struct savepng_stripe *)SDL_calloc(ctx.count, sizeof(*ctx.stripes));
+    threads = (SDL_Thread **)SDL_calloc(num_threads, sizeof(*threads));
+    if (!ctx.stripes || !threads) {
+        goto done;
+    }
+    for (i = 0; i < ctx.count; ++i) {
+        ctx.stripes[i].y = i * stripe_rows;
+        ctx.stripes[i].h = SDL_min(stripe_rows, source->h - ctx.stripes[i].y);
+    }
+
+    ihdr[0] = (Uint8)(source->w >> 24);
+    ihdr[1] = (Uint8)(source->w >> 16);
+    ihdr[2] = (Uint8)(source->w >> 8);
+    ihdr[3] = (Uint8)source->w;
+    ihdr[4] = (Uint8)(source->h >> 24);
+    ihdr[5] = (Uint8)(source->h >> 16);
+    ihdr[6] = (Uint8)(source->h >> 8);
+    ihdr[7] = (Uint8)source->h;
+    ihdr[8] = (Uint8)(palette ? ctx.depth : 8);    /* bit depth */
+    ihdr[9] = (Uint8)(palette ? 3 : 6);             /* palette or RGBA color type */
+    ihdr[10] = 0;   /* compression method */
+    ihdr[11] = 0;   /* filter method */
+    ihdr[12] = 0;   /* no interlacing */
+
+    start = SDL_TellIO(dst);
+    if (SDL_WriteIO(dst, "\x89PNG\r\n\x1a\n", 8) != 8 ||
+        !MINIZ_WriteChunk(dst, "IHDR", ihdr, sizeof(ihdr))) {
+        goto done;
+    }
+    if (palette) {
+        for (i = 0; i < palette->ncolors; ++i) {
+            plte[i * 3 + 0] = palette->colors[i].r;
+            plte[i * 3 + 1] = palette->colors[i].g;
+            plte[i * 3 + 2] = palette->colors[i].b;
+            trns[i] = palette->colors[i].a;
+            if (trns[i] != 255) {
+                num_trans = i + 1;
+            }
+        }
+        if (!MINIZ_WriteChunk(dst, "PLTE", plte, palette->ncolors * 3) ||
+            (num_trans > 0 && !MINIZ_WriteChunk(dst, "tRNS", trns, num_trans))) {
+            goto done;
         }
     }
-    if (png) {
-        if (SDL_WriteIO(dst, png, size)) {
-            result = true;
+
+    /* Deflate with a 32K window, and the compression level as zlib would report it */
+    level = options->level;
+    header[0] = 0x78;
+    header[1] = (Uint8)((level < 2 ? 0 : level < 6 ? 1 : level == 6 ? 2 : 3) << 6);
+    header[1] = (Uint8)(header[1] + 31 - ((header[0] << 8) | header[1]) % 31);
+
+    if (ctx.count == 1) {
+        /* Stream IDAT chunks straight to the output */
+        struct savepng_output *output = &ctx.stripes[0].output;
+
+        output->dst = dst;
+        output->capacity = IDAT_CHUNK_SIZE;
+        output->data = (Uint8 *)SDL_malloc(output->capacity);
+        if (!output->data || !MINIZ_PutOutput(header, sizeof(header), output)) {
+            goto done;
         }
-        mz_free(png); /* calls SDL_free() */
+        MINIZ_EncodeStripes(&ctx);
     } else {
-        return SDL_SetError("Failed to convert and save image");
+        if (!MINIZ_PutOutput(header, sizeof(header), &ctx.stripes[0].output)) {
+            goto done;
+        }
+
+        /* The calling thread works on stripes too */
+        for (i = 1; i < num_threads; ++i) {
+            threads[i] = SDL_CreateThread(MINIZ_EncodeStripes, "SDL_image PNG", &ctx);
+            if (!threads[i]) {
+                break;
+            }
+        }
+        MINIZ_EncodeStripes(&ctx);
+        for (i = 1; i < num_threads; ++i) {
+            SDL_WaitThread(threads[i], NULL);
+        }
+    }
+
+    for (i = 0; i < ctx.count; ++i) {
+        if (!ctx.stripes[i].result) {
+            SDL_SetError("Failed to compress PNG image data");
+            goto done;
+        }
+        adler = MINIZ_CombineAdler32(adler, ctx.stripes[i].adler, (1 + (Uint64)ctx.row_length) * ctx.stripes[i].h);
+    }
+    trailer[0] = (Uint8)(adler >> 24);
+    trailer[1] = (Uint8)(adler >> 16);
+    trailer[2] = (Uint8)(adler >> 8);
+    trailer[3] = (Uint8)adler;
+    if (!MINIZ_PutOutput(trailer, sizeof(trailer), &ctx.stripes[ctx.count - 1].output)) {
+        goto done;
+    }
+
+    for (i = 0; i < ctx.count; ++i) {
+        ctx.stripes[i].output.dst = dst;
+        if (!MINIZ_FlushOutput(&ctx.stripes[i].output)) {
+            goto done;
+        }
+    }
+    result = MINIZ_WriteChunk(dst, "IEND", iend, 0);
+
+done:
+    if (!result && start >= 0) {
+        SDL_SeekIO(dst, start, SDL_IO_SEEK_SET);
+    }
+    if (ctx.stripes) {
+        for (i = 0; i < ctx.count; ++i) {
+            SDL_free(ctx.stripes[i].output.data);
+        }
+        SDL_free(ctx.stripes);
+    }
+    SDL_free(threads);
+    if (source != surface) {
+        SDL_DestroySurface(source);
     }
     return result;
 }
-#endif /* LOAD_PNG_DYNAMIC || !WANT_LIBPNG */
 
 #endif /* SDL_IMAGE_SAVE_PNG */
 
-bool IMG_SavePNG(SDL_Surface *surface, const char *file)
+static void PNG_GetSaveOptions(SDL_PropertiesID props, struct savepng_options *options)
 {
-    SDL_IOStream *dst = SDL_IOFromFile(file, "wb");
-    if (dst) {
-        return IMG_SavePNG_IO(surface, dst, 1);
-    } else {
-        return false;
+    IMG_PNGPreset preset = (IMG_PNGPreset)SDL_GetNumberProperty(props, IMG_PROP_PNG_SAVE_PRESET_NUMBER, IMG_PNG_PRESET_DEFAULT);
+
+    SDL_zerop(options);
+    options->level = 6;
+    options->strategy = IMG_PNG_STRATEGY_DEFAULT;
+    options->filter = IMG_PNG_FILTER_DEFAULT;
+    switch (preset) {
+    case IMG_PNG_PRESET_FAST:
+        options->level = 1;
+        options->filter = IMG_PNG_FILTER_SUB;
+        break;
+    case IMG_PNG_PRESET_SMALL:
+        options->level = 9;
+        options->filter = IMG_PNG_FILTER_ADAPTIVE;
+        break;
+    default:
+        break;
+    }
+
+    options->level = (int)SDL_GetNumberProperty(props, IMG_PROP_PNG_SAVE_COMPRESSION_LEVEL_NUMBER, options->level);
+    options->level = SDL_clamp(options->level, 0, 9);
+    options->strategy = (IMG_PNGStrategy)SDL_GetNumberProperty(props, IMG_PROP_PNG_SAVE_STRATEGY_NUMBER, options->strategy);
+    options->filter = (IMG_PNGFilter)SDL_GetNumberProperty(props, IMG_PROP_PNG_SAVE_FILTER_NUMBER, options->filter);
+    options->threads = (int)SDL_GetNumberProperty(props, IMG_PROP_PNG_SAVE_THREADS_NUMBER, 1);
+    options->palette_colors = (int)SDL_GetNumberProperty(props, IMG_PROP_PNG_SAVE_PALETTE_COLORS_NUMBER, 0);
+    if (options->palette_colors > 0) {
+        options->palette_colors = SDL_clamp(options->palette_colors, 2, 256);
     }
+    options->dither = IMG_GetDitherProperty(props, IMG_PROP_PNG_SAVE_DITHER_NUMBER);
 }
 
-bool IMG_SavePNG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio)
+static bool IMG_SavePNG_IO_Internal(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, const struct savepng_options *options)
 {
+    SDL_Surface *quantized = NULL;
     bool result = false;
+    bool parallel = false;
+    (void)quantized;
+    (void)surface;
+    (void)options;
+    (void)parallel;
 
     if (!dst) {
         return SDL_SetError("Passed NULL dst");
     }
+    if (!surface) {
+        if (closeio) {
+            SDL_CloseIO(dst);
+        }
+        return SDL_InvalidParamError("surface");
+    }
 
 #if SDL_IMAGE_SAVE_PNG
-#ifdef USE_LIBPNG
-    if (!result) {
-        result = IMG_SavePNG_IO_libpng(surface, dst);
+    if (options->palette_colors > 0 && !SDL_GetSurfacePalette(surface)) {
+        quantized = PNG_QuantizeSurface(surface, options->palette_colors, options->dither);
+        surface = quantized;
     }
+
+    if (surface) {
+        /* libpng deflates on a single thread, so the built-in encoder is used to save on more */
+        if (!SDL_GetSurfacePalette(surface) && MINIZ_GetNumThreads(surface, options) > 1) {
+            result = IMG_SavePNG_IO_miniz(surface, dst, options);
+            parallel = true;
+        }
+
+#ifdef USE_LIBPNG
+        if (!result && !parallel) {
+            result = IMG_SavePNG_IO_libpng(surface, dst, options);
+        }
 #endif
 
 #if defined(LOAD_PNG_DYNAMIC) || !defined(WANT_LIBPNG)
-    if (!result) {
-        result = IMG_SavePNG_IO_miniz(surface, dst);
-    }
+        if (!result && !parallel) {
+            result = IMG_SavePNG_IO_miniz(surface, dst, options);
+        }
 #endif
+    }
+    SDL_DestroySurface(quantized);
 
 #else
     result = SDL_SetError("SDL_image built without PNG save support");
@@ -818,3 +3111,29 @@ bool IMG_SavePNG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio)
     }
     return result;
 }
+
+bool IMG_SavePNG(SDL_Surface *surface, const char *file)
+{
+    SDL_IOStream *dst = SDL_IOFromFile(file, "wb");
+    if (dst) {
+        return IMG_SavePNG_IO(surface, dst, 1);
+    } else {
+        return false;
+    }
+}
+
+bool IMG_SavePNG_IO(SDL_Surface *surface, SDL_IOStream *dst, bool closeio)
+{
+    struct savepng_options options;
+
+    PNG_GetSaveOptions(0, &options);
+    return IMG_SavePNG_IO_Internal(surface, dst, closeio, &options);
+}
+
+bool IMG_SavePNGWithProperties(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props)
+{
+    struct savepng_options options;
+
+    PNG_GetSaveOptions(props, &options);
+    return IMG_SavePNG_IO_Internal(surface, dst, closeio, &options);
+}
@@ -0,0 +1,461 @@
+/*
+  SDL_image:  An example image loading library for use with SDL
+  Copyright (C) 1997-2025 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Palette quantization, shared by the PNG and GIF encoders */
+
+#include <SDL3_image/SDL_image.h>
+
+#include "IMG_quantize.h"
+
+/*
+ * Images that have no more distinct colors than the palette allows are
+ * stored exactly. Otherwise colors are counted in a histogram with 5 bits
+ * for each of red, green and blue and 4 bits of alpha, and a palette is
+ * chosen with median cut: the box of colors with the widest range in any
+ * channel is repeatedly split at the weighted median of that channel.
+ * Fully transparent colors are kept in a box of their own that is never
+ * split, so they end up as a single palette entry. Pixels are then mapped
+ * to the nearest palette color, optionally with ordered or Floyd-Steinberg
+ * dithering, through a cache indexed like the histogram.
+ *
+ * Palette entries are sorted by alpha, so a transparent entry comes first
+ * and a PNG tRNS chunk only has to cover the translucent ones.
+ */
+#define QUANTIZE_HISTOGRAM_SIZE (1 << 19)
+#define QUANTIZE_HASH_SIZE      1024    /* a power of two, well above 256 */
+
+struct quantize_color
+{
+    Uint8 c[4];
+    Uint32 count;
+};
+
+struct quantize_box
+{
+    int first;
+    int count;
+    int channel;
+    int range;
+};
+
+/* Thresholds for ordered dithering, from 0 to 63 */
+static const Uint8 QUANTIZE_bayer[8][8] = {
+    {  0, 32,  8, 40,  2, 34, 10, 42 },
+    { 48, 16, 56, 24, 50, 18, 58, 26 },
+    { 12, 44,  4, 36, 14, 46,  6, 38 },
+    { 60, 28, 52, 20, 62, 30, 54, 22 },
+    {  3, 35, 11, 43,  1, 33,  9, 41 },
+    { 51, 19, 59, 27, 49, 17, 57, 25 },
+    { 15, 47,  7, 39, 13, 45,  5, 37 },
+    { 63, 31, 55, 23, 61, 29, 53, 21 }
+};
+
+static Uint32 QUANTIZE_GetBin(const Uint8 *c)
+{
+    return ((Uint32)(c[0] >> 3) << 14) | ((Uint32)(c[1] >> 3) << 9) | ((Uint32)(c[2] >> 3) << 4) | (Uint32)(c[3] >> 4);
+}
+
+/* The color a histogram bin stands for, with the ends of each channel exact */
+static void QUANTIZE_GetBinColor(Uint32 bin, Uint8 *c)
+{
+    Uint8 r = (Uint8)((bin >> 14) & 0x1F);
+    Uint8 g = (Uint8)((bin >> 9) & 0x1F);
+    Uint8 b = (Uint8)((bin >> 4) & 0x1F);
+
+    c[0] = (Uint8)((r << 3) | (r >> 2));
+    c[1] = (Uint8)((g << 3) | (g >> 2));
+    c[2] = (Uint8)((b << 3) | (b >> 2));
+    c[3] = (Uint8)((bin & 0xF) * 17);
+}
+
+static int SDLCALL QUANTIZE_CompareAlpha(const void *a, const void *b)
+{
+    const SDL_Color *ca = (const SDL_Color *)a;
+    const SDL_Color *cb = (const SDL_Color *)b;
+
+    if (ca->a != cb->a) {
+        return (int)ca->a - (int)cb->a;
+    }
+    if (ca->r != cb->r) {
+        return (int)ca->r - (int)cb->r;
+    }
+    if (ca->g != cb->g) {
+        return (int)ca->g - (int)cb->g;
+    }
+    return (int)ca->b - (int)cb->b;
+}
+
+static Uint32 QUANTIZE_Hash(Uint32 color)
+{
+    return (color * 2654435761u) >> 22;
+}
+
+/* Look up a color in the hash table, returning its slot, which is empty if the color isn't there */
+static Uint32 QUANTIZE_FindSlot(const Uint32 *keys, const bool *used, Uint32 color)
+{
+    Uint32 slot = QUANTIZE_Hash(color);
+
+    while (used[slot] && keys[slot] != color) {
+        slot = (slot + 1) & (QUANTIZE_HASH_SIZE - 1);
+    }
+    return slot;
+}
+
+/* Map the pixels exactly, returns the number of colors or 0 if there are too many */
+static int QUANTIZE_Exact(SDL_Surface *src, SDL_Surface *dst, SDL_Color *colors, int max_colors)
+{
+    Uint32 keys[QUANTIZE_HASH_SIZE];
+    bool used[QUANTIZE_HASH_SIZE];
+    Uint8 values[QUANTIZE_HASH_SIZE];
+    int ncolors = 0;
+    int x, y, i;
+
+    SDL_zeroa(used);
+    for (y = 0; y < src->h; ++y) {
+        const Uint8 *p = (const Uint8 *)src->pixels + y * src->pitch;
+
+        for (x = 0; x < src->w; ++x, p += 4) {
+            Uint32 color = ((Uint32)p[0] << 24) | ((Uint32)p[1] << 16) | ((Uint32)p[2] << 8) | p[3];
+            Uint32 slot = QUANTIZE_FindSlot(keys, used, color);
+
+            if (!used[slot]) {
+                if (ncolors == max_colors) {
+                    return 0;
+                }
+                used[slot] = true;
+                keys[slot] = color;
+                colors[ncolors].r = p[0];
+                colors[ncolors].g = p[1];
+                colors[ncolors].b = p[2];
+                colors[ncolors].a = p[3];
+                ++ncolors;
+            }
+        }
+    }
+
+    SDL_qsort(colors, ncolors, sizeof(*colors), QUANTIZE_CompareAlpha);
+    for (i = 0; i < ncolors; ++i) {
+        Uint32 color = ((Uint32)colors[i].r << 24) | ((Uint32)colors[i].g << 16) | ((Uint32)colors[i].b << 8) | colors[i].a;
+        values[QUANTIZE_FindSlot(keys, used, color)] = (Uint8)i;
+    }
+
+    for (y = 0; y < src->h; ++y) {
+        const Uint8 *p = (const Uint8 *)src->pixels + y * src->pitch;
+        Uint8 *q = (Uint8 *)dst->pixels + y * dst->pitch;
+
+        for (x = 0; x < src->w; ++x, p += 4) {
+            Uint32 color = ((Uint32)p[0] << 24) | ((Uint32)p[1] << 16) | ((Uint32)p[2] << 8) | p[3];
+            *q++ = values[QUANTIZE_FindSlot(keys, used, color)];
+        }
+    }
+    return ncolors;
+}
+
+static void QUANTIZE_ShrinkBox(const struct quantize_color *entries, struct quantize_box *box)
+{
+    int lo[4] = { 255, 255, 255, 255 };
+    int hi[4] = { 0, 0, 0, 0 };
+    int i, c;
+
+    for (i = box->first; i < box->first + box->count; ++i) {
+        for (c = 0; c < 4; ++c) {
+            lo[c] = SDL_min(lo[c], entries[i].c[c]);
+            hi[c] = SDL_max(hi[c], entries[i].c[c]);
+        }
+    }
+    box->channel = 0;
+    box->range = 0;
+    for (c = 0; c < 4; ++c) {
+        if (hi[c] - lo[c] > box->range) {
+            box->channel = c;
+            box->range = hi[c] - lo[c];
+        }
+    }
+}
+
+/* Split a box at the weighted median of its widest channel */
+static void QUANTIZE_SplitBox(struct quantize_color *entries, struct quantize_box *box, struct quantize_box *other)
+{
+    Uint32 weights[256];
+    Uint64 total = 0, sum = 0;
+    int channel = box->channel;
+    int lo = 255, hi = 0;
+    int i, j, split;
+
+    SDL_zeroa(weights);
+    for (i = box->first; i < box->first + box->count; ++i) {
+        Uint8 v = entries[i].c[channel];
+        weights[v] += entries[i].count;
+        total += entries[i].count;
+        lo = SDL_min(lo, v);
+        hi = SDL_max(hi, v);
+    }
+    for (split = lo; split < hi - 1; ++split) {
+        sum += weights[split];
+        if (sum * 2 >= total) {
+            break;
+        }
+    }
+
+    /* Partition the entries so the ones at or below the split come first */
+    i = box->first;
+    j = box->first + box->count - 1;
+    while (i <= j) {
+        if (entries[i].c[channel] <= split) {
+            ++i;
+        } else {
+            struct quantize_color swap = entries[i];
+            entries[i] = entries[j];
+            entries[j] = swap;
+            --j;
+        }
+    }
+    other->first = i;
+    other->count = box->first + box->count - i;
+    box->count = i - box->first;
+    QUANTIZE_ShrinkBox(entries, box);
+    QUANTIZE_ShrinkBox(entries, other);
+}
+
+static Uint8 QUANTIZE_FindNearest(const SDL_Color *colors, int ncolors, const Uint8 *c)
+{
+    Uint32 best_distance = SDL_MAX_UINT32;
+    int best = 0;
+    int i;
+
+    for (i = 0; i < ncolors; ++i) {
+        int dr = (int)colors[i].r - c[0];
+        int dg = (int)colors[i].g - c[1];
+        int db = (int)colors[i].b - c[2];
+        int da = (int)colors[i].a - c[3];
+        Uint32 distance = (Uint32)(dr * dr + dg * dg + db * db + da * da);
+
+        if (distance < best_distance) {
+            best_distance = distance;
+            best = i;
+        }
+    }
+    return (Uint8)best;
+}
+
+/* Choose a palette with median cut and map the pixels to it, returns the number of colors or -1 on error */
+static int QUANTIZE_MedianCut(SDL_Surface *src, SDL_Surface *dst, SDL_Color *colors, int max_colors, IMG_DitherMode dither, int x0, int y0)
+{
+    Uint32 *histogram;
+    Uint16 *cache = NULL;
+    struct quantize_color *entries = NULL;
+    struct quantize_box boxes[256];
+    Sint16 *errors = NULL;
+    int nentries = 0, ntransparent = 0, nboxes, ncolors = -1;
+    int levels = 2, spread = 0;
+    int x, y, i, c;
+    Uint32 bin;
+
+    histogram = (Uint32 *)SDL_calloc(QUANTIZE_HISTOGRAM_SIZE, sizeof(*histogram));
+    if (!histogram) {
+        goto done;
+    }
+    for (y = 0; y < src->h; ++y) {
+        const Uint8 *p = (const Uint8 *)src->pixels + y * src->pitch;
+
+        for (x = 0; x < src->w; ++x, p += 4) {
+            bin = QUANTIZE_GetBin(p);
+            if (histogram[bin]++ == 0) {
+                ++nentries;
+            }
+        }
+    }
+
+    entries = (struct quantize_color *)SDL_malloc(nentries * sizeof(*entries));
+    if (!entries) {
+        goto done;
+    }
+    nentries = 0;
+    for (bin = 0; bin < QUANTIZE_HISTOGRAM_SIZE; ++bin) {
+        if (histogram[bin]) {
+            QUANTIZE_GetBinColor(bin, entries[nentries].c);
+            entries[nentries].count = histogram[bin];
+            ++nentries;
+        }
+    }
+
+    /* Move the fully transparent colors to the front, into a box that isn't split */
+    for (i = 0; i < nentries; ++i) {
+        if (entries[i].c[3] == 0) {
+            struct quantize_color swap = entries[i];
+            entries[i] = entries[ntransparent];
+            entries[ntransparent] = swap;
+            ++ntransparent;
+        }
+    }
+    nboxes = 0;
+    if (ntransparent > 0 && ntransparent < nentries) {
+        boxes[0].first = 0;
+        boxes[0].count = ntransparent;
+        boxes[0].channel = 3;
+        boxes[0].range = 0;
+        ++nboxes;
+    }
+    boxes[nboxes].first = nboxes ? ntransparent : 0;
+    boxes[nboxes].count = nentries - boxes[nboxes].first;
+    QUANTIZE_ShrinkBox(entries, &boxes[nboxes]);
+    for (++nboxes; nboxes < max_colors; ++nboxes) {
+        int widest = -1;
+
+        for (i = 0; i < nboxes; ++i) {
+            if (boxes[i].range > 0 && (widest < 0 || boxes[i].range > boxes[widest].range)) {
+                widest = i;
+            }
+        }
+        if (widest < 0) {
+            break;
+        }
+        QUANTIZE_SplitBox(entries, &boxes[widest], &boxes[nboxes]);
+    }
+
+    for (i = 0; i < nboxes; ++i) {
+        Uint64 sums[4] = { 0, 0, 0, 0 };
+        Uint64 total = 0;
+        int j;
+
+        for (j = boxes[i].first; j < boxes[i].first + boxes[i].count; ++j) {
+            for (c = 0; c < 4; ++c) {
+                sums[c] += (Uint64)entries[j].c[c] * entries[j].count;
+            }
+            total += entries[j].count;
+        }
+        colors[i].r = (Uint8)((sums[0] + total / 2) / total);
+        colors[i].g = (Uint8)((sums[1] + total / 2) / total);
+        colors[i].b = (Uint8)((sums[2] + total / 2) / total);
+        colors[i].a = (Uint8)((sums[3] + total / 2) / total);
+    }
+    SDL_qsort(colors, nboxes, sizeof(*colors), QUANTIZE_CompareAlpha);
+
+    /* The histogram isn't needed anymore, its memory holds the nearest color cache */
+    cache = (Uint16 *)histogram;
+    histogram = NULL;
+    SDL_memset(cache, 0xFF, QUANTIZE_HISTOGRAM_SIZE * sizeof(*cache));
+
+    if (dither == IMG_DITHER_ORDERED) {
+        /* Spread the threshold over about the distance between palette colors */
+        while ((levels + 1) * (levels + 1) * (levels + 1) <= nboxes) {
+            ++levels;
+        }
+        spread = 256 / levels;
+    } else if (dither == IMG_DITHER_FLOYD_STEINBERG) {
+        /* Two rows of error terms, with a pixel of padding on either side */
+        errors = (Sint16 *)SDL_calloc(2 * (src->w + 2) * 4, sizeof(*errors));
+        if (!errors) {
+            goto done;
+        }
+    }
+    for (y = 0; y < src->h; ++y) {
+        const Uint8 *p = (const Uint8 *)src->pixels + y * src->pitch;
+        Uint8 *q = (Uint8 *)dst->pixels + y * dst->pitch;
+        Sint16 *current = NULL, *next = NULL;
+
+        if (dither == IMG_DITHER_FLOYD_STEINBERG) {
+            current = errors + ((y & 1) ? (src->w + 2) * 4 : 0) + 4;
+            next = errors + ((y & 1) ? 0 : (src->w + 2) * 4) + 4;
+            SDL_memset(next - 4, 0, (src->w + 2) * 4 * sizeof(*next));
+        }
+        for (x = 0; x < src->w; ++x, p += 4) {
+            Uint8 pixel[4];
+            Uint8 index;
+
+            if (dither == IMG_DITHER_FLOYD_STEINBERG) {
+                for (c = 0; c < 4; ++c) {
+                    int v = p[c] + current[x * 4 + c] / 16;
+                    pixel[c] = (Uint8)SDL_clamp(v, 0, 255);
+                }
+            } else if (dither == IMG_DITHER_ORDERED) {
+                int offset = ((int)QUANTIZE_bayer[(y0 + y) & 7][(x0 + x) & 7] - 32) * spread / 64;
+
+                for (c = 0; c < 3; ++c) {
+                    int v = p[c] + offset;
+                    pixel[c] = (Uint8)SDL_clamp(v, 0, 255);
+                }
+                pixel[3] = p[3];
+            } else {
+                SDL_memcpy(pixel, p, 4);
+            }
+
+            bin = QUANTIZE_GetBin(pixel);
+            if (cache[bin] == 0xFFFF) {
+                Uint8 center[4];
+
+                QUANTIZE_GetBinColor(bin, center);
+                if (center[3] == 0 && ntransparent > 0) {
+                    cache[bin] = 0;
+                } else {
+                    cache[bin] = QUANTIZE_FindNearest(colors, nboxes, center);
+                }
+            }
+            index = (Uint8)cache[bin];
+            *q++ = index;
+
+            if (dither == IMG_DITHER_FLOYD_STEINBERG) {
+                Uint8 chosen[4];
+
+                chosen[0] = colors[index].r;
+                chosen[1] = colors[index].g;
+                chosen[2] = colors[index].b;
+                chosen[3] = colors[index].a;
+                for (c = 0; c < 4; ++c) {
+                    int error = (int)pixel[c] - chosen[c];
+
+                    current[(x + 1) * 4 + c] += (Sint16)(error * 7);
+                    next[(x - 1) * 4 + c] += (Sint16)(error * 3);
+                    next[x * 4 + c] += (Sint16)(error * 5);
+                    next[(x + 1) * 4 + c] += (Sint16)error;
+                }
+            }
+        }
+    }
+    ncolors = nboxes;
+
+done:
+    SDL_free(histogram);
+    SDL_free(cache);
+    SDL_free(entries);
+    SDL_free(errors);
+    return ncolors;
+}
+
+int IMG_QuantizePixels(SDL_Surface *src, SDL_Surface *dst, SDL_Color *colors, int max_colors, IMG_DitherMode dither, int x, int y)
+{
+    int ncolors = QUANTIZE_Exact(src, dst, colors, max_colors);
+
+    if (ncolors == 0) {
+        ncolors = QUANTIZE_MedianCut(src, dst, colors, max_colors, dither, x, y);
+    }
+    return ncolors;
+}
+
+IMG_DitherMode IMG_GetDitherProperty(SDL_PropertiesID props, const char *name)
+{
+    Sint64 dither = SDL_GetNumberProperty(props, name, IMG_DITHER_NONE);
+
+    if (dither < IMG_DITHER_NONE || dither > IMG_DITHER_FLOYD_STEINBERG) {
+        return IMG_DITHER_NONE;
+    }
+    return (IMG_DitherMode)dither;
+}
@@ -0,0 +1,40 @@
+/*
+  SDL_image:  An example image loading library for use with SDL
+  Copyright (C) 1997-2025 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Palette quantization, shared by the PNG and GIF encoders */
+
+#ifndef IMG_QUANTIZE_H_
+#define IMG_QUANTIZE_H_
+
+#include <SDL3_image/SDL_image.h>
+
+/* Reduce an RGBA32 surface to at most max_colors colors, from 2 to 256,
+   writing the palette to colors and the indices to an INDEX8 surface of
+   the same size. x and y are the position of src in the whole image, to
+   line up the ordered dithering pattern.
+   Returns the number of colors or -1 on error. */
+extern int IMG_QuantizePixels(SDL_Surface *src, SDL_Surface *dst, SDL_Color *colors, int max_colors, IMG_DitherMode dither, int x, int y);
+
+/* Read an IMG_DitherMode property, using IMG_DITHER_NONE if it's missing or
+   out of range. */
+extern IMG_DitherMode IMG_GetDitherProperty(SDL_PropertiesID props, const char *name);
+
+#endif /* IMG_QUANTIZE_H_ */
@@ -73,15 +73,108 @@ static int IMG_LoadSTB_IO_eof(void *user)
     return SDL_GetIOStatus(src) == SDL_IO_STATUS_EOF;
 }
 
+/* Create the surface as soon as stb knows the image size, so JPEG images are
+ * decoded straight into the surface pixels. PNG images are decoded into a
+ * buffer of their own first, which is copied here only if it can't be
+ * adopted, gray images with alpha are expanded to RGBA while being copied.
+ */
+static stbi_uc *IMG_LoadSTB_IO_alloc(void *user, int w, int h, int *comp, int *stride)
+{
+    SDL_Surface **surface = (SDL_Surface **)user;
+    SDL_PixelFormat format;
+
+    switch (*comp) {
+    case STBI_grey:
+        format = SDL_PIXELFORMAT_INDEX8;
+        break;
+    case STBI_grey_alpha:
+        *comp = STBI_rgb_alpha;
+        format = SDL_PIXELFORMAT_RGBA32;
+        break;
+    case STBI_rgb:
+        format = SDL_PIXELFORMAT_RGB24;
+        break;
+    case STBI_rgb_alpha:
+        format = SDL_PIXELFORMAT_RGBA32;
+        break;
+    default:
+        SDL_SetError("Unknown image format: %d", *comp);
+        return NULL;
+    }
+
+    *surface = SDL_CreateSurface(w, h, format);
+    if (!*surface) {
+        return NULL;
+    }
+    *stride = (*surface)->pitch;
+    return (stbi_uc *)(*surface)->pixels;
+}
+
+/* Use the buffer stb decoded into as the surface pixels, if it's already in
+ * the surface format */
+static int IMG_LoadSTB_IO_adopt(void *user, stbi_uc *data, int w, int h, int comp)
+{
+    SDL_Surface **surface = (SDL_Surface **)user;
+    SDL_PixelFormat format;
+
+    switch (comp) {
+    case STBI_grey:
+        format = SDL_PIXELFORMAT_INDEX8;
+        break;
+    case STBI_rgb:
+        format = SDL_PIXELFORMAT_RGB24;
+        break;
+    case STBI_rgb_alpha:
+        format = SDL_PIXELFORMAT_RGBA32;
+        break;
+    default:
+        return 0;
+    }
+
+    *surface = SDL_CreateSurfaceFrom(w, h, format, data, w * comp);
+    if (!*surface) {
+        return 0;
+    }
+    /* The buffer was allocated with SDL_malloc(), the surface frees it */
+    (*surface)->flags &= ~SDL_SURFACE_PREALLOCATED;
+    return 1;
+}
+
+/* Look for a tRNS chunk in front of the image data of a PNG, reading from
+   the end of the IHDR chunk */
+static bool IMG_PNGHasTransparency(SDL_IOStream *src)
+{
+    Uint8 chunk[8];
+
+    while (SDL_ReadIO(src, chunk, sizeof(chunk)) == sizeof(chunk)) {
+        Uint32 length = ((Uint32)chunk[0] << 24) | ((Uint32)chunk[1] << 16) | ((Uint32)chunk[2] << 8) | chunk[3];
+
+        if (SDL_memcmp(&chunk[4], "tRNS", 4) == 0) {
+            return true;
+        }
+        if (SDL_memcmp(&chunk[4], "IDAT", 4) == 0 || SDL_memcmp(&chunk[4], "IEND", 4) == 0) {
+            break;
+        }
+        /* Skip the chunk data and CRC */
+        if (SDL_SeekIO(src, (Sint64)length + 4, SDL_IO_SEEK_CUR) < 0) {
+            break;
+        }
+    }
+    return false;
+}
+
 SDL_Surface *IMG_LoadSTB_IO(SDL_IOStream *src)
 {
     Sint64 start;
     Uint8 magic[26];
     int w, h, format;
-    stbi_uc *pixels;
+    int loaded;
     stbi_io_callbacks rw_callbacks;
+    stbi_output output;
     SDL_Surface *surface = NULL;
     bool use_palette = false;
+    bool use_16bit = false;
+    bool use_alpha = false;
     unsigned int palette_colors[256];
 
     if (!src) {
@@ -92,6 +185,7 @@ SDL_Surface *IMG_LoadSTB_IO(SDL_IOStream *src)
 
     if (SDL_ReadIO(src, magic, sizeof(magic)) == sizeof(magic)) {
         const Uint8 PNG_COLOR_INDEXED = 3;
+        const Uint8 PNG_COLOR_MASK_ALPHA = 4;
         if (magic[0] == 0x89 &&
             magic[1] == 'P' &&
             magic[2] == 'N' &&
@@ -103,6 +197,21 @@ SDL_Surface *IMG_LoadSTB_IO(SDL_IOStream *src)
             magic[25] == PNG_COLOR_INDEXED) {
             use_palette = true;
         }
+        if (magic[0] == 0x89 &&
+            magic[1] == 'P' &&
+            magic[2] == 'N' &&
+            magic[3] == 'G' &&
+            magic[24] == 16 &&
+            SDL_GetHintBoolean(IMG_HINT_PNG_LOAD_16BIT, false)) {
+            use_16bit = true;
+
+            /* A color key is expanded to an alpha channel, like libpng does */
+            if (magic[25] & PNG_COLOR_MASK_ALPHA) {
+                use_alpha = true;
+            } else if (SDL_SeekIO(src, start + 8 + 8 + 13 + 4, SDL_IO_SEEK_SET) >= 0) {
+                use_alpha = IMG_PNGHasTransparency(src);
+            }
+        }
     }
     SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
 
@@ -111,142 +220,108 @@ SDL_Surface *IMG_LoadSTB_IO(SDL_IOStream *src)
     rw_callbacks.skip = IMG_LoadSTB_IO_skip;
     rw_callbacks.eof = IMG_LoadSTB_IO_eof;
     w = h = format = 0; /* silence warning */
+    if (use_16bit) {
+        /* Keep full precision, with grayscale expanded to RGB */
+        int channels = use_alpha ? STBI_rgb_alpha : STBI_rgb;
+        stbi_us *pixels16 = stbi_load_16_from_callbacks(&rw_callbacks, src, &w, &h, &format, channels);
+        if (!pixels16) {
+            SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
+            return NULL;
+        }
+
+        surface = SDL_CreateSurfaceFrom(
+            w,
+            h,
+            (channels == STBI_rgb_alpha) ? SDL_PIXELFORMAT_RGBA64 : SDL_PIXELFORMAT_RGB48,
+            pixels16,
+            w * channels * (int)sizeof(*pixels16)
+        );
+        if (!surface) {
+            stbi_image_free(pixels16);
+            SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
+            return NULL;
+        }
+        surface->flags &= ~SDL_SURFACE_PREALLOCATED;
+        return surface;
+    }
+
+    output.alloc = IMG_LoadSTB_IO_alloc;
+    output.adopt = IMG_LoadSTB_IO_adopt;
+    output.user = &surface;
     if (use_palette) {
         /* Unused palette entries will be opaque white */
         SDL_memset(palette_colors, 0xff, sizeof(palette_colors));
 
-        pixels = stbi_load_from_callbacks_with_palette(
+        loaded = stbi_load_from_callbacks_with_palette_into(
             &rw_callbacks,
             src,
             &w,
             &h,
             palette_colors,
-            SDL_arraysize(palette_colors)
+            SDL_arraysize(palette_colors),
+            &output
         );
     } else {
-        pixels = stbi_load_from_callbacks(
+        loaded = stbi_load_from_callbacks_into(
             &rw_callbacks,
             src,
             &w,
             &h,
             &format,
-            STBI_default
+            STBI_default,
+            &output
         );
     }
-    if (!pixels) {
+    if (!loaded) {
+        /* The error message should already be set */
+        SDL_DestroySurface(surface);
         SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
         return NULL;
     }
 
     if (use_palette) {
-        surface = SDL_CreateSurfaceFrom(
-            w,
-            h,
-            SDL_PIXELFORMAT_INDEX8,
-            pixels,
-            w
-        );
-        if (surface) {
-            bool has_colorkey = false;
-            int colorkey_index = -1;
-            bool has_alpha = false;
-            SDL_Palette *palette = SDL_CreateSurfacePalette(surface);
-            if (palette) {
-                int i;
-                Uint8 *palette_bytes = (Uint8 *)palette_colors;
-
-                for (i = 0; i < palette->ncolors; i++) {
-                    palette->colors[i].r = *palette_bytes++;
-                    palette->colors[i].g = *palette_bytes++;
-                    palette->colors[i].b = *palette_bytes++;
-                    palette->colors[i].a = *palette_bytes++;
-                    if (palette->colors[i].a != SDL_ALPHA_OPAQUE) {
-                        if (palette->colors[i].a == SDL_ALPHA_TRANSPARENT && !has_colorkey) {
-                            has_colorkey = true;
-                            colorkey_index = i;
-                        } else {
-                            /* Partial opacity or multiple colorkeys */
-                            has_alpha = true;
-                        }
-                    }
-                }
-            }
-            if (has_alpha) {
-                SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_BLEND);
-            } else if (has_colorkey) {
-                SDL_SetSurfaceColorKey(surface, true, colorkey_index);
-            }
-
-            /* FIXME: This sucks. It'd be better to allocate the surface first, then
-             * write directly to the pixel buffer:
-             * https://github.com/nothings/stb/issues/58
-             * -flibit
-             */
-            surface->flags &= ~SDL_SURFACE_PREALLOCATED;
-        }
+        bool has_colorkey = false;
+        int colorkey_index = -1;
+        bool has_alpha = false;
+        SDL_Palette *palette = SDL_CreateSurfacePalette(surface);
+        if (palette) {
+            int i;
+            Uint8 *palette_bytes = (Uint8 *)palette_colors;
 
-    } else if (format == STBI_grey || format == STBI_rgb || format == STBI_rgb_alpha) {
-        surface = SDL_CreateSurfaceFrom(
-            w,
-            h,
-            (format == STBI_rgb_alpha) ? SDL_PIXELFORMAT_RGBA32 :
-            (format == STBI_rgb) ? SDL_PIXELFORMAT_RGB24 :
-            SDL_PIXELFORMAT_INDEX8,
-            pixels,
-            w * format
-        );
-        if (surface) {
-            /* Set a grayscale palette for gray images */
-            if (surface->format == SDL_PIXELFORMAT_INDEX8) {
-                SDL_Palette *palette = SDL_CreateSurfacePalette(surface);
-                if (palette) {
-                    int i;
-
-                    for (i = 0; i < palette->ncolors; i++) {
-                        palette->colors[i].r = (Uint8)i;
-                        palette->colors[i].g = (Uint8)i;
-                        palette->colors[i].b = (Uint8)i;
+            for (i = 0; i < palette->ncolors; i++) {
+                palette->colors[i].r = *palette_bytes++;
+                palette->colors[i].g = *palette_bytes++;
+                palette->colors[i].b = *palette_bytes++;
+                palette->colors[i].a = *palette_bytes++;
+                if (palette->colors[i].a != SDL_ALPHA_OPAQUE) {
+                    if (palette->colors[i].a == SDL_ALPHA_TRANSPARENT && !has_colorkey) {
+                        has_colorkey = true;
+                        colorkey_index = i;
+                    } else {
+                        /* Partial opacity or multiple colorkeys */
+                        has_alpha = true;
                     }
                 }
             }
-
-            /* FIXME: This sucks. It'd be better to allocate the surface first, then
-             * write directly to the pixel buffer:
-             * https://github.com/nothings/stb/issues/58
-             * -flibit
-             */
-            surface->flags &= ~SDL_SURFACE_PREALLOCATED;
+        }
+        if (has_alpha) {
+            SDL_SetSurfaceBlendMode(surface, SDL_BLENDMODE_BLEND);
+        } else if (has_colorkey) {
+            SDL_SetSurfaceColorKey(surface, true, colorkey_index);
         }
 
-    } else if (format == STBI_grey_alpha) {
-        surface = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
-        if (surface) {
-            Uint8 *src_ptr = pixels;
-            Uint8 *dst = (Uint8 *)surface->pixels;
-            int skip = surface->pitch - (surface->w * 4);
-            int row, col;
-
-            for (row = 0; row < h; ++row) {
-                for (col = 0; col < w; ++col) {
-                    Uint8 c = *src_ptr++;
-                    Uint8 a = *src_ptr++;
-                    *dst++ = c;
-                    *dst++ = c;
-                    *dst++ = c;
-                    *dst++ = a;
-                }
-                dst += skip;
+    } else if (surface->format == SDL_PIXELFORMAT_INDEX8) {
+        /* Set a grayscale palette for gray images */
+        SDL_Palette *palette = SDL_CreateSurfacePalette(surface);
+        if (palette) {
+            int i;
+
+            for (i = 0; i < palette->ncolors; i++) {
+                palette->colors[i].r = (Uint8)i;
+                palette->colors[i].g = (Uint8)i;
+                palette->colors[i].b = (Uint8)i;
             }
-            stbi_image_free(pixels);
         }
-    } else {
-        SDL_SetError("Unknown image format: %d", format);
-    }
-
-    if (!surface) {
-        /* The error message should already be set */
-        stbi_image_free(pixels); /* calls SDL_free() */
-        SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
     }
     return surface;
 }
@@ -23,6 +23,8 @@
 
 #include <SDL3_image/SDL_image.h>
 
+#include "IMG_anim_decoder.h"
+
 #ifdef LOAD_WEBP
 
 /*=============================================================================
@@ -266,31 +268,233 @@ error:
     return NULL;
 }
 
-IMG_Animation *IMG_LoadWEBPAnimation_IO(SDL_IOStream *src)
+/* How a frame is shown, found without decoding it */
+typedef struct
 {
-    Sint64 start;
+    int delay;
+    bool keyframe;      /* Composited without the frames before it */
+} WEBP_FrameInfo;
+
+typedef struct
+{
+    uint8_t *raw_data;
+    struct WebPDemuxer *demuxer;
+    WebPIterator iter;
+    bool iterating;
+    SDL_Surface *canvas;
+    uint32_t bgcolor;
+    WebPMuxAnimDispose dispose_method;
+    WEBP_FrameInfo *frames;
+    int num_frames;
+} WEBP_AnimationContext;
+
+/* Go through the frames without decoding them, finding their delays and
+   which ones can be composited without the frames before them */
+static bool WEBP_ScanFrames(WEBP_AnimationContext *ctx)
+{
+    WebPIterator iter;
+    int count, i = 0;
+    bool cleared = true;
+
+    count = (int)lib.WebPDemuxGetI(ctx->demuxer, WEBP_FF_FRAME_COUNT);
+    if (count <= 0) {
+        return true;
+    }
+    ctx->frames = (WEBP_FrameInfo *)SDL_calloc(count, sizeof(*ctx->frames));
+    if (!ctx->frames) {
+        return false;
+    }
+
+    if (lib.WebPDemuxGetFrame(ctx->demuxer, 1, &iter)) {
+        do {
+            WEBP_FrameInfo *info = &ctx->frames[i++];
+
+            info->delay = iter.duration;
+            info->keyframe = cleared ||
+                             (iter.x_offset == 0 && iter.y_offset == 0 &&
+                              iter.width == ctx->canvas->w && iter.height == ctx->canvas->h &&
+                              (iter.blend_method == WEBP_MUX_NO_BLEND || !iter.has_alpha));
+
+            /* Disposing to the background clears the whole canvas */
+            cleared = (iter.dispose_method == WEBP_MUX_DISPOSE_BACKGROUND);
+        } while (i < count && lib.WebPDemuxNextFrame(&iter));
+        lib.WebPDemuxReleaseIterator(&iter);
+    }
+    ctx->num_frames = i;
+    return true;
+}
+
+static IMG_AnimationDecoderStatus WEBP_GetNextFrame(IMG_AnimationDecoder *decoder, SDL_Surface **frame, int *delay, SDL_Rect *dirty)
+{
+    WEBP_AnimationContext *ctx = (WEBP_AnimationContext *)decoder->ctx;
+    SDL_Surface *curr;
+    SDL_Rect dst, bounds;
+
+    if (!ctx->iterating) {
+        if (!lib.WebPDemuxGetFrame(ctx->demuxer, 1, &ctx->iter)) {
+            return IMG_DECODER_STATUS_COMPLETE;
+        }
+        ctx->iterating = true;
+    } else if (!lib.WebPDemuxNextFrame(&ctx->iter)) {
+        return IMG_DECODER_STATUS_COMPLETE;
+    }
+
+    if (ctx->dispose_method == WEBP_MUX_DISPOSE_BACKGROUND) {
+        SDL_FillSurfaceRect(ctx->canvas, NULL, ctx->bgcolor);
+    }
+
+    curr = SDL_CreateSurface(ctx->iter.width, ctx->iter.height, SDL_PIXELFORMAT_RGBA32);
+    if (!curr) {
+        return IMG_DECODER_STATUS_FAILED;
+    }
+
+    if (!lib.WebPDecodeRGBAInto(ctx->iter.fragment.bytes,
+                                ctx->iter.fragment.size,
+                                (uint8_t *)curr->pixels,
+                                curr->pitch * curr->h,
+                                curr->pitch)) {
+        SDL_SetError("WebPDecodeRGBAInto() failed");
+        SDL_DestroySurface(curr);
+        return IMG_DECODER_STATUS_FAILED;
+    }
+
+    dst.x = ctx->iter.x_offset;
+    dst.y = ctx->iter.y_offset;
+    dst.w = ctx->iter.width;
+    dst.h = ctx->iter.height;
+    if (ctx->iter.blend_method == WEBP_MUX_BLEND) {
+        SDL_SetSurfaceBlendMode(curr, SDL_BLENDMODE_BLEND);
+    } else {
+        SDL_SetSurfaceBlendMode(curr, SDL_BLENDMODE_NONE);
+    }
+    SDL_BlitSurface(curr, NULL, ctx->canvas, &dst);
+    SDL_DestroySurface(curr);
+
+    bounds.x = 0;
+    bounds.y = 0;
+    bounds.w = ctx->canvas->w;
+    bounds.h = ctx->canvas->h;
+    if (ctx->dispose_method == WEBP_MUX_DISPOSE_BACKGROUND) {
+        /* The whole canvas was cleared */
+        *dirty = bounds;
+    } else if (!SDL_GetRectIntersection(&dst, &bounds, dirty)) {
+        SDL_zerop(dirty);
+    }
+
+    ctx->dispose_method = ctx->iter.dispose_method;
+    *frame = ctx->canvas;
+    *delay = ctx->iter.duration;
+    return IMG_DECODER_STATUS_OK;
+}
+
+static bool WEBP_RewindAnimation(IMG_AnimationDecoder *decoder)
+{
+    WEBP_AnimationContext *ctx = (WEBP_AnimationContext *)decoder->ctx;
+
+    /* The whole file is in memory, so we just start iterating again */
+    if (ctx->iterating) {
+        lib.WebPDemuxReleaseIterator(&ctx->iter);
+        ctx->iterating = false;
+    }
+    ctx->dispose_method = WEBP_MUX_DISPOSE_BACKGROUND;
+    return true;
+}
+
+static bool WEBP_GetFrameDelay(IMG_AnimationDecoder *decoder, int index, int *delay)
+{
+    WEBP_AnimationContext *ctx = (WEBP_AnimationContext *)decoder->ctx;
+
+    if (index >= ctx->num_frames) {
+        return false;
+    }
+    *delay = ctx->frames[index].delay;
+    return true;
+}
+
+static bool WEBP_SeekAnimation(IMG_AnimationDecoder *decoder, int index)
+{
+    WEBP_AnimationContext *ctx = (WEBP_AnimationContext *)decoder->ctx;
+    SDL_Surface *frame;
+    SDL_Rect dirty;
+    int key, next, delay;
+
+    key = index;
+    while (!ctx->frames[key].keyframe) {
+        --key;
+    }
+
+    /* The iterator is on the last frame composited, and frame numbers start
+       at 1, so its number is the index of the next frame */
+    next = ctx->iterating ? ctx->iter.frame_num : 0;
+
+    /* Carry on from the current frame if it's between the key frame and the one we want */
+    if (decoder->status != IMG_DECODER_STATUS_OK || next < key || next > index) {
+        if (ctx->iterating) {
+            lib.WebPDemuxReleaseIterator(&ctx->iter);
+            ctx->iterating = false;
+        }
+        if (key > 0) {
+            if (!lib.WebPDemuxGetFrame(ctx->demuxer, key, &ctx->iter)) {
+                return SDL_SetError("WebPDemuxGetFrame() failed");
+            }
+            ctx->iterating = true;
+        }
+        ctx->dispose_method = WEBP_MUX_DISPOSE_BACKGROUND;
+        next = key;
+    }
+
+    for ( ; next < index; ++next) {
+        switch (WEBP_GetNextFrame(decoder, &frame, &delay, &dirty)) {
+        case IMG_DECODER_STATUS_OK:
+            break;
+        case IMG_DECODER_STATUS_COMPLETE:
+            return SDL_SetError("Couldn't read WEBP frame %d", next);
+        default:
+            return false;
+        }
+    }
+    return true;
+}
+
+static void WEBP_CloseAnimation(IMG_AnimationDecoder *decoder)
+{
+    WEBP_AnimationContext *ctx = (WEBP_AnimationContext *)decoder->ctx;
+
+    if (ctx->iterating) {
+        lib.WebPDemuxReleaseIterator(&ctx->iter);
+    }
+    if (ctx->canvas) {
+        SDL_DestroySurface(ctx->canvas);
+    }
+    if (ctx->demuxer) {
+        lib.WebPDemuxDelete(ctx->demuxer);
+    }
+    SDL_free(ctx->frames);
+    if (ctx->raw_data) {
+        SDL_free(ctx->raw_data);
+    }
+    SDL_free(ctx);
+}
+
+bool IMG_CreateWEBPAnimationDecoder(IMG_AnimationDecoder *decoder)
+{
+    SDL_IOStream *src = decoder->src;
     const char *error = NULL;
     WebPBitstreamFeatures features;
-    struct WebPDemuxer *demuxer = NULL;
-    WebPIterator iter;
-    IMG_Animation *anim = NULL;
+    WEBP_AnimationContext *ctx;
     size_t raw_data_size;
-    uint8_t *raw_data = NULL;
     WebPData wd;
     uint32_t bgcolor;
-    SDL_Surface *canvas = NULL;
-    WebPMuxAnimDispose dispose_method = WEBP_MUX_DISPOSE_BACKGROUND;
 
-    if (!src) {
-        /* The error message has been set in SDL_IOFromFile */
-        return NULL;
+    if (!IMG_InitWEBP()) {
+        return false;
     }
 
-    start = SDL_TellIO(src);
-
-    if (!IMG_InitWEBP()) {
-        goto error;
+    ctx = (WEBP_AnimationContext *)SDL_calloc(1, sizeof(*ctx));
+    if (!ctx) {
+        return false;
     }
+    decoder->ctx = ctx;
 
     raw_data_size = -1;
     if (!webp_getinfo(src, &raw_data_size)) {
@@ -298,134 +502,96 @@ IMG_Animation *IMG_LoadWEBPAnimation_IO(SDL_IOStream *src)
         goto error;
     }
 
-    raw_data = (uint8_t*) SDL_malloc(raw_data_size);
-    if (raw_data == NULL) {
+    ctx->raw_data = (uint8_t*) SDL_malloc(raw_data_size);
+    if (ctx->raw_data == NULL) {
         goto error;
     }
 
-    if (SDL_ReadIO(src, raw_data, raw_data_size) != raw_data_size) {
+    if (SDL_ReadIO(src, ctx->raw_data, raw_data_size) != raw_data_size) {
         goto error;
     }
 
-    if (lib.WebPGetFeaturesInternal(raw_data, raw_data_size, &features, WEBP_DECODER_ABI_VERSION) != VP8_STATUS_OK) {
+    if (lib.WebPGetFeaturesInternal(ctx->raw_data, raw_data_size, &features, WEBP_DECODER_ABI_VERSION) != VP8_STATUS_OK) {
         error = "WebPGetFeatures() failed";
         goto error;
     }
 
     wd.size = raw_data_size;
-    wd.bytes = raw_data;
-    demuxer = lib.WebPDemuxInternal(&wd, 0, NULL, WEBP_DEMUX_ABI_VERSION);
-    if (!demuxer) {
+    wd.bytes = ctx->raw_data;
+    ctx->demuxer = lib.WebPDemuxInternal(&wd, 0, NULL, WEBP_DEMUX_ABI_VERSION);
+    if (!ctx->demuxer) {
         error = "WebPDemux() failed";
         goto error;
     }
 
-    anim = (IMG_Animation *)SDL_calloc(1, sizeof(*anim));
-    if (!anim) {
-        goto error;
-    }
-    anim->w = features.width;
-    anim->h = features.height;
-    anim->count = lib.WebPDemuxGetI(demuxer, WEBP_FF_FRAME_COUNT);
-    anim->frames = (SDL_Surface **)SDL_calloc(anim->count, sizeof(*anim->frames));
-    anim->delays = (int *)SDL_calloc(anim->count, sizeof(*anim->delays));
-    if (!anim->frames || !anim->delays) {
+    ctx->canvas = SDL_CreateSurface(features.width, features.height, features.has_alpha ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGBX32);
+    if (!ctx->canvas) {
         goto error;
     }
 
-    canvas = SDL_CreateSurface(anim->w, anim->h, features.has_alpha ? SDL_PIXELFORMAT_RGBA32 : SDL_PIXELFORMAT_RGBX32);
-    if (!canvas) {
+    if (!WEBP_ScanFrames(ctx)) {
         goto error;
     }
 
     /* Background color is BGRA byte order according to the spec */
-    bgcolor = lib.WebPDemuxGetI(demuxer, WEBP_FF_BACKGROUND_COLOR);
+    bgcolor = lib.WebPDemuxGetI(ctx->demuxer, WEBP_FF_BACKGROUND_COLOR);
 #if SDL_BYTEORDER == SDL_BIG_ENDIAN
-    bgcolor = SDL_MapSurfaceRGBA(canvas,
-                                 (bgcolor >> 8) & 0xFF,
-                                 (bgcolor >> 16) & 0xFF,
-                                 (bgcolor >> 24) & 0xFF,
-                                 (bgcolor >> 0) & 0xFF);
+    ctx->bgcolor = SDL_MapSurfaceRGBA(ctx->canvas,
+                                      (bgcolor >> 8) & 0xFF,
+                                      (bgcolor >> 16) & 0xFF,
+                                      (bgcolor >> 24) & 0xFF,
+                                      (bgcolor >> 0) & 0xFF);
 #else
-    bgcolor = SDL_MapSurfaceRGBA(canvas,
-                                 (bgcolor >> 16) & 0xFF,
-                                 (bgcolor >> 8) & 0xFF,
-                                 (bgcolor >> 0) & 0xFF,
-                                 (bgcolor >> 24) & 0xFF);
+    ctx->bgcolor = SDL_MapSurfaceRGBA(ctx->canvas,
+                                      (bgcolor >> 16) & 0xFF,
+                                      (bgcolor >> 8) & 0xFF,
+                                      (bgcolor >> 0) & 0xFF,
+                                      (bgcolor >> 24) & 0xFF);
 #endif
+    ctx->dispose_method = WEBP_MUX_DISPOSE_BACKGROUND;
+
+    decoder->w = features.width;
+    decoder->h = features.height;
+    decoder->GetNextFrame = WEBP_GetNextFrame;
+    decoder->Rewind = WEBP_RewindAnimation;
+    decoder->GetFrameDelay = WEBP_GetFrameDelay;
+    decoder->Seek = WEBP_SeekAnimation;
+    decoder->Close = WEBP_CloseAnimation;
+    return true;
 
-    SDL_zero(iter);
-    if (lib.WebPDemuxGetFrame(demuxer, 1, &iter)) {
-        do {
-            int frame_idx = (iter.frame_num - 1);
-            if (frame_idx < 0 || frame_idx >= anim->count) {
-                continue;
-            }
-
-            if (dispose_method == WEBP_MUX_DISPOSE_BACKGROUND) {
-                SDL_FillSurfaceRect(canvas, NULL, bgcolor);
-            }
-
-            SDL_Surface *curr = SDL_CreateSurface(iter.width, iter.height, SDL_PIXELFORMAT_RGBA32);
-            if (!curr) {
-                goto error;
-            }
-
-            if (!lib.WebPDecodeRGBAInto(iter.fragment.bytes,
-                                        iter.fragment.size,
-                                        (uint8_t *)curr->pixels,
-                                        curr->pitch * curr->h,
-                                        curr->pitch)) {
-                error = "WebPDecodeRGBAInto() failed";
-                SDL_DestroySurface(curr);
-                goto error;
-            }
-
-            SDL_Rect dst = { iter.x_offset, iter.y_offset, iter.width, iter.height };
-            if (iter.blend_method == WEBP_MUX_BLEND) {
-                SDL_SetSurfaceBlendMode(curr, SDL_BLENDMODE_BLEND);
-            } else {
-                SDL_SetSurfaceBlendMode(curr, SDL_BLENDMODE_NONE);
-            }
-            SDL_BlitSurface(curr, NULL, canvas, &dst);
-            SDL_DestroySurface(curr);
-
-            anim->frames[frame_idx] = SDL_DuplicateSurface(canvas);
-            anim->delays[frame_idx] = iter.duration;
-            dispose_method = iter.dispose_method;
-
-        } while (lib.WebPDemuxNextFrame(&iter));
+error:
+    WEBP_CloseAnimation(decoder);
+    decoder->ctx = NULL;
 
-        lib.WebPDemuxReleaseIterator(&iter);
+    if (error) {
+        SDL_SetError("%s", error);
     }
+    SDL_SeekIO(src, decoder->start, SDL_IO_SEEK_SET);
+    return false;
+}
 
-    SDL_DestroySurface(canvas);
-
-    lib.WebPDemuxDelete(demuxer);
-
-    SDL_free(raw_data);
-
-    return anim;
+IMG_Animation *IMG_LoadWEBPAnimation_IO(SDL_IOStream *src)
+{
+    IMG_AnimationDecoder decoder;
+    IMG_Animation *anim;
 
-error:
-    if (canvas) {
-        SDL_DestroySurface(canvas);
-    }
-    if (anim) {
-        IMG_FreeAnimation(anim);
-    }
-    if (demuxer) {
-        lib.WebPDemuxDelete(demuxer);
-    }
-    if (raw_data) {
-        SDL_free(raw_data);
+    if (!src) {
+        /* The error message has been set in SDL_IOFromFile */
+        return NULL;
     }
 
-    if (error) {
-        SDL_SetError("%s", error);
+    SDL_zero(decoder);
+    decoder.src = src;
+    decoder.start = SDL_TellIO(src);
+    if (!IMG_CreateWEBPAnimationDecoder(&decoder)) {
+        return NULL;
     }
-    SDL_SeekIO(src, start, SDL_IO_SEEK_SET);
-    return NULL;
+    anim = IMG_DecodeAnimation(&decoder);
+    decoder.Close(&decoder);
+    if (!anim) {
+        SDL_SeekIO(src, decoder.start, SDL_IO_SEEK_SET);
+    }
+    return anim;
 }
 
 #else
@@ -450,4 +616,10 @@ IMG_Animation *IMG_LoadWEBPAnimation_IO(SDL_IOStream *src)
     return NULL;
 }
 
+bool IMG_CreateWEBPAnimationDecoder(IMG_AnimationDecoder *decoder)
+{
+    (void)decoder;
+    return SDL_SetError("WEBP animations are not supported");
+}
+
 #endif /* LOAD_WEBP */
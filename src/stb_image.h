@@ -427,8 +427,8 @@ typedef struct
 
 #if 0 /* not used in SDL_image */
 STBIDEF stbi_uc *stbi_load_from_memory   (stbi_uc           const *buffer, int len   , int *x, int *y, int *channels_in_file, int desired_channels);
-#endif
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk  , void *user, int *x, int *y, int *channels_in_file, int desired_channels);
+#endif
 
 #ifndef STBI_NO_STDIO
 STBIDEF stbi_uc *stbi_load            (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
@@ -453,8 +453,33 @@ STBIDEF int stbi_convert_wchar_to_utf8(char *buffer, size_t bufferlen, const wch
 
 #if 0 /* not used in SDL_image */
 STBIDEF stbi_uc *stbi_load_from_memory_with_palette   (stbi_uc           const *buffer, int len , int *x, int *y, unsigned int *palette_buffer, int palette_buffer_len);
-#endif
 STBIDEF stbi_uc *stbi_load_from_callbacks_with_palette(stbi_io_callbacks const *clbk, void *user, int *x, int *y, unsigned int *palette_buffer, int palette_buffer_len);
+#endif
+
+////////////////////////////////////
+//
+// SDL_image change: decode into caller-provided memory
+//
+// 'alloc' is called once the size of the image is known, with the number of
+// components that would be returned. It can change *comp to have the image
+// converted to that many components while it is written, and returns the
+// first row of the destination with its pitch in bytes in *stride, or NULL
+// to fail the load.
+//
+// Loaders that decode into a packed buffer of their own first call 'adopt',
+// if it's set, which can take ownership of that buffer instead of having it
+// copied. It returns nonzero if it did, or zero to fall back to 'alloc'.
+//
+
+typedef struct
+{
+   stbi_uc *(*alloc)(void *user, int x, int y, int *comp, int *stride);
+   int      (*adopt)(void *user, stbi_uc *data, int x, int y, int comp);
+   void     *user;
+} stbi_output;
+
+STBIDEF int stbi_load_from_callbacks_into             (stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels, stbi_output *output);
+STBIDEF int stbi_load_from_callbacks_with_palette_into(stbi_io_callbacks const *clbk, void *user, int *x, int *y, unsigned int *palette_buffer, int palette_buffer_len, stbi_output *output);
 
 ////////////////////////////////////
 //
@@ -463,8 +488,8 @@ STBIDEF stbi_uc *stbi_load_from_callbacks_with_palette(stbi_io_callbacks const *
 
 #if 0 /* not used in SDL_image */
 STBIDEF stbi_us *stbi_load_16_from_memory   (stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels);
-STBIDEF stbi_us *stbi_load_16_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels);
 #endif
+STBIDEF stbi_us *stbi_load_16_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels);
 
 #ifndef STBI_NO_STDIO
 STBIDEF stbi_us *stbi_load_16          (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels);
@@ -878,6 +903,8 @@ typedef struct
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   stbi_output *output; /* SDL_image change */
 } stbi__context;
 
 
@@ -900,6 +927,7 @@ static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *
 {
    s->io = *c;
    s->io_user_data = user;
+   s->output = NULL; /* SDL_image change */
    s->buflen = sizeof(s->buffer_start);
    s->read_from_callbacks = 1;
    s->callback_already_read = 0;
@@ -966,8 +994,11 @@ typedef struct
    int bits_per_channel;
    int num_channels;
    int channel_order;
+   int in_output; /* SDL_image change: the loader wrote into stbi__context::output */
 } stbi__result_info;
 
+static void *stbi__write_output(stbi__context *s, void *data, int x, int y, int img_n); /* SDL_image change */
+
 #ifndef STBI_NO_JPEG
 static int      stbi__jpeg_test(stbi__context *s);
 static void    *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri);
@@ -1280,7 +1311,6 @@ static stbi_uc *stbi__convert_16_to_8(stbi__uint16 *orig, int w, int h, int chan
    return reduced;
 }
 
-#if 0 /* not used in SDL_image */
 static stbi__uint16 *stbi__convert_8_to_16(stbi_uc *orig, int w, int h, int channels)
 {
    int i;
@@ -1296,7 +1326,6 @@ static stbi__uint16 *stbi__convert_8_to_16(stbi_uc *orig, int w, int h, int chan
    STBI_FREE(orig);
    return enlarged;
 }
-#endif
 
 static void stbi__vertical_flip(void *image, int w, int h, int bytes_per_pixel)
 {
@@ -1350,7 +1379,8 @@ static unsigned char *stbi__load_indexed(stbi__context *s, int *x, int *y, unsig
       return NULL;
 
    if (comp != 1) {
-       stbi_image_free(result);
+       if (!ri.in_output) /* SDL_image change */
+           stbi_image_free(result);
        return NULL;
    }
 
@@ -1361,6 +1391,10 @@ static unsigned char *stbi__load_indexed(stbi__context *s, int *x, int *y, unsig
 
    // @TODO: move stbi__convert_format to here
 
+   if (s->output && !ri.in_output) { /* SDL_image change */
+      return (unsigned char *) stbi__write_output(s, result, *x, *y, 1);
+   }
+
    if (stbi__vertically_flip_on_load) {
       int channels = 1;
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
@@ -1387,6 +1421,10 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
 
    // @TODO: move stbi__convert_format to here
 
+   if (s->output && !ri.in_output) { /* SDL_image change */
+      return (unsigned char *) stbi__write_output(s, result, *x, *y, req_comp ? req_comp : *comp);
+   }
+
    if (stbi__vertically_flip_on_load) {
       int channels = req_comp ? req_comp : *comp;
       stbi__vertical_flip(result, *x, *y, channels * sizeof(stbi_uc));
@@ -1395,7 +1433,6 @@ static unsigned char *stbi__load_and_postprocess_8bit(stbi__context *s, int *x,
    return (unsigned char *) result;
 }
 
-#if 0 /* not used in SDL_image */
 static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x, int *y, int *comp, int req_comp)
 {
    stbi__result_info ri;
@@ -1422,7 +1459,6 @@ static stbi__uint16 *stbi__load_and_postprocess_16bit(stbi__context *s, int *x,
 
    return (stbi__uint16 *) result;
 }
-#endif /**/
 
 #if !defined(STBI_NO_HDR) && !defined(STBI_NO_LINEAR)
 static void stbi__float_postprocess(float *result, int *x, int *y, int *comp, int req_comp)
@@ -1533,6 +1569,7 @@ STBIDEF stbi_us *stbi_load_16_from_memory(stbi_uc const *buffer, int len, int *x
    stbi__start_mem(&s,buffer,len);
    return stbi__load_and_postprocess_16bit(&s,x,y,channels_in_file,desired_channels);
 }
+#endif /**/
 
 STBIDEF stbi_us *stbi_load_16_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *channels_in_file, int desired_channels)
 {
@@ -1541,13 +1578,13 @@ STBIDEF stbi_us *stbi_load_16_from_callbacks(stbi_io_callbacks const *clbk, void
    return stbi__load_and_postprocess_16bit(&s,x,y,channels_in_file,desired_channels);
 }
 
+#if 0 /* not used in SDL_image */
 STBIDEF stbi_uc *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp)
 {
    stbi__context s;
    stbi__start_mem(&s,buffer,len);
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
-#endif /**/
 
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
 {
@@ -1555,6 +1592,7 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
+#endif /**/
 
 #if 0 /* not used in SDL_image */
 STBIDEF stbi_uc *stbi_load_from_memory_with_palette(stbi_uc const *buffer, int len, int *x, int *y, unsigned int *palette_buffer, int palette_buffer_len)
@@ -1563,7 +1601,6 @@ STBIDEF stbi_uc *stbi_load_from_memory_with_palette(stbi_uc const *buffer, int l
     stbi__start_mem(&s, buffer, len);
     return stbi__load_indexed(&s, x, y, palette_buffer, palette_buffer_len);
 }
-#endif
 
 STBIDEF stbi_uc *stbi_load_from_callbacks_with_palette(stbi_io_callbacks const *clbk, void *user, int *x, int *y, unsigned int *palette_buffer, int palette_buffer_len)
 {
@@ -1571,6 +1608,24 @@ STBIDEF stbi_uc *stbi_load_from_callbacks_with_palette(stbi_io_callbacks const *
     stbi__start_callbacks(&s, (stbi_io_callbacks *)clbk, user);
     return stbi__load_indexed(&s, x, y, palette_buffer, palette_buffer_len);
 }
+#endif
+
+/* SDL_image change */
+STBIDEF int stbi_load_from_callbacks_into(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp, stbi_output *output)
+{
+   stbi__context s;
+   stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   s.output = output;
+   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp) != NULL;
+}
+
+STBIDEF int stbi_load_from_callbacks_with_palette_into(stbi_io_callbacks const *clbk, void *user, int *x, int *y, unsigned int *palette_buffer, int palette_buffer_len, stbi_output *output)
+{
+    stbi__context s;
+    stbi__start_callbacks(&s, (stbi_io_callbacks *)clbk, user);
+    s.output = output;
+    return stbi__load_indexed(&s, x, y, palette_buffer, palette_buffer_len) != NULL;
+}
 
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp)
@@ -1890,9 +1945,38 @@ static stbi_uc stbi__compute_y(int r, int g, int b)
 #if defined(STBI_NO_PNG) && defined(STBI_NO_BMP) && defined(STBI_NO_PSD) && defined(STBI_NO_TGA) && defined(STBI_NO_GIF) && defined(STBI_NO_PIC) && defined(STBI_NO_PNM)
 // nothing
 #else
+// SDL_image change: convert a single row, so it can be written anywhere
+static int stbi__convert_format_row(unsigned char *src, int img_n, unsigned char *dest, int req_comp, unsigned int x)
+{
+   int i;
+
+   #define STBI__COMBO(a,b)  ((a)*8+(b))
+   #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
+   // convert source image with img_n components to one with req_comp components;
+   // avoid switch per pixel, so use switch per scanline and massive macros
+   switch (STBI__COMBO(img_n, req_comp)) {
+      STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=255;                                     } break;
+      STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
+      STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=255;                     } break;
+      STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
+      STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
+      STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                  } break;
+      STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=255;        } break;
+      STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = 255;    } break;
+      STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
+      STBI__CASE(4,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = src[3]; } break;
+      STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                    } break;
+      default: STBI_ASSERT(0); return 0;
+   }
+   #undef STBI__CASE
+
+   return 1;
+}
+
 static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int req_comp, unsigned int x, unsigned int y)
 {
-   int i,j;
+   int j;
    unsigned char *good;
 
    if (data == NULL) return data;
@@ -1909,31 +1993,54 @@ static unsigned char *stbi__convert_format(unsigned char *data, int img_n, int r
       unsigned char *src  = data + j * x * img_n   ;
       unsigned char *dest = good + j * x * req_comp;
 
-      #define STBI__COMBO(a,b)  ((a)*8+(b))
-      #define STBI__CASE(a,b)   case STBI__COMBO(a,b): for(i=x-1; i >= 0; --i, src += a, dest += b)
-      // convert source image with img_n components to one with req_comp components;
-      // avoid switch per pixel, so use switch per scanline and massive macros
-      switch (STBI__COMBO(img_n, req_comp)) {
-         STBI__CASE(1,2) { dest[0]=src[0]; dest[1]=255;                                     } break;
-         STBI__CASE(1,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(1,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=255;                     } break;
-         STBI__CASE(2,1) { dest[0]=src[0];                                                  } break;
-         STBI__CASE(2,3) { dest[0]=dest[1]=dest[2]=src[0];                                  } break;
-         STBI__CASE(2,4) { dest[0]=dest[1]=dest[2]=src[0]; dest[3]=src[1];                  } break;
-         STBI__CASE(3,4) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];dest[3]=255;        } break;
-         STBI__CASE(3,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(3,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = 255;    } break;
-         STBI__CASE(4,1) { dest[0]=stbi__compute_y(src[0],src[1],src[2]);                   } break;
-         STBI__CASE(4,2) { dest[0]=stbi__compute_y(src[0],src[1],src[2]); dest[1] = src[3]; } break;
-         STBI__CASE(4,3) { dest[0]=src[0];dest[1]=src[1];dest[2]=src[2];                    } break;
-         default: STBI_ASSERT(0); STBI_FREE(data); STBI_FREE(good); return stbi__errpuc("unsupported", "Unsupported format conversion");
+      if (!stbi__convert_format_row(src, img_n, dest, req_comp, x)) {
+         STBI_FREE(data); STBI_FREE(good); return stbi__errpuc("unsupported", "Unsupported format conversion");
       }
-      #undef STBI__CASE
    }
 
    STBI_FREE(data);
    return good;
 }
+
+// SDL_image change: hand the decoded image over to the caller, or copy it
+// into the caller's memory, converting it on the way if a different number
+// of components is wanted
+static void *stbi__write_output(stbi__context *s, void *data, int x, int y, int img_n)
+{
+   int j, comp = img_n, stride = x * img_n;
+   stbi_uc *pixels;
+
+   if (data == NULL) return data;
+
+   if (s->output->adopt && s->output->adopt(s->output->user, (stbi_uc *) data, x, y, img_n)) {
+      return data;
+   }
+
+   pixels = s->output->alloc(s->output->user, x, y, &comp, &stride);
+   if (pixels == NULL) {
+      // the error is set by the caller
+      STBI_FREE(data);
+      return NULL;
+   }
+   if (comp < 1 || comp > 4) {
+      STBI_FREE(data);
+      return stbi__errpuc("bad req_comp", "Internal error");
+   }
+
+   for (j=0; j < y; ++j) {
+      unsigned char *src  = (unsigned char *) data + (size_t) j * x * img_n;
+      unsigned char *dest = pixels + (size_t) j * stride;
+
+      if (comp == img_n) {
+         memcpy(dest, src, (size_t) x * img_n);
+      } else if (!stbi__convert_format_row(src, img_n, dest, comp, x)) {
+         STBI_FREE(data); return stbi__errpuc("unsupported", "Unsupported format conversion");
+      }
+   }
+
+   STBI_FREE(data);
+   return pixels;
+}
 #endif
 
 #if defined(STBI_NO_PNG) && defined(STBI_NO_PSD)
@@ -4006,6 +4113,8 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n, is_rgb;
+   stbi_uc *output = NULL; /* SDL_image change */
+   size_t output_stride = 0;
    z->s->img_n = 0; // make stbi__cleanup_jpeg safe
 
    // validate req_comp
@@ -4017,6 +4126,15 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
+   // SDL_image change: let the caller provide the output, it may change n
+   if (z->s->output) {
+      int stride = z->s->img_x * n;
+      output = z->s->output->alloc(z->s->output->user, z->s->img_x, z->s->img_y, &n, &stride);
+      if (!output) { stbi__cleanup_jpeg(z); return NULL; }
+      if (n < 1 || n > 4) { stbi__cleanup_jpeg(z); return stbi__errpuc("bad req_comp", "Internal error"); }
+      output_stride = (size_t) stride;
+   }
+
    is_rgb = z->s->img_n == 3 && (z->rgb == 3 || (z->app14_color_transform == 0 && !z->jfif));
 
    if (z->s->img_n == 3 && n < 3 && !is_rgb)
@@ -4032,7 +4150,6 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    {
       int k;
       unsigned int i,j;
-      stbi_uc *output;
       stbi_uc *coutput[4] = { NULL, NULL, NULL, NULL };
 
       stbi__resample res_comp[4];
@@ -4060,12 +4177,15 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
       }
 
       // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+      if (!output) {
+         output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+         if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+         output_stride = (size_t) n * z->s->img_x;
+      }
 
       // now go ahead and resample
       for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
+         stbi_uc *out = output + output_stride * j;
          for (k=0; k < decode_n; ++k) {
             stbi__resample *r = &res_comp[k];
             int y_bot = r->ystep >= (r->vs >> 1);
@@ -4172,10 +4292,10 @@ static void *stbi__jpeg_load(stbi__context *s, int *x, int *y, int *comp, int re
    stbi__jpeg* j = (stbi__jpeg*) stbi__malloc(sizeof(stbi__jpeg));
    if (!j) return stbi__errpuc("outofmem", "Out of memory");
    memset(j, 0, sizeof(stbi__jpeg));
-   STBI_NOTUSED(ri);
    j->s = s;
    stbi__setup_jpeg(j);
    result = load_jpeg_image(j, x,y,comp,req_comp);
+   ri->in_output = (s->output != NULL); /* SDL_image change */
    STBI_FREE(j);
    return result;
 }
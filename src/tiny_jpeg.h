@@ -155,6 +155,26 @@ int tje_encode_with_func(tje_write_func* func,
                          const unsigned char* src_data,
                          const int pitch);
 
+/* SDL_image change */
+// - tje_encode_with_func_offsets -
+//
+// Usage
+//  Same as tje_encode_with_func, but the red, green and blue bytes are read
+//  from the given offsets within each pixel, so BGR and ARGB style data can be
+//  encoded without converting it first.
+
+int tje_encode_with_func_offsets(tje_write_func* func,
+                                 void* context,
+                                 const int quality,
+                                 const int width,
+                                 const int height,
+                                 const int num_components,
+                                 const int r_offset,
+                                 const int g_offset,
+                                 const int b_offset,
+                                 const unsigned char* src_data,
+                                 const int pitch);
+
 #endif // TJE_HEADER_GUARD
 
 
@@ -972,6 +992,9 @@ static int tjei_encode_main(TJEState* state,
                             const int width,
                             const int height,
                             const int src_num_components,
+                            const int r_offset, /* SDL_image change */
+                            const int g_offset,
+                            const int b_offset,
                             const int pitch)
 {
 #if TJE_USE_FAST_DCT
@@ -1156,9 +1179,9 @@ static int tjei_encode_main(TJEState* state,
                     }
                     assert(src_index < height * pitch);
 
-                    r = src_data[src_index + 0];
-                    g = src_data[src_index + 1];
-                    b = src_data[src_index + 2];
+                    r = src_data[src_index + r_offset]; /* SDL_image change */
+                    g = src_data[src_index + g_offset];
+                    b = src_data[src_index + b_offset];
 
                     luma = 0.299f   * r + 0.587f    * g + 0.114f    * b - 128;
                     cb   = -0.1687f * r - 0.3313f   * g + 0.5f      * b;
@@ -1269,6 +1292,22 @@ int tje_encode_with_func(tje_write_func* func,
                          const int num_components,
                          const unsigned char* src_data,
                          const int pitch)
+{
+    return tje_encode_with_func_offsets(func, context, quality, width, height, num_components, 0, 1, 2, src_data, pitch);
+}
+
+/* SDL_image change */
+int tje_encode_with_func_offsets(tje_write_func* func,
+                                 void* context,
+                                 const int quality,
+                                 const int width,
+                                 const int height,
+                                 const int num_components,
+                                 const int r_offset,
+                                 const int g_offset,
+                                 const int b_offset,
+                                 const unsigned char* src_data,
+                                 const int pitch)
 {
     TJEState state;
     TJEWriteContext wc;
@@ -1318,7 +1357,7 @@ int tje_encode_with_func(tje_write_func* func,
 
     tjei_huff_expand(&state);
 
-    return tjei_encode_main(&state, src_data, width, height, num_components, pitch);
+    return tjei_encode_main(&state, src_data, width, height, num_components, r_offset, g_offset, b_offset, pitch);
 }
 // ============================================================
 #endif // TJE_IMPLEMENTATION
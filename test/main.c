@@ -180,7 +180,7 @@ static const Format formats[] =
 #else
         false,
 #endif
-        false,      /* can save */
+        SDL_IMAGE_SAVE_GIF,
         IMG_isGIF,
         IMG_LoadGIF_IO,
     },
@@ -770,6 +770,7 @@ FormatSaveTest(const Format *format,
     SDL_Surface *reference = NULL;
     SDL_Surface *surface = NULL;
     SDL_IOStream *dest = NULL;
+    int tolerance = format->tolerance;
     int diff;
     bool result;
 
@@ -803,6 +804,16 @@ FormatSaveTest(const Format *format,
         } else {
             result = IMG_SaveAVIF(reference, filename, 90);
         }
+    } else if (SDL_strcmp(format->name, "GIF") == 0) {
+        if (rw) {
+            dest = SDL_IOFromFile(filename, "wb");
+            result = IMG_SaveGIF_IO(reference, dest, false);
+            SDL_CloseIO(dest);
+        } else {
+            result = IMG_SaveGIF(reference, filename);
+        }
+        /* The reference has more colors than fit in a GIF palette */
+        tolerance = 300;
     } else if (SDL_strcmp(format->name, "JPG") == 0) {
         if (rw) {
             dest = SDL_IOFromFile(filename, "wb");
@@ -846,10 +857,10 @@ FormatSaveTest(const Format *format,
                             "Expected height %d px, got %d",
                             format->h, surface->h);
 
-        diff = SDLTest_CompareSurfaces(surface, reference, format->tolerance);
+        diff = SDLTest_CompareSurfaces(surface, reference, tolerance);
         SDLTest_AssertCheck(diff == 0,
                             "Surface differed from reference by at most %d in %d pixels",
-                            format->tolerance, diff);
+                            tolerance, diff);
         if (diff != 0 || GetStringBoolean(SDL_getenv("SDL_IMAGE_TEST_DEBUG"), false)) {
             DumpPixels(filename, surface);
             DumpPixels(refFilename, reference);
@@ -938,12 +949,2056 @@ TestFormats(void *arg)
     return TEST_COMPLETED;
 }
 
-static const SDLTest_TestCaseReference formatsTestCase = {
-    TestFormats, "Images", "Load and save various image formats", TEST_ENABLED
+/* Create an RGBA surface with smooth gradients and some fine detail */
+static SDL_Surface *
+CreateTestSurface(int w, int h)
+{
+    SDL_Surface *surface;
+    int x, y;
+
+    surface = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    if (!SDLTest_AssertCheck(surface != NULL,
+                             "Creating %dx%d surface should succeed (%s)",
+                             w, h, SDL_GetError())) {
+        return NULL;
+    }
+
+    for (y = 0; y < h; y++) {
+        Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch;
+
+        for (x = 0; x < w; x++) {
+            *p++ = (Uint8)(x * 255 / w);
+            *p++ = (Uint8)(y * 255 / h);
+            *p++ = (Uint8)((x ^ y) & 0xFF);
+            *p++ = (Uint8)(255 - ((x + y) & 0x7F));
+        }
+    }
+    return surface;
+}
+
+/* Save a surface to memory with a set of properties and load it back */
+static SDL_Surface *
+SaveAndReload(SDL_Surface *surface,
+              bool (SDLCALL *saveFunction)(SDL_Surface *surface, SDL_IOStream *dst, bool closeio, SDL_PropertiesID props),
+              SDL_PropertiesID props)
+{
+    SDL_IOStream *mem;
+    SDL_Surface *result = NULL;
+
+    mem = SDL_IOFromDynamicMem();
+    if (!SDLTest_AssertCheck(mem != NULL,
+                             "Creating memory stream should succeed (%s)",
+                             SDL_GetError())) {
+        return NULL;
+    }
+
+    SDL_ClearError();
+    if (SDLTest_AssertCheck(saveFunction(surface, mem, false, props),
+                            "Save to memory (%s)", SDL_GetError())) {
+        SDL_SeekIO(mem, 0, SDL_IO_SEEK_SET);
+        result = IMG_Load_IO(mem, false);
+        if (SDLTest_AssertCheck(result != NULL,
+                                "Load from memory (%s)", SDL_GetError())) {
+            ConvertToRgba32(&result);
+        }
+    }
+    SDL_CloseIO(mem);
+    return result;
+}
+
+#if (USING_IMAGEIO && defined(JPG_USES_IMAGEIO)) || defined(SDL_IMAGE_USE_WIC_BACKEND) || defined(LOAD_JPG)
+/* Load a file from the test data, converted to RGBA */
+static SDL_Surface *
+LoadTestFile(const char *file)
+{
+    SDL_Surface *surface = NULL;
+    char *filename;
+
+    SDL_ClearError();
+    filename = GetTestFilename(TEST_FILE_DIST, file);
+    if (!SDLTest_AssertCheck(filename != NULL,
+                             "Building filename should succeed (%s)",
+                             SDL_GetError())) {
+        return NULL;
+    }
+    surface = IMG_Load(filename);
+    SDL_free(filename);
+    if (!SDLTest_AssertCheck(surface != NULL,
+                             "Load %s (%s)", file, SDL_GetError())) {
+        return NULL;
+    }
+    if (!ConvertToRgba32(&surface)) {
+        SDL_DestroySurface(surface);
+        return NULL;
+    }
+    return surface;
+}
+
+static int SDLCALL
+TestJPGDecodeModes(void *arg)
+{
+    static const char *modes[] = { "fast", "fastest" };
+    SDL_Surface *reference;
+    SDL_Surface *surface;
+    size_t i;
+    int diff;
+    (void)arg;
+
+    /* The faster modes only approximate the accurate one */
+    SDL_SetHint(IMG_HINT_JPG_DECODE_MODE, "accurate");
+    reference = LoadTestFile("sample.jpg");
+    if (!reference) {
+        SDL_ResetHint(IMG_HINT_JPG_DECODE_MODE);
+        return TEST_ABORTED;
+    }
+    for (i = 0; i < SDL_arraysize(modes); i++) {
+        SDL_SetHint(IMG_HINT_JPG_DECODE_MODE, modes[i]);
+        surface = LoadTestFile("sample.jpg");
+        if (surface) {
+            diff = SDLTest_CompareSurfaces(surface, reference, 100);
+            SDLTest_AssertCheck(diff == 0,
+                                "JPG decoded in %s mode differed from accurate mode by more than 100 in %d pixels",
+                                modes[i], diff);
+            SDL_DestroySurface(surface);
+        }
+    }
+    SDL_ResetHint(IMG_HINT_JPG_DECODE_MODE);
+    SDL_DestroySurface(reference);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference jpgDecodeModesTestCase = {
+    TestJPGDecodeModes, "JPGDecodeModes", "Load JPG images in each decode mode", TEST_ENABLED
 };
+#endif
 
-static const SDLTest_TestCaseReference *testCases[] =  {
-    &formatsTestCase,
+#if defined(LOAD_JPG) && SDL_IMAGE_SAVE_JPG
+/* Copy a JPG into a new stream with an Exif marker after the SOI marker,
+   whose IFD1 holds a JPG thumbnail */
+static SDL_IOStream *
+AddExifThumbnail(SDL_IOStream *jpg, SDL_IOStream *thumbnail)
+{
+    /* TIFF header, an empty IFD0 and an IFD1 with the thumbnail offset and size */
+    const Uint32 thumbnail_offset = 8 + 6 + 30;
+    SDL_IOStream *result = SDL_IOFromDynamicMem();
+    Uint8 *data = NULL;
+    size_t size = 0;
+    bool ok;
+
+    if (!result) {
+        return NULL;
+    }
+    data = (Uint8 *)SDL_LoadFile_IO(thumbnail, &size, false);
+    ok = data && size <= 0xFFFF - 2 - 6 - thumbnail_offset &&
+         SDL_WriteU16BE(result, 0xFFD8) &&
+         SDL_WriteU16BE(result, 0xFFE1) &&
+         SDL_WriteU16BE(result, (Uint16)(2 + 6 + thumbnail_offset + size)) &&
+         SDL_WriteIO(result, "Exif\0\0MM\0\x2A", 10) == 10 &&
+         SDL_WriteU32BE(result, 8) &&
+         SDL_WriteU16BE(result, 0) && SDL_WriteU32BE(result, 8 + 6) &&
+         SDL_WriteU16BE(result, 2) &&
+         SDL_WriteU16BE(result, 0x0201) && SDL_WriteU16BE(result, 4) &&
+         SDL_WriteU32BE(result, 1) && SDL_WriteU32BE(result, thumbnail_offset) &&
+         SDL_WriteU16BE(result, 0x0202) && SDL_WriteU16BE(result, 4) &&
+         SDL_WriteU32BE(result, 1) && SDL_WriteU32BE(result, (Uint32)size) &&
+         SDL_WriteU32BE(result, 0) &&
+         SDL_WriteIO(result, data, size) == size;
+    SDL_free(data);
+
+    /* The rest of the image, after its SOI marker */
+    data = ok ? (Uint8 *)SDL_LoadFile_IO(jpg, &size, false) : NULL;
+    ok = data && size > 2 && SDL_WriteIO(result, data + 2, size - 2) == size - 2;
+    SDL_free(data);
+    if (!ok) {
+        SDL_CloseIO(result);
+        return NULL;
+    }
+    return result;
+}
+
+static int SDLCALL
+TestJPGThumbnail(void *arg)
+{
+    struct {
+        bool exif;
+        int size;
+        int w;
+        int h;
+    } cases[] = {
+        { true, 0, 64, 32 },        /* Any thumbnail will do */
+        { true, 64, 64, 32 },       /* The thumbnail is big enough */
+        { true, 100, 128, 64 },     /* Too small, the image is decoded at 1/2 */
+        { false, 0, 32, 16 },       /* No thumbnail, the image is decoded at 1/8 */
+        { false, 40, 64, 32 },      /* 1/4 */
+        { false, 300, 256, 128 },   /* Full size */
+    };
+    SDL_Surface *image = NULL;
+    SDL_Surface *small = NULL;
+    SDL_Surface *surface;
+    SDL_IOStream *jpg = NULL;
+    SDL_IOStream *thumbnail = NULL;
+    SDL_IOStream *exif = NULL;
+    SDL_IOStream *src;
+    size_t i;
+    (void)arg;
+
+    image = CreateTestSurface(256, 128);
+    small = CreateTestSurface(64, 32);
+    jpg = SDL_IOFromDynamicMem();
+    thumbnail = SDL_IOFromDynamicMem();
+    if (!SDLTest_AssertCheck(image && small && jpg && thumbnail &&
+                             IMG_SaveJPG_IO(image, jpg, false, 90) &&
+                             IMG_SaveJPG_IO(small, thumbnail, false, 90),
+                             "Save JPG images to memory (%s)", SDL_GetError())) {
+        goto out;
+    }
+    SDL_SeekIO(jpg, 0, SDL_IO_SEEK_SET);
+    SDL_SeekIO(thumbnail, 0, SDL_IO_SEEK_SET);
+    exif = AddExifThumbnail(jpg, thumbnail);
+    if (!SDLTest_AssertCheck(exif != NULL,
+                             "Add an Exif thumbnail (%s)", SDL_GetError())) {
+        goto out;
+    }
+
+    for (i = 0; i < SDL_arraysize(cases); i++) {
+        src = cases[i].exif ? exif : jpg;
+        SDL_SeekIO(src, 0, SDL_IO_SEEK_SET);
+        SDL_ClearError();
+        surface = IMG_LoadJPGThumbnail_IO(src, cases[i].size);
+        if (!SDLTest_AssertCheck(surface != NULL,
+                                 "Load a thumbnail of at least %d px (%s)",
+                                 cases[i].size, SDL_GetError())) {
+            continue;
+        }
+        SDLTest_AssertCheck(surface->w == cases[i].w && surface->h == cases[i].h,
+                            "Thumbnail of at least %d px %s Exif should be %dx%d, got %dx%d",
+                            cases[i].size, cases[i].exif ? "with" : "without",
+                            cases[i].w, cases[i].h, surface->w, surface->h);
+        SDLTest_AssertCheck((SDL_max(surface->w, surface->h) >= cases[i].size || surface->w == image->w) &&
+                            surface->w == surface->h * 2,
+                            "Thumbnail should be at least %d px, or full size, and keep the 2:1 aspect ratio",
+                            cases[i].size);
+        SDL_DestroySurface(surface);
+    }
+
+out:
+    if (exif) {
+        SDL_CloseIO(exif);
+    }
+    if (thumbnail) {
+        SDL_CloseIO(thumbnail);
+    }
+    if (jpg) {
+        SDL_CloseIO(jpg);
+    }
+    SDL_DestroySurface(small);
+    SDL_DestroySurface(image);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference jpgThumbnailTestCase = {
+    TestJPGThumbnail, "JPGThumbnail", "Load JPG thumbnails from Exif data or a scaled decode", TEST_ENABLED
+};
+#endif
+
+#if ((USING_IMAGEIO && defined(JPG_USES_IMAGEIO)) || defined(SDL_IMAGE_USE_WIC_BACKEND) || defined(LOAD_JPG)) && SDL_IMAGE_SAVE_JPG
+static int SDLCALL
+TestJPGSaveThreads(void *arg)
+{
+    SDL_Surface *surface;
+    SDL_Surface *single = NULL;
+    SDL_Surface *threaded = NULL;
+    SDL_PropertiesID props;
+    int restart_interval;
+    int diff;
+    (void)arg;
+
+    /* Tall enough to be split into several stripes */
+    surface = CreateTestSurface(64, 256);
+    if (!surface) {
+        return TEST_ABORTED;
+    }
+    props = SDL_CreateProperties();
+
+    /* With and without the caller's own restart markers */
+    for (restart_interval = 0; restart_interval <= 4; restart_interval += 4) {
+        SDL_SetNumberProperty(props, IMG_PROP_JPG_SAVE_RESTART_INTERVAL_NUMBER, restart_interval);
+
+        SDL_SetNumberProperty(props, IMG_PROP_JPG_SAVE_THREADS_NUMBER, 1);
+        single = SaveAndReload(surface, IMG_SaveJPGWithProperties, props);
+        SDL_SetNumberProperty(props, IMG_PROP_JPG_SAVE_THREADS_NUMBER, 4);
+        threaded = SaveAndReload(surface, IMG_SaveJPGWithProperties, props);
+
+        if (single && threaded) {
+            SDLTest_AssertCheck(threaded->w == surface->w && threaded->h == surface->h,
+                                "Expected %dx%d px, got %dx%d",
+                                surface->w, surface->h, threaded->w, threaded->h);
+            diff = SDLTest_CompareSurfaces(threaded, single, 100);
+            SDLTest_AssertCheck(diff == 0,
+                                "Threaded JPG (restart interval %d) differed from single threaded by at most %d in %d pixels",
+                                restart_interval, 100, diff);
+        }
+        if (single) {
+            SDL_DestroySurface(single);
+        }
+        if (threaded) {
+            SDL_DestroySurface(threaded);
+        }
+    }
+
+    SDL_DestroyProperties(props);
+    SDL_DestroySurface(surface);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference jpgSaveThreadsTestCase = {
+    TestJPGSaveThreads, "JPGSaveThreads", "Save JPG images on several threads", TEST_ENABLED
+};
+#endif
+
+/* Lossless transforms need libjpeg, which is chosen the same way in IMG_jpg.c */
+#if defined(LOAD_JPG) && SDL_IMAGE_SAVE_JPG && !defined(USE_STBIMAGE) && \
+    (defined(SDL_IMAGE_USE_COMMON_BACKEND) || \
+     !(defined(SDL_IMAGE_USE_WIC_BACKEND) || (defined(__APPLE__) && defined(JPG_USES_IMAGEIO))))
+#define TEST_JPG_TRANSFORM
+#endif
+
+#ifdef TEST_JPG_TRANSFORM
+/* Apply a lossless transform, replacing src with the transformed image */
+static bool
+TransformJPG(SDL_IOStream **src, IMG_JPGTransform transform, int count)
+{
+    SDL_IOStream *dst;
+    bool result;
+    int i;
+
+    for (i = 0; i < count; i++) {
+        dst = SDL_IOFromDynamicMem();
+        if (!SDLTest_AssertCheck(dst != NULL,
+                                 "Creating memory stream should succeed (%s)",
+                                 SDL_GetError())) {
+            return false;
+        }
+
+        SDL_ClearError();
+        SDL_SeekIO(*src, 0, SDL_IO_SEEK_SET);
+        result = IMG_TransformJPG_IO(*src, dst, false, transform, NULL);
+        SDL_CloseIO(*src);
+        *src = dst;
+        if (!SDLTest_AssertCheck(result,
+                                 "Transform %d (%s)", (int)transform, SDL_GetError())) {
+            return false;
+        }
+    }
+    SDL_SeekIO(*src, 0, SDL_IO_SEEK_SET);
+    return true;
+}
+
+static SDL_Surface *
+LoadTransformedJPG(SDL_IOStream *src, IMG_JPGTransform transform, int count)
+{
+    SDL_IOStream *mem;
+    SDL_Surface *surface = NULL;
+    Sint64 size = SDL_GetIOSize(src);
+    void *data;
+
+    /* Work on a copy so the original stays available */
+    data = SDL_malloc((size_t)size);
+    if (!data) {
+        return NULL;
+    }
+    SDL_SeekIO(src, 0, SDL_IO_SEEK_SET);
+    SDL_ReadIO(src, data, (size_t)size);
+    mem = SDL_IOFromConstMem(data, (size_t)size);
+
+    if (mem && TransformJPG(&mem, transform, count)) {
+        surface = IMG_Load_IO(mem, false);
+        if (SDLTest_AssertCheck(surface != NULL,
+                                "Load transformed JPG (%s)", SDL_GetError())) {
+            ConvertToRgba32(&surface);
+        }
+    }
+    if (mem) {
+        SDL_CloseIO(mem);
+    }
+    SDL_free(data);
+    return surface;
+}
+
+/* An Exif APP1 marker holding only the orientation tag, 6 is rotated by 90 degrees */
+static const Uint8 jpg_exif_rotate_90[] = {
+    0xFF, 0xE1, 0x00, 0x22, 'E', 'x', 'i', 'f', 0x00, 0x00, 'M', 'M',
+    0x00, 0x2A, 0x00, 0x00, 0x00, 0x08, 0x00, 0x01, 0x01, 0x12, 0x00, 0x03,
+    0x00, 0x00, 0x00, 0x01, 0x00, 0x06, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+/* Copy a JPG into a new stream with jpg_exif_rotate_90 after the SOI marker */
+static SDL_IOStream *
+AddExifOrientation(SDL_IOStream *jpg)
+{
+    SDL_IOStream *result = SDL_IOFromDynamicMem();
+    Uint8 buffer[1024];
+    size_t size;
+
+    if (!result) {
+        return NULL;
+    }
+    SDL_SeekIO(jpg, 0, SDL_IO_SEEK_SET);
+    if (SDL_ReadIO(jpg, buffer, 2) != 2 || SDL_WriteIO(result, buffer, 2) != 2 ||
+        SDL_WriteIO(result, jpg_exif_rotate_90, sizeof(jpg_exif_rotate_90)) != sizeof(jpg_exif_rotate_90)) {
+        SDL_CloseIO(result);
+        return NULL;
+    }
+    while ((size = SDL_ReadIO(jpg, buffer, sizeof(buffer))) > 0) {
+        if (SDL_WriteIO(result, buffer, size) != size) {
+            SDL_CloseIO(result);
+            return NULL;
+        }
+    }
+    return result;
+}
+
+static int SDLCALL
+TestJPGTransform(void *arg)
+{
+    SDL_Surface *surface;
+    SDL_Surface *reference = NULL;
+    SDL_Surface *rotated = NULL;
+    SDL_Surface *transformed;
+    SDL_IOStream *jpg;
+    SDL_IOStream *exif = NULL;
+    int diff;
+    (void)arg;
+
+    /* A whole number of 16x16 blocks, so no edge blocks are trimmed */
+    surface = CreateTestSurface(64, 48);
+    if (!surface) {
+        return TEST_ABORTED;
+    }
+    jpg = SDL_IOFromDynamicMem();
+    if (!SDLTest_AssertCheck(jpg != NULL && IMG_SaveJPG_IO(surface, jpg, false, 90),
+                             "Save JPG to memory (%s)", SDL_GetError())) {
+        goto out;
+    }
+    SDL_SeekIO(jpg, 0, SDL_IO_SEEK_SET);
+    reference = IMG_Load_IO(jpg, false);
+    if (!SDLTest_AssertCheck(reference != NULL,
+                             "Load JPG from memory (%s)", SDL_GetError())) {
+        goto out;
+    }
+    ConvertToRgba32(&reference);
+
+    rotated = LoadTransformedJPG(jpg, IMG_JPG_TRANSFORM_ROTATE_90, 1);
+    if (rotated) {
+        SDLTest_AssertCheck(rotated->w == reference->h && rotated->h == reference->w,
+                            "Rotating %dx%d by 90 degrees should give %dx%d, got %dx%d",
+                            reference->w, reference->h, reference->h, reference->w,
+                            rotated->w, rotated->h);
+    }
+
+    transformed = LoadTransformedJPG(jpg, IMG_JPG_TRANSFORM_ROTATE_90, 4);
+    if (transformed) {
+        diff = SDLTest_CompareSurfaces(transformed, reference, 0);
+        SDLTest_AssertCheck(diff == 0,
+                            "Rotating by 90 degrees four times changed %d pixels", diff);
+        SDL_DestroySurface(transformed);
+    }
+
+    transformed = LoadTransformedJPG(jpg, IMG_JPG_TRANSFORM_FLIP_H, 2);
+    if (transformed) {
+        diff = SDLTest_CompareSurfaces(transformed, reference, 0);
+        SDLTest_AssertCheck(diff == 0,
+                            "Flipping horizontally twice changed %d pixels", diff);
+        SDL_DestroySurface(transformed);
+    }
+
+    /* The Exif orientation is applied once, then reset to normal */
+    exif = AddExifOrientation(jpg);
+    if (rotated && SDLTest_AssertCheck(exif != NULL,
+                                       "Add an Exif orientation (%s)", SDL_GetError())) {
+        transformed = LoadTransformedJPG(exif, IMG_JPG_TRANSFORM_EXIF, 2);
+        if (transformed) {
+            diff = SDLTest_CompareSurfaces(transformed, rotated, 0);
+            SDLTest_AssertCheck(diff == 0,
+                                "Applying the Exif orientation twice differed from one rotation in %d pixels", diff);
+            SDL_DestroySurface(transformed);
+        }
+    }
+
+out:
+    if (exif) {
+        SDL_CloseIO(exif);
+    }
+    if (rotated) {
+        SDL_DestroySurface(rotated);
+    }
+    if (reference) {
+        SDL_DestroySurface(reference);
+    }
+    if (jpg) {
+        SDL_CloseIO(jpg);
+    }
+    SDL_DestroySurface(surface);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference jpgTransformTestCase = {
+    TestJPGTransform, "JPGTransform", "Losslessly rotate and flip JPG images", TEST_ENABLED
+};
+#endif
+
+#if ((USING_IMAGEIO && defined(PNG_USES_IMAGEIO)) || defined(SDL_IMAGE_USE_WIC_BACKEND) || defined(LOAD_PNG)) && SDL_IMAGE_SAVE_PNG
+static int SDLCALL
+TestPNGSaveThreads(void *arg)
+{
+    SDL_Surface *surface;
+    SDL_Surface *result;
+    SDL_PropertiesID props;
+    int diff;
+    (void)arg;
+
+    /* Large enough to be compressed in several stripes */
+    surface = CreateTestSurface(512, 512);
+    if (!surface) {
+        return TEST_ABORTED;
+    }
+    props = SDL_CreateProperties();
+    SDL_SetNumberProperty(props, IMG_PROP_PNG_SAVE_THREADS_NUMBER, 4);
+
+    result = SaveAndReload(surface, IMG_SavePNGWithProperties, props);
+    if (result) {
+        diff = SDLTest_CompareSurfaces(result, surface, 0);
+        SDLTest_AssertCheck(diff == 0,
+                            "Threaded PNG differed from the original in %d pixels", diff);
+        SDL_DestroySurface(result);
+    }
+
+    SDL_DestroyProperties(props);
+    SDL_DestroySurface(surface);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference pngSaveThreadsTestCase = {
+    TestPNGSaveThreads, "PNGSaveThreads", "Save PNG images on several threads", TEST_ENABLED
+};
+
+static int SDLCALL
+TestPNGSavePalette(void *arg)
+{
+    static const struct {
+        int colors;
+        int depth;
+    } cases[] = {
+        { 2, 1 },
+        { 4, 2 },
+        { 16, 4 },
+        { 256, 8 }
+    };
+    SDL_PropertiesID props;
+    SDL_IOStream *mem;
+    size_t i;
+    (void)arg;
+
+    props = SDL_CreateProperties();
+
+    for (i = 0; i < SDL_arraysize(cases); i++) {
+        SDL_Surface *surface;
+        SDL_Surface *result = NULL;
+        Uint8 header[26];
+        int x, y, diff;
+
+        /* An odd width leaves a partly filled byte at the end of each row */
+        surface = SDL_CreateSurface(37, 23, SDL_PIXELFORMAT_RGBA32);
+        if (!SDLTest_AssertCheck(surface != NULL,
+                                 "Creating surface should succeed (%s)",
+                                 SDL_GetError())) {
+            break;
+        }
+        for (y = 0; y < surface->h; y++) {
+            Uint8 *p = (Uint8 *)surface->pixels + y * surface->pitch;
+
+            for (x = 0; x < surface->w; x++) {
+                int color = (x * 7 + y * 3) % cases[i].colors;
+
+                *p++ = (Uint8)(color * 37);
+                *p++ = (Uint8)(color * 91);
+                *p++ = (Uint8)(color * 53);
+                *p++ = (color % 3) ? 255 : 128;
+            }
+        }
+
+        SDL_SetNumberProperty(props, IMG_PROP_PNG_SAVE_PALETTE_COLORS_NUMBER, cases[i].colors);
+        mem = SDL_IOFromDynamicMem();
+        SDL_ClearError();
+        if (SDLTest_AssertCheck(mem && IMG_SavePNGWithProperties(surface, mem, false, props),
+                                "Save PNG with %d colors (%s)", cases[i].colors, SDL_GetError())) {
+            /* The bit depth and color type follow the signature and the IHDR chunk header */
+            SDL_SeekIO(mem, 0, SDL_IO_SEEK_SET);
+            if (SDLTest_AssertCheck(SDL_ReadIO(mem, header, sizeof(header)) == sizeof(header),
+                                    "Read PNG header")) {
+                SDLTest_AssertCheck(header[24] == cases[i].depth && header[25] == 3,
+                                    "Expected %d-bit indexed PNG, got bit depth %d, color type %d",
+                                    cases[i].depth, header[24], header[25]);
+            }
+
+            SDL_SeekIO(mem, 0, SDL_IO_SEEK_SET);
+            result = IMG_Load_IO(mem, false);
+            if (SDLTest_AssertCheck(result != NULL,
+                                    "Load indexed PNG (%s)", SDL_GetError()) &&
+                ConvertToRgba32(&result)) {
+                diff = SDLTest_CompareSurfaces(result, surface, 0);
+                SDLTest_AssertCheck(diff == 0,
+                                    "PNG with %d colors differed from the original in %d pixels",
+                                    cases[i].colors, diff);
+            }
+        }
+
+        if (result) {
+            SDL_DestroySurface(result);
+        }
+        if (mem) {
+            SDL_CloseIO(mem);
+        }
+        SDL_DestroySurface(surface);
+    }
+
+    /* A missing surface is rejected before trying to quantize it */
+    mem = SDL_IOFromDynamicMem();
+    if (mem) {
+        SDL_ClearError();
+        SDLTest_AssertCheck(!IMG_SavePNGWithProperties(NULL, mem, false, props),
+                            "Saving a NULL surface should fail (%s)", SDL_GetError());
+        SDL_CloseIO(mem);
+    }
+
+    SDL_DestroyProperties(props);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference pngSavePaletteTestCase = {
+    TestPNGSavePalette, "PNGSavePalette", "Save PNG images with a reduced palette", TEST_ENABLED
+};
+#endif
+
+/* libpng and stb_image honor IMG_HINT_PNG_LOAD_16BIT */
+#if defined(LOAD_PNG) && (defined(USE_STBIMAGE) || \
+    !(defined(SDL_IMAGE_USE_WIC_BACKEND) || (USING_IMAGEIO && defined(PNG_USES_IMAGEIO))))
+/* 3x1 16-bit gray, with 0x8001 as the transparent color */
+static const Uint8 png_gray16_key[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01,
+    0x10, 0x00, 0x00, 0x00, 0x00, 0x6e, 0x1b, 0x97, 0x2b, 0x00, 0x00, 0x00,
+    0x02, 0x74, 0x52, 0x4e, 0x53, 0x80, 0x01, 0x3a, 0x17, 0x65, 0xe5, 0x00,
+    0x00, 0x00, 0x0f, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x10, 0x32,
+    0x69, 0x60, 0xfc, 0x77, 0x07, 0x00, 0x06, 0x52, 0x02, 0xa2, 0xe3, 0x71,
+    0x00, 0x94, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42,
+    0x60, 0x82,
+};
+/* 3x1 16-bit RGB, with 0x0102, 0x0304, 0x0506 as the transparent color */
+static const Uint8 png_rgb16_key[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01,
+    0x10, 0x02, 0x00, 0x00, 0x00, 0xc4, 0x12, 0x5f, 0xa0, 0x00, 0x00, 0x00,
+    0x06, 0x74, 0x52, 0x4e, 0x53, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x5e,
+    0x92, 0xd1, 0x16, 0x00, 0x00, 0x00, 0x1b, 0x49, 0x44, 0x41, 0x54, 0x78,
+    0xda, 0x63, 0x10, 0x32, 0x09, 0xab, 0x98, 0xb5, 0x87, 0x91, 0x89, 0x99,
+    0x85, 0x95, 0xed, 0xff, 0x7f, 0x06, 0x86, 0x06, 0x46, 0x00, 0x2f, 0xd7,
+    0x04, 0xff, 0x28, 0x09, 0x49, 0x0f, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45,
+    0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+/* The same pixels without a transparent color */
+static const Uint8 png_rgb16[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x01,
+    0x10, 0x02, 0x00, 0x00, 0x00, 0xc4, 0x12, 0x5f, 0xa0, 0x00, 0x00, 0x00,
+    0x1b, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x10, 0x32, 0x09, 0xab,
+    0x98, 0xb5, 0x87, 0x91, 0x89, 0x99, 0x85, 0x95, 0xed, 0xff, 0x7f, 0x06,
+    0x86, 0x06, 0x46, 0x00, 0x2f, 0xd7, 0x04, 0xff, 0x28, 0x09, 0x49, 0x0f,
+    0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+/* Load a 16-bit PNG and check its format and every sample */
+static void
+CheckPNG16(const char *name, const Uint8 *data, size_t size, SDL_PixelFormat format, const Uint16 *expected)
+{
+    SDL_Surface *surface;
+    const Uint16 *pixels;
+    int i, channels, wrong = 0;
+
+    SDL_ClearError();
+    surface = IMG_LoadTyped_IO(SDL_IOFromConstMem(data, size), true, "PNG");
+    if (!SDLTest_AssertCheck(surface != NULL,
+                             "Load %s (%s)", name, SDL_GetError())) {
+        return;
+    }
+    if (SDLTest_AssertCheck(surface->format == format,
+                            "%s should be loaded as %s, got %s", name,
+                            SDL_GetPixelFormatName(format),
+                            SDL_GetPixelFormatName(surface->format))) {
+        channels = SDL_BYTESPERPIXEL(format) / 2;
+        pixels = (const Uint16 *)surface->pixels;
+        for (i = 0; i < surface->w * channels; i++) {
+            if (pixels[i] != expected[i]) {
+                ++wrong;
+            }
+        }
+        SDLTest_AssertCheck(wrong == 0, "%s had %d wrong samples", name, wrong);
+    }
+    SDL_DestroySurface(surface);
+}
+
+static int SDLCALL
+TestPNGLoad16Bit(void *arg)
+{
+    static const Uint16 gray_key[] = {
+        0x1234, 0x1234, 0x1234, 0xFFFF, 0x8001, 0x8001, 0x8001, 0x0000, 0xFEDC, 0xFEDC, 0xFEDC, 0xFFFF
+    };
+    static const Uint16 rgb_key[] = {
+        0x1234, 0x5678, 0x9ABC, 0xFFFF, 0x0102, 0x0304, 0x0506, 0x0000, 0xFFFF, 0x0000, 0x8001, 0xFFFF
+    };
+    static const Uint16 rgb[] = {
+        0x1234, 0x5678, 0x9ABC, 0x0102, 0x0304, 0x0506, 0xFFFF, 0x0000, 0x8001
+    };
+    SDL_Surface *surface;
+    (void)arg;
+
+    SDL_SetHint(IMG_HINT_PNG_LOAD_16BIT, "1");
+    CheckPNG16("16-bit gray PNG with a color key", png_gray16_key, sizeof(png_gray16_key), SDL_PIXELFORMAT_RGBA64, gray_key);
+    CheckPNG16("16-bit RGB PNG with a color key", png_rgb16_key, sizeof(png_rgb16_key), SDL_PIXELFORMAT_RGBA64, rgb_key);
+    CheckPNG16("16-bit RGB PNG", png_rgb16, sizeof(png_rgb16), SDL_PIXELFORMAT_RGB48, rgb);
+
+    /* By default the samples are reduced to 8 bits */
+    SDL_ResetHint(IMG_HINT_PNG_LOAD_16BIT);
+    surface = IMG_LoadTyped_IO(SDL_IOFromConstMem(png_rgb16_key, sizeof(png_rgb16_key)), true, "PNG");
+    if (SDLTest_AssertCheck(surface != NULL,
+                            "Load 16-bit PNG without the hint (%s)", SDL_GetError())) {
+        SDLTest_AssertCheck(SDL_BITSPERPIXEL(surface->format) <= 32,
+                            "16-bit PNG should be reduced to 8 bits without the hint, got %s",
+                            SDL_GetPixelFormatName(surface->format));
+        SDL_DestroySurface(surface);
+    }
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference pngLoad16BitTestCase = {
+    TestPNGLoad16Bit, "PNGLoad16Bit", "Load 16-bit PNG images at full precision", TEST_ENABLED
+};
+
+/* Find the data of the last IDAT chunk of a PNG, returning its offset, or 0 if there isn't one */
+static size_t
+FindLastIDAT(const Uint8 *png, size_t size, Uint32 *length)
+{
+    size_t offset = 8;
+    size_t found = 0;
+
+    while (offset + 12 <= size) {
+        Uint32 chunk_length = ((Uint32)png[offset] << 24) | ((Uint32)png[offset + 1] << 16) |
+                              ((Uint32)png[offset + 2] << 8) | png[offset + 3];
+
+        if (chunk_length > size - offset - 12) {
+            break;
+        }
+        if (SDL_memcmp(png + offset + 4, "IDAT", 4) == 0) {
+            found = offset + 8;
+            *length = chunk_length;
+        }
+        offset += 12 + chunk_length;
+    }
+    return found;
+}
+
+/* Load a corrupted PNG, which should only succeed when checksums are skipped */
+static void
+CheckPNGChecksums(const char *name, const Uint8 *data, size_t size, SDL_Surface *reference)
+{
+    SDL_Surface *surface;
+    int diff;
+
+    SDL_ResetHint(IMG_HINT_PNG_SKIP_CHECKSUMS);
+    surface = IMG_LoadTyped_IO(SDL_IOFromConstMem(data, size), true, "PNG");
+    SDLTest_AssertCheck(surface == NULL, "PNG with %s should fail to load by default", name);
+    SDL_DestroySurface(surface);
+
+    SDL_SetHint(IMG_HINT_PNG_SKIP_CHECKSUMS, "1");
+    surface = IMG_LoadTyped_IO(SDL_IOFromConstMem(data, size), true, "PNG");
+    if (SDLTest_AssertCheck(surface != NULL,
+                            "PNG with %s should load when skipping checksums (%s)", name, SDL_GetError())) {
+        diff = SDLTest_CompareSurfaces(surface, reference, 0);
+        SDLTest_AssertCheck(diff == 0,
+                            "PNG with %s differed from the original in %d pixels", name, diff);
+        SDL_DestroySurface(surface);
+    }
+    SDL_ResetHint(IMG_HINT_PNG_SKIP_CHECKSUMS);
+}
+
+static int SDLCALL
+TestPNGSkipChecksums(void *arg)
+{
+    SDL_Surface *reference;
+    char *filename;
+    Uint8 *data;
+    size_t size = 0;
+    size_t idat;
+    Uint32 length = 0;
+    Uint32 crc;
+    (void)arg;
+
+    filename = GetTestFilename(TEST_FILE_DIST, "sample.png");
+    data = filename ? (Uint8 *)SDL_LoadFile(filename, &size) : NULL;
+    SDL_free(filename);
+    if (!SDLTest_AssertCheck(data != NULL, "Read sample.png (%s)", SDL_GetError())) {
+        return TEST_ABORTED;
+    }
+    idat = FindLastIDAT(data, size, &length);
+    reference = IMG_LoadTyped_IO(SDL_IOFromConstMem(data, size), true, "PNG");
+    if (!SDLTest_AssertCheck(idat > 0 && length > 4 && reference != NULL,
+                             "Load sample.png (%s)", SDL_GetError())) {
+        SDL_DestroySurface(reference);
+        SDL_free(data);
+        return TEST_ABORTED;
+    }
+
+    /* The CRC follows the chunk data */
+    data[idat + length] ^= 0x01;
+    CheckPNGChecksums("a wrong chunk CRC", data, size, reference);
+    data[idat + length] ^= 0x01;
+
+    /* The Adler-32 ends the zlib stream, the chunk CRC is updated to match */
+    data[idat + length - 1] ^= 0x01;
+    crc = SDL_crc32(0, data + idat - 4, length + 4);
+    data[idat + length] = (Uint8)(crc >> 24);
+    data[idat + length + 1] = (Uint8)(crc >> 16);
+    data[idat + length + 2] = (Uint8)(crc >> 8);
+    data[idat + length + 3] = (Uint8)crc;
+    CheckPNGChecksums("a wrong Adler-32", data, size, reference);
+
+    SDL_DestroySurface(reference);
+    SDL_free(data);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference pngSkipChecksumsTestCase = {
+    TestPNGSkipChecksums, "PNGSkipChecksums", "Load PNG images with bad checksums when skipping them", TEST_ENABLED
+};
+#endif
+
+#ifdef LOAD_PNG
+/* 10x7 RGB, Adam7 interlaced */
+static const Uint8 png_interlaced[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x0a, 0x00, 0x00, 0x00, 0x07,
+    0x08, 0x02, 0x00, 0x00, 0x01, 0xc9, 0xc9, 0x7b, 0xa2, 0x00, 0x00, 0x00,
+    0xb2, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x0d, 0xce, 0x21, 0x19, 0x03,
+    0x20, 0x10, 0x06, 0xd0, 0x5f, 0x2c, 0x02, 0x62, 0xf8, 0x13, 0x88, 0x29,
+    0x34, 0x01, 0xee, 0xfb, 0x30, 0x84, 0x38, 0x79, 0x01, 0x30, 0x34, 0x40,
+    0xa0, 0xd0, 0x6b, 0x80, 0xb9, 0x10, 0x44, 0x40, 0xcc, 0xd0, 0x60, 0x11,
+    0xb6, 0x97, 0xe0, 0x01, 0xc0, 0xc6, 0x1b, 0x82, 0x02, 0x8c, 0x22, 0x03,
+    0x7b, 0x7c, 0x11, 0x11, 0x26, 0x2a, 0xe2, 0xa8, 0x73, 0x04, 0x80, 0x43,
+    0x64, 0x08, 0xd7, 0xc9, 0x65, 0xf3, 0x06, 0x4e, 0x8d, 0xa7, 0xc8, 0x09,
+    0xf3, 0x60, 0x9f, 0x27, 0x3c, 0x5c, 0x46, 0x6a, 0x90, 0x85, 0x7e, 0x61,
+    0xf0, 0x9c, 0x32, 0xbb, 0xc6, 0x7d, 0xb1, 0x5c, 0xfe, 0xc0, 0x0f, 0xc9,
+    0xa3, 0xb7, 0xe1, 0xd6, 0x48, 0x77, 0x3c, 0xe0, 0x4f, 0xcf, 0x47, 0xda,
+    0x49, 0xeb, 0xb8, 0x7b, 0x5e, 0x00, 0x39, 0x4f, 0x88, 0x94, 0x32, 0x05,
+    0x21, 0x69, 0x54, 0x26, 0xf5, 0x45, 0x75, 0x93, 0x5d, 0x7a, 0x03, 0x9a,
+    0xbc, 0x86, 0xa8, 0x2e, 0x2b, 0x44, 0x7b, 0xd3, 0x3a, 0x55, 0x96, 0x96,
+    0xad, 0x9f, 0xab, 0xff, 0x8d, 0x89, 0xb7, 0x12, 0xad, 0x67, 0xab, 0x62,
+    0xae, 0x19, 0xa6, 0xa5, 0x65, 0x61, 0xdb, 0xe3, 0xda, 0xf7, 0x07, 0x95,
+    0xed, 0x53, 0xb8, 0x40, 0xfc, 0xae, 0x62, 0x00, 0x00, 0x00, 0x00, 0x49,
+    0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+
+/* The rows of a PNG stream, copied out as they're reported */
+typedef struct
+{
+    SDL_Surface *rows;
+    int calls;
+    bool bad_row;
+} PNGStreamRows;
+
+static void SDLCALL
+PNGStreamRowCallback(void *userdata, SDL_Surface *surface, int row, int pass)
+{
+    PNGStreamRows *rows = (PNGStreamRows *)userdata;
+
+    ++rows->calls;
+    if (row < 0 || row >= surface->h || pass < 0 || pass > 6) {
+        rows->bad_row = true;
+        return;
+    }
+    if (!rows->rows) {
+        rows->rows = SDL_CreateSurface(surface->w, surface->h, surface->format);
+        if (!rows->rows) {
+            rows->bad_row = true;
+            return;
+        }
+    }
+    SDL_memcpy((Uint8 *)rows->rows->pixels + row * rows->rows->pitch,
+               (const Uint8 *)surface->pixels + row * surface->pitch,
+               (size_t)surface->w * SDL_BYTESPERPIXEL(surface->format));
+}
+
+/* Feed a PNG to a stream in pieces of the given size and compare the rows
+   it reports with the image loaded in one go */
+static void
+CheckPNGStream(const char *name, const Uint8 *data, size_t size, size_t piece)
+{
+    PNGStreamRows rows;
+    IMG_PNGStream *stream;
+    SDL_Surface *reference;
+    SDL_Surface *surface;
+    size_t offset, length;
+    bool fed = true;
+    int diff;
+
+    reference = IMG_Load_IO(SDL_IOFromConstMem(data, size), true);
+    if (!SDLTest_AssertCheck(reference != NULL,
+                             "Load %s (%s)", name, SDL_GetError())) {
+        return;
+    }
+
+    SDL_zero(rows);
+    stream = IMG_CreatePNGStream(PNGStreamRowCallback, &rows);
+    if (!SDLTest_AssertCheck(stream != NULL,
+                             "IMG_CreatePNGStream (%s)", SDL_GetError())) {
+        SDL_DestroySurface(reference);
+        return;
+    }
+    for (offset = 0; offset < size && fed; offset += length) {
+        length = SDL_min(piece, size - offset);
+        fed = IMG_FeedPNGStream(stream, data + offset, length);
+    }
+    SDLTest_AssertCheck(fed, "Feed %s in pieces of %d bytes (%s)", name, (int)piece, SDL_GetError());
+    surface = IMG_ClosePNGStream(stream);
+    if (SDLTest_AssertCheck(surface != NULL,
+                            "Close stream of %s in pieces of %d bytes (%s)", name, (int)piece, SDL_GetError())) {
+        diff = SDLTest_CompareSurfaces(surface, reference, 0);
+        SDLTest_AssertCheck(diff == 0,
+                            "%s streamed in pieces of %d bytes differed in %d pixels", name, (int)piece, diff);
+        SDL_DestroySurface(surface);
+    }
+
+    SDLTest_AssertCheck(!rows.bad_row && rows.calls >= reference->h,
+                        "%s should report every row, got %d calls", name, rows.calls);
+    if (rows.rows && !rows.bad_row) {
+        diff = SDLTest_CompareSurfaces(rows.rows, reference, 0);
+        SDLTest_AssertCheck(diff == 0,
+                            "Rows reported for %s in pieces of %d bytes differed in %d pixels", name, (int)piece, diff);
+    }
+    SDL_DestroySurface(rows.rows);
+    SDL_DestroySurface(reference);
+}
+
+static int SDLCALL
+TestPNGStream(void *arg)
+{
+    static const size_t pieces[] = { 1, 3, 7, 13, 64, 1000 };
+    char *filename;
+    Uint8 *data;
+    size_t size = 0;
+    size_t i;
+    (void)arg;
+
+    filename = GetTestFilename(TEST_FILE_DIST, "sample.png");
+    data = filename ? (Uint8 *)SDL_LoadFile(filename, &size) : NULL;
+    SDL_free(filename);
+    if (!SDLTest_AssertCheck(data != NULL, "Read sample.png (%s)", SDL_GetError())) {
+        return TEST_ABORTED;
+    }
+    for (i = 0; i < SDL_arraysize(pieces); i++) {
+        CheckPNGStream("sample.png", data, size, pieces[i]);
+        CheckPNGStream("interlaced PNG", png_interlaced, sizeof(png_interlaced), pieces[i]);
+    }
+    SDL_free(data);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference pngStreamTestCase = {
+    TestPNGStream, "PNGStream", "Decode PNG images fed to a stream a few bytes at a time", TEST_ENABLED
+};
+
+/* 5x10 images whose rows cycle through all five filter types, and the same
+   pixels interlaced, which the built-in decoder of stb_image builds leaves
+   to stb_image */
+static const Uint8 png_filters_gray[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0a,
+    0x08, 0x00, 0x00, 0x00, 0x00, 0x59, 0x52, 0xcb, 0xec, 0x00, 0x00, 0x00,
+    0x45, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0xe8, 0x95, 0x5e,
+    0x61, 0xc6, 0x78, 0x8c, 0x8d, 0x8d, 0x9d, 0x8d, 0xe9, 0x98, 0xfd, 0x0e,
+    0x83, 0x95, 0xcc, 0x4d, 0xf1, 0xf2, 0x17, 0x2f, 0xb0, 0x30, 0x30, 0x30,
+    0x18, 0x14, 0x30, 0xdc, 0x3f, 0xb1, 0x61, 0x66, 0x13, 0xe3, 0xd2, 0xc4,
+    0xa4, 0xc4, 0x24, 0xa0, 0xec, 0x76, 0xc3, 0x95, 0xcc, 0x7f, 0x3c, 0xdb,
+    0x9c, 0xfe, 0xb1, 0x1c, 0x3f, 0xbd, 0xdd, 0x60, 0x05, 0x00, 0x4d, 0x11,
+    0x16, 0xb0, 0x1f, 0x0c, 0xd8, 0x97, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45,
+    0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+static const Uint8 png_filters_gray_interlaced[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0a,
+    0x08, 0x00, 0x00, 0x00, 0x01, 0x2e, 0x55, 0xfb, 0x7a, 0x00, 0x00, 0x00,
+    0x51, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x01, 0x46, 0x00, 0xb9, 0xff,
+    0x00, 0x00, 0x01, 0x31, 0x02, 0x36, 0x03, 0x62, 0x04, 0xc8, 0x11, 0x00,
+    0x1b, 0x01, 0xc8, 0x02, 0x0f, 0x03, 0x8c, 0x44, 0x43, 0x04, 0x19, 0xc3,
+    0xc3, 0x00, 0x8d, 0xa8, 0x01, 0x0b, 0xfe, 0x02, 0xbd, 0x60, 0x03, 0xa2,
+    0x92, 0x04, 0x7e, 0x61, 0x00, 0xc6, 0xcc, 0xd2, 0xd9, 0xdf, 0x01, 0xc8,
+    0x00, 0x00, 0x71, 0xf7, 0x02, 0x17, 0x00, 0xe8, 0x60, 0x52, 0x03, 0xfc,
+    0xac, 0xa5, 0x9e, 0x16, 0x04, 0x8d, 0xcb, 0xcb, 0x60, 0xcb, 0xcc, 0xb3,
+    0x19, 0x29, 0x08, 0x9a, 0x75, 0x9c, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45,
+    0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+static const Uint8 png_filters_gray_alpha[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0a,
+    0x08, 0x04, 0x00, 0x00, 0x00, 0xd6, 0x30, 0x5c, 0xbb, 0x00, 0x00, 0x00,
+    0x6e, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x70, 0xeb, 0xbd,
+    0x2c, 0x9d, 0xb8, 0xe2, 0xbd, 0x59, 0x0d, 0xe3, 0x31, 0x1e, 0x36, 0x36,
+    0x36, 0x76, 0x76, 0x20, 0xc1, 0x74, 0xec, 0x98, 0xbd, 0xfd, 0x8e, 0xed,
+    0x06, 0x06, 0x2b, 0x57, 0x32, 0x37, 0xc5, 0xc7, 0xdb, 0xc8, 0xff, 0xb9,
+    0xf8, 0xe5, 0xc2, 0x45, 0x16, 0x06, 0x30, 0x30, 0x30, 0x28, 0x28, 0x64,
+    0xb8, 0xaf, 0x7a, 0x82, 0x6f, 0xc3, 0xf7, 0x99, 0xf7, 0x9b, 0x4e, 0x30,
+    0x2e, 0x7d, 0x9d, 0x98, 0x94, 0x94, 0x08, 0xc2, 0x60, 0x6d, 0xdb, 0x77,
+    0x18, 0x82, 0xb4, 0xfd, 0x51, 0xf0, 0xf4, 0x68, 0x6b, 0x75, 0x72, 0xfa,
+    0x57, 0xc7, 0x72, 0xfc, 0xd8, 0xe9, 0x89, 0xdb, 0xcf, 0x18, 0x9c, 0x5e,
+    0xb1, 0x12, 0x00, 0xb6, 0xf9, 0x2d, 0x68, 0x7d, 0x14, 0x97, 0x21, 0x00,
+    0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+static const Uint8 png_filters_gray_alpha_interlaced[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0a,
+    0x08, 0x04, 0x00, 0x00, 0x01, 0xa1, 0x37, 0x6c, 0x2d, 0x00, 0x00, 0x00,
+    0x7f, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x70, 0x63, 0x34,
+    0xac, 0x60, 0x32, 0xab, 0x61, 0x4e, 0x6a, 0x65, 0x39, 0x71, 0x42, 0x30,
+    0x82, 0x41, 0x3a, 0x91, 0xf1, 0xc4, 0x09, 0x26, 0xfe, 0x50, 0xe6, 0x9e,
+    0x4b, 0x2e, 0xe9, 0xce, 0x69, 0x2c, 0x92, 0x92, 0x87, 0x81, 0x80, 0xa1,
+    0xf7, 0xf2, 0x8a, 0xf7, 0x8c, 0xdc, 0x81, 0xff, 0xfe, 0x31, 0xed, 0x2d,
+    0x4f, 0x48, 0x60, 0x5e, 0xf4, 0x72, 0xd2, 0x24, 0x96, 0xba, 0xda, 0xc4,
+    0x65, 0x0c, 0xc7, 0x78, 0xce, 0x08, 0x5d, 0x92, 0xbc, 0x29, 0x7f, 0x5f,
+    0x15, 0xa8, 0x8f, 0x01, 0x08, 0x0a, 0xb7, 0x7f, 0xff, 0xc1, 0x24, 0x1e,
+    0xcb, 0xe0, 0xf6, 0x42, 0x3f, 0x21, 0x21, 0x28, 0x90, 0xf9, 0xcf, 0xfc,
+    0x35, 0xba, 0x4b, 0x97, 0xce, 0x9b, 0x27, 0x36, 0x8d, 0xa5, 0xb7, 0xf7,
+    0xf4, 0xe9, 0xd3, 0x67, 0x12, 0x80, 0x18, 0x00, 0x88, 0x7d, 0x32, 0x1f,
+    0x6d, 0xa6, 0xf8, 0x01, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44,
+    0xae, 0x42, 0x60, 0x82,
+};
+static const Uint8 png_filters_rgb[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0a,
+    0x08, 0x02, 0x00, 0x00, 0x00, 0xf3, 0x5b, 0x03, 0x67, 0x00, 0x00, 0x00,
+    0x95, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x70, 0xeb, 0xe9,
+    0xbd, 0x2c, 0x25, 0x9d, 0xb8, 0x7c, 0xc5, 0x7b, 0x53, 0xb3, 0x9a, 0x43,
+    0x8c, 0xc7, 0x78, 0x82, 0xd8, 0xd8, 0xd8, 0xc1, 0x10, 0x04, 0x98, 0x8e,
+    0x1d, 0x3b, 0x6e, 0x6f, 0x6f, 0xb7, 0x63, 0xfb, 0x76, 0x03, 0x03, 0x83,
+    0x95, 0x2b, 0x57, 0x32, 0x37, 0xc5, 0xef, 0x89, 0xb7, 0x91, 0x94, 0xff,
+    0x13, 0x79, 0xf1, 0x8b, 0xf8, 0x85, 0x8b, 0x81, 0x2c, 0x0c, 0x30, 0x60,
+    0x60, 0x60, 0x58, 0x50, 0x58, 0xc0, 0x70, 0x5f, 0x35, 0xfb, 0x04, 0x5f,
+    0xc8, 0x86, 0xef, 0xb6, 0x33, 0xef, 0xab, 0x35, 0x9d, 0xe0, 0x67, 0x5c,
+    0xfa, 0xda, 0x30, 0x31, 0x29, 0x29, 0x29, 0x31, 0x11, 0x42, 0x42, 0xcc,
+    0xb3, 0xdf, 0xbe, 0x63, 0x87, 0x21, 0xc4, 0xbc, 0x3f, 0x0a, 0x4e, 0x9e,
+    0x1e, 0x9e, 0x6d, 0xad, 0x6c, 0x4e, 0x4e, 0x8e, 0xff, 0xea, 0xea, 0x58,
+    0x8e, 0x1f, 0x3b, 0x76, 0x7a, 0xa2, 0xfd, 0xf6, 0x33, 0xdb, 0x0d, 0x4e,
+    0x37, 0xad, 0x58, 0xb9, 0x12, 0x00, 0xab, 0x89, 0x3e, 0x99, 0x28, 0xb5,
+    0x87, 0x09, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42,
+    0x60, 0x82,
+};
+static const Uint8 png_filters_rgb_interlaced[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0a,
+    0x08, 0x02, 0x00, 0x00, 0x01, 0x84, 0x5c, 0x33, 0xf1, 0x00, 0x00, 0x00,
+    0xa9, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x70, 0xeb, 0x61,
+    0x34, 0xac, 0xd8, 0xc7, 0x64, 0x56, 0x73, 0x88, 0x39, 0xa9, 0x75, 0x05,
+    0xcb, 0x89, 0x13, 0x27, 0x04, 0x23, 0xe6, 0x31, 0x48, 0x27, 0x2e, 0x67,
+    0x04, 0x32, 0x99, 0xf8, 0x43, 0xe7, 0x30, 0xf7, 0x5c, 0x92, 0x74, 0x49,
+    0xe7, 0x72, 0x4e, 0xe3, 0x64, 0x91, 0x94, 0x94, 0x38, 0x0c, 0x06, 0x0c,
+    0xbd, 0x97, 0xa5, 0x56, 0xbc, 0x37, 0x65, 0xe4, 0x0e, 0x9c, 0xfe, 0xef,
+    0xdf, 0x3f, 0xa6, 0xbd, 0xe5, 0x86, 0x09, 0x09, 0x89, 0xcc, 0x8b, 0x5e,
+    0xea, 0x4f, 0x9a, 0x34, 0x89, 0xa5, 0xae, 0xb6, 0x2e, 0x71, 0xd9, 0x52,
+    0x86, 0x63, 0x3c, 0x41, 0x67, 0x84, 0x22, 0x2f, 0x49, 0xc6, 0xdf, 0x94,
+    0x4f, 0xbd, 0xaf, 0x9a, 0x0d, 0x32, 0x8e, 0x01, 0x0c, 0x0a, 0xb7, 0xff,
+    0xfd, 0xfe, 0xe3, 0x07, 0x93, 0x78, 0xec, 0x62, 0xa0, 0xe5, 0x2f, 0xf4,
+    0x4b, 0x81, 0x5a, 0x83, 0x02, 0x83, 0x98, 0xff, 0xcc, 0x3f, 0xbc, 0x46,
+    0x57, 0x67, 0xe9, 0x52, 0xd5, 0x79, 0xf3, 0x64, 0xc5, 0xa6, 0x89, 0xb1,
+    0xf4, 0xf6, 0xf6, 0x9c, 0x3e, 0x7d, 0x06, 0x08, 0x13, 0x4e, 0x03, 0xe9,
+    0x33, 0x00, 0x04, 0xe9, 0x4a, 0x57, 0x3a, 0xf8, 0x8f, 0x7c, 0x00, 0x00,
+    0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+static const Uint8 png_filters_rgba[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0a,
+    0x08, 0x06, 0x00, 0x00, 0x00, 0x7c, 0x39, 0x94, 0x30, 0x00, 0x00, 0x00,
+    0xc1, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x70, 0xeb, 0xb9,
+    0xd4, 0x7b, 0x59, 0x2a, 0x41, 0x3a, 0x71, 0xf9, 0xbb, 0x15, 0xef, 0x4d,
+    0xab, 0xcd, 0x6a, 0x0e, 0x71, 0x32, 0x1e, 0xe3, 0x09, 0x9a, 0xc9, 0xc6,
+    0xc6, 0x0e, 0x43, 0x20, 0xc0, 0xce, 0x74, 0xec, 0xd8, 0xf1, 0x63, 0xf6,
+    0xf6, 0x76, 0xf6, 0x3b, 0xb6, 0x6f, 0xdf, 0x61, 0x60, 0x60, 0x60, 0xb8,
+    0x72, 0xe5, 0xca, 0x15, 0xcc, 0x4d, 0xf1, 0x7b, 0x66, 0xc6, 0xdb, 0x48,
+    0x7e, 0x95, 0xff, 0x13, 0x69, 0x76, 0xf1, 0x8b, 0xb8, 0xd5, 0x85, 0x8b,
+    0x81, 0x17, 0x58, 0x18, 0x90, 0x00, 0x50, 0xa1, 0x41, 0x41, 0x61, 0x41,
+    0x01, 0xc3, 0x7d, 0xd5, 0xec, 0x4d, 0x27, 0xf8, 0x42, 0x66, 0x6d, 0xf8,
+    0x6e, 0xdb, 0x3c, 0xf3, 0xbe, 0x5a, 0x4e, 0xd3, 0x09, 0xfe, 0x50, 0xc6,
+    0xa5, 0xaf, 0x0d, 0x2b, 0x12, 0x93, 0x92, 0x12, 0x93, 0x12, 0x81, 0x08,
+    0x4a, 0x43, 0x2d, 0xb2, 0xb7, 0xdf, 0xbe, 0x63, 0xc7, 0x76, 0x43, 0xa0,
+    0x4d, 0x40, 0x8b, 0x56, 0x32, 0xff, 0x51, 0x70, 0x7a, 0xea, 0xe9, 0xe1,
+    0xe9, 0xd9, 0xd6, 0xca, 0xc6, 0xe6, 0xe4, 0xe4, 0xe8, 0xf4, 0xaf, 0xae,
+    0xae, 0x96, 0xe5, 0xf8, 0xb1, 0x63, 0xc7, 0x4e, 0x4f, 0xb4, 0x3f, 0xb3,
+    0xfd, 0xcc, 0xf6, 0xed, 0x06, 0xa7, 0x9b, 0x9a, 0x57, 0xac, 0x5c, 0x79,
+    0x1a, 0x00, 0x98, 0xd5, 0x54, 0xa0, 0x00, 0xc7, 0x26, 0x50, 0x00, 0x00,
+    0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+static const Uint8 png_filters_rgba_interlaced[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x0a,
+    0x08, 0x06, 0x00, 0x00, 0x01, 0x0b, 0x3e, 0xa4, 0xa6, 0x00, 0x00, 0x00,
+    0xd1, 0x49, 0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0x60, 0x70, 0xeb, 0xb9,
+    0xc4, 0x68, 0x58, 0xb1, 0x8f, 0x85, 0xc9, 0xac, 0xe6, 0x10, 0x27, 0x73,
+    0x52, 0xeb, 0x0a, 0x6f, 0x96, 0x13, 0x40, 0x20, 0x18, 0x31, 0xef, 0x09,
+    0x83, 0x74, 0xe2, 0xf2, 0x77, 0x8c, 0x20, 0x1e, 0x13, 0x7f, 0xe8, 0x9c,
+    0x47, 0xcc, 0x3d, 0x97, 0x24, 0xe3, 0x5d, 0xd2, 0xb9, 0xf4, 0x9c, 0xd3,
+    0x38, 0x75, 0x58, 0x24, 0x25, 0x25, 0x24, 0x0f, 0x43, 0x01, 0x43, 0xef,
+    0x65, 0xa9, 0x84, 0x15, 0xef, 0x4d, 0xab, 0x19, 0xb9, 0x03, 0xa7, 0xdf,
+    0xfb, 0x07, 0x04, 0x4c, 0x7b, 0xcb, 0x0d, 0x5f, 0x25, 0x24, 0x24, 0x26,
+    0x30, 0x2f, 0x7a, 0xa9, 0x5f, 0x3a, 0x69, 0xd2, 0x24, 0x21, 0x96, 0xba,
+    0xda, 0xba, 0xba, 0xc4, 0x65, 0x4b, 0x97, 0x31, 0x1c, 0xe3, 0x09, 0x9a,
+    0x79, 0x46, 0x28, 0x72, 0x3e, 0xd0, 0xb4, 0xa5, 0x37, 0xe5, 0x53, 0x57,
+    0xdf, 0x57, 0xcd, 0xde, 0x04, 0xb6, 0x85, 0x01, 0x0a, 0x0a, 0xb7, 0xff,
+    0x75, 0xf9, 0xfe, 0xe3, 0xc7, 0x77, 0x26, 0xf1, 0xd8, 0xc5, 0xaf, 0x40,
+    0x0e, 0x7c, 0xa1, 0x5f, 0xba, 0x1b, 0x64, 0x58, 0x50, 0x60, 0x50, 0x10,
+    0xf3, 0x9f, 0xf9, 0x87, 0x9f, 0xae, 0xd1, 0xd5, 0x59, 0xb3, 0x74, 0xa9,
+    0xea, 0xd2, 0x79, 0xf3, 0x64, 0x65, 0xc5, 0xa6, 0x89, 0x89, 0xb3, 0xf4,
+    0xf6, 0xf6, 0xf4, 0x9c, 0x3e, 0x7d, 0xe6, 0xcc, 0xe9, 0x33, 0xa7, 0xf3,
+    0x13, 0x80, 0x0c, 0x10, 0x13, 0x00, 0x57, 0x4a, 0x65, 0xf7, 0x43, 0x4c,
+    0x90, 0xe4, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42,
+    0x60, 0x82,
+};
+
+static int SDLCALL
+TestPNGFilters(void *arg)
+{
+    static const struct {
+        const char *name;
+        const Uint8 *data;
+        size_t size;
+        const Uint8 *interlaced;
+        size_t interlaced_size;
+    } cases[] = {
+        { "gray", png_filters_gray, sizeof(png_filters_gray), png_filters_gray_interlaced, sizeof(png_filters_gray_interlaced) },
+        { "gray+alpha", png_filters_gray_alpha, sizeof(png_filters_gray_alpha), png_filters_gray_alpha_interlaced, sizeof(png_filters_gray_alpha_interlaced) },
+        { "RGB", png_filters_rgb, sizeof(png_filters_rgb), png_filters_rgb_interlaced, sizeof(png_filters_rgb_interlaced) },
+        { "RGBA", png_filters_rgba, sizeof(png_filters_rgba), png_filters_rgba_interlaced, sizeof(png_filters_rgba_interlaced) }
+    };
+    SDL_Surface *surface;
+    SDL_Surface *reference;
+    size_t i;
+    int diff;
+    (void)arg;
+
+    for (i = 0; i < SDL_arraysize(cases); i++) {
+        surface = IMG_LoadTyped_IO(SDL_IOFromConstMem(cases[i].data, cases[i].size), true, "PNG");
+        reference = IMG_LoadTyped_IO(SDL_IOFromConstMem(cases[i].interlaced, cases[i].interlaced_size), true, "PNG");
+        if (SDLTest_AssertCheck(surface != NULL && reference != NULL,
+                                "Load filtered %s PNG (%s)", cases[i].name, SDL_GetError()) &&
+            ConvertToRgba32(&surface) && ConvertToRgba32(&reference)) {
+            diff = SDLTest_CompareSurfaces(surface, reference, 0);
+            SDLTest_AssertCheck(diff == 0,
+                                "Filtered %s PNG differed from the interlaced one in %d pixels", cases[i].name, diff);
+        }
+        SDL_DestroySurface(surface);
+        SDL_DestroySurface(reference);
+    }
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference pngFiltersTestCase = {
+    TestPNGFilters, "PNGFilters", "Decode PNG images using every filter type", TEST_ENABLED
+};
+#endif
+
+#ifdef LOAD_GIF
+/* 16x8 with a 4 color palette, its LZW data in sub-blocks of 1 and 2 bytes */
+static const Uint8 gif_short_blocks[] = {
+    0x47, 0x49, 0x46, 0x38, 0x39, 0x61, 0x10, 0x00, 0x08, 0x00, 0x91, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00,
+    0xff, 0x2c, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00, 0x08, 0x00, 0x00, 0x08,
+    0x01, 0x00, 0x02, 0x01, 0x0c, 0x01, 0x10, 0x02, 0x10, 0x40, 0x01, 0x20,
+    0x02, 0x41, 0x83, 0x01, 0x05, 0x02, 0x07, 0x06, 0x01, 0x48, 0x02, 0x28,
+    0xe0, 0x01, 0xe0, 0x02, 0x00, 0x85, 0x01, 0x00, 0x02, 0x10, 0x12, 0x01,
+    0x2c, 0x02, 0x28, 0x70, 0x01, 0xe0, 0x02, 0xc4, 0x88, 0x01, 0x0f, 0x02,
+    0x05, 0x58, 0x01, 0x6c, 0x02, 0xb8, 0x70, 0x01, 0x61, 0x02, 0x44, 0x8c,
+    0x01, 0x0f, 0x02, 0x3f, 0x8a, 0x01, 0x1c, 0x02, 0x29, 0xb2, 0x01, 0x63,
+    0x02, 0x80, 0x86, 0x01, 0x0d, 0x02, 0x1f, 0x86, 0x01, 0xfc, 0x02, 0x98,
+    0x72, 0x01, 0x40, 0x02, 0xc4, 0x85, 0x01, 0x2d, 0x02, 0x5f, 0x06, 0x01,
+    0x08, 0x02, 0x79, 0x52, 0x01, 0x23, 0x02, 0x00, 0x98, 0x01, 0x2e, 0x02,
+    0x6f, 0x0a, 0x01, 0x08, 0x01, 0x08, 0x00, 0x3b,
+};
+
+/* 5x3 interlaced with a 4 color palette, shorter than the interlace passes */
+static const Uint8 gif_interlaced_small[] = {
+    0x47, 0x49, 0x46, 0x38, 0x39, 0x61, 0x05, 0x00, 0x03, 0x00, 0x91, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00,
+    0xff, 0x2c, 0x00, 0x00, 0x00, 0x00, 0x05, 0x00, 0x03, 0x00, 0x40, 0x02,
+    0x06, 0x44, 0x34, 0x60, 0x08, 0x7c, 0x05, 0x00, 0x3b,
+};
+
+static const SDL_Color gif_test_colors[] = {
+    { 0, 0, 0, 255 }, { 255, 0, 0, 255 }, { 0, 255, 0, 255 }, { 0, 0, 255, 255 }
+};
+
+/* Load a GIF from memory and check each pixel against its expected palette index */
+static void
+CheckGIFPixels(const char *name, const Uint8 *data, size_t size, const Uint8 *expected, int w, int h)
+{
+    SDL_Surface *surface;
+    int x, y, wrong = 0;
+
+    SDL_ClearError();
+    surface = IMG_LoadTyped_IO(SDL_IOFromConstMem(data, size), true, "GIF");
+    if (!SDLTest_AssertCheck(surface != NULL,
+                             "Load %s (%s)", name, SDL_GetError())) {
+        return;
+    }
+    if (ConvertToRgba32(&surface) &&
+        SDLTest_AssertCheck(surface->w == w && surface->h == h,
+                            "Expected %dx%d px, got %dx%d",
+                            w, h, surface->w, surface->h)) {
+        for (y = 0; y < h; y++) {
+            const Uint8 *p = (const Uint8 *)surface->pixels + y * surface->pitch;
+
+            for (x = 0; x < w; x++, p += 4) {
+                const SDL_Color *color = &gif_test_colors[expected[y * w + x]];
+
+                if (p[0] != color->r || p[1] != color->g || p[2] != color->b) {
+                    ++wrong;
+                }
+            }
+        }
+        SDLTest_AssertCheck(wrong == 0, "%s had %d wrong pixels", name, wrong);
+    }
+    SDL_DestroySurface(surface);
+}
+
+static int SDLCALL
+TestGIFDecoding(void *arg)
+{
+    Uint8 expected[16 * 8];
+    int x, y;
+    (void)arg;
+
+    for (y = 0; y < 8; y++) {
+        for (x = 0; x < 16; x++) {
+            expected[y * 16 + x] = (Uint8)((x * 3 + y * 5 + ((x * y) >> 2)) % 4);
+        }
+    }
+    CheckGIFPixels("GIF with short sub-blocks", gif_short_blocks, sizeof(gif_short_blocks), expected, 16, 8);
+
+    for (y = 0; y < 3; y++) {
+        for (x = 0; x < 5; x++) {
+            expected[y * 5 + x] = (Uint8)((x + 2 * y) % 4);
+        }
+    }
+    CheckGIFPixels("small interlaced GIF", gif_interlaced_small, sizeof(gif_interlaced_small), expected, 5, 3);
+
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference gifDecodingTestCase = {
+    TestGIFDecoding, "GIFDecoding", "Decode GIF data with unusual block and interlace layouts", TEST_ENABLED
+};
+
+/* 8x6 with 4 frames: a full frame, a transparent one disposed to the
+   background, one restored to the previous frame and an interlaced one */
+static const Uint8 gif_animation[] = {
+    0x47, 0x49, 0x46, 0x38, 0x39, 0x61, 0x08, 0x00, 0x06, 0x00, 0x91, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00, 0xff, 0x00, 0x00, 0x00,
+    0xff, 0x21, 0xff, 0x0b, 0x4e, 0x45, 0x54, 0x53, 0x43, 0x41, 0x50, 0x45,
+    0x32, 0x2e, 0x30, 0x03, 0x01, 0x00, 0x00, 0x00, 0x21, 0xf9, 0x04, 0x04,
+    0x0a, 0x00, 0x00, 0x00, 0x2c, 0x00, 0x00, 0x00, 0x00, 0x08, 0x00, 0x06,
+    0x00, 0x00, 0x02, 0x0c, 0x44, 0x34, 0x86, 0x97, 0x0c, 0xa8, 0x5a, 0x83,
+    0x27, 0x46, 0xe7, 0x0a, 0x00, 0x21, 0xf9, 0x04, 0x09, 0x14, 0x00, 0x03,
+    0x00, 0x2c, 0x02, 0x00, 0x01, 0x00, 0x04, 0x00, 0x03, 0x00, 0x00, 0x02,
+    0x05, 0x9c, 0x72, 0x83, 0x68, 0x05, 0x00, 0x21, 0xf9, 0x04, 0x0d, 0x05,
+    0x00, 0x00, 0x00, 0x2c, 0x01, 0x00, 0x02, 0x00, 0x05, 0x00, 0x03, 0x00,
+    0x00, 0x02, 0x06, 0x84, 0x1f, 0x32, 0x26, 0xd0, 0x05, 0x00, 0x21, 0xf9,
+    0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x2c, 0x00, 0x00, 0x00, 0x00, 0x08,
+    0x00, 0x06, 0x00, 0x40, 0x02, 0x0f, 0x44, 0x34, 0x86, 0x9a, 0x37, 0xeb,
+    0x4c, 0x00, 0x6f, 0xbe, 0x4a, 0xc5, 0xb4, 0x3a, 0x17, 0x00, 0x3b,
+};
+
+static const int gif_animation_delays[] = { 100, 200, 50, 100 };
+
+/* Decode an animation one frame at a time, twice with a rewind in between,
+   and check it against the same animation loaded all at once. This takes
+   ownership of anim and decoder. */
+static void
+CheckAnimationDecoder(const char *name, IMG_Animation *anim, IMG_AnimationDecoder *decoder)
+{
+    SDL_Surface *frame = NULL;
+    int pass, i, w, h, delay, diff;
+
+    if (!SDLTest_AssertCheck(anim != NULL,
+                             "Load %s as an animation (%s)", name, SDL_GetError()) ||
+        !SDLTest_AssertCheck(decoder != NULL,
+                             "Create a decoder for %s (%s)", name, SDL_GetError())) {
+        goto out;
+    }
+    if (!SDLTest_AssertCheck(IMG_GetAnimationDecoderSize(decoder, &w, &h) &&
+                             w == anim->w && h == anim->h,
+                             "Decoder size should be %dx%d", anim->w, anim->h)) {
+        goto out;
+    }
+    frame = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    if (!SDLTest_AssertCheck(frame != NULL,
+                             "Create a frame surface (%s)", SDL_GetError())) {
+        goto out;
+    }
+
+    for (pass = 0; pass < 2; pass++) {
+        if (pass > 0) {
+            SDLTest_AssertCheck(IMG_RewindAnimationDecoder(decoder),
+                                "Rewind the decoder for %s (%s)", name, SDL_GetError());
+        }
+        for (i = 0; i < anim->count; i++) {
+            delay = -1;
+            if (!SDLTest_AssertCheck(IMG_GetAnimationDecoderFrame(decoder, frame, &delay),
+                                     "Decode frame %d of %s (%s)", i, name, SDL_GetError())) {
+                goto out;
+            }
+            SDLTest_AssertCheck(delay == anim->delays[i],
+                                "Frame %d of %s should last %d ms, got %d",
+                                i, name, anim->delays[i], delay);
+            if (!ConvertToRgba32(&anim->frames[i])) {
+                goto out;
+            }
+            diff = SDLTest_CompareSurfaces(frame, anim->frames[i], 0);
+            SDLTest_AssertCheck(diff == 0,
+                                "Frame %d of %s differed in %d pixels", i, name, diff);
+        }
+        SDLTest_AssertCheck(!IMG_GetAnimationDecoderFrame(decoder, frame, NULL) &&
+                            IMG_GetAnimationDecoderStatus(decoder) == IMG_DECODER_STATUS_COMPLETE,
+                            "Decoding %s should be complete after %d frames", name, anim->count);
+    }
+
+out:
+    SDL_DestroySurface(frame);
+    IMG_CloseAnimationDecoder(decoder);
+    IMG_FreeAnimation(anim);
+}
+
+static int SDLCALL
+TestAnimationDecoder(void *arg)
+{
+    IMG_Animation *anim;
+    IMG_AnimationDecoder *decoder;
+    char *filename;
+    int i;
+    (void)arg;
+
+    filename = GetTestFilename(TEST_FILE_DIST, "palette.gif");
+    if (SDLTest_AssertCheck(filename != NULL,
+                            "Building filename should succeed (%s)",
+                            SDL_GetError())) {
+        CheckAnimationDecoder("palette.gif",
+                              IMG_LoadAnimation(filename),
+                              IMG_CreateAnimationDecoder(filename));
+        SDL_free(filename);
+    }
+
+    anim = IMG_LoadAnimationTyped_IO(SDL_IOFromConstMem(gif_animation, sizeof(gif_animation)), true, "GIF");
+    if (anim) {
+        bool match = (anim->count == SDL_arraysize(gif_animation_delays));
+
+        for (i = 0; match && i < anim->count; i++) {
+            match = (anim->delays[i] == gif_animation_delays[i]);
+        }
+        SDLTest_AssertCheck(match, "Animated GIF should have %d frames with the expected delays",
+                            (int)SDL_arraysize(gif_animation_delays));
+    }
+    decoder = IMG_CreateAnimationDecoder_IO(SDL_IOFromConstMem(gif_animation, sizeof(gif_animation)), true, "GIF");
+    CheckAnimationDecoder("animated GIF", anim, decoder);
+
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference animationDecoderTestCase = {
+    TestAnimationDecoder, "AnimationDecoder", "Decode animations one frame at a time", TEST_ENABLED
+};
+
+/* Apply every frame of a delta animation in order to a surface and to a
+   texture in the given format, and check them against the same animation
+   loaded all at once. This takes ownership of anim and delta. */
+static void
+CheckDeltaAnimation(const char *name, IMG_Animation *anim, IMG_DeltaAnimation *delta, SDL_PixelFormat format)
+{
+    SDL_Surface *frame = NULL;
+    SDL_Surface *target = NULL;
+    SDL_Surface *result;
+    SDL_Renderer *renderer = NULL;
+    SDL_Texture *texture = NULL;
+    int i, w, h, count, delay, diff;
+
+    if (!SDLTest_AssertCheck(anim != NULL,
+                             "Load %s as an animation (%s)", name, SDL_GetError()) ||
+        !SDLTest_AssertCheck(delta != NULL,
+                             "Load %s as a delta animation (%s)", name, SDL_GetError())) {
+        goto out;
+    }
+    if (!SDLTest_AssertCheck(IMG_GetDeltaAnimationInfo(delta, &w, &h, NULL, &count) &&
+                             w == anim->w && h == anim->h && count == anim->count,
+                             "Delta animation of %s should be %dx%d with %d frames",
+                             name, anim->w, anim->h, anim->count)) {
+        goto out;
+    }
+
+    frame = SDL_CreateSurface(w, h, format);
+    target = SDL_CreateSurface(w, h, format);
+    renderer = target ? SDL_CreateSoftwareRenderer(target) : NULL;
+    texture = renderer ? SDL_CreateTexture(renderer, format, SDL_TEXTUREACCESS_STREAMING, w, h) : NULL;
+    if (!SDLTest_AssertCheck(frame != NULL && texture != NULL,
+                             "Create a frame surface and texture (%s)", SDL_GetError())) {
+        goto out;
+    }
+    SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE);
+
+    for (i = 0; i < count; i++) {
+        if (!ConvertToRgba32(&anim->frames[i])) {
+            goto out;
+        }
+        SDLTest_AssertCheck(IMG_GetDeltaAnimationFrameInfo(delta, i, NULL, &delay) && delay == anim->delays[i],
+                            "Frame %d of %s should last %d ms", i, name, anim->delays[i]);
+
+        if (SDLTest_AssertCheck(IMG_ApplyDeltaAnimationFrame(delta, i, frame),
+                                "Apply frame %d of %s (%s)", i, name, SDL_GetError())) {
+            result = SDL_ConvertSurface(frame, SDL_PIXELFORMAT_RGBA32);
+            if (result) {
+                diff = SDLTest_CompareSurfaces(result, anim->frames[i], 0);
+                SDLTest_AssertCheck(diff == 0,
+                                    "Frame %d of %s applied to a surface differed in %d pixels", i, name, diff);
+                SDL_DestroySurface(result);
+            }
+        }
+
+        if (SDLTest_AssertCheck(IMG_UpdateDeltaAnimationTexture(delta, i, texture) &&
+                                SDL_RenderTexture(renderer, texture, NULL, NULL),
+                                "Update the texture with frame %d of %s (%s)", i, name, SDL_GetError())) {
+            result = SDL_RenderReadPixels(renderer, NULL);
+            if (result && ConvertToRgba32(&result)) {
+                diff = SDLTest_CompareSurfaces(result, anim->frames[i], 0);
+                SDLTest_AssertCheck(diff == 0,
+                                    "Frame %d of %s applied to a texture differed in %d pixels", i, name, diff);
+            }
+            SDL_DestroySurface(result);
+        }
+    }
+
+out:
+    SDL_DestroyTexture(texture);
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroySurface(target);
+    SDL_DestroySurface(frame);
+    IMG_FreeDeltaAnimation(delta);
+    IMG_FreeAnimation(anim);
+}
+
+static int SDLCALL
+TestDeltaAnimation(void *arg)
+{
+    IMG_DeltaAnimation *delta;
+    SDL_PixelFormat format = SDL_PIXELFORMAT_UNKNOWN;
+    char *filename;
+    (void)arg;
+
+    filename = GetTestFilename(TEST_FILE_DIST, "palette.gif");
+    if (SDLTest_AssertCheck(filename != NULL,
+                            "Building filename should succeed (%s)",
+                            SDL_GetError())) {
+        CheckDeltaAnimation("palette.gif",
+                            IMG_LoadAnimation(filename),
+                            IMG_LoadDeltaAnimation(filename),
+                            SDL_PIXELFORMAT_ARGB8888);
+        SDL_free(filename);
+    }
+
+    /* The frames share a palette, so they're kept as INDEX8 */
+    delta = IMG_LoadDeltaAnimation_IO(SDL_IOFromConstMem(gif_animation, sizeof(gif_animation)), true, "GIF");
+    SDLTest_AssertCheck(delta && IMG_GetDeltaAnimationInfo(delta, NULL, NULL, &format, NULL) &&
+                        format == SDL_PIXELFORMAT_INDEX8,
+                        "Animated GIF should be an INDEX8 delta animation, got %s",
+                        SDL_GetPixelFormatName(format));
+    CheckDeltaAnimation("animated GIF",
+                        IMG_LoadAnimationTyped_IO(SDL_IOFromConstMem(gif_animation, sizeof(gif_animation)), true, "GIF"),
+                        delta, SDL_PIXELFORMAT_ARGB8888);
+
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference deltaAnimationTestCase = {
+    TestDeltaAnimation, "DeltaAnimation", "Apply delta animation frames to surfaces and textures", TEST_ENABLED
+};
+
+/* Check that two animations have the same frames and delays, pixel for
+   pixel. This takes ownership of expected and actual. */
+static void
+CheckSameAnimation(const char *name, IMG_Animation *expected, IMG_Animation *actual)
+{
+    int i, diff;
+
+    if (!SDLTest_AssertCheck(expected != NULL && actual != NULL,
+                             "Load %s (%s)", name, SDL_GetError())) {
+        goto out;
+    }
+    if (!SDLTest_AssertCheck(actual->w == expected->w && actual->h == expected->h &&
+                             actual->count == expected->count,
+                             "%s should be %dx%d with %d frames, got %dx%d with %d",
+                             name, expected->w, expected->h, expected->count,
+                             actual->w, actual->h, actual->count)) {
+        goto out;
+    }
+
+    for (i = 0; i < expected->count; i++) {
+        SDLTest_AssertCheck(actual->delays[i] == expected->delays[i],
+                            "Frame %d of %s should last %d ms, got %d",
+                            i, name, expected->delays[i], actual->delays[i]);
+        if (!ConvertToRgba32(&expected->frames[i]) ||
+            !ConvertToRgba32(&actual->frames[i])) {
+            goto out;
+        }
+        diff = SDLTest_CompareSurfaces(actual->frames[i], expected->frames[i], 0);
+        SDLTest_AssertCheck(diff == 0,
+                            "Frame %d of %s differed in %d pixels", i, name, diff);
+    }
+
+out:
+    IMG_FreeAnimation(expected);
+    IMG_FreeAnimation(actual);
+}
+
+/* A stream that reads from another one but can't seek, like a pipe */
+static size_t SDLCALL
+NonSeekableRead(void *userdata, void *ptr, size_t size, SDL_IOStatus *status)
+{
+    SDL_IOStream *src = (SDL_IOStream *)userdata;
+    size_t amount = SDL_ReadIO(src, ptr, size);
+
+    *status = SDL_GetIOStatus(src);
+    return amount;
+}
+
+static Sint64 SDLCALL
+NonSeekableSeek(void *userdata, Sint64 offset, SDL_IOWhence whence)
+{
+    (void)userdata;
+    (void)offset;
+    (void)whence;
+    SDL_SetError("Can't seek in this stream");
+    return -1;
+}
+
+static bool SDLCALL
+NonSeekableClose(void *userdata)
+{
+    return SDL_CloseIO((SDL_IOStream *)userdata);
+}
+
+static SDL_IOStream *
+OpenNonSeekable(const void *data, size_t size)
+{
+    SDL_IOStreamInterface iface;
+    SDL_IOStream *src, *result;
+
+    src = SDL_IOFromConstMem(data, size);
+    if (!src) {
+        return NULL;
+    }
+    SDL_INIT_INTERFACE(&iface);
+    iface.read = NonSeekableRead;
+    iface.seek = NonSeekableSeek;
+    iface.close = NonSeekableClose;
+    result = SDL_OpenIO(&iface, src);
+    if (!result) {
+        SDL_CloseIO(src);
+    }
+    return result;
+}
+
+static int SDLCALL
+TestGIFAnimationStreams(void *arg)
+{
+    static const Uint8 trailer[] = { 'G', 'I', 'F', '!' };
+    Uint8 data[sizeof(gif_animation) + sizeof(trailer)];
+    IMG_Animation *anim;
+    SDL_IOStream *src;
+    (void)arg;
+
+    /* The stream is left right after the GIF data */
+    SDL_memcpy(data, gif_animation, sizeof(gif_animation));
+    SDL_memcpy(data + sizeof(gif_animation), trailer, sizeof(trailer));
+    src = SDL_IOFromConstMem(data, sizeof(data));
+    anim = src ? IMG_LoadGIFAnimation_IO(src) : NULL;
+    SDLTest_AssertCheck(src && SDL_TellIO(src) == (Sint64)sizeof(gif_animation),
+                        "Loading an animated GIF should stop at offset %d, got %d",
+                        (int)sizeof(gif_animation), src ? (int)SDL_TellIO(src) : -1);
+    SDL_CloseIO(src);
+    CheckSameAnimation("animated GIF followed by other data",
+                       IMG_LoadAnimationTyped_IO(SDL_IOFromConstMem(gif_animation, sizeof(gif_animation)), true, "GIF"),
+                       anim);
+
+    /* The frames are found before they're decoded, without seeking back */
+    src = OpenNonSeekable(gif_animation, sizeof(gif_animation));
+    anim = src ? IMG_LoadGIFAnimation_IO(src) : NULL;
+    SDL_CloseIO(src);
+    CheckSameAnimation("animated GIF from a stream that can't seek",
+                       IMG_LoadAnimationTyped_IO(SDL_IOFromConstMem(gif_animation, sizeof(gif_animation)), true, "GIF"),
+                       anim);
+
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference gifAnimationStreamsTestCase = {
+    TestGIFAnimationStreams, "GIFAnimationStreams", "Load GIF animations from streams that can't seek", TEST_ENABLED
+};
+
+/* Load a GIF animation with the frames decoded on a number of threads */
+static IMG_Animation *
+LoadGIFAnimationWithThreads(SDL_IOStream *src, const char *threads)
+{
+    IMG_Animation *anim;
+
+    SDL_SetHint(IMG_HINT_GIF_LOAD_THREADS, threads);
+    anim = IMG_LoadAnimationTyped_IO(src, true, "GIF");
+    SDL_ResetHint(IMG_HINT_GIF_LOAD_THREADS);
+    return anim;
+}
+
+static int SDLCALL
+TestGIFLoadThreads(void *arg)
+{
+    char *filename;
+    (void)arg;
+
+    filename = GetTestFilename(TEST_FILE_DIST, "palette.gif");
+    if (SDLTest_AssertCheck(filename != NULL,
+                            "Building filename should succeed (%s)",
+                            SDL_GetError())) {
+        CheckSameAnimation("palette.gif loaded on 4 threads",
+                           LoadGIFAnimationWithThreads(SDL_IOFromFile(filename, "rb"), "1"),
+                           LoadGIFAnimationWithThreads(SDL_IOFromFile(filename, "rb"), "4"));
+        SDL_free(filename);
+    }
+
+    CheckSameAnimation("animated GIF loaded on 4 threads",
+                       LoadGIFAnimationWithThreads(SDL_IOFromConstMem(gif_animation, sizeof(gif_animation)), "1"),
+                       LoadGIFAnimationWithThreads(SDL_IOFromConstMem(gif_animation, sizeof(gif_animation)), "4"));
+
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference gifLoadThreadsTestCase = {
+    TestGIFLoadThreads, "GIFLoadThreads", "Load GIF animations on several threads", TEST_ENABLED
+};
+
+#if SDL_IMAGE_SAVE_GIF
+/* Draw one of three 8x6 test pictures, each clearing pixels that the others
+   have set, with every pixel either fully transparent or opaque */
+static SDL_Surface *
+CreateGIFTestFrame(int picture)
+{
+    SDL_Surface *frame;
+    SDL_Rect rect;
+
+    frame = SDL_CreateSurface(8, 6, SDL_PIXELFORMAT_RGBA32);
+    if (!frame) {
+        return NULL;
+    }
+    switch (picture) {
+    case 0:
+        SDL_FillSurfaceRect(frame, NULL, SDL_MapSurfaceRGBA(frame, 255, 0, 0, 255));
+        rect.x = 2;
+        rect.y = 1;
+        rect.w = 3;
+        rect.h = 3;
+        SDL_FillSurfaceRect(frame, &rect, SDL_MapSurfaceRGBA(frame, 0, 0, 255, 255));
+        rect.x = 0;
+        rect.y = 0;
+        rect.w = 1;
+        rect.h = 1;
+        SDL_FillSurfaceRect(frame, &rect, 0);
+        break;
+    case 1:
+        SDL_FillSurfaceRect(frame, NULL, SDL_MapSurfaceRGBA(frame, 255, 0, 0, 255));
+        rect.x = 4;
+        rect.y = 2;
+        rect.w = 4;
+        rect.h = 4;
+        SDL_FillSurfaceRect(frame, &rect, 0);
+        rect.x = 1;
+        rect.y = 1;
+        rect.w = 1;
+        rect.h = 1;
+        SDL_FillSurfaceRect(frame, &rect, SDL_MapSurfaceRGBA(frame, 0, 255, 0, 255));
+        break;
+    default:
+        rect.x = 0;
+        rect.y = 5;
+        rect.w = 8;
+        rect.h = 1;
+        SDL_FillSurfaceRect(frame, &rect, SDL_MapSurfaceRGBA(frame, 255, 255, 255, 255));
+        break;
+    }
+    return frame;
+}
+
+/* Build an animation from a list of test pictures and delays */
+static IMG_Animation *
+CreateGIFTestAnimation(const int *pictures, const int *delays, int count)
+{
+    IMG_Animation *anim;
+    int i;
+
+    anim = (IMG_Animation *)SDL_calloc(1, sizeof(*anim));
+    if (!anim) {
+        return NULL;
+    }
+    anim->w = 8;
+    anim->h = 6;
+    anim->count = count;
+    anim->frames = (SDL_Surface **)SDL_calloc(count, sizeof(*anim->frames));
+    anim->delays = (int *)SDL_calloc(count, sizeof(*anim->delays));
+    if (!anim->frames || !anim->delays) {
+        IMG_FreeAnimation(anim);
+        return NULL;
+    }
+    for (i = 0; i < count; i++) {
+        anim->frames[i] = CreateGIFTestFrame(pictures[i]);
+        if (!anim->frames[i]) {
+            IMG_FreeAnimation(anim);
+            return NULL;
+        }
+        anim->delays[i] = delays[i];
+    }
+    return anim;
+}
+
+/* Save an animation as a GIF and load it back */
+static IMG_Animation *
+SaveAndReloadGIFAnimation(IMG_Animation *anim, SDL_PropertiesID props)
+{
+    IMG_Animation *result = NULL;
+    SDL_IOStream *mem;
+    bool saved;
+
+    mem = SDL_IOFromDynamicMem();
+    if (!mem) {
+        return NULL;
+    }
+    if (props) {
+        saved = IMG_SaveGIFAnimationWithProperties(anim, mem, false, props);
+    } else {
+        saved = IMG_SaveGIFAnimation_IO(anim, mem, false);
+    }
+    if (SDLTest_AssertCheck(saved, "Save GIF animation (%s)", SDL_GetError())) {
+        SDL_SeekIO(mem, 0, SDL_IO_SEEK_SET);
+        result = IMG_LoadAnimationTyped_IO(mem, false, "GIF");
+    }
+    SDL_CloseIO(mem);
+    return result;
+}
+
+static int SDLCALL
+TestGIFSaveAnimation(void *arg)
+{
+    /* Frames that clear pixels, and runs of identical frames */
+    static const int pictures[] = { 0, 1, 1, 2, 2, 0 };
+    static const int delays[] = { 100, 50, 30, 200, 20, 70 };
+
+    /* Identical frames are merged, adding up their delays */
+    static const int merged_pictures[] = { 0, 1, 2, 0 };
+    static const int merged_delays[] = { 100, 80, 220, 70 };
+    IMG_Animation *anim;
+    SDL_PropertiesID props;
+    (void)arg;
+
+    anim = CreateGIFTestAnimation(pictures, delays, SDL_arraysize(pictures));
+    if (!SDLTest_AssertCheck(anim != NULL,
+                             "Create a test animation (%s)", SDL_GetError())) {
+        return TEST_ABORTED;
+    }
+    CheckSameAnimation("saved GIF animation",
+                       CreateGIFTestAnimation(merged_pictures, merged_delays, SDL_arraysize(merged_pictures)),
+                       SaveAndReloadGIFAnimation(anim, 0));
+
+    /* Without optimization every frame is stored whole */
+    props = SDL_CreateProperties();
+    SDL_SetBooleanProperty(props, IMG_PROP_GIF_SAVE_OPTIMIZE_BOOLEAN, false);
+    CheckSameAnimation("saved GIF animation without optimization",
+                       CreateGIFTestAnimation(pictures, delays, SDL_arraysize(pictures)),
+                       SaveAndReloadGIFAnimation(anim, props));
+    SDL_DestroyProperties(props);
+
+    IMG_FreeAnimation(anim);
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference gifSaveAnimationTestCase = {
+    TestGIFSaveAnimation, "GIFSaveAnimation", "Save GIF animations and load them back", TEST_ENABLED
+};
+#endif
+#endif
+
+#if defined(LOAD_GIF) || defined(LOAD_PNG)
+#ifdef LOAD_PNG
+/* 2x2 APNG with 4 frames lasting 0, 100, 0 and 50 ms */
+static const Uint8 png_mixed_delays[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02,
+    0x08, 0x06, 0x00, 0x00, 0x00, 0x72, 0xb6, 0x0d, 0x24, 0x00, 0x00, 0x00,
+    0x08, 0x61, 0x63, 0x54, 0x4c, 0x00, 0x00, 0x00, 0x04, 0x00, 0x00, 0x00,
+    0x00, 0x7c, 0xcd, 0x66, 0xd0, 0x00, 0x00, 0x00, 0x1a, 0x66, 0x63, 0x54,
+    0x4c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+    0xe8, 0x00, 0x00, 0x6d, 0xe7, 0x5e, 0x90, 0x00, 0x00, 0x00, 0x11, 0x49,
+    0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0xf8, 0xcf, 0xc0, 0xf0, 0x1f, 0x84,
+    0x19, 0x60, 0x0c, 0x00, 0x47, 0xca, 0x07, 0xf9, 0x1a, 0xb6, 0xf1, 0xa9,
+    0x00, 0x00, 0x00, 0x1a, 0x66, 0x63, 0x54, 0x4c, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x64, 0x03, 0xe8, 0x00, 0x00, 0x9a, 0x26,
+    0x65, 0xc9, 0x00, 0x00, 0x00, 0x12, 0x66, 0x64, 0x41, 0x54, 0x00, 0x00,
+    0x00, 0x02, 0x78, 0xda, 0x63, 0x60, 0xf8, 0x0f, 0x85, 0x30, 0x06, 0x00,
+    0x43, 0xce, 0x07, 0xf9, 0xc3, 0x00, 0x69, 0xaf, 0x00, 0x00, 0x00, 0x1a,
+    0x66, 0x63, 0x54, 0x4c, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x03, 0xe8, 0x00, 0x00, 0x1b, 0x02, 0x67, 0xad, 0x00, 0x00,
+    0x00, 0x14, 0x66, 0x64, 0x41, 0x54, 0x00, 0x00, 0x00, 0x04, 0x78, 0xda,
+    0x63, 0x60, 0x60, 0xf8, 0xff, 0x1f, 0x82, 0xa1, 0x0c, 0x00, 0x3f, 0xd2,
+    0x07, 0xf9, 0x99, 0x35, 0xd9, 0xca, 0x00, 0x00, 0x00, 0x1a, 0x66, 0x63,
+    0x54, 0x4c, 0x00, 0x00, 0x00, 0x05, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00,
+    0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x32,
+    0x03, 0xe8, 0x00, 0x00, 0x2d, 0x29, 0xfe, 0x31, 0x00, 0x00, 0x00, 0x12,
+    0x66, 0x64, 0x41, 0x54, 0x00, 0x00, 0x00, 0x06, 0x78, 0xda, 0x63, 0xf8,
+    0x0f, 0x05, 0x0c, 0x30, 0x06, 0x00, 0x8f, 0x82, 0x0f, 0xf1, 0x82, 0x7b,
+    0xb8, 0x72, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45, 0x4e, 0x44, 0xae, 0x42,
+    0x60, 0x82,
+};
+
+/* 2x2 APNG with 3 frames that all last 0 ms */
+static const Uint8 png_zero_delays[] = {
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02,
+    0x08, 0x06, 0x00, 0x00, 0x00, 0x72, 0xb6, 0x0d, 0x24, 0x00, 0x00, 0x00,
+    0x08, 0x61, 0x63, 0x54, 0x4c, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x00, 0xce, 0xed, 0xba, 0xc0, 0x00, 0x00, 0x00, 0x1a, 0x66, 0x63, 0x54,
+    0x4c, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03,
+    0xe8, 0x00, 0x00, 0x6d, 0xe7, 0x5e, 0x90, 0x00, 0x00, 0x00, 0x11, 0x49,
+    0x44, 0x41, 0x54, 0x78, 0xda, 0x63, 0xf8, 0xcf, 0xc0, 0xf0, 0x1f, 0x84,
+    0x19, 0x60, 0x0c, 0x00, 0x47, 0xca, 0x07, 0xf9, 0x1a, 0xb6, 0xf1, 0xa9,
+    0x00, 0x00, 0x00, 0x1a, 0x66, 0x63, 0x54, 0x4c, 0x00, 0x00, 0x00, 0x01,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xe8, 0x00, 0x00, 0xf6, 0x94,
+    0xb4, 0x44, 0x00, 0x00, 0x00, 0x12, 0x66, 0x64, 0x41, 0x54, 0x00, 0x00,
+    0x00, 0x02, 0x78, 0xda, 0x63, 0x60, 0xf8, 0x0f, 0x85, 0x30, 0x06, 0x00,
+    0x43, 0xce, 0x07, 0xf9, 0xc3, 0x00, 0x69, 0xaf, 0x00, 0x00, 0x00, 0x1a,
+    0x66, 0x63, 0x54, 0x4c, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x02,
+    0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x03, 0xe8, 0x00, 0x00, 0x1b, 0x02, 0x67, 0xad, 0x00, 0x00,
+    0x00, 0x14, 0x66, 0x64, 0x41, 0x54, 0x00, 0x00, 0x00, 0x04, 0x78, 0xda,
+    0x63, 0x60, 0x60, 0xf8, 0xff, 0x1f, 0x82, 0xa1, 0x0c, 0x00, 0x3f, 0xd2,
+    0x07, 0xf9, 0x99, 0x35, 0xd9, 0xca, 0x00, 0x00, 0x00, 0x00, 0x49, 0x45,
+    0x4e, 0x44, 0xae, 0x42, 0x60, 0x82,
+};
+#endif
+
+/* Decode the frame at index by rewinding and reading every frame in order */
+static bool
+DecodeFrameInOrder(IMG_AnimationDecoder *decoder, int index, SDL_Surface *frame, int *delay)
+{
+    int i;
+
+    if (!IMG_RewindAnimationDecoder(decoder)) {
+        return false;
+    }
+    for (i = 0; i <= index; i++) {
+        if (!IMG_GetAnimationDecoderFrame(decoder, frame, delay)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void
+CheckSeekToTime(const char *name, IMG_AnimationDecoder *decoder, Uint64 ms, int expected_index, SDL_Surface *expected, SDL_Surface *actual)
+{
+    int index = -1, diff;
+
+    if (!SDLTest_AssertCheck(IMG_SeekAnimationDecoderToTime(decoder, ms, &index) && index == expected_index,
+                             "Seeking %s to %" SDL_PRIu64 " ms should go to frame %d, got %d (%s)",
+                             name, ms, expected_index, index, SDL_GetError()) ||
+        !SDLTest_AssertCheck(IMG_GetAnimationDecoderFrame(decoder, actual, NULL),
+                             "Decode frame %d of %s (%s)", index, name, SDL_GetError())) {
+        return;
+    }
+    diff = SDLTest_CompareSurfaces(actual, expected, 0);
+    SDLTest_AssertCheck(diff == 0,
+                        "Frame at %" SDL_PRIu64 " ms of %s differed in %d pixels", ms, name, diff);
+}
+
+/* Seek to every frame of an animation, by index and by time, and check it
+   against the same frame decoded in order by a second decoder. This takes
+   ownership of decoder and reference. */
+static void
+CheckAnimationSeeking(const char *name, IMG_AnimationDecoder *decoder, IMG_AnimationDecoder *reference)
+{
+    SDL_Surface *expected = NULL, *actual = NULL;
+    Uint64 start, total = 0;
+    int count = 0, i, w, h, delay, diff;
+
+    if (!SDLTest_AssertCheck(decoder != NULL && reference != NULL,
+                             "Create decoders for %s (%s)", name, SDL_GetError()) ||
+        !SDLTest_AssertCheck(IMG_GetAnimationDecoderSize(decoder, &w, &h),
+                             "Get the size of %s (%s)", name, SDL_GetError())) {
+        goto out;
+    }
+    expected = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    actual = SDL_CreateSurface(w, h, SDL_PIXELFORMAT_RGBA32);
+    if (!SDLTest_AssertCheck(expected != NULL && actual != NULL,
+                             "Create frame surfaces (%s)", SDL_GetError())) {
+        goto out;
+    }
+
+    while (IMG_GetAnimationDecoderFrame(reference, expected, &delay)) {
+        total += SDL_max(delay, 0);
+        ++count;
+    }
+    if (!SDLTest_AssertCheck(count > 0, "%s should have frames (%s)", name, SDL_GetError())) {
+        goto out;
+    }
+
+    /* Go backwards, so every seek goes to an earlier frame */
+    for (i = count - 1; i >= 0; i--) {
+        if (!SDLTest_AssertCheck(DecodeFrameInOrder(reference, i, expected, NULL),
+                                 "Decode %s up to frame %d (%s)", name, i, SDL_GetError()) ||
+            !SDLTest_AssertCheck(IMG_SeekAnimationDecoder(decoder, i) &&
+                                 IMG_GetAnimationDecoderFrame(decoder, actual, NULL),
+                                 "Seek to frame %d of %s and decode it (%s)", i, name, SDL_GetError())) {
+            goto out;
+        }
+        diff = SDLTest_CompareSurfaces(actual, expected, 0);
+        SDLTest_AssertCheck(diff == 0,
+                            "Frame %d of %s differed in %d pixels after seeking", i, name, diff);
+    }
+
+    if (total == 0) {
+        /* Nothing moves, so the first frame is showing all the time */
+        if (SDLTest_AssertCheck(DecodeFrameInOrder(reference, 0, expected, NULL),
+                                "Decode the first frame of %s (%s)", name, SDL_GetError())) {
+            CheckSeekToTime(name, decoder, 0, 0, expected, actual);
+            CheckSeekToTime(name, decoder, 1000, 0, expected, actual);
+        }
+        goto out;
+    }
+
+    /* Frames that last 0 ms are never showing */
+    for (i = 0, start = 0; i < count; i++, start += SDL_max(delay, 0)) {
+        if (!SDLTest_AssertCheck(DecodeFrameInOrder(reference, i, expected, &delay),
+                                 "Decode %s up to frame %d (%s)", name, i, SDL_GetError())) {
+            goto out;
+        }
+        if (delay > 0) {
+            CheckSeekToTime(name, decoder, start, i, expected, actual);
+            CheckSeekToTime(name, decoder, start + delay - 1, i, expected, actual);
+        }
+    }
+    SDLTest_AssertCheck(!IMG_SeekAnimationDecoderToTime(decoder, total, NULL),
+                        "Seeking %s to %" SDL_PRIu64 " ms should be past the end", name, total);
+
+out:
+    SDL_DestroySurface(expected);
+    SDL_DestroySurface(actual);
+    IMG_CloseAnimationDecoder(decoder);
+    IMG_CloseAnimationDecoder(reference);
+}
+
+static void
+CheckAnimationSeekingInMemory(const char *name, const Uint8 *data, size_t size)
+{
+    CheckAnimationSeeking(name,
+                          IMG_CreateAnimationDecoder_IO(SDL_IOFromConstMem(data, size), true, NULL),
+                          IMG_CreateAnimationDecoder_IO(SDL_IOFromConstMem(data, size), true, NULL));
+}
+
+static int SDLCALL
+TestAnimationSeeking(void *arg)
+{
+    (void)arg;
+
+#ifdef LOAD_GIF
+    {
+        char *filename = GetTestFilename(TEST_FILE_DIST, "palette.gif");
+
+        if (SDLTest_AssertCheck(filename != NULL,
+                                "Building filename should succeed (%s)",
+                                SDL_GetError())) {
+            CheckAnimationSeeking("palette.gif",
+                                  IMG_CreateAnimationDecoder(filename),
+                                  IMG_CreateAnimationDecoder(filename));
+            SDL_free(filename);
+        }
+    }
+    CheckAnimationSeekingInMemory("animated GIF", gif_animation, sizeof(gif_animation));
+#endif
+#ifdef LOAD_PNG
+    CheckAnimationSeekingInMemory("APNG with mixed delays", png_mixed_delays, sizeof(png_mixed_delays));
+    CheckAnimationSeekingInMemory("APNG with no delays", png_zero_delays, sizeof(png_zero_delays));
+#endif
+
+    return TEST_COMPLETED;
+}
+
+static const SDLTest_TestCaseReference animationSeekingTestCase = {
+    TestAnimationSeeking, "AnimationSeeking", "Seek animations by frame and by time", TEST_ENABLED
+};
+#endif
+
+static const SDLTest_TestCaseReference formatsTestCase = {
+    TestFormats, "Images", "Load and save various image formats", TEST_ENABLED
+};
+
+static const SDLTest_TestCaseReference *testCases[] =  {
+    &formatsTestCase,
+#if (USING_IMAGEIO && defined(JPG_USES_IMAGEIO)) || defined(SDL_IMAGE_USE_WIC_BACKEND) || defined(LOAD_JPG)
+    &jpgDecodeModesTestCase,
+#endif
+#if defined(LOAD_JPG) && SDL_IMAGE_SAVE_JPG
+    &jpgThumbnailTestCase,
+#endif
+#if ((USING_IMAGEIO && defined(JPG_USES_IMAGEIO)) || defined(SDL_IMAGE_USE_WIC_BACKEND) || defined(LOAD_JPG)) && SDL_IMAGE_SAVE_JPG
+    &jpgSaveThreadsTestCase,
+#endif
+#ifdef TEST_JPG_TRANSFORM
+    &jpgTransformTestCase,
+#endif
+#if ((USING_IMAGEIO && defined(PNG_USES_IMAGEIO)) || defined(SDL_IMAGE_USE_WIC_BACKEND) || defined(LOAD_PNG)) && SDL_IMAGE_SAVE_PNG
+    &pngSaveThreadsTestCase,
+    &pngSavePaletteTestCase,
+#endif
+#if defined(LOAD_PNG) && (defined(USE_STBIMAGE) || \
+    !(defined(SDL_IMAGE_USE_WIC_BACKEND) || (USING_IMAGEIO && defined(PNG_USES_IMAGEIO))))
+    &pngLoad16BitTestCase,
+    &pngSkipChecksumsTestCase,
+#endif
+#ifdef LOAD_PNG
+    &pngStreamTestCase,
+    &pngFiltersTestCase,
+#endif
+#ifdef LOAD_GIF
+    &gifDecodingTestCase,
+    &animationDecoderTestCase,
+    &deltaAnimationTestCase,
+    &gifAnimationStreamsTestCase,
+    &gifLoadThreadsTestCase,
+#if SDL_IMAGE_SAVE_GIF
+    &gifSaveAnimationTestCase,
+#endif
+#endif
+#if defined(LOAD_GIF) || defined(LOAD_PNG)
+    &animationSeekingTestCase,
+#endif
     NULL
 };
 static SDLTest_TestSuiteReference testSuite = {